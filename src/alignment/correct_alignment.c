@@ -142,7 +142,7 @@ static TraversalResult traverse_one_way2(const dBNode *block, size_t n,
   }
 
   result.gap_len = contig->len - init_len;
-  rpt_walker_fast_clear(rptwlk, contig->data+init_len, result.gap_len);
+  rpt_walker_clear(rptwlk);
 
   // Check paths match remaining nodes
   if(result.traversed && do_paths_check) {
@@ -256,8 +256,8 @@ static TraversalResult traverse_two_way2(dBNodeBuffer *contig0,
   }
 
   // Clear RepeatWalker
-  rpt_walker_fast_clear(rptwlk0, contig0->data+init_len0, contig0->len-init_len0);
-  rpt_walker_fast_clear(rptwlk1, contig1->data+init_len1, contig1->len-init_len1);
+  rpt_walker_clear(rptwlk0);
+  rpt_walker_clear(rptwlk1);
 
   // Clean up GraphWalker
   graph_walker_finish(wlk0);
@@ -579,7 +579,7 @@ void correct_aln_read(CorrectAlnWorker *wrkr, const CorrectAlnParam *params,
     revcontig->len = i;
 
     graph_walker_finish(wlk);
-    rpt_walker_fast_clear(rptwlk, revcontig->data, revcontig->len);
+    rpt_walker_clear(rptwlk);
 
     if(revcontig->len > 0)
       wrkr->aln_stats.num_end_traversed++;
@@ -624,6 +624,6 @@ void correct_aln_read(CorrectAlnWorker *wrkr, const CorrectAlnParam *params,
       wrkr->aln_stats.num_end_traversed++;
 
     graph_walker_finish(wlk);
-    rpt_walker_fast_clear(rptwlk, nodebuf->data+orig_len, nodebuf->len-orig_len);
+    rpt_walker_clear(rptwlk);
   }
 }
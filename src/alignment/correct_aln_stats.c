@@ -80,6 +80,24 @@ void correct_aln_stats_add_contig(CorrectAlnStats *stats, size_t contig_len_bp)
   stats->contig_histgrm.data[contig_len_bp]++;
 }
 
+cJSON* correct_aln_stats_to_json(const CorrectAlnStats *stats,
+                                 const LoadingStats *load_stats)
+{
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddItemToObject(json, "loading", loading_stats_to_json(load_stats));
+  cJSON_AddNumberToObject(json, "num_gap_attempts",    stats->num_gap_attempts);
+  cJSON_AddNumberToObject(json, "num_gap_successes",   stats->num_gap_successes);
+  cJSON_AddNumberToObject(json, "num_paths_disagreed", stats->num_paths_disagreed);
+  cJSON_AddNumberToObject(json, "num_gaps_too_short",  stats->num_gaps_too_short);
+  cJSON_AddNumberToObject(json, "num_ins_gaps",        stats->num_ins_gaps);
+  cJSON_AddNumberToObject(json, "num_ins_traversed",   stats->num_ins_traversed);
+  cJSON_AddNumberToObject(json, "num_mid_gaps",        stats->num_mid_gaps);
+  cJSON_AddNumberToObject(json, "num_mid_traversed",   stats->num_mid_traversed);
+  cJSON_AddNumberToObject(json, "num_end_gaps",        stats->num_end_gaps);
+  cJSON_AddNumberToObject(json, "num_end_traversed",   stats->num_end_traversed);
+  return json;
+}
+
 // Save gap size distribution matrix
 void correct_aln_stats_dump_gaps(const CorrectAlnStats *stats, const char *path)
 {
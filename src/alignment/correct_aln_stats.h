@@ -58,6 +58,11 @@ void correct_aln_stats_add_mp(CorrectAlnStats *stats, size_t gap_kmers,
 
 void correct_aln_stats_add_contig(CorrectAlnStats *stats, size_t contig_len_bp);
 
+// Returns a new JSON object with the gap counts of `stats` and the read counts
+// of `load_stats`
+cJSON* correct_aln_stats_to_json(const CorrectAlnStats *stats,
+                                 const LoadingStats *load_stats);
+
 // Save gap size distribution
 void correct_aln_stats_dump_gaps(const CorrectAlnStats *stats, const char *path);
 // Save fragment size vector
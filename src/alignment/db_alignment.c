@@ -33,10 +33,11 @@ static size_t db_alignment_from_read(dBAlignment *aln, const read_t *r,
   size_t contig_start, contig_end = 0, search_start = 0;
   const size_t kmer_size = db_graph->kmer_size;
 
-  BinaryKmer bkmer, tmp_key;
-  Nucleotide nuc;
-  hkey_t node;
-  size_t i, offset, nxtbse;
+  BinaryKmerIter kmer_iter;
+  BinaryKmer bkeys[DB_GRAPH_BATCH];
+  Orientation orients[DB_GRAPH_BATCH];
+  dBNode node, batch[DB_GRAPH_BATCH];
+  size_t i, j, m, offset, contig_kmers;
 
   dBNodeBuffer *nodes = &aln->nodes;
   Int32Buffer *rpos = &aln->rpos;
@@ -56,23 +57,29 @@ static size_t db_alignment_from_read(dBAlignment *aln, const read_t *r,
     const char *contig = r->seq.b + contig_start;
     size_t contig_len = contig_end - contig_start;
 
-    bkmer = binary_kmer_from_str(contig, kmer_size);
-    bkmer = binary_kmer_right_shift_one_base(bkmer);
+    if(contig_len < kmer_size) continue;
+    contig_kmers = contig_len + 1 - kmer_size;
 
-    for(offset=contig_start, nxtbse=kmer_size-1; nxtbse < contig_len; nxtbse++,offset++)
+    binary_kmer_iter_init(&kmer_iter, kmer_size);
+    binary_kmer_iter_add_str(&kmer_iter, contig, kmer_size-1);
+
+    // Look up kmers in batches
+    for(offset = 0; offset < contig_kmers; offset += m)
     {
-      nuc = dna_char_to_nuc(contig[nxtbse]);
-      bkmer = binary_kmer_left_shift_add(bkmer, kmer_size, nuc);
-      tmp_key = binary_kmer_get_key(bkmer, kmer_size);
-      node = hash_table_find(&db_graph->ht, tmp_key);
-
-      if(node != HASH_NOT_FOUND &&
-         (colour == -1 || db_node_has_col(db_graph, node, colour)))
-      {
-        nodes->data[n].key = node;
-        nodes->data[n].orient = bkmer_get_orientation(bkmer, tmp_key);
-        rpos->data[n] = offset;
-        n++;
+      m = MIN2(contig_kmers - offset, DB_GRAPH_BATCH);
+      binary_kmer_iter_keys(&kmer_iter, contig+kmer_size-1+offset, m,
+                            bkeys, orients);
+      db_graph_find_batch(db_graph, bkeys, orients, m, batch);
+
+      for(j = 0; j < m; j++) {
+        node = batch[j];
+        if(node.key != HASH_NOT_FOUND &&
+           (colour == -1 || db_node_has_col(db_graph, node.key, colour)))
+        {
+          nodes->data[n] = node;
+          rpos->data[n] = contig_start+offset+j;
+          n++;
+        }
       }
     }
   }
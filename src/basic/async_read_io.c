@@ -5,6 +5,7 @@
 #include "util.h" // util_run_threads()
 
 #include <pthread.h>
+#include <sys/time.h> // gettimeofday()
 
 struct AsyncIOWorker
 {
@@ -12,6 +13,15 @@ struct AsyncIOWorker
   MsgPool *const pool;
   AsyncIOInput task;
   size_t *const num_running;
+  size_t *const num_reads;
+  // Batch currently being filled, pos is -1 if we don't have one
+  AsyncIOBatch *batch;
+  int pos;
+  // If sharded, this worker reads shard shard_idx of num_shards of file1,
+  // using nthreads to decompress (BAM only)
+  bool sharded;
+  size_t shard_idx, num_shards, nthreads;
+  uint8_t qoffset, qmin, qmax;
 };
 
 
@@ -98,35 +108,50 @@ void asynciodata_dealloc(AsyncIOData *iod)
   seq_read_dealloc(&iod->r2);
 }
 
-void asynciodata_pool_init(void *el, size_t idx, void *args)
+void asynciobatch_pool_init(void *el, size_t idx, void *args)
 {
-  // status("alloc: %zu %p", idx, el);
-  AsyncIOData *store = (AsyncIOData*)args, *data = store + idx;
-  memcpy(el, &data, sizeof(AsyncIOData*));
+  AsyncIOBatch *store = (AsyncIOBatch*)args, *batch = store + idx;
+  memcpy(el, &batch, sizeof(AsyncIOBatch*));
 }
 
 // No memory allocated for io worker
 static void async_io_worker_init(AsyncIOWorker *wrkr,
                                  const AsyncIOInput *task,
-                                 MsgPool *pool, size_t *num_running)
+                                 MsgPool *pool, size_t *num_running,
+                                 size_t *num_reads)
 {
-  ctx_assert(pool->elsize == sizeof(AsyncIOData*));
-  AsyncIOWorker tmp = {.pool = pool, .task = *task, .num_running = num_running};
+  ctx_assert(pool->elsize == sizeof(AsyncIOBatch*));
+  AsyncIOWorker tmp = {.pool = pool, .task = *task, .num_running = num_running,
+                       .num_reads = num_reads, .batch = NULL, .pos = -1};
   memcpy(wrkr, &tmp, sizeof(AsyncIOWorker));
 }
 
+// Pass the batch being filled to the consumers
+static void async_io_worker_release(AsyncIOWorker *wrkr)
+{
+  if(wrkr->pos == -1) return;
+  __sync_fetch_and_add((volatile size_t*)wrkr->num_reads, wrkr->batch->len);
+  msgpool_release(wrkr->pool, wrkr->pos, MPOOL_FULL);
+  wrkr->batch = NULL;
+  wrkr->pos = -1;
+}
+
 static void add_to_pool(read_t *r1, read_t *r2,
                         uint8_t fq_offset1, uint8_t fq_offset2,
                         void *arg)
 {
   AsyncIOWorker *wrkr = (AsyncIOWorker*)arg;
   MsgPool *pool = wrkr->pool;
-  int pos;
   AsyncIOData *data;
 
-  // Swap reads and parameters into the data obj
-  pos = msgpool_claim_write(pool);
-  memcpy(&data, msgpool_get_ptr(pool, pos), sizeof(AsyncIOData*));
+  if(wrkr->pos == -1) {
+    wrkr->pos = msgpool_claim_write(pool);
+    memcpy(&wrkr->batch, msgpool_get_ptr(pool, wrkr->pos), sizeof(AsyncIOBatch*));
+    wrkr->batch->len = 0;
+  }
+
+  // Swap reads and parameters into the next data obj in the batch
+  data = &wrkr->batch->data[wrkr->batch->len++];
 
   data->fq_offset1 = fq_offset1;
   data->fq_offset2 = fq_offset2;
@@ -137,7 +162,8 @@ static void add_to_pool(read_t *r1, read_t *r2,
   if(r2) SWAP(data->r2, *r2);
   else seq_read_reset(&data->r2);
 
-  msgpool_release(pool, pos, MPOOL_FULL);
+  if(wrkr->batch->len == ASYNCIO_BATCH_SIZE)
+    async_io_worker_release(wrkr);
 }
 
 static void* async_io_reader(void *ptr) __attribute__((noreturn));
@@ -151,7 +177,17 @@ static void* async_io_reader(void *ptr)
   seq_read_alloc(&r1);
   seq_read_alloc(&r2);
 
-  if(task->interleaved)
+  if(wrkr->sharded)
+  {
+    SeqShard shard;
+    seq_shard_open(&shard, task->file1, wrkr->shard_idx, wrkr->num_shards,
+                   wrkr->nthreads);
+    seq_parse_shard(&shard, task->interleaved,
+                    wrkr->qoffset, wrkr->qmin, wrkr->qmax,
+                    &r1, &r2, add_to_pool, wrkr);
+    seq_shard_close(&shard);
+  }
+  else if(task->interleaved)
   {
     seq_parse_interleaved_sf(task->file1, task->fq_offset,
                              &r1, &r2, add_to_pool, wrkr);
@@ -163,6 +199,9 @@ static void* async_io_reader(void *ptr)
   seq_read_dealloc(&r1);
   seq_read_dealloc(&r2);
 
+  // Pass on the last partially filled batch
+  async_io_worker_release(wrkr);
+
   // Check if we are the last thread to finish, if so close the pool
   size_t n = __sync_sub_and_fetch((volatile size_t*)wrkr->num_running, 1);
 
@@ -175,43 +214,92 @@ static void* async_io_reader(void *ptr)
 }
 
 // Start loading into a pool
-// returns an array of AsyncIOWorker of length len_files, each is a running
-// thread putting reading into the pool passed.
+// returns an array of AsyncIOWorker of length *num_workers, each is a running
+// thread putting reading into the pool passed. Single input files are split
+// between up to `max_shards` threads where possible (see seq_shard.h).
 static AsyncIOWorker* asyncio_read_start(MsgPool *pool,
                                          const AsyncIOInput *inputs,
-                                         size_t num_inputs)
+                                         size_t num_inputs,
+                                         size_t max_shards,
+                                         size_t *num_reads,
+                                         size_t *num_workers)
 {
+  *num_workers = 0;
   if(num_inputs == 0) return NULL;
 
-  size_t i;
+  size_t i, j, w, nworkers = 0;
+  size_t *nshards = ctx_calloc(num_inputs, sizeof(size_t));
   int rc;
 
   // Initiate all reads in the pool
-  ctx_assert(pool->elsize == sizeof(AsyncIOData*));
+  ctx_assert(pool->elsize == sizeof(AsyncIOBatch*));
+
+  // Work out which files we can split between threads
+  // nshards[i] == 0 means read input i without sharding
+  for(i = 0; i < num_inputs; i++) {
+    if(max_shards > 1 && inputs[i].file2 == NULL) {
+      nshards[i] = seq_shard_count(inputs[i].file1, max_shards);
+      if(nshards[i] == 1 && !seq_is_bam(inputs[i].file1)) nshards[i] = 0;
+    }
+    nworkers += MAX2(nshards[i], 1);
+  }
 
   // Create workers
-  AsyncIOWorker *workers = ctx_malloc(num_inputs * sizeof(AsyncIOWorker));
+  AsyncIOWorker *workers = ctx_malloc(nworkers * sizeof(AsyncIOWorker));
 
   // Keep a counter of how many threads are still running
   // last thread to finish closes the pool
   size_t *num_running = ctx_malloc(sizeof(size_t));
-  *num_running = num_inputs;
+  *num_running = nworkers;
 
-  for(i = 0; i < num_inputs; i++)
-    async_io_worker_init(&workers[i], &inputs[i], pool, num_running);
+  for(i = w = 0; i < num_inputs; i++)
+  {
+    if(nshards[i] == 0) {
+      async_io_worker_init(&workers[w++], &inputs[i], pool,
+                           num_running, num_reads);
+      continue;
+    }
+
+    // Guess quality score offset once for all shards
+    uint8_t qoffset, qmin, qmax;
+    seq_guess_qual_range(inputs[i].file1, inputs[i].fq_offset,
+                         &qoffset, &qmin, &qmax);
+
+    if(seq_is_bam(inputs[i].file1))
+      status("[asyncio] Reading %s with %zu decompression threads",
+             inputs[i].file1->path, max_shards);
+    else
+      status("[asyncio] Reading %s with %zu threads",
+             inputs[i].file1->path, nshards[i]);
+
+    for(j = 0; j < nshards[i]; j++, w++) {
+      async_io_worker_init(&workers[w], &inputs[i], pool,
+                           num_running, num_reads);
+      workers[w].sharded = true;
+      workers[w].shard_idx = j;
+      workers[w].num_shards = nshards[i];
+      workers[w].nthreads = max_shards;
+      workers[w].qoffset = qoffset;
+      workers[w].qmin = qmin;
+      workers[w].qmax = qmax;
+    }
+  }
+
+  ctx_free(nshards);
 
   // Start threads
   pthread_attr_t thread_attr;
   pthread_attr_init(&thread_attr);
   pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_JOINABLE);
 
-  for(i = 0; i < num_inputs; i++) {
+  for(i = 0; i < nworkers; i++) {
     rc = pthread_create(&workers[i].thread, &thread_attr,
                         async_io_reader, (void*)&workers[i]);
     if(rc != 0) die("Creating thread failed: %s", strerror(rc));
   }
 
   pthread_attr_destroy(&thread_attr);
+  *num_workers = nworkers;
   return workers;
 }
 
@@ -247,66 +335,138 @@ void asyncio_run_threads(MsgPool *pool,
 
   status("[asyncio] Inputs: %zu; Threads: %zu", num_inputs, num_readers);
 
-  // Start async io reading
+  struct timeval start, end;
+  size_t num_reads = 0;
+  gettimeofday(&start, NULL);
+
+  // Start async io reading, splitting files between up to one thread per
+  // reader thread
   AsyncIOWorker *asyncio_workers;
-  asyncio_workers = asyncio_read_start(pool, asyncio_inputs, num_inputs);
+  size_t num_workers, max_shards = MAX2(num_readers / num_inputs, 1);
+  asyncio_workers = asyncio_read_start(pool, asyncio_inputs, num_inputs,
+                                       max_shards, &num_reads, &num_workers);
 
   util_run_threads(args, num_readers, elsize, num_readers, job);
 
   // Finish with the async io (waits until queue is empty)
-  asyncio_read_finish(asyncio_workers, num_inputs);
+  asyncio_read_finish(asyncio_workers, num_workers);
+
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)*1e-6;
+  char nreads_str[50], rate_str[50];
+  ulong_to_str(num_reads, nreads_str);
+  ulong_to_str(secs > 0 ? (size_t)(num_reads / secs) : num_reads, rate_str);
+  status("[asyncio] Processed %s entries (reads / read pairs) "
+         "in %.2f secs [%s / sec]", nreads_str, secs, rate_str);
 }
 
 typedef struct {
   MsgPool *pool;
+  void (*batch_func)(AsyncIOBatch *_batch, void *_arg);
   void (*func)(AsyncIOData *_data, void *_arg);
   void *arg;
 } PoolFuncPair;
 
-// pthread method, loop: reads from pool, call function
+// pthread method, loop: reads batches from pool, call function
 static void grab_reads_from_pool(void *arg)
 {
   PoolFuncPair wrkr = *(PoolFuncPair*)arg;
   int pos;
-  AsyncIOData *data = NULL;
+  size_t i;
+  AsyncIOBatch *batch = NULL;
 
   while((pos = msgpool_claim_read(wrkr.pool)) != -1)
   {
-    memcpy(&data, msgpool_get_ptr(wrkr.pool, pos), sizeof(AsyncIOData*));
-    wrkr.func(data, wrkr.arg);
+    memcpy(&batch, msgpool_get_ptr(wrkr.pool, pos), sizeof(AsyncIOBatch*));
+
+    if(wrkr.batch_func) wrkr.batch_func(batch, wrkr.arg);
+    else {
+      for(i = 0; i < batch->len; i++)
+        wrkr.func(&batch->data[i], wrkr.arg);
+    }
+
     msgpool_release(wrkr.pool, pos, MPOOL_EMPTY);
   }
 }
 
-// `num_inputs` number of threads pushing reads into the pool
-// `num_readers` number of threads pulling reads from the pool
-void asyncio_run_pool(AsyncIOInput *asyncio_inputs, size_t num_inputs,
-                      void (*job)(AsyncIOData *_data, void *_arg),
-                      void *args, size_t num_readers, size_t elsize)
+// Each reader holds one batch at a time, each input thread fills one batch
+// while another of its batches waits in the queue. Files may be split
+// between as many input threads as there are readers.
+static inline size_t _asyncio_pool_nbatches(size_t num_inputs, size_t num_readers)
+{
+  return 2*num_readers + 2*num_inputs;
+}
+
+size_t asyncio_pool_mem(size_t num_inputs, size_t num_readers)
+{
+  // Measure the initial read buffers rather than assume their sizes
+  AsyncIOData iod;
+  asynciodata_alloc(&iod);
+  size_t read_mem = sizeof(AsyncIOData) +
+                    iod.r1.name.size + iod.r1.seq.size + iod.r1.qual.size +
+                    iod.r2.name.size + iod.r2.seq.size + iod.r2.qual.size;
+  asynciodata_dealloc(&iod);
+
+  size_t nbatches = _asyncio_pool_nbatches(num_inputs, num_readers);
+  return nbatches * (sizeof(AsyncIOBatch) + ASYNCIO_BATCH_SIZE * read_mem);
+}
+
+static void _asyncio_run_pool(AsyncIOInput *asyncio_inputs, size_t num_inputs,
+                              void (*batch_job)(AsyncIOBatch *_batch, void *_arg),
+                              void (*job)(AsyncIOData *_data, void *_arg),
+                              void *args, size_t num_readers, size_t elsize)
 {
+  const size_t nbatches = _asyncio_pool_nbatches(num_inputs, num_readers);
+  const size_t nreads = nbatches * ASYNCIO_BATCH_SIZE;
   size_t i;
-  AsyncIOData *data = ctx_malloc(MSGPOOLSIZE * sizeof(AsyncIOData));
-  for(i = 0; i < MSGPOOLSIZE; i++) asynciodata_alloc(&data[i]);
+
+  AsyncIOData *data = ctx_malloc(nreads * sizeof(AsyncIOData));
+  AsyncIOBatch *batches = ctx_malloc(nbatches * sizeof(AsyncIOBatch));
+
+  for(i = 0; i < nreads; i++) asynciodata_alloc(&data[i]);
+  for(i = 0; i < nbatches; i++)
+    batches[i] = (AsyncIOBatch){.data = data + i*ASYNCIO_BATCH_SIZE, .len = 0};
 
   MsgPool pool;
-  msgpool_alloc(&pool, MSGPOOLSIZE, sizeof(AsyncIOData*), USE_MSG_POOL);
-  msgpool_iterate(&pool, asynciodata_pool_init, data);
+  msgpool_alloc(&pool, nbatches, sizeof(AsyncIOBatch*), USE_MSG_POOL);
+  msgpool_iterate(&pool, asynciobatch_pool_init, batches);
 
   PoolFuncPair poolfunc[num_readers];
 
   for(i = 0; i < num_readers; i++) {
-    poolfunc[i] = (PoolFuncPair){.pool = &pool, .func = job,
+    poolfunc[i] = (PoolFuncPair){.pool = &pool,
+                                 .batch_func = batch_job, .func = job,
                                  .arg = (char*)args+i*elsize};
   }
 
   asyncio_run_threads(&pool, asyncio_inputs, num_inputs, grab_reads_from_pool,
                       &poolfunc, num_readers, sizeof(PoolFuncPair));
 
-  for(i = 0; i < MSGPOOLSIZE; i++) asynciodata_dealloc(&data[i]);
+  for(i = 0; i < nreads; i++) asynciodata_dealloc(&data[i]);
+  ctx_free(batches);
   ctx_free(data);
   msgpool_dealloc(&pool);
 }
 
+// `num_inputs` number of threads pushing reads into the pool
+// `num_readers` number of threads pulling batches of reads from the pool
+void asyncio_run_batch_pool(AsyncIOInput *asyncio_inputs, size_t num_inputs,
+                            void (*job)(AsyncIOBatch *_batch, void *_arg),
+                            void *args, size_t num_readers, size_t elsize)
+{
+  _asyncio_run_pool(asyncio_inputs, num_inputs, job, NULL,
+                    args, num_readers, elsize);
+}
+
+// Same as asyncio_run_batch_pool() but job is called once per read (pair)
+void asyncio_run_pool(AsyncIOInput *asyncio_inputs, size_t num_inputs,
+                      void (*job)(AsyncIOData *_data, void *_arg),
+                      void *args, size_t num_readers, size_t elsize)
+{
+  _asyncio_run_pool(asyncio_inputs, num_inputs, NULL, job,
+                    args, num_readers, elsize);
+}
+
 // Guess numer of kmers
 size_t asyncio_input_nkmers(const AsyncIOInput *io)
 {
@@ -24,6 +24,15 @@ typedef struct
   uint8_t fq_offset1, fq_offset2;
 } AsyncIOData;
 
+// Reads are passed through the pool in batches to reduce locking
+#define ASYNCIO_BATCH_SIZE 1024
+
+typedef struct
+{
+  AsyncIOData *data; // points into an array shared by all batches in a pool
+  size_t len;
+} AsyncIOBatch;
+
 #define asyncio_task_is_pe(a) ((a)->file2 != NULL || (a)->interleaved)
 
 // if out_base != NULL, we expect an output string as well:
@@ -45,20 +54,30 @@ void asynciodata_dealloc(AsyncIOData *iod);
 
 typedef struct AsyncIOWorker AsyncIOWorker;
 
-void asynciodata_pool_init(void *el, size_t idx, void *args);
-void asynciodata_pool_destroy(void *el, size_t idx, void *args);
+void asynciobatch_pool_init(void *el, size_t idx, void *args);
 
+// `pool` elements are of type AsyncIOBatch*
 void asyncio_run_threads(MsgPool *pool,
                          AsyncIOInput *asyncio_tasks, size_t num_inputs,
                          void (*job)(void*),
                          void *args, size_t num_readers, size_t elsize);
 
 // `num_inputs` number of threads pushing reads into the pool
-// `num_readers` number of threads pulling reads from the pool
+// `num_readers` number of threads pulling batches of reads from the pool
+// job is called once per batch of up to ASYNCIO_BATCH_SIZE reads
+void asyncio_run_batch_pool(AsyncIOInput *asyncio_inputs, size_t num_inputs,
+                            void (*job)(AsyncIOBatch *_batch, void *_arg),
+                            void *args, size_t num_readers, size_t elsize);
+
+// Same as asyncio_run_batch_pool() but job is called once per read (pair)
 void asyncio_run_pool(AsyncIOInput *asyncio_inputs, size_t num_inputs,
                       void (*job)(AsyncIOData *_data, void *_arg),
                       void *args, size_t num_readers, size_t elsize);
 
+// Memory used by the reads of a pool with `num_inputs` input threads and
+// `num_readers` reader threads, before any read buffers have to grow
+size_t asyncio_pool_mem(size_t num_inputs, size_t num_readers);
+
 // Guess numer of kmers
 size_t asyncio_input_nkmers(const AsyncIOInput *io);
 
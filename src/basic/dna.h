@@ -19,6 +19,17 @@ extern const unsigned char dna_complement_char_arr[256];
 #define dna_char_to_nuc(c)  ({ ctx_assert2(char_is_acgt(c),"%c",c); dna_char_to_nuc_arr[(uint8_t)(c)]; })
 #define dna_char_complement(c) ({ ctx_assert2(char_is_acgt(c),"%i",c); (char)dna_complement_char_arr[(uint8_t)(c)]; })
 
+// Convert [ACGTacgt] to a Nucleotide with arithmetic instead of a table lookup
+// A:0x41 C:0x43 G:0x47 T:0x54 => ((c>>1) ^ (c>>2)) & 3 => 0,1,2,3
+#define dna_acgt_to_nuc(c) ((Nucleotide)((((uint8_t)(c)>>1) ^ ((uint8_t)(c)>>2)) & 3))
+
+// Convert a string of [ACGTacgt] to Nucleotides, loop is vectorised (SIMD)
+static inline void dna_str_to_nucs(const char *str, size_t len, Nucleotide *nucs)
+{
+  size_t i;
+  for(i = 0; i < len; i++) nucs[i] = dna_acgt_to_nuc(str[i]);
+}
+
 #define dna_reverse_complement_str(str,len) dna_revcomp_str(str,str,len)
 
 /**
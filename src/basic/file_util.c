@@ -235,7 +235,7 @@ void futil_get_strbuf_of_dir_path(const char *path, StrBuf *dir)
   char *tmp = strdup(path);
   strbuf_set(dir, dirname(tmp));
   strbuf_append_char(dir, '/');
-  ctx_free(tmp);
+  free(tmp);
 }
 
 char* futil_get_current_dir(char abspath[PATH_MAX+1])
@@ -254,6 +254,28 @@ bool futil_path_has_extension(const char *path, const char *ext)
   return (ext_len <= path_len && strcasecmp(path+path_len-ext_len, ext) == 0);
 }
 
+// Create a temporary file in directory `dir` that is removed when closed
+// Calls die() on error
+FILE* futil_create_tmp_file(const char *dir)
+{
+  StrBuf tmppath;
+  strbuf_alloc(&tmppath, 1024);
+  strbuf_sprintf(&tmppath, "%s/cortex.tmp.XXXXXX", dir);
+
+  int fd = mkstemp(tmppath.b);
+  if(fd == -1)
+    die("Cannot write temporary file: %s [%s]", tmppath.b, strerror(errno));
+
+  unlink(tmppath.b); // Immediately unlink to hide temp file
+
+  FILE *fh = fdopen(fd, "w+");
+  if(fh == NULL)
+    die("Cannot open temporary file: %s [%s]", tmppath.b, strerror(errno));
+
+  strbuf_dealloc(&tmppath);
+  return fh;
+}
+
 // Usage:
 //     FILE **tmp_files = futil_create_tmp_files(num_tmp);
 // to clear up:
@@ -262,22 +284,10 @@ bool futil_path_has_extension(const char *path, const char *ext)
 FILE** futil_create_tmp_files(size_t num_tmp_files)
 {
   size_t i;
-  StrBuf tmppath;
-  strbuf_alloc(&tmppath, 1024);
   FILE **tmp_files = ctx_malloc(num_tmp_files * sizeof(FILE*));
 
-  int r = rand() & ((1<<20)-1);
-
   for(i = 0; i < num_tmp_files; i++)
-  {
-    strbuf_reset(&tmppath);
-    strbuf_sprintf(&tmppath, "/tmp/cortex.tmp.%i.%zu", r, i);
-    if((tmp_files[i] = fopen(tmppath.b, "r+")) == NULL) {
-      die("Cannot write temporary file: %s [%s]", tmppath.b, strerror(errno));
-    }
-    unlink(tmppath.b); // Immediately unlink to hide temp file
-  }
-  strbuf_dealloc(&tmppath);
+    tmp_files[i] = futil_create_tmp_file("/tmp");
 
   return tmp_files;
 }
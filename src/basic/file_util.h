@@ -71,6 +71,10 @@ char* futil_get_current_dir(char abspath[PATH_MAX+1]);
 // Case insensitive comparision of path with given extension
 bool futil_path_has_extension(const char *path, const char *ext);
 
+// Create a temporary file in directory `dir` that is removed when closed
+// Calls die() on error
+FILE* futil_create_tmp_file(const char *dir);
+
 // Usage:
 //   FILE **tmp_files = futil_create_tmp_files(num_tmp);
 // To clear up:
@@ -33,7 +33,7 @@ size_t hash_table_mem_limit(size_t memlimit, size_t entrybits, uint64_t *nkmers_
     num_of_buckets = 1UL << num_of_bits;
   }
 
-  bktsize = (memlimit - num_of_buckets*sizeof(uint8_t[2])) /
+  bktsize = (memlimit - num_of_buckets*HT_BKT_BYTES) /
             ((num_of_buckets * entrybits) /8);
 
   if(bktsize == 0) {
@@ -7,10 +7,18 @@
 // bucket size must be <256
 #define MAX_BUCKET_SIZE 48
 
+// Bytes of metadata per bucket
+#ifdef USE_HASH_FPRINT
+  // One cache line: a fingerprint byte per entry then bucket size and count
+  #define HT_BKT_BYTES 64
+#else
+  #define HT_BKT_BYTES 2
+#endif
+
 // Hash table capacity is x*(2^y) where x and y are parameters
-// memory is x*(2^y)*sizeof(BinaryKmer) + (2^y) * 2
+// memory is x*(2^y)*sizeof(BinaryKmer) + (2^y) * HT_BKT_BYTES
 static inline size_t ht_mem(size_t bktsize, size_t nbkts, size_t nbits) {
-  return (bktsize * nbkts * nbits)/8 + (nbkts) * sizeof(uint8_t[2]);
+  return (bktsize * nbkts * nbits)/8 + (nbkts) * HT_BKT_BYTES;
 }
 
 // Returns capacity of a hash table that holds at least nkmers
@@ -30,6 +30,24 @@ void loading_stats_merge(LoadingStats* dst, const LoadingStats* src)
   dst->num_kmers_novel += src->num_kmers_novel;
 }
 
+cJSON* loading_stats_to_json(const LoadingStats *stats)
+{
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddNumberToObject(json, "num_se_reads",       stats->num_se_reads);
+  cJSON_AddNumberToObject(json, "num_pe_reads",       stats->num_pe_reads);
+  cJSON_AddNumberToObject(json, "num_good_reads",     stats->num_good_reads);
+  cJSON_AddNumberToObject(json, "num_bad_reads",      stats->num_bad_reads);
+  cJSON_AddNumberToObject(json, "num_dup_se_reads",   stats->num_dup_se_reads);
+  cJSON_AddNumberToObject(json, "num_dup_pe_pairs",   stats->num_dup_pe_pairs);
+  cJSON_AddNumberToObject(json, "total_bases_read",   stats->total_bases_read);
+  cJSON_AddNumberToObject(json, "total_bases_loaded", stats->total_bases_loaded);
+  cJSON_AddNumberToObject(json, "contigs_parsed",     stats->contigs_parsed);
+  cJSON_AddNumberToObject(json, "num_kmers_parsed",   stats->num_kmers_parsed);
+  cJSON_AddNumberToObject(json, "num_kmers_loaded",   stats->num_kmers_loaded);
+  cJSON_AddNumberToObject(json, "num_kmers_novel",    stats->num_kmers_novel);
+  return json;
+}
+
 // @ht_num_kmers is the number of kmers loaded into the graph
 void loading_stats_print_summary(const LoadingStats *stats, size_t ht_num_kmers)
 {
@@ -1,6 +1,8 @@
 #ifndef LOADING_STATS_H_
 #define LOADING_STATS_H_
 
+#include "cJSON/cJSON.h"
+
 // Stucture for statistics on loading sequence and cortex binary files
 typedef struct
 {
@@ -24,6 +26,9 @@ typedef struct
 void loading_stats_init(LoadingStats *stats);
 void loading_stats_merge(LoadingStats *dst, const LoadingStats *src);
 
+// Returns a new JSON object with a field for each count
+cJSON* loading_stats_to_json(const LoadingStats *stats);
+
 // @ht_num_kmers is the number of kmers loaded into the graph
 void loading_stats_print_summary(const LoadingStats *stats, size_t ht_num_kmers);
 
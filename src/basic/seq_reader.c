@@ -238,6 +238,156 @@ static inline int guess_fastq_format(seq_file_t *sf)
   return fmt;
 }
 
+// Get the quality score offset and valid range for a file, guessing the offset
+// if ascii_fq_offset is 0
+void seq_guess_qual_range(seq_file_t *sf, uint8_t ascii_fq_offset,
+                          uint8_t *qoffset, uint8_t *qmin, uint8_t *qmax)
+{
+  int format;
+  *qoffset = *qmin = ascii_fq_offset;
+  *qmax = 126;
+
+  if(ascii_fq_offset == 0 && (format = guess_fastq_format(sf)) != -1)
+  {
+    *qmin = (uint8_t)FASTQ_MIN[format];
+    *qmax = (uint8_t)FASTQ_MAX[format];
+    *qoffset = (uint8_t)FASTQ_OFFSET[format];
+  }
+}
+
+// Get the next read from a shard into *curr, taking the read-ahead if we have one
+static inline int shard_read(SeqShard *sh, read_t **curr, off_t *pos,
+                             read_t **ahead, off_t ahead_pos, bool *have_ahead)
+{
+  if(*have_ahead) {
+    SWAP(*curr, *ahead);
+    *pos = ahead_pos;
+    *have_ahead = false;
+    return 1;
+  }
+  return seq_shard_read(sh, *curr, pos);
+}
+
+// Parse the reads belonging to one shard of a file (see seq_shard.h).
+// If interleaved, consecutive reads with matching names are passed as pairs.
+// A pair that spans a shard boundary is read by the shard that contains its
+// first read. At a boundary both shards look at the first two reads (A,B) of
+// the next shard: if their names match the next shard starts with A,
+// otherwise A is finished by this shard (as a mate or single read) and the
+// next shard starts with B.
+void seq_parse_shard(SeqShard *sh, bool interleaved,
+                     uint8_t qoffset, uint8_t qmin, uint8_t qmax,
+                     read_t *r1, read_t *r2,
+                     void (*read_func)(read_t *_r1, read_t *_r2,
+                                       uint8_t _qoffset1, uint8_t _qoffset2,
+                                       void *_ptr),
+                     void *reader_ptr)
+{
+  // prev is an unpaired read waiting for its mate, ahead is a read-ahead
+  read_t r3, *prev = r1, *curr = r2, *ahead = &r3;
+  off_t pos = 0, ahead_pos = 0;
+  bool have_prev = false, have_ahead = false;
+  uint8_t warn_flags = 0;
+  size_t num_se_reads = 0, num_pe_pairs = 0;
+  int s;
+
+  seq_read_alloc(&r3);
+
+  #define shard_next_read() \
+    (s = shard_read(sh, &curr, &pos, &ahead, ahead_pos, &have_ahead))
+
+  #define shard_read_ahead() \
+    (have_ahead = (seq_shard_read(sh, ahead, &ahead_pos) > 0))
+
+  if(!interleaved)
+  {
+    while(shard_next_read() > 0 && pos < sh->end) {
+      warn_flags = process_new_read(curr, qmin, qmax, sh->path, warn_flags);
+      read_func(curr, NULL, qoffset, 0, reader_ptr);
+      num_se_reads++;
+    }
+  }
+  else
+  {
+    s = 1;
+
+    // Decide if the first read is ours or the mate of the previous shard's
+    // last read
+    if(sh->start > 0) {
+      if(shard_next_read() <= 0 || pos >= sh->end) s = 0;
+      else if(shard_read_ahead() &&
+              seq_read_names_cmp(curr->name.b, ahead->name.b) == 0) {
+        warn_flags = process_new_read(curr, qmin, qmax, sh->path, warn_flags);
+        SWAP(prev, curr);
+        have_prev = true;
+      }
+    }
+
+    while(s > 0 && shard_next_read() > 0)
+    {
+      warn_flags = process_new_read(curr, qmin, qmax, sh->path, warn_flags);
+
+      if(pos >= sh->end)
+      {
+        // curr is the first read of the next shard
+        if(have_prev && seq_read_names_cmp(prev->name.b, curr->name.b) == 0) {
+          read_func(prev, curr, qoffset, qoffset, reader_ptr);
+          num_pe_pairs++;
+          have_prev = false;
+          break;
+        }
+        if(have_prev) {
+          read_func(prev, NULL, qoffset, 0, reader_ptr);
+          num_se_reads++;
+          have_prev = false;
+        }
+        if(!shard_read_ahead() ||
+           seq_read_names_cmp(curr->name.b, ahead->name.b) != 0) {
+          read_func(curr, NULL, qoffset, 0, reader_ptr);
+          num_se_reads++;
+        }
+        break;
+      }
+
+      if(!have_prev) {
+        SWAP(prev, curr);
+        have_prev = true;
+      }
+      else if(seq_read_names_cmp(prev->name.b, curr->name.b) == 0) {
+        read_func(prev, curr, qoffset, qoffset, reader_ptr);
+        num_pe_pairs++;
+        have_prev = false;
+      }
+      else {
+        read_func(prev, NULL, qoffset, 0, reader_ptr);
+        num_se_reads++;
+        SWAP(prev, curr);
+      }
+    }
+
+    // Process last read
+    if(have_prev) {
+      read_func(prev, NULL, qoffset, 0, reader_ptr);
+      num_se_reads++;
+    }
+  }
+
+  #undef shard_next_read
+  #undef shard_read_ahead
+
+  if(s < 0) warn("Input error: %s\n", sh->path);
+
+  // prev, curr, ahead still point to r1, r2, r3 in some order
+  seq_read_dealloc(&r3);
+
+  char num_se_reads_str[100], num_pe_pairs_str[100];
+  ulong_to_str(num_pe_pairs, num_pe_pairs_str);
+  ulong_to_str(num_se_reads, num_se_reads_str);
+  status("[seq] Loaded %s reads and %s reads pairs (file: %s, from offset: %zu)",
+         num_se_reads_str, num_pe_pairs_str, futil_inpath_str(sh->path),
+         (size_t)sh->start);
+}
+
 void seq_parse_interleaved_sf(seq_file_t *sf, uint8_t ascii_fq_offset,
                               read_t *r1, read_t *r2,
                               void (*read_func)(read_t *_r1, read_t *_r2,
@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include "seq_file.h"
 #include "cortex_types.h"
+#include "seq_shard.h"
 
 extern const char *MP_DIR_STRS[];
 
@@ -39,6 +40,21 @@ void seq_parse_se_sf(seq_file_t *sf, uint8_t ascii_fq_offset,
                                        void *_ptr),
                      void *reader_ptr);
 
+// Get the quality score offset and valid range for a file, guessing the offset
+// if ascii_fq_offset is 0
+void seq_guess_qual_range(seq_file_t *sf, uint8_t ascii_fq_offset,
+                          uint8_t *qoffset, uint8_t *qmin, uint8_t *qmax);
+
+// Parse the reads belonging to one shard of a file (see seq_shard.h)
+// If interleaved, consecutive reads with matching names are passed as pairs
+void seq_parse_shard(SeqShard *sh, bool interleaved,
+                     uint8_t qoffset, uint8_t qmin, uint8_t qmax,
+                     read_t *r1, read_t *r2,
+                     void (*read_func)(read_t *_r1, read_t *_r2,
+                                       uint8_t _qoffset1, uint8_t _qoffset2,
+                                       void *_ptr),
+                     void *reader_ptr);
+
 void seq_parse_interleaved_sf(seq_file_t *sf, uint8_t ascii_fq_offset,
                               read_t *r1, read_t *r2,
                               void (*read_func)(read_t *_r1, read_t *_r2,
@@ -0,0 +1,417 @@
+#include "global.h"
+#include "seq_shard.h"
+#include "file_util.h"
+#include "util.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SEQ_SHARD_PLAIN_BUFSIZE (1UL<<20)
+
+// BGZF header is 18 bytes, blocks are at most 64KB compressed
+#define BGZF_HDR_LEN 18
+#define BGZF_MAX_BLOCK (1UL<<16)
+
+#define OFF_T_MAX ((off_t)(~(uint64_t)0 >> 1))
+
+static inline bool bgzf_is_header(const uint8_t *h)
+{
+  return h[0] == 0x1f && h[1] == 0x8b && h[2] == 8 && (h[3] & 4) &&
+         h[10] == 6 && h[11] == 0 && h[12] == 'B' && h[13] == 'C' &&
+         h[14] == 2 && h[15] == 0;
+}
+
+static inline size_t bgzf_block_size(const uint8_t *h)
+{
+  return ((size_t)h[16] | ((size_t)h[17] << 8)) + 1;
+}
+
+// Returns false if we cannot read this file with SeqShard
+static bool seq_shard_get_type(seq_file_t *sf, SeqShardType *type, char *fmt)
+{
+  uint8_t hdr[BGZF_HDR_LEN];
+  ssize_t n;
+  int fd;
+
+  if(strcmp(sf->path, "-") == 0) return false;
+  if(seq_is_bam(sf)) { *type = SEQ_SHARD_BAM; *fmt = 0; return true; }
+  if(!seq_is_fastq(sf) && !seq_is_fasta(sf)) return false;
+
+  *fmt = seq_is_fastq(sf) ? '@' : '>';
+
+  if((fd = open(sf->path, O_RDONLY)) < 0) return false;
+  n = pread(fd, hdr, BGZF_HDR_LEN, 0);
+  close(fd);
+
+  if(n >= 2 && hdr[0] == 0x1f && hdr[1] == 0x8b) {
+    // gzip, only BGZF can be split
+    if(n < BGZF_HDR_LEN || !bgzf_is_header(hdr)) return false;
+    *type = SEQ_SHARD_BGZF;
+  }
+  else *type = SEQ_SHARD_PLAIN;
+
+  return true;
+}
+
+// Returns the number of shards to split a file into, up to max_shards.
+// Returns 0 if the file cannot be read with SeqShard, 1 if it can but should
+// not be split (BAM files are never split).
+size_t seq_shard_count(seq_file_t *sf, size_t max_shards)
+{
+  SeqShardType type;
+  char fmt;
+  off_t fsize;
+
+  if(!seq_shard_get_type(sf, &type, &fmt)) return 0;
+  if(type == SEQ_SHARD_BAM) return 1;
+  if((fsize = futil_get_file_size(sf->path)) < 0) return 0;
+
+  return MAX2(1, MIN2(max_shards, (size_t)fsize / SEQ_SHARD_MIN_BYTES));
+}
+
+// Read the next chunk of plain text or the next non-empty BGZF block
+// Returns false at the end of the file
+static bool seq_shard_fill(SeqShard *sh)
+{
+  ssize_t n;
+
+  if(sh->type == SEQ_SHARD_PLAIN)
+  {
+    n = pread(sh->fd, sh->buf, sh->buf_size, sh->next_offset);
+    if(n < 0) die("Cannot read file: %s [%s]", sh->path, strerror(errno));
+    if(n == 0) return false;
+    sh->buf_offset = sh->next_offset;
+    sh->next_offset += n;
+    sh->buf_pos = 0;
+    sh->buf_len = (size_t)n;
+    return true;
+  }
+
+  size_t bsize;
+  int ret;
+
+  do
+  {
+    n = pread(sh->fd, sh->in, BGZF_HDR_LEN, sh->next_offset);
+    if(n == 0) return false;
+    if(n < BGZF_HDR_LEN || !bgzf_is_header(sh->in))
+      die("Bad BGZF block at %zu: %s", (size_t)sh->next_offset, sh->path);
+
+    bsize = bgzf_block_size(sh->in);
+    n = pread(sh->fd, sh->in+BGZF_HDR_LEN, bsize-BGZF_HDR_LEN,
+              sh->next_offset+BGZF_HDR_LEN);
+    if(bsize < BGZF_HDR_LEN+8 || n != (ssize_t)(bsize-BGZF_HDR_LEN))
+      die("Truncated BGZF block at %zu: %s", (size_t)sh->next_offset, sh->path);
+
+    inflateReset(&sh->strm);
+    sh->strm.next_in = sh->in+BGZF_HDR_LEN;
+    sh->strm.avail_in = (uInt)(bsize-BGZF_HDR_LEN-8);
+    sh->strm.next_out = (Bytef*)sh->buf;
+    sh->strm.avail_out = (uInt)sh->buf_size;
+    ret = inflate(&sh->strm, Z_FINISH);
+    if(ret != Z_STREAM_END)
+      die("Corrupt BGZF block at %zu: %s", (size_t)sh->next_offset, sh->path);
+
+    sh->buf_offset = sh->next_offset;
+    sh->next_offset += bsize;
+    sh->buf_pos = 0;
+    sh->buf_len = sh->buf_size - sh->strm.avail_out;
+  }
+  while(sh->buf_len == 0);
+
+  return true;
+}
+
+// Find the first BGZF block starting at or after `offset` and the last
+// non-empty block before it. Blocks are found by searching for a block header
+// then following the chain of block sizes, so every shard agrees on where
+// blocks begin.
+static off_t bgzf_find_block(SeqShard *sh, off_t offset, off_t fsize,
+                             off_t *prev_block)
+{
+  const size_t win = 2*BGZF_MAX_BLOCK;
+  off_t lo = offset > (off_t)win ? offset - (off_t)win : 0;
+  uint8_t *scan = ctx_malloc(win + BGZF_HDR_LEN), hdr[BGZF_HDR_LEN], isize[4];
+  off_t cand, p, prev;
+  ssize_t n, i;
+
+  *prev_block = -1;
+
+  for(; lo < fsize; lo += win)
+  {
+    n = pread(sh->fd, scan, win + BGZF_HDR_LEN, lo);
+    for(i = 0; i + BGZF_HDR_LEN <= n; i++)
+    {
+      if(!bgzf_is_header(scan+i)) continue;
+
+      // Follow the chain of blocks from this candidate
+      cand = lo + i;
+      prev = -1;
+      for(p = cand; p < offset; p += bgzf_block_size(hdr)) {
+        if(pread(sh->fd, hdr, BGZF_HDR_LEN, p) != BGZF_HDR_LEN ||
+           !bgzf_is_header(hdr)) break;
+        // Last four bytes of a block give the uncompressed size
+        if(pread(sh->fd, isize, 4, p+bgzf_block_size(hdr)-4) == 4 &&
+           (isize[0] | isize[1] | isize[2] | isize[3])) prev = p;
+      }
+
+      if(p > fsize) continue;
+      if(p < fsize && (pread(sh->fd, hdr, BGZF_HDR_LEN, p) != BGZF_HDR_LEN ||
+                       !bgzf_is_header(hdr))) continue;
+
+      ctx_free(scan);
+      *prev_block = prev;
+      return p;
+    }
+  }
+
+  ctx_free(scan);
+  return fsize;
+}
+
+// Fill a line buffer with the next line. Returns false at end of file
+static bool seq_shard_readline(SeqShard *sh, buffer_t *line, off_t *pos)
+{
+  const char *end;
+  size_t len;
+
+  line->end = 0;
+
+  if(sh->buf_pos == sh->buf_len && !seq_shard_fill(sh)) return false;
+  *pos = sh->type == SEQ_SHARD_BGZF ? sh->buf_offset
+                                    : sh->buf_offset + (off_t)sh->buf_pos;
+
+  while(1)
+  {
+    end = memchr(sh->buf+sh->buf_pos, '\n', sh->buf_len-sh->buf_pos);
+    len = (end ? (size_t)(end - sh->buf) : sh->buf_len) - sh->buf_pos;
+    buffer_ensure_capacity(line, line->end+len);
+    memcpy(line->b+line->end, sh->buf+sh->buf_pos, len);
+    line->end += len;
+    sh->buf_pos += len;
+    if(end) { sh->buf_pos++; break; }
+    if(!seq_shard_fill(sh)) break;
+  }
+
+  if(line->end > 0 && line->b[line->end-1] == '\r') line->end--;
+  line->b[line->end] = '\0';
+  return true;
+}
+
+// Ensure we have read ahead at least n lines, returns false if we can't
+static bool seq_shard_peek_lines(SeqShard *sh, size_t n)
+{
+  size_t i;
+  while(sh->lines_len < n) {
+    i = (sh->lines_start + sh->lines_len) & 3;
+    if(!seq_shard_readline(sh, &sh->lines[i], &sh->line_pos[i])) return false;
+    sh->lines_len++;
+  }
+  return true;
+}
+
+#define seq_shard_line(sh,i) (&(sh)->lines[((sh)->lines_start+(i))&3])
+
+static inline void seq_shard_pop_line(SeqShard *sh)
+{
+  sh->lines_start = (sh->lines_start+1) & 3;
+  sh->lines_len--;
+}
+
+// Skip lines until the first line of a record
+static void seq_shard_sync(SeqShard *sh)
+{
+  buffer_t *l0, *l1, *l2, *l3;
+
+  if(sh->fmt == '>') {
+    while(seq_shard_peek_lines(sh, 1) && seq_shard_line(sh,0)->b[0] != '>')
+      seq_shard_pop_line(sh);
+    return;
+  }
+
+  // FASTQ: '@' line, two lines later a '+' line, seq and qual the same length.
+  // A qual line may start with '@' but is then followed by a name line
+  while(seq_shard_peek_lines(sh, 4))
+  {
+    l0 = seq_shard_line(sh,0);
+    l1 = seq_shard_line(sh,1);
+    l2 = seq_shard_line(sh,2);
+    l3 = seq_shard_line(sh,3);
+    if(l0->b[0] == '@' && l2->b[0] == '+' && l1->end == l3->end) return;
+    seq_shard_pop_line(sh);
+  }
+}
+
+void seq_shard_open(SeqShard *sh, seq_file_t *sf, size_t idx, size_t nshards,
+                    size_t nthreads)
+{
+  memset(sh, 0, sizeof(SeqShard));
+  sh->path = sf->path;
+  sh->fd = -1;
+
+  if(!seq_shard_get_type(sf, &sh->type, &sh->fmt))
+    die("Cannot split sequence file: %s", sf->path);
+
+  if(sh->type == SEQ_SHARD_BAM)
+  {
+    ctx_assert(nshards == 1);
+    if((sh->samfh = sam_open(sf->path, "r")) == NULL)
+      die("Cannot open file: %s", sf->path);
+    if(nthreads > 1 && hts_set_threads(sh->samfh, (int)nthreads) != 0)
+      warn("Cannot use %zu threads to decompress: %s", nthreads, sf->path);
+    if((sh->bamhdr = sam_hdr_read(sh->samfh)) == NULL)
+      die("Cannot read header: %s", sf->path);
+    sh->start = 0;
+    sh->end = OFF_T_MAX;
+    return;
+  }
+
+  off_t fsize = futil_get_file_size(sf->path);
+  if(fsize < 0) die("Cannot get file size: %s", sf->path);
+
+  if((sh->fd = open(sf->path, O_RDONLY)) < 0)
+    die("Cannot open file: %s [%s]", sf->path, strerror(errno));
+
+  sh->start = (off_t)((uint64_t)fsize * idx / nshards);
+  sh->end = (off_t)((uint64_t)fsize * (idx+1) / nshards);
+
+  bool line_start = true;
+  char c;
+
+  if(sh->type == SEQ_SHARD_PLAIN)
+  {
+    sh->buf_size = SEQ_SHARD_PLAIN_BUFSIZE;
+    sh->buf = ctx_malloc(sh->buf_size);
+    if(sh->start > 0)
+      line_start = (pread(sh->fd, &c, 1, sh->start-1) == 1 && c == '\n');
+    sh->next_offset = sh->start;
+  }
+  else
+  {
+    sh->buf_size = SEQ_SHARD_BUFSIZE;
+    sh->buf = ctx_malloc(sh->buf_size);
+    sh->in = ctx_malloc(BGZF_MAX_BLOCK);
+    if(inflateInit2(&sh->strm, -15) != Z_OK) die("zlib error");
+
+    // Move shard boundaries to the start of BGZF blocks
+    off_t prev_block = -1, tmp;
+    if(sh->end < fsize) sh->end = bgzf_find_block(sh, sh->end, fsize, &tmp);
+    if(sh->start > 0) {
+      sh->start = bgzf_find_block(sh, sh->start, fsize, &prev_block);
+      // Check if the last character before our first block is a new line
+      if(prev_block >= 0) {
+        sh->next_offset = prev_block;
+        line_start = (seq_shard_fill(sh) && sh->buf[sh->buf_len-1] == '\n');
+      }
+    }
+    sh->next_offset = sh->start;
+    sh->buf_pos = sh->buf_len = 0;
+  }
+
+  // Skip the partial line at the start of the shard then find a record
+  if(!line_start && seq_shard_peek_lines(sh, 1)) seq_shard_pop_line(sh);
+  seq_shard_sync(sh);
+}
+
+void seq_shard_close(SeqShard *sh)
+{
+  size_t i;
+  if(sh->type == SEQ_SHARD_BAM) {
+    bam_hdr_destroy(sh->bamhdr);
+    sam_close(sh->samfh);
+  }
+  else {
+    if(sh->type == SEQ_SHARD_BGZF) inflateEnd(&sh->strm);
+    if(sh->fd >= 0) close(sh->fd);
+    ctx_free(sh->buf);
+    ctx_free(sh->in);
+  }
+  for(i = 0; i < 4; i++) free(sh->lines[i].b);
+  memset(sh, 0, sizeof(SeqShard));
+}
+
+static inline void seq_shard_set_buf(buffer_t *buf, const char *str, size_t len)
+{
+  buffer_ensure_capacity(buf, len);
+  memcpy(buf->b, str, len);
+  buf->b[len] = '\0';
+  buf->end = len;
+}
+
+static int seq_shard_read_bam(SeqShard *sh, read_t *r, off_t *pos)
+{
+  int s;
+  size_t i, len;
+
+  seq_read_reset(r);
+  if(r->bam == NULL) r->bam = bam_init1();
+  if((s = sam_read1(sh->samfh, sh->bamhdr, r->bam)) < 0) return s == -1 ? 0 : -1;
+
+  const bam1_t *b = r->bam;
+  const uint8_t *seq = bam_get_seq(b), *qual = bam_get_qual(b);
+  const char *name = bam_get_qname(b);
+
+  len = (size_t)b->core.l_qseq;
+  seq_shard_set_buf(&r->name, name, strlen(name));
+  buffer_ensure_capacity(&r->seq, len);
+  for(i = 0; i < len; i++) r->seq.b[i] = seq_nt16_str[bam_seqi(seq, i)];
+  r->seq.b[r->seq.end = len] = '\0';
+
+  if(len > 0 && qual[0] != 0xff) {
+    buffer_ensure_capacity(&r->qual, len);
+    for(i = 0; i < len; i++) r->qual.b[i] = (char)(qual[i] + 33);
+    r->qual.b[r->qual.end = len] = '\0';
+  }
+
+  // Reads are stored on the forward strand of the reference
+  if(bam_is_rev(b)) seq_read_reverse_complement(r);
+  r->from_sam = true;
+  *pos = 0;
+  return 1;
+}
+
+// Read the next record, setting *pos to the position of its first byte.
+// The record belongs to this shard if *pos < sh->end.
+// Returns 1 on success, 0 at end of file, -1 on error
+int seq_shard_read(SeqShard *sh, read_t *r, off_t *pos)
+{
+  const buffer_t *line;
+
+  if(sh->type == SEQ_SHARD_BAM) return seq_shard_read_bam(sh, r, pos);
+
+  seq_read_reset(r);
+  if(!seq_shard_peek_lines(sh, 1)) return 0;
+
+  line = seq_shard_line(sh,0);
+  if(line->b[0] != sh->fmt) return -1;
+  seq_shard_set_buf(&r->name, line->b+1, line->end-1);
+  *pos = sh->line_pos[sh->lines_start];
+  seq_shard_pop_line(sh);
+
+  if(sh->fmt == '@')
+  {
+    if(!seq_shard_peek_lines(sh, 3) || seq_shard_line(sh,1)->b[0] != '+')
+      return -1;
+    line = seq_shard_line(sh,0);
+    seq_shard_set_buf(&r->seq, line->b, line->end);
+    line = seq_shard_line(sh,2);
+    seq_shard_set_buf(&r->qual, line->b, line->end);
+    seq_shard_pop_line(sh);
+    seq_shard_pop_line(sh);
+    seq_shard_pop_line(sh);
+  }
+  else
+  {
+    // FASTA sequence may span several lines
+    while(seq_shard_peek_lines(sh, 1) && (line = seq_shard_line(sh,0))->b[0] != '>')
+    {
+      buffer_ensure_capacity(&r->seq, r->seq.end+line->end);
+      memcpy(r->seq.b+r->seq.end, line->b, line->end);
+      r->seq.end += line->end;
+      r->seq.b[r->seq.end] = '\0';
+      seq_shard_pop_line(sh);
+    }
+  }
+
+  return 1;
+}
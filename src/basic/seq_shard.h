@@ -0,0 +1,76 @@
+#ifndef SEQ_SHARD_H_
+#define SEQ_SHARD_H_
+
+//
+// Split a single large sequence file so that it can be parsed by several
+// threads at once.
+//
+// Uncompressed and bgzipped (BGZF) FASTA/FASTQ files are cut into byte ranges
+// ('shards'). Each shard opens the file, seeks to its start and syncs to the
+// first record boundary. BGZF blocks are independent gzip members so each
+// shard decompresses its own blocks. A record belongs to the shard in which
+// its first byte lies (for BGZF: the block holding its first byte). Shards
+// continue past their end to finish their last record.
+//
+// BAM files cannot be split without an index. They are read by one shard
+// but use htslib's threads for BGZF decompression.
+//
+// Plain gzip, SAM and one-sequence-per-line files cannot be sharded.
+//
+
+#include <zlib.h>
+#include "seq_file.h"
+
+// Don't make shards smaller than this, to keep thread overheads low and
+// ensure every shard contains a record
+#define SEQ_SHARD_MIN_BYTES (16UL<<20)
+
+// BGZF blocks decompress to at most 64KB
+#define SEQ_SHARD_BUFSIZE (1UL<<16)
+
+typedef enum { SEQ_SHARD_PLAIN, SEQ_SHARD_BGZF, SEQ_SHARD_BAM } SeqShardType;
+
+typedef struct
+{
+  const char *path;
+  SeqShardType type;
+  char fmt; // '@' for FASTQ, '>' for FASTA
+  off_t start, end; // records starting in [start,end) belong to this shard
+  int fd;
+
+  // Plain text or one decompressed BGZF block
+  char *buf;
+  size_t buf_pos, buf_len, buf_size;
+  off_t buf_offset; // offset of buf in file (of compressed block for BGZF)
+  off_t next_offset; // where to read the next chunk / block from
+
+  // BGZF compressed block
+  uint8_t *in;
+  z_stream strm;
+
+  // Lines read ahead whilst syncing to a record, and the line being read
+  buffer_t lines[4];
+  off_t line_pos[4];
+  size_t lines_start, lines_len;
+
+  // BAM input
+  samFile *samfh;
+  bam_hdr_t *bamhdr;
+} SeqShard;
+
+// Returns the number of shards to split a file into, up to max_shards.
+// Returns 1 if the file cannot be usefully split.
+size_t seq_shard_count(seq_file_t *sf, size_t max_shards);
+
+// Open shard `idx` of `nshards`. For BAM input nshards must be 1 and
+// `nthreads` is the number of decompression threads.
+void seq_shard_open(SeqShard *sh, seq_file_t *sf, size_t idx, size_t nshards,
+                    size_t nthreads);
+void seq_shard_close(SeqShard *sh);
+
+// Read the next record, setting *pos to the position of its first byte.
+// The record belongs to this shard if *pos < sh->end.
+// Returns 1 on success, 0 at end of file, -1 on error
+int seq_shard_read(SeqShard *sh, read_t *r, off_t *pos);
+
+#endif /* SEQ_SHARD_H_ */
@@ -0,0 +1,53 @@
+#include "global.h"
+#include "thread_stats.h"
+
+void thread_stats_alloc(ThreadStats *ts, size_t nthreads, size_t size)
+{
+  ctx_assert(nthreads > 0);
+  size_t stride = (size + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES;
+  stride = MAX2(stride, CACHE_LINE_BYTES);
+
+  // Allocate an extra line so the first copy can be aligned
+  void *mem = ctx_calloc(nthreads * stride + CACHE_LINE_BYTES, 1);
+  size_t offset = CACHE_LINE_BYTES - ((size_t)mem % CACHE_LINE_BYTES);
+
+  ThreadStats tmp = {.mem = mem, .data = (char*)mem + offset,
+                     .nthreads = nthreads, .size = size, .stride = stride};
+
+  memcpy(ts, &tmp, sizeof(ThreadStats));
+}
+
+void thread_stats_dealloc(ThreadStats *ts)
+{
+  ctx_free(ts->mem);
+  memset(ts, 0, sizeof(ThreadStats));
+}
+
+void thread_stats_reset(ThreadStats *ts)
+{
+  memset(ts->data, 0, ts->nthreads * ts->stride);
+}
+
+void thread_hist_alloc(ThreadHist *th, size_t nthreads, size_t len)
+{
+  ctx_assert(len > 0);
+  thread_stats_alloc(&th->counts, nthreads, len * sizeof(uint64_t));
+  th->len = len;
+}
+
+void thread_hist_dealloc(ThreadHist *th)
+{
+  thread_stats_dealloc(&th->counts);
+  th->len = 0;
+}
+
+void thread_hist_merge(const ThreadHist *th, uint64_t *hist)
+{
+  size_t t, i;
+  const uint64_t *counts;
+  memset(hist, 0, th->len * sizeof(uint64_t));
+  for(t = 0; t < th->counts.nthreads; t++) {
+    counts = (const uint64_t*)thread_stats_get(&th->counts, t);
+    for(i = 0; i < th->len; i++) hist[i] += counts[i];
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef THREAD_STATS_H_
+#define THREAD_STATS_H_
+
+//
+// Per-thread statistics
+//
+// Counters and histograms updated by many threads are kept as one copy per
+// thread rather than shared and updated with atomics. Each copy starts on its
+// own cache line so threads never write to the same line. Copies are merged
+// after the threads have joined.
+//
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define CACHE_LINE_BYTES 64
+
+typedef struct
+{
+  void *mem;
+  char *data; // cache line aligned
+  size_t nthreads, size, stride; // stride is size rounded up to a cache line
+} ThreadStats;
+
+// One zeroed struct of `size` bytes per thread
+void thread_stats_alloc(ThreadStats *ts, size_t nthreads, size_t size);
+void thread_stats_dealloc(ThreadStats *ts);
+void thread_stats_reset(ThreadStats *ts);
+
+static inline void* thread_stats_get(const ThreadStats *ts, size_t threadid)
+{
+  return ts->data + threadid * ts->stride;
+}
+
+//
+// Per-thread histograms
+//
+typedef struct
+{
+  ThreadStats counts;
+  size_t len;
+} ThreadHist;
+
+void thread_hist_alloc(ThreadHist *th, size_t nthreads, size_t len);
+void thread_hist_dealloc(ThreadHist *th);
+
+// Values past the end are added to the last bin
+static inline void thread_hist_add(ThreadHist *th, size_t threadid,
+                                   size_t bin, uint64_t n)
+{
+  uint64_t *counts = (uint64_t*)thread_stats_get(&th->counts, threadid);
+  counts[bin < th->len ? bin : th->len-1] += n;
+}
+
+// Sum histograms of all threads into `hist`, which must have th->len entries
+void thread_hist_merge(const ThreadHist *th, uint64_t *hist);
+
+#endif /* THREAD_STATS_H_ */
@@ -7,6 +7,7 @@
 int ctx_build(int argc, char **argv);
 int ctx_sort(int argc, char **argv);
 int ctx_index(int argc, char **argv);
+int ctx_query(int argc, char **argv);
 int ctx_infer_edges(int argc, char **argv);
 int ctx_thread(int argc, char **argv);
 int ctx_correct(int argc, char **argv);
@@ -38,6 +39,7 @@ int ctx_exp_abc(int argc, char **argv);
 extern const char build_usage[];
 extern const char sort_usage[];
 extern const char index_usage[];
+extern const char query_usage[];
 extern const char view_usage[];
 extern const char pview_usage[];
 extern const char health_usage[];
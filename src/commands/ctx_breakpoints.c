@@ -177,7 +177,8 @@ int ctx_breakpoints(int argc, char **argv)
 
   // Paths memory
   size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem, false);
+  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem,
+                                  false, true);
 
   // Shift path store memory from graphs->paths
   graph_mem -= sizeof(GPath*)*kmers_in_hash;
@@ -203,7 +204,7 @@ int ctx_breakpoints(int argc, char **argv)
 
   // Paths
   gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len,
-                             path_mem, false, &db_graph);
+                             path_mem, false, true, &db_graph);
 
   //
   // Load graphs
@@ -216,6 +217,7 @@ int ctx_breakpoints(int argc, char **argv)
                               .must_exist_in_edges = NULL,
                               .empty_colours = true};
 
+  ctx_prof_phase("load_graph");
   for(i = 0; i < num_gfiles; i++) {
     graph_load(&gfiles[i], gprefs, &stats);
     graph_file_close(&gfiles[i]);
@@ -226,8 +228,12 @@ int ctx_breakpoints(int argc, char **argv)
   hash_table_print_stats(&db_graph.ht);
 
   // Load path files
+  ctx_prof_phase("load_paths");
   for(i = 0; i < gpfiles.len; i++)
-    gpath_reader_load(&gpfiles.data[i], true, &db_graph);
+    gpath_reader_load(&gpfiles.data[i], true, nthreads, &db_graph);
+
+  // Paths are read-only from here
+  gpath_store_compact(&db_graph.gpstore);
 
   // Get array of sequence file paths
   size_t num_seq_paths = sfilebuf.len;
@@ -256,6 +262,8 @@ int ctx_breakpoints(int argc, char **argv)
   for(i = 0; i < gpfiles.len; i++) hdrs[i] = gpfiles.data[i].json;
 
   // Call breakpoints
+  // Output is written as it is found
+  ctx_prof_phase("walk");
   breakpoints_call(nthreads,
                    gzout, output_file,
                    rbuf.data, rbuf.len,
@@ -266,6 +274,7 @@ int ctx_breakpoints(int argc, char **argv)
 
   // Finished: do clean up
   gzclose(gzout);
+  ctx_prof_phase_end();
   ctx_free(hdrs);
 
   // Close input files
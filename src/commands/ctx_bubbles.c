@@ -144,12 +144,11 @@ int ctx_bubbles(int argc, char **argv)
   size_t bits_per_kmer, kmers_in_hash, graph_mem, path_mem, thread_mem;
   char thread_mem_str[100];
 
-  // edges(1bytes) + kmer_paths(8bytes) + in_colour(1bit/col) +
-  // visitedfw/rv(2bits/thread)
+  // edges(1bytes) + kmer_paths(8bytes) + in_colour(1bit/col)
 
   bits_per_kmer = sizeof(BinaryKmer)*8 + sizeof(Edges)*8 +
                   (gpfiles.len > 0 ? sizeof(GPath*)*8 : 0) +
-                  ncols + 2*nthreads;
+                  ncols;
 
   kmers_in_hash = cmd_get_kmers_in_hash(memargs.mem_to_use,
                                         memargs.mem_to_use_set,
@@ -160,21 +159,23 @@ int ctx_bubbles(int argc, char **argv)
                                         false, &graph_mem);
 
   // Thread memory
-  thread_mem = roundup_bits2bytes(kmers_in_hash) * 2;
+  thread_mem = rpt_walker_est_mem(kmers_in_hash, 22);
   bytes_to_str(thread_mem * nthreads, 1, thread_mem_str);
   status("[memory] (of which threads: %zu x %zu = %s)\n",
           nthreads, thread_mem, thread_mem_str);
 
   // Paths memory
-  size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem+thread_mem);
-  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem, false);
+  size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use,
+                                             graph_mem + thread_mem*nthreads);
+  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem,
+                                  false, true);
 
   // Shift path store memory from graphs->paths
   graph_mem -= sizeof(GPath*)*kmers_in_hash;
   path_mem  += sizeof(GPath*)*kmers_in_hash;
   cmd_print_mem(path_mem, "paths");
 
-  size_t total_mem = graph_mem + thread_mem + path_mem;
+  size_t total_mem = graph_mem + thread_mem*nthreads + path_mem;
   cmd_check_mem_limit(memargs.mem_to_use, total_mem);
 
   //
@@ -188,7 +189,8 @@ int ctx_bubbles(int argc, char **argv)
                  DBG_ALLOC_EDGES | DBG_ALLOC_NODE_IN_COL);
 
   // Paths
-  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem, false, &db_graph);
+  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem,
+                             false, true, &db_graph);
 
   //
   // Load graphs
@@ -199,8 +201,10 @@ int ctx_bubbles(int argc, char **argv)
                               .boolean_covgs = false,
                               .must_exist_in_graph = false,
                               .must_exist_in_edges = NULL,
-                              .empty_colours = true};
+                              .empty_colours = true,
+                              .nthreads = nthreads};
 
+  ctx_prof_phase("load_graph");
   for(i = 0; i < num_gfiles; i++) {
     graph_load(&gfiles[i], gprefs, &stats);
     graph_file_close(&gfiles[i]);
@@ -211,8 +215,13 @@ int ctx_bubbles(int argc, char **argv)
   hash_table_print_stats(&db_graph.ht);
 
   // Load path files
+  ctx_prof_phase("load_paths");
   for(i = 0; i < gpfiles.len; i++)
-    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS,
+                      nthreads, &db_graph);
+
+  // Paths are read-only from here
+  gpath_store_compact(&db_graph.gpstore);
 
   // Create array of cJSON** from input files
   cJSON **hdrs = ctx_malloc(gpfiles.len * sizeof(cJSON*));
@@ -224,6 +233,8 @@ int ctx_bubbles(int argc, char **argv)
                                    .haploid_cols = haploidbuf.data,
                                    .num_haploid = haploidbuf.len};
 
+  // Output is written as it is found
+  ctx_prof_phase("walk");
   invoke_bubble_caller(nthreads, call_prefs,
                        gzout, out_path,
                        hdrs, gpfiles.len,
@@ -231,6 +242,7 @@ int ctx_bubbles(int argc, char **argv)
 
   status("  saved to: %s\n", out_path);
   gzclose(gzout);
+  ctx_prof_phase_end();
   ctx_free(hdrs);
 
   // Close input path files
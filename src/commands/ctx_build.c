@@ -20,6 +20,14 @@ const char build_usage[] =
 "  -f, --force              Overwrite output files\n"
 "  -m, --memory <mem>       Memory to use\n"
 "  -n, --nkmers <kmers>     Number of hash table entries (e.g. 1G ~ 1 billion)\n"
+"  -G, --grow               Start with a small hash table (or -n) and grow it as\n"
+"                           needed, up to the memory limit (-m)\n"
+"  -D, --disk <P>           Build out-of-core: write kmers to <P> temporary\n"
+"                           partitions, then load one partition at a time\n"
+"  -T, --tmp <dir>          Directory for temporary files [default: output dir]\n"
+"  -B, --bloom <mem>        Only add kmers seen at least twice per colour, using\n"
+"                           a Bloom filter of <mem> (from -m) to remember kmers\n"
+"                           seen once. Coverage includes the first sighting.\n"
 "  -t, --threads <T>        Number of threads to use [default: "QUOTE_VALUE(DEFAULT_NTHREADS)"]\n"
 //
 "  -k, --kmer <kmer>        Kmer size must be odd ("QUOTE_VALUE(MAX_KMER_SIZE)" >= k >= "QUOTE_VALUE(MIN_KMER_SIZE)")\n"
@@ -54,6 +62,10 @@ static struct option longopts[] =
   {"nkmers",       required_argument, NULL, 'n'},
   {"threads",      required_argument, NULL, 't'},
   {"force",        no_argument,       NULL, 'f'},
+  {"grow",         no_argument,       NULL, 'G'},
+  {"disk",         required_argument, NULL, 'D'},
+  {"tmp",          required_argument, NULL, 'T'},
+  {"bloom",        required_argument, NULL, 'B'},
 // command specific
   {"kmer",         required_argument, NULL, 'k'},
   {"sample",       required_argument, NULL, 's'},
@@ -87,6 +99,13 @@ static struct MemArgs memargs = MEM_ARGS_INIT;
 
 static char *out_path = NULL;
 static size_t output_colours = 0, kmer_size = 0;
+static bool grow_table = false;
+static size_t nparts = 0;
+static const char *tmp_dir = NULL;
+static size_t bloom_mem = 0;
+
+// Initial hash table size with --grow
+#define GROW_INIT_NKMERS (1UL<<20)
 
 static void add_task(BuildGraphTask *task)
 {
@@ -130,6 +149,14 @@ static void parse_args(int argc, char **argv)
       case 'm': cmd_mem_args_set_memory(&memargs, optarg); break;
       case 'n': cmd_mem_args_set_nkmers(&memargs, optarg); break;
       case 'f': cmd_check(!futil_get_force(), cmd); futil_set_force(true); break;
+      case 'G': cmd_check(!grow_table, cmd); grow_table = true; break;
+      case 'D': cmd_check(!nparts, cmd); nparts = cmd_uint32_nonzero(cmd, optarg); break;
+      case 'T': cmd_check(!tmp_dir, cmd); tmp_dir = optarg; break;
+      case 'B':
+        cmd_check(!bloom_mem, cmd);
+        bloom_mem = cmd_parse_arg_mem(cmd, optarg);
+        if(!bloom_mem) cmd_print_usage("--bloom <mem> cannot be zero");
+        break;
       case 'k': cmd_check(!kmer_size,cmd); kmer_size = cmd_kmer_size(cmd, optarg); break;
       case 's':
         intocolour++;
@@ -195,6 +222,13 @@ static void parse_args(int argc, char **argv)
 
   if(!kmer_size) die("kmer size not set with -k <K>");
 
+  if(nparts > 0 && gfilebuf.len > 0)
+    cmd_print_usage("Cannot load graphs (--graph) with --disk");
+  if(nparts == 0 && tmp_dir != NULL)
+    cmd_print_usage("--tmp <dir> is only used with --disk <P>");
+  if(nparts > 0 && bloom_mem > 0)
+    cmd_print_usage("Cannot use --bloom with --disk");
+
   // Check kmer size in graphs to load
   size_t i;
   for(i = 0; i < gfilebuf.len; i++) {
@@ -226,10 +260,15 @@ int ctx_build(int argc, char **argv)
   for(i = 0; i < ntasks && !tasks[i].remove_pcr_dups; i++) {}
   bool remove_pcr_used = (i < ntasks);
 
+  if(nparts > 0 && remove_pcr_used)
+    cmd_print_usage("Cannot remove PCR duplicates (--remove-pcr) with --disk");
+  if(bloom_mem > 0 && remove_pcr_used)
+    cmd_print_usage("Cannot remove PCR duplicates (--remove-pcr) with --bloom");
+
   //
   // Print inputs
   //
-  size_t max_kmers = 0;
+  size_t max_kmers = 0, graph_kmers;
 
   // Print graphs to be loaded
   for(i = 0; i < gfilebuf.len; i++) {
@@ -237,6 +276,8 @@ int ctx_build(int argc, char **argv)
     max_kmers += gfilebuf.data[i].num_of_kmers;
   }
 
+  graph_kmers = max_kmers;
+
   // Print tasks and sample names
   for(s = t = 0; s < ncolours || t < ntasks; ) {
     if(t == ntasks || (s < ncolours && samples[s].colour <= tasks[t].colour)) {
@@ -257,21 +298,77 @@ int ctx_build(int argc, char **argv)
   //
   // Decide on memory
   //
-  size_t bits_per_kmer, kmers_in_hash, graph_mem;
+  size_t bits_per_kmer, kmers_in_hash, graph_mem, parts_mem = 0;
+  size_t mem_to_use = memargs.mem_to_use;
+
+  // Out-of-core: the graph only needs to hold one partition
+  if(nparts > 0)
+  {
+    parts_mem = build_graph_parts_mem(nparts, nthreads);
+    cmd_print_mem(parts_mem, "partition buffers");
+    if(parts_mem >= mem_to_use)
+      die("Not enough memory for %zu partitions, use fewer or increase -m", nparts);
+    mem_to_use -= parts_mem;
+    if(max_kmers != SIZE_MAX)
+      max_kmers = MIN2(max_kmers, (max_kmers / nparts + 1) * BUILD_PARTS_SKEW);
+  }
+
+  // Bloom filter of kmers seen once
+  if(bloom_mem > 0)
+  {
+    bloom_mem = kmer_bloom_mem(bloom_mem);
+    cmd_print_mem(bloom_mem, "bloom filter");
+    if(bloom_mem >= mem_to_use)
+      die("Not enough memory for Bloom filter, decrease --bloom or increase -m");
+    mem_to_use -= bloom_mem;
+  }
+
+  // Batches of reads passed from input threads to build threads
+  size_t reads_mem = asyncio_pool_mem(MIN2(ntasks, MAX_IO_THREADS), nthreads);
+  reads_mem = cmd_reserve_mem(&mem_to_use, reads_mem, "read buffers");
 
   // remove_pcr_dups requires a fw and rv bit per kmer
   bits_per_kmer = sizeof(BinaryKmer)*8 +
                   (sizeof(Covg) + sizeof(Edges)) * 8 * output_colours +
                   remove_pcr_used*2;
 
-  kmers_in_hash = cmd_get_kmers_in_hash(memargs.mem_to_use,
-                                        memargs.mem_to_use_set,
-                                        memargs.num_kmers,
-                                        memargs.num_kmers_set,
-                                        bits_per_kmer, 0, max_kmers,
-                                        true, &graph_mem);
+  uint64_t max_capacity = 0;
+
+  if(grow_table)
+  {
+    // Graphs are loaded before the table can grow, so must fit initially
+    size_t init_kmers = memargs.num_kmers_set ? memargs.num_kmers :
+                        MAX2(GROW_INIT_NKMERS, graph_kmers / IDEAL_OCCUPANCY);
+
+    kmers_in_hash = cmd_get_kmers_in_hash(mem_to_use,
+                                          memargs.mem_to_use_set,
+                                          init_kmers, true,
+                                          bits_per_kmer, graph_kmers, -1,
+                                          true, &graph_mem);
+
+    // Growing needs memory for the old and new table at the same time,
+    // db_graph_grow_for() keeps them within 1.5 times the largest table
+    graph_mem = hash_table_mem_limit(mem_to_use / 3 * 2,
+                                     bits_per_kmer, &max_capacity);
+    max_capacity = MAX2(max_capacity, kmers_in_hash);
+
+    char max_cap_str[50];
+    ulong_to_str(max_capacity, max_cap_str);
+    status("[memory] hash table may grow to %s entries", max_cap_str);
+    graph_mem += graph_mem / 2;
+  }
+  else
+  {
+    kmers_in_hash = cmd_get_kmers_in_hash(mem_to_use,
+                                          memargs.mem_to_use_set,
+                                          memargs.num_kmers,
+                                          memargs.num_kmers_set,
+                                          bits_per_kmer, 0, max_kmers,
+                                          true, &graph_mem);
+  }
 
-  cmd_check_mem_limit(memargs.mem_to_use, graph_mem);
+  cmd_check_mem_limit(memargs.mem_to_use,
+                      graph_mem + parts_mem + bloom_mem + reads_mem);
 
   //
   // Check output path
@@ -288,12 +385,22 @@ int ctx_build(int argc, char **argv)
   db_graph_alloc(&db_graph, kmer_size, output_colours, output_colours,
                  kmers_in_hash, alloc_flags);
 
+  db_graph.max_capacity = max_capacity;
+
+  KmerBloom bloom;
+  if(bloom_mem > 0) {
+    kmer_bloom_alloc(&bloom, bloom_mem);
+    db_graph.bloom = &bloom;
+  }
+
   hash_table_print_stats(&db_graph.ht);
 
   // Load graphs
   if(gfilebuf.len > 0)
   {
+    ctx_prof_phase("load_graph");
     GraphLoadingPrefs gprefs = LOAD_GPREFS_INIT(&db_graph);
+    gprefs.nthreads = nthreads;
     LoadingStats gstats = LOAD_STATS_INIT_MACRO;
 
     for(i = 0; i < gfilebuf.len; i++) {
@@ -308,8 +415,25 @@ int ctx_build(int argc, char **argv)
     strbuf_set(&db_graph.ginfo[samples[i].colour].sample_name, samples[i].name);
   }
 
+  // Temporary files go in the output directory by default
+  BuildGraphParts parts;
+  StrBuf tmp_path;
+  strbuf_alloc(&tmp_path, 1024);
+
+  if(nparts > 0) {
+    if(tmp_dir == NULL) {
+      if(strcmp(out_path,"-") == 0) strbuf_set(&tmp_path, ".");
+      else futil_get_strbuf_of_dir_path(out_path, &tmp_path);
+      tmp_dir = tmp_path.b;
+    }
+    status("[build] Writing %zu partitions to: %s", nparts, tmp_dir);
+    build_graph_parts_alloc(&parts, nparts, kmer_size, tmp_dir);
+  }
+
   size_t start, end, num_load, colour, prev_colour = 0;
 
+  ctx_prof_phase("build");
+
   // If we are using PCR duplicate removal,
   // it's best to load one colour at a time
   for(start = 0; start < ntasks; start = end, prev_colour = colour)
@@ -330,11 +454,14 @@ int ctx_build(int argc, char **argv)
     }
 
     num_load = end-start;
-    build_graph(&db_graph, tasks+start, num_load, nthreads);
+    if(nparts > 0)
+      build_graph_to_parts(&db_graph, tasks+start, num_load, nthreads, &parts);
+    else
+      build_graph(&db_graph, tasks+start, num_load, nthreads);
   }
 
   // Print stats for hash table
-  hash_table_print_stats(&db_graph.ht);
+  if(nparts == 0) hash_table_print_stats(&db_graph.ht);
 
   // Print stats per input file
   for(i = 0; i < ntasks; i++) {
@@ -342,9 +469,22 @@ int ctx_build(int argc, char **argv)
     build_graph_task_destroy(&tasks[i]);
   }
 
-  status("Dumping graph...\n");
-  graph_file_save_mkhdr(out_path, &db_graph, CTX_GRAPH_FILEFORMAT, NULL,
-                        0, output_colours);
+  ctx_prof_phase("write");
+
+  if(nparts > 0) {
+    build_graph_parts_save(&parts, &db_graph, out_path, nthreads);
+    build_graph_parts_dealloc(&parts);
+  }
+  else {
+    status("Dumping graph...\n");
+    graph_file_save_mkhdr(out_path, &db_graph, CTX_GRAPH_FILEFORMAT, NULL,
+                          0, output_colours);
+  }
+
+  ctx_prof_phase_end();
+
+  strbuf_dealloc(&tmp_path);
+  if(bloom_mem > 0) kmer_bloom_dealloc(&bloom);
 
   build_graph_task_buf_dealloc(&gtaskbuf);
   gfile_buf_dealloc(&gfilebuf);
@@ -6,6 +6,7 @@
 #include "graph_info.h"
 #include "graph_format.h"
 #include "clean_graph.h"
+#include "unitig_index.h"
 #include "supernode.h" // for saving length histogram
 
 const bool use_supernode_covg = false;
@@ -15,11 +16,13 @@ const char clean_usage[] =
 "\n"
 "  Clean a cortex graph. Joins graphs first, if multiple inputs given.\n"
 "  If neither -t or -s specified, just saves output statistics.\n"
+"  The union of colours is cleaned, unless --each-colour is given.\n"
 "\n"
 "  -h, --help                  This help message\n"
 "  -q, --quiet                 Silence status output normally printed to STDERR\n"
 "  -f, --force                 Overwrite output files\n"
 "  -o, --out <out.ctx>         Save output graph file [required]\n"
+"  -P, --per-colour            Save each colour to <out>.<col>.ctx\n"
 "  -m, --memory <mem>          Memory to use\n"
 "  -n, --nkmers <kmers>        Number of hash table entries (e.g. 1G ~ 1 billion)\n"
 "  -t, --threads <T>           Number of threads to use [default: "QUOTE_VALUE(DEFAULT_NTHREADS)"]\n"
@@ -29,6 +32,12 @@ const char clean_usage[] =
 "  -T, --tips <L>              Clip tips shorter than <L> kmers\n"
 "  -S[T], --supernodes[=T]     Remove low coverage supernode with coverage < T [default: auto]\n"
 "  -d, --kdepth <C>            kmer depth: (depth*(R-Kmersize+1)/R); R = read length\n"
+"  -E, --each-colour           Clean each colour separately with its own threshold\n"
+"                              (all colours must fit in memory)\n"
+"\n"
+"  Unitigs (only when cleaning the union of colours):\n"
+"  -u, --unitigs <in.utg>      Load unitig index of the input graph\n"
+"  -U, --unitigs-out <out.utg> Save unitig index of the cleaned graph\n"
 "\n"
 "  Statistics:\n"
 "  -c, --covg-before <out.csv> Save kmer coverage histogram before cleaning\n"
@@ -37,6 +46,8 @@ const char clean_usage[] =
 "  -L, --len-after <out.csv>   Save supernode length histogram after cleaning\n"
 "\n"
 "  --supernodes without a threshold, causes a caclulated threshold to be used\n"
+"  When cleaning colours separately, histograms are saved per colour to\n"
+"  <out>.<col>.csv\n"
 "  Default: --tips 2*kmer_size --supernodes\n"
 "\n";
 
@@ -49,10 +60,14 @@ static struct option longopts[] =
   {"memory",       required_argument, NULL, 'm'},
   {"nkmers",       required_argument, NULL, 'n'},
   {"threads",      required_argument, NULL, 't'},
+  {"per-colour",   no_argument,       NULL, 'P'},
 // command specific
   {"tips",         required_argument, NULL, 'T'},
   {"supernodes",   optional_argument, NULL, 'S'},
   {"kdepth",       required_argument, NULL, 'd'},
+  {"each-colour",  no_argument,       NULL, 'E'},
+  {"unitigs",      required_argument, NULL, 'u'},
+  {"unitigs-out",  required_argument, NULL, 'U'},
 // output
   {"len-before",   required_argument, NULL, 'l'},
   {"len-after",    required_argument, NULL, 'L'},
@@ -61,17 +76,35 @@ static struct option longopts[] =
   {NULL, 0, NULL, 0}
 };
 
+// Path for colour `col` when cleaning or saving colours separately:
+// insert ".<col>" before the extension (out.csv -> out.<col>.csv) or append
+// it if there is no extension. "-" (STDOUT) is unchanged.
+// Returns NULL if path is NULL, otherwise free with ctx_free()
+static char* clean_colour_path(const char *path, size_t col)
+{
+  if(path == NULL) return NULL;
+  size_t len = strlen(path);
+  char *out = ctx_malloc(len + 30);
+  if(strcmp(path,"-") == 0) { strcpy(out, path); return out; }
+  const char *ext = strrchr(path, '.'), *dir = strrchr(path, '/');
+  if(ext == NULL || ext == path || (dir != NULL && ext < dir)) ext = path + len;
+  sprintf(out, "%.*s.%zu%s", (int)(ext - path), path, col, ext);
+  return out;
+}
+
 int ctx_clean(int argc, char **argv)
 {
   size_t nthreads = 0, use_ncols = 0;
   struct MemArgs memargs = MEM_ARGS_INIT;
   const char *out_ctx_path = NULL;
-  bool tip_cleaning = false, supernode_cleaning = false;
+  bool tip_cleaning = false, supernode_cleaning = false, per_colour_out = false;
+  bool each_colour = false;
   size_t min_keep_tip = 0;
   Covg threshold = 0;
   double seq_depth = 0;
   const char *len_before_path = NULL, *len_after_path = NULL;
   const char *covg_before_path = NULL, *covg_after_path = NULL;
+  const char *utigs_in_path = NULL, *utigs_out_path = NULL;
 
   // Arg parsing
   char cmd[100];
@@ -92,6 +125,7 @@ int ctx_clean(int argc, char **argv)
         if(out_ctx_path != NULL) cmd_print_usage(NULL);
         out_ctx_path = optarg;
         break;
+      case 'P': cmd_check(!per_colour_out, cmd); per_colour_out = true; break;
       case 'm': cmd_mem_args_set_memory(&memargs, optarg); break;
       case 'n': cmd_mem_args_set_nkmers(&memargs, optarg); break;
       case 'N': use_ncols = cmd_uint32_nonzero(cmd, optarg); break;
@@ -107,6 +141,9 @@ int ctx_clean(int argc, char **argv)
         supernode_cleaning = true;
         break;
       case 'd': cmd_check(seq_depth <= 0, cmd); seq_depth = cmd_udouble_nonzero(cmd, optarg); break;
+      case 'E': cmd_check(!each_colour, cmd); each_colour = true; break;
+      case 'u': cmd_check(!utigs_in_path, cmd); utigs_in_path = optarg; break;
+      case 'U': cmd_check(!utigs_out_path, cmd); utigs_out_path = optarg; break;
       case 'l': cmd_check(!len_before_path, cmd); len_before_path = optarg; break;
       case 'L': cmd_check(!len_after_path, cmd); len_after_path = optarg; break;
       case 'c': cmd_check(!covg_before_path, cmd); covg_before_path = optarg; break;
@@ -148,7 +185,21 @@ int ctx_clean(int argc, char **argv)
                     "any cleaning (set -s, --supernodes or -t, --tips)");
   }
 
-  if(doing_cleaning && strcmp(out_ctx_path,"-") != 0 &&
+  if(per_colour_out && !doing_cleaning)
+    cmd_print_usage("--per-colour needs --out <out.ctx> and cleaning");
+
+  if(per_colour_out && strcmp(out_ctx_path,"-") == 0)
+    cmd_print_usage("Cannot use STDOUT with --per-colour");
+
+  if(each_colour && !doing_cleaning)
+    cmd_print_usage("--each-colour needs --out <out.ctx> and cleaning");
+
+  if(each_colour && (utigs_in_path || utigs_out_path)) {
+    cmd_print_usage("--unitigs / --unitigs-out can only be used when "
+                    "cleaning the union of colours");
+  }
+
+  if(doing_cleaning && !per_colour_out && strcmp(out_ctx_path,"-") != 0 &&
      !futil_get_force() && futil_file_exists(out_ctx_path))
   {
     cmd_print_usage("Output file already exists: %s", out_ctx_path);
@@ -240,8 +291,10 @@ int ctx_clean(int argc, char **argv)
   size_t kmers_in_hash, bits_per_kmer, graph_mem;
   size_t per_kmer_per_col_bits = (sizeof(BinaryKmer)+sizeof(Covg)+sizeof(Edges)) * 8;
   size_t pop_edges_per_kmer_bits = (all_colours_loaded ? 0 : sizeof(Edges) * 8);
+  size_t utig_per_kmer_bits = UNITIG_INDEX_KMER_BYTES * 8;
 
-  bits_per_kmer = per_kmer_per_col_bits * use_ncols + pop_edges_per_kmer_bits;
+  bits_per_kmer = per_kmer_per_col_bits * use_ncols + pop_edges_per_kmer_bits +
+                  utig_per_kmer_bits;
 
   kmers_in_hash = cmd_get_kmers_in_hash(memargs.mem_to_use,
                                         memargs.mem_to_use_set,
@@ -252,22 +305,56 @@ int ctx_clean(int argc, char **argv)
                                         use_mem_limit, &graph_mem);
 
   // Maximise the number of colours we load to fill the mem
-  size_t max_usencols = (memargs.mem_to_use*8 - pop_edges_per_kmer_bits * kmers_in_hash) /
+  size_t max_usencols = (memargs.mem_to_use*8 -
+                          (pop_edges_per_kmer_bits + utig_per_kmer_bits) * kmers_in_hash) /
                         (per_kmer_per_col_bits * kmers_in_hash);
   use_ncols = MIN2(max_usencols, ncols);
 
   cmd_check_mem_limit(memargs.mem_to_use, graph_mem);
 
+  if(per_colour_out && use_ncols < ncols)
+    die("Not enough memory to load all %zu colours for --per-colour", ncols);
+
+  if(each_colour && use_ncols < ncols)
+    die("Not enough memory to load all %zu colours for --each-colour", ncols);
+
+  // Nothing to do separately with one colour
+  each_colour &= (ncols > 1);
+
+  if(each_colour) status("Cleaning %zu colours separately", ncols);
+
   //
   // Check output files are writable
   //
-  futil_create_output(out_ctx_path);
+  size_t col;
+  const char *csv_paths[4] = {covg_before_path, covg_after_path,
+                              len_before_path, len_after_path};
+  char *path;
+
+  if(per_colour_out) {
+    for(col = 0; col < ncols; col++) {
+      path = clean_colour_path(out_ctx_path, col);
+      if(!futil_get_force() && futil_file_exists(path))
+        cmd_print_usage("Output file already exists: %s", path);
+      futil_create_output(path);
+      ctx_free(path);
+    }
+  }
+  else futil_create_output(out_ctx_path);
 
   // Does nothing if arg is NULL
-  futil_create_output(covg_before_path);
-  futil_create_output(covg_after_path);
-  futil_create_output(len_before_path);
-  futil_create_output(len_after_path);
+  for(i = 0; i < 4; i++) {
+    if(each_colour) {
+      for(col = 0; col < ncols; col++) {
+        path = clean_colour_path(csv_paths[i], col);
+        futil_create_output(path);
+        ctx_free(path);
+      }
+    }
+    else futil_create_output(csv_paths[i]);
+  }
+
+  futil_create_output(utigs_out_path);
 
   // Create db_graph
   // Load as many colours as possible
@@ -287,7 +374,8 @@ int ctx_clean(int argc, char **argv)
                               .boolean_covgs = false,
                               .must_exist_in_graph = false,
                               .must_exist_in_edges = NULL,
-                              .empty_colours = false};
+                              .empty_colours = false,
+                              .nthreads = nthreads};
 
   // Construct cleaned graph header
   GraphFileHeader outhdr;
@@ -308,6 +396,8 @@ int ctx_clean(int argc, char **argv)
     }
   }
 
+  ctx_prof_phase("load_graph");
+
   if(ncols > use_ncols) {
     graph_files_load_flat(gfiles, num_gfiles, gprefs, &stats);
   } else {
@@ -322,28 +412,80 @@ int ctx_clean(int argc, char **argv)
   size_t initial_nkmers = db_graph.ht.num_kmers;
   hash_table_print_stats(&db_graph.ht);
 
-  uint8_t *visited = ctx_calloc(roundup_bits2bytes(db_graph.ht.capacity), 1);
+  ctx_prof_phase("clean");
+
   uint8_t *keep = ctx_calloc(roundup_bits2bytes(db_graph.ht.capacity), 1);
+  Covg *col_thresholds = ctx_calloc(ncols, sizeof(Covg));
+
+  // Find unitigs once, cleaning updates them
+  UnitigIndex uidx;
+  unitig_index_alloc(&uidx, db_graph.ht.capacity);
+
+  if(each_colour)
+  {
+    // One load, then find unitigs and clean one colour at a time
+    char *col_paths[4];
+    int est_threshold;
+
+    for(col = 0; col < ncols; col++)
+    {
+      for(i = 0; i < 4; i++) col_paths[i] = clean_colour_path(csv_paths[i], col);
 
-  if(threshold == 0 || covg_before_path || len_before_path) {
-    // Get coverage distribution and estimate cleaning threshold
-    size_t est_threshold = cleaning_get_threshold(nthreads, use_supernode_covg,
-                                                  seq_depth,
-                                                  covg_before_path, len_before_path,
-                                                  visited, &db_graph);
+      unitig_index_build_col(&uidx, nthreads, (int)col, &db_graph);
+      col_thresholds[col] = threshold;
 
-    // Use estimated threshold if threshold not set
-    if(threshold == 0) threshold = est_threshold;
+      if(threshold == 0 || covg_before_path || len_before_path) {
+        est_threshold = cleaning_get_threshold(nthreads, use_supernode_covg,
+                                               seq_depth,
+                                               col_paths[0], col_paths[2],
+                                               &uidx, &db_graph);
+
+        if(threshold == 0 && est_threshold > 0)
+          col_thresholds[col] = est_threshold;
+      }
+
+      clean_graph(nthreads, use_supernode_covg, col_thresholds[col],
+                  min_keep_tip, col_paths[1], col_paths[3],
+                  keep, &uidx, &db_graph);
+
+      for(i = 0; i < 4; i++) ctx_free(col_paths[i]);
+    }
+
+    // Kmers may now be missing from every colour
+    cleaning_remove_uncoloured(nthreads, keep, &db_graph);
   }
+  else
+  {
+    if(utigs_in_path != NULL)
+      unitig_index_load(&uidx, utigs_in_path, nthreads, &db_graph);
+    else
+      unitig_index_build(&uidx, nthreads, &db_graph);
+
+    if(threshold == 0 || covg_before_path || len_before_path) {
+      // Get coverage distribution and estimate cleaning threshold
+      size_t est_threshold = cleaning_get_threshold(nthreads, use_supernode_covg,
+                                                    seq_depth,
+                                                    covg_before_path, len_before_path,
+                                                    &uidx, &db_graph);
+
+      // Use estimated threshold if threshold not set
+      if(threshold == 0) threshold = est_threshold;
+    }
 
-  if(doing_cleaning) {
-    // Clean graph of tips (if min_keep_tip > 0) and supernodes (if threshold > 0)
-    clean_graph(nthreads, use_supernode_covg, threshold, min_keep_tip,
-                covg_after_path, len_after_path,
-                visited, keep, &db_graph);
+    if(doing_cleaning) {
+      // Clean graph of tips (if min_keep_tip > 0) and supernodes (if threshold > 0)
+      clean_graph(nthreads, use_supernode_covg, threshold, min_keep_tip,
+                  covg_after_path, len_after_path,
+                  keep, &uidx, &db_graph);
+    }
+
+    if(utigs_out_path != NULL)
+      unitig_index_save(&uidx, utigs_out_path, &db_graph);
+
+    for(col = 0; col < ncols; col++) col_thresholds[col] = threshold;
   }
 
-  ctx_free(visited);
+  unitig_index_dealloc(&uidx);
   ctx_free(keep);
 
   if(doing_cleaning)
@@ -351,7 +493,7 @@ int ctx_clean(int argc, char **argv)
     // Output graph file
     Edges *intersect_edges = NULL;
     bool kmers_loaded = true;
-    size_t col, thresh;
+    size_t thresh;
 
     // Set output header ginfo cleaned
     for(col = 0; col < ncols; col++)
@@ -366,7 +508,8 @@ int ctx_clean(int argc, char **argv)
 
       if(supernode_cleaning) {
         thresh = cleaning->clean_snodes_thresh;
-        thresh = cleaning->cleaned_snodes ? MAX2(thresh, threshold) : threshold;
+        thresh = cleaning->cleaned_snodes ? MAX2(thresh, col_thresholds[col])
+                                          : col_thresholds[col];
         cleaning->clean_snodes_thresh = thresh;
 
         char name_append[200];
@@ -375,6 +518,9 @@ int ctx_clean(int argc, char **argv)
       }
     }
 
+    // Colours are all loaded if we cleaned them separately
+    all_colours_loaded |= each_colour;
+
     if(!all_colours_loaded)
     {
       // We haven't loaded all the colours
@@ -384,6 +530,8 @@ int ctx_clean(int argc, char **argv)
       db_graph.col_edges += db_graph.ht.capacity;
     }
 
+    ctx_prof_phase("write");
+
     // Print stats on removed kmers
     size_t removed_nkmers = initial_nkmers - db_graph.ht.num_kmers;
     double removed_pct = (100.0 * removed_nkmers) / initial_nkmers;
@@ -392,17 +540,36 @@ int ctx_clean(int argc, char **argv)
     ulong_to_str(initial_nkmers, init_str);
     status("Removed %s of %s (%.2f%%) kmers", removed_str, init_str, removed_pct);
 
-    graph_files_merge(out_ctx_path, gfiles, num_gfiles,
-                      kmers_loaded, all_colours_loaded,
-                      intersect_edges, &outhdr, &db_graph);
+    if(per_colour_out)
+    {
+      // Header of a single colour
+      GraphFileHeader colhdr = outhdr;
+      colhdr.num_of_cols = colhdr.capacity = 1;
+
+      for(col = 0; col < ncols; col++) {
+        colhdr.ginfo = &outhdr.ginfo[col];
+        path = clean_colour_path(out_ctx_path, col);
+        graph_file_save(path, &db_graph, &colhdr, 0, NULL, col, 1);
+        ctx_free(path);
+      }
+    }
+    else
+    {
+      graph_files_merge(out_ctx_path, gfiles, num_gfiles,
+                        kmers_loaded, all_colours_loaded,
+                        intersect_edges, &outhdr, &db_graph);
+    }
 
     // Swap back
     if(!all_colours_loaded)
       db_graph.col_edges = intersect_edges;
   }
 
+  ctx_prof_phase_end();
+
   ctx_check(db_graph.ht.num_kmers == hash_table_count_kmers(&db_graph.ht));
 
+  ctx_free(col_thresholds);
   graph_header_dealloc(&outhdr);
 
   for(i = 0; i < num_gfiles; i++) graph_file_close(&gfiles[i]);
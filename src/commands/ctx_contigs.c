@@ -202,7 +202,8 @@ int ctx_contigs(int argc, char **argv)
 
   // Paths memory
   size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem, false);
+  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem,
+                                  false, true);
 
   // Shift path store memory from graphs->paths
   graph_mem -= sizeof(GPath*)*kmers_in_hash;
@@ -248,7 +249,7 @@ int ctx_contigs(int argc, char **argv)
 
   // Paths
   gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem,
-                             false, &db_graph);
+                             false, true, &db_graph);
 
   uint8_t *visited = NULL;
 
@@ -261,23 +262,32 @@ int ctx_contigs(int argc, char **argv)
   GraphLoadingPrefs gprefs = {.db_graph = &db_graph,
                               .boolean_covgs = false,
                               .must_exist_in_graph = false,
-                              .empty_colours = true};
+                              .empty_colours = true,
+                              .nthreads = nthreads};
 
+  ctx_prof_phase("load_graph");
   graph_load(&gfile, gprefs, &stats);
   graph_file_close(&gfile);
 
   hash_table_print_stats(&db_graph.ht);
 
   // Load path files
+  ctx_prof_phase("load_paths");
   for(i = 0; i < gpfiles.len; i++) {
-    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS,
+                      nthreads, &db_graph);
     gpath_reader_close(&gpfiles.data[i]);
   }
   gpfile_buf_dealloc(&gpfiles);
 
+  // Paths are read-only from here
+  gpath_store_compact(&db_graph.gpstore);
+
   AssembleContigStats assem_stats;
   assemble_contigs_stats_init(&assem_stats);
 
+  // Contigs are written as they are assembled
+  ctx_prof_phase("walk");
   assemble_contigs(nthreads, seed_buf.data, seed_buf.len,
                    contig_limit, visited,
                    use_missing_info_check, seed_with_unused_paths,
@@ -286,6 +296,7 @@ int ctx_contigs(int argc, char **argv)
                    &db_graph, 0); // Sample always loaded into colour zero
 
   if(fout && fout != stdout) fclose(fout);
+  ctx_prof_phase_end();
 
   assemble_contigs_stats_print(&assem_stats);
   assemble_contigs_stats_destroy(&assem_stats);
@@ -126,13 +126,19 @@ int ctx_correct(int argc, char **argv)
   // Decide on memory
   //
   size_t bits_per_kmer, kmers_in_hash, graph_mem, path_mem, total_mem;
+  size_t mem_to_use = args.memargs.mem_to_use;
 
   // 1 bit needed per kmer if we need to keep track of noreseed
   bits_per_kmer = sizeof(BinaryKmer)*8 + sizeof(Edges)*8 +
                   (gpfiles->len > 0 ? sizeof(GPath*)*8 : 0) +
                   ncols; // in colour
 
-  kmers_in_hash = cmd_get_kmers_in_hash(args.memargs.mem_to_use,
+  // Batches of reads passed from input threads to worker threads
+  size_t reads_mem = asyncio_pool_mem(MIN2(inputs->len, MAX_IO_THREADS),
+                                      args.nthreads);
+  reads_mem = cmd_reserve_mem(&mem_to_use, reads_mem, "read buffers");
+
+  kmers_in_hash = cmd_get_kmers_in_hash(mem_to_use,
                                         args.memargs.mem_to_use_set,
                                         args.memargs.num_kmers,
                                         args.memargs.num_kmers_set,
@@ -141,8 +147,9 @@ int ctx_correct(int argc, char **argv)
                                         false, &graph_mem);
 
   // Paths memory
-  size_t rem_mem = args.memargs.mem_to_use - MIN2(args.memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(gpfiles->data, gpfiles->len, ncols, rem_mem, false);
+  size_t rem_mem = mem_to_use - MIN2(mem_to_use, graph_mem);
+  path_mem = gpath_reader_mem_req(gpfiles->data, gpfiles->len, ncols, rem_mem,
+                                  false, true);
 
   cmd_print_mem(path_mem, "paths");
 
@@ -151,7 +158,7 @@ int ctx_correct(int argc, char **argv)
   path_mem  += sizeof(GPath*)*kmers_in_hash;
 
   // Total memory
-  total_mem = graph_mem + path_mem;
+  total_mem = graph_mem + path_mem + reads_mem;
   cmd_check_mem_limit(args.memargs.mem_to_use, total_mem);
 
   //
@@ -187,7 +194,8 @@ int ctx_correct(int argc, char **argv)
                  DBG_ALLOC_EDGES | DBG_ALLOC_NODE_IN_COL);
 
   // Create a path store that does not tracks path counts
-  gpath_reader_alloc_gpstore(gpfiles->data, gpfiles->len, path_mem, false, &db_graph);
+  gpath_reader_alloc_gpstore(gpfiles->data, gpfiles->len, path_mem,
+                             false, true, &db_graph);
 
   //
   // Load Graph and Path files
@@ -197,22 +205,30 @@ int ctx_correct(int argc, char **argv)
                               .boolean_covgs = false,
                               .must_exist_in_graph = false,
                               .must_exist_in_edges = NULL,
-                              .empty_colours = true};
+                              .empty_colours = true,
+                              .nthreads = args.nthreads};
 
   // Load graph, print stats, close file
+  ctx_prof_phase("load_graph");
   graph_load(gfile, gprefs, &gstats);
   hash_table_print_stats_brief(&db_graph.ht);
   graph_file_close(gfile);
 
   // Load path files
+  ctx_prof_phase("load_paths");
   for(i = 0; i < gpfiles->len; i++) {
-    gpath_reader_load(&gpfiles->data[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&gpfiles->data[i], GPATH_DIE_MISSING_KMERS,
+                      args.nthreads, &db_graph);
     gpath_reader_close(&gpfiles->data[i]);
   }
 
+  // Paths are read-only from here
+  gpath_store_compact(&db_graph.gpstore);
+
   //
   // Run alignment
   //
+  ctx_prof_phase("walk");
   correct_reads(inputs->data, inputs->len,
                 args.dump_seq_sizes, args.dump_frag_sizes,
                 args.fq_zero, args.append_orig_seq,
@@ -222,6 +238,7 @@ int ctx_correct(int argc, char **argv)
   for(i = 0; i < inputs->len; i++)
     seqout_close(&outputs[i], false);
   ctx_free(outputs);
+  ctx_prof_phase_end();
 
   // Closes input files
   read_thread_args_dealloc(&args);
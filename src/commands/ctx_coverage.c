@@ -110,11 +110,12 @@ static inline void print_read_covg(const dBGraph *db_graph, const read_t *r,
     memset(edgebuf->data, 0, ncols * kmer_length * sizeof(Edges));
   }
 
-  size_t i, j, col, search_start = 0;
-  size_t contig_start, contig_end;
-  BinaryKmer bkmer;
-  Nucleotide nuc;
-  dBNode node;
+  size_t i, k, m, col, search_start = 0;
+  size_t contig_start, contig_end, contig_kmers;
+  BinaryKmerIter kmer_iter;
+  BinaryKmer bkeys[DB_GRAPH_BATCH];
+  Orientation orients[DB_GRAPH_BATCH];
+  dBNode node, nodes[DB_GRAPH_BATCH];
   Covg *covgs;
 
   while((contig_start = seq_contig_start(r, search_start, kmer_size,
@@ -122,19 +123,27 @@ static inline void print_read_covg(const dBGraph *db_graph, const read_t *r,
   {
     contig_end = seq_contig_end(r, contig_start, kmer_size, 0, 0, &search_start);
 
-    bkmer = binary_kmer_from_str(r->seq.b + contig_start, kmer_size);
-    bkmer = binary_kmer_right_shift_one_base(bkmer);
+    contig_kmers = contig_end - contig_start + 1 - kmer_size;
 
-    for(i = contig_start, j = contig_start+kmer_size-1; j < contig_end; j++, i++)
+    binary_kmer_iter_init(&kmer_iter, kmer_size);
+    binary_kmer_iter_add_str(&kmer_iter, r->seq.b+contig_start, kmer_size-1);
+
+    // Look up kmers in batches, i is the offset of the first kmer in a batch
+    for(i = contig_start; i < contig_start + contig_kmers; i += m)
     {
-      nuc = dna_char_to_nuc(r->seq.b[j]);
-      bkmer = binary_kmer_left_shift_add(bkmer, kmer_size, nuc);
-      node = db_graph_find(db_graph, bkmer);
-      if(node.key != HASH_NOT_FOUND) {
-        covgs = &db_node_covg(db_graph, node.key, 0);
-        memcpy(covgbuf->data+i*ncols, covgs, ncols * sizeof(Covg));
-        if(db_graph->col_edges) {
-          fetch_node_edges(db_graph, node, edgebuf->data+i*ncols);
+      m = MIN2(contig_start + contig_kmers - i, DB_GRAPH_BATCH);
+      binary_kmer_iter_keys(&kmer_iter, r->seq.b+i+kmer_size-1, m,
+                            bkeys, orients);
+      db_graph_find_batch(db_graph, bkeys, orients, m, nodes);
+
+      for(k = 0; k < m; k++) {
+        node = nodes[k];
+        if(node.key != HASH_NOT_FOUND) {
+          covgs = &db_node_covg(db_graph, node.key, 0);
+          memcpy(covgbuf->data+(i+k)*ncols, covgs, ncols * sizeof(Covg));
+          if(db_graph->col_edges) {
+            fetch_node_edges(db_graph, node, edgebuf->data+(i+k)*ncols);
+          }
         }
       }
     }
@@ -60,6 +60,7 @@ static struct option longopts[] =
 
 typedef struct {
   size_t colour, threadid, nthreads;
+  TaskScheduler *sched;
   bool prime_AB; // prime the distance A->B instead of traversing
   size_t num_tests, num_limit; // Counting how many tests we've run / limit
   size_t max_AB_dist; // Max contig to assemble finding A from B
@@ -72,11 +73,10 @@ typedef struct {
   bool print_failed_contigs;
 } ExpABCWorker;
 
-static inline void reset(GraphWalker *wlk, RepeatWalker *rptwlk,
-                         const dBNodeBuffer *nbuf)
+static inline void reset(GraphWalker *wlk, RepeatWalker *rptwlk)
 {
   graph_walker_finish(wlk);
-  rpt_walker_fast_clear(rptwlk, nbuf->data, nbuf->len);
+  rpt_walker_clear(rptwlk);
 }
 
 #define CONFIRM_SUCCESS  0
@@ -100,19 +100,19 @@ static inline int confirm_seq(size_t startidx, bool allow_extend,
 
   for(i = startidx+1; graph_walker_next(wlk); i++) {
     if(!rpt_walker_attempt_traverse(rpt, wlk)) {
-      reset(wlk,rpt,nbuf);
+      reset(wlk,rpt);
       return CONFIRM_REPEAT;
     }
     if(i < init_len) {
       if(!db_nodes_are_equal(nbuf->data[i], wlk->node)) {
-        reset(wlk,rpt,nbuf);
+        reset(wlk,rpt);
         return CONFIRM_WRONG;
       }
     }
     else {
       db_node_buf_add(nbuf, wlk->node);
       if(!allow_extend) {
-        reset(wlk,rpt,nbuf);
+        reset(wlk,rpt);
         nbuf->len--; // Remove node we added
         return CONFIRM_OVERSHOT;
       }
@@ -121,7 +121,7 @@ static inline int confirm_seq(size_t startidx, bool allow_extend,
 
   // printf("stopped %zu / %zu %zu\n", i, init_len, nbuf->len);
 
-  reset(wlk,rpt,nbuf);
+  reset(wlk,rpt);
   return i < init_len ? CONFIRM_SHORT : CONFIRM_SUCCESS;
 }
 
@@ -162,12 +162,12 @@ int test_statement_node(dBNode node, ExpABCWorker *wrkr)
 
   while(graph_walker_next(wlk) && nbuf->len < walk_limit) {
     if(!rpt_walker_attempt_traverse(rpt, wlk)) {
-      reset(wlk,rpt,nbuf); return RES_LOST_IN_RPT;
+      reset(wlk,rpt); return RES_LOST_IN_RPT;
     }
     db_node_buf_add(nbuf, wlk->node);
   }
 
-  reset(wlk,rpt,nbuf);
+  reset(wlk,rpt);
 
   if(nbuf->len == 1) return RES_NO_TRAVERSAL;
 
@@ -182,7 +182,7 @@ int test_statement_node(dBNode node, ExpABCWorker *wrkr)
 
     while(graph_walker_next(wlk)) {
       if(!rpt_walker_attempt_traverse(rpt, wlk)) {
-        reset(wlk,rpt,nbuf); return RES_LOST_IN_RPT;
+        reset(wlk,rpt); return RES_LOST_IN_RPT;
       }
       db_node_buf_add(nbuf, wlk->node);
     }
@@ -203,7 +203,7 @@ int test_statement_node(dBNode node, ExpABCWorker *wrkr)
     }
   }
 
-  reset(wlk,rpt,nbuf);
+  reset(wlk,rpt);
 
   if(nbuf->len == b_idx+1) return RES_NO_TRAVERSAL; // Couldn't get past B
 
@@ -257,8 +257,8 @@ static void run_exp_abc_thread(void *ptr)
   const dBGraph *db_graph = wrkr->db_graph;
 
   // // Start from each kmer, in each direction
-  HASH_ITERATE_PART(&db_graph->ht, wrkr->threadid, wrkr->nthreads,
-                    test_statement_bkmer, wrkr);
+  HASH_ITERATE_SCHED(&db_graph->ht, wrkr->sched, wrkr->threadid,
+                     test_statement_bkmer, wrkr);
 }
 
 static void run_exp_abc(const dBGraph *db_graph, bool prime_AB,
@@ -268,12 +268,16 @@ static void run_exp_abc(const dBGraph *db_graph, bool prime_AB,
   ExpABCWorker *wrkrs = ctx_calloc(nthreads, sizeof(ExpABCWorker));
   size_t i, j;
 
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, nthreads);
+
   if(max_AB_dist == 0) max_AB_dist = SIZE_MAX;
 
   for(i = 0; i < nthreads; i++) {
     wrkrs[i].colour = 0;
     wrkrs[i].threadid = i;
     wrkrs[i].nthreads = nthreads;
+    wrkrs[i].sched = &sched;
     wrkrs[i].db_graph = db_graph;
     wrkrs[i].prime_AB = prime_AB;
     wrkrs[i].num_limit = num_repeats / nthreads;
@@ -302,6 +306,8 @@ static void run_exp_abc(const dBGraph *db_graph, bool prime_AB,
     rpt_walker_dealloc(&wrkrs[i].rptwlk);
   }
 
+  task_sched_dealloc(&sched);
+
   // Print results
   char nrunstr[50];
   ulong_to_str(num_tests, nrunstr);
@@ -413,7 +419,8 @@ int ctx_exp_abc(int argc, char **argv)
 
   // Paths memory
   size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem, false);
+  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem,
+                                  false, false);
 
   // Shift path store memory from graphs->paths
   graph_mem -= sizeof(GPath*)*kmers_in_hash;
@@ -431,7 +438,8 @@ int ctx_exp_abc(int argc, char **argv)
                  DBG_ALLOC_EDGES | DBG_ALLOC_NODE_IN_COL);
 
   // Paths
-  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem, false, &db_graph);
+  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem,
+                             false, false, &db_graph);
 
   // Load the graph
   LoadingStats stats = LOAD_STATS_INIT_MACRO;
@@ -448,7 +456,8 @@ int ctx_exp_abc(int argc, char **argv)
 
   // Load path files
   for(i = 0; i < gpfiles.len; i++) {
-    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS,
+                      nthreads, &db_graph);
     gpath_reader_close(&gpfiles.data[i]);
   }
   gpfile_buf_dealloc(&gpfiles);
@@ -4,6 +4,7 @@
 #include "util.h"
 #include "file_util.h"
 #include "graph_format.h"
+#include "graph_file_index.h"
 #include "binary_kmer.h"
 
 // DEV: add .ctp.gz sorting
@@ -31,53 +32,6 @@ static struct option longopts[] =
   {NULL, 0, NULL, 0}
 };
 
-static inline size_t read_kmer(FILE *fin, const char *path,
-                               size_t kmer_mem, char *tmp)
-{
-  size_t n = fread(tmp, 1, kmer_mem, fin);
-  if(n == 0) return 0;
-  if(n != kmer_mem) die("Invalid graph file: %s", path);
-  return 1;
-}
-
-// Return number of kmers in the block
-static inline size_t index_block(GraphFileReader *gfile,
-                                 char *tmp, size_t kmer_mem,
-                                 size_t block_kmers, size_t *offset,
-                                 FILE *fout)
-{
-  size_t n_read, kmer_size = gfile->hdr.kmer_size;
-  const char *path = file_filter_path(&gfile->fltr);
-
-  BinaryKmer bkmer_start, bkmer_end;
-  char kmer_start[MAX_KMER_SIZE+1], kmer_end[MAX_KMER_SIZE+1];
-
-  if(!read_kmer(gfile->fh, path, kmer_mem, tmp)) return 0;
-
-  memcpy(bkmer_start.b, tmp, sizeof(BinaryKmer));
-  binary_kmer_to_str(bkmer_start, kmer_size, kmer_start);
-
-  for(n_read = 1; n_read < block_kmers; n_read++) {
-    if(!read_kmer(gfile->fh, path, kmer_mem, tmp))
-      break;
-  }
-
-  memcpy(bkmer_end.b, tmp, sizeof(BinaryKmer));
-  binary_kmer_to_str(bkmer_end, kmer_size, kmer_end);
-
-  if(strcmp(kmer_start, kmer_end) >= 0)
-    die("File is not sorted: %s vs %s [%s]", kmer_start, kmer_end, path);
-
-  size_t block_start = *offset, block_size = n_read * kmer_mem;
-  *offset += block_size;
-
-  // Print index entry
-  fprintf(fout, "%s %s %zu %zu %zu\n", kmer_start, kmer_end, n_read,
-                                       block_start, block_size);
-
-  return n_read;
-}
-
 int ctx_index(int argc, char **argv)
 {
   const char *out_path = NULL;
@@ -132,13 +86,14 @@ int ctx_index(int argc, char **argv)
   if(!file_filter_is_direct(&gfile.fltr))
     die("Cannot open graph file with a filter ('in.ctx:blah' syntax)");
 
+  if(graph_file_is_compressed(&gfile))
+    die("Compressed graph files have a block index already: %s", ctx_path);
+
   // Open output file
   FILE *fout = out_path ? futil_open_create(out_path, "w") : stdout;
 
   // Start
-  size_t ncols = gfile.hdr.num_of_cols;
-  size_t kmer_mem = sizeof(BinaryKmer) + (sizeof(Edges)+sizeof(Covg))*ncols;
-  size_t nkmers, num_blocks = 0, num_kmers = 0, offset = gfile.hdr_size;
+  size_t kmer_mem = gfile.kmer_mem, num_blocks = 0, num_kmers;
 
   if(block_size) {
     block_kmers = block_size / kmer_mem;
@@ -152,20 +107,8 @@ int ctx_index(int argc, char **argv)
 
   if(block_kmers == 0) die("Cannot set block_kmers to zero");
 
-  char tmp[kmer_mem];
-  memset(tmp, 0, sizeof(tmp));
-
-  // Print header
-  fputs("#start_kmer end_kmer num_kmers start_byte block_size\n", fout);
-
   // Read in file, print index
-  while(1)
-  {
-    nkmers = index_block(&gfile, tmp, kmer_mem, block_kmers, &offset, fout);
-    num_kmers += nkmers;
-    num_blocks += (nkmers > 0);
-    if(nkmers < block_kmers) break;
-  }
+  num_kmers = graph_index_write(&gfile, block_kmers, fout, &num_blocks);
 
   // done
   char num_kmers_str[50], num_blocks_str[50];
@@ -126,8 +126,7 @@ static size_t inferedges_on_file(const dBGraph *db_graph, bool add_all_edges,
   graph_write_header(fout, &file->hdr);
 
   // Read the input file again
-  if(fseek(file->fh, file->hdr_size, SEEK_SET) != 0)
-    die("fseek failed: %s", strerror(errno));
+  graph_file_rewind(file);
 
   const size_t ncols = file->hdr.num_of_cols;
   BinaryKmer bkmer;
@@ -224,6 +223,12 @@ int ctx_infer_edges(int argc, char **argv)
 
   bool editing_file = !(out_ctx_path || reading_stream);
 
+  if(graph_file_is_compressed(&file)) {
+    if(editing_file)
+      die("Cannot edit a compressed graph file in place, use --out: %s", graph_path);
+    file.hdr.version = CTX_GRAPH_FILEFORMAT; // output is not compressed
+  }
+
   FILE *fout = NULL;
 
   // Editing input file or writing a new file
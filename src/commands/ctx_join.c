@@ -10,6 +10,7 @@
 #include "db_node.h"
 #include "graph_format.h"
 #include "graph_file_reader.h"
+#include "graph_file_blocks.h"
 
 // Given (A,B,C) are ctx binaries, A:1 means colour 1 in A,
 // {A:1,B:0} is loading A:1 and B:0 into a single colour
@@ -34,9 +35,16 @@ const char join_usage[] =
 "  -i, --intersect <a.ctx> Only load the kmers that are in graph A.ctx. Can be\n"
 "                          specified multiple times. <a.ctx> is NOT merged into\n"
 "                          the output file.\n"
+"  -z, --compress          Write a block compressed graph (format version 8).\n"
+"                          Input graphs must be sorted and indexed.\n"
 "\n"
 "  Files can be specified with specific colours: samples.ctx:2,3\n"
 "  Offset specifies where to load the first colour: 3:samples.ctx\n"
+"\n"
+"  If all input graphs are sorted and indexed (`"CMD" sort` then `"CMD" index -o\n"
+"  <in.ctx>.idx`), or block compressed, and there are no intersect graphs, they\n"
+"  are merged in a single pass with little memory. The output is then also\n"
+"  sorted.\n"
 "\n";
 
 static struct option longopts[] =
@@ -50,6 +58,7 @@ static struct option longopts[] =
 // command specific
   {"ncols",        required_argument, NULL, 'N'},
   {"intersect",    required_argument, NULL, 'i'},
+  {"compress",     no_argument,       NULL, 'z'},
   {NULL, 0, NULL, 0}
 };
 
@@ -65,6 +74,7 @@ int ctx_join(int argc, char **argv)
   struct MemArgs memargs = MEM_ARGS_INIT;
   const char *out_path = NULL;
   size_t use_ncols = 0;
+  bool compress = false;
 
   GraphFileReader tmp_gfile;
   GraphFileBuffer isec_gfiles_buf;
@@ -93,6 +103,7 @@ int ctx_join(int argc, char **argv)
         file_filter_flatten(&tmp_gfile.fltr, 0);
         gfile_buf_add(&isec_gfiles_buf, tmp_gfile);
         break;
+      case 'z': cmd_check(!compress, cmd); compress = true; break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         // cmd_print_usage(NULL);
@@ -163,7 +174,16 @@ int ctx_join(int argc, char **argv)
   if(take_intersect)
     ctx_max_kmers = min_intersect_num_kmers;
 
-  if(use_ncols < ctx_max_cols && strcmp(out_path,"-") == 0)
+  // Sorted inputs are merged in a single pass without a hash table
+  bool sorted_merge = ((num_gfiles > 1 || compress) && !take_intersect &&
+                       graph_files_are_sorted(gfiles, num_gfiles));
+
+  if(compress && !sorted_merge) {
+    cmd_print_usage("--compress requires sorted, indexed input graphs "
+                    "(`"CMD" sort`, `"CMD" index`) and no --intersect graphs");
+  }
+
+  if(!sorted_merge && use_ncols < ctx_max_cols && strcmp(out_path,"-") == 0)
     die("I need %zu colours if outputting to STDOUT (--ncols)", ctx_max_cols);
 
   // Check out_path is writable
@@ -178,7 +198,7 @@ int ctx_join(int argc, char **argv)
   status("Output %zu cols; from %zu files; intersecting %zu graphs; ",
          ctx_max_cols, num_gfiles, num_igfiles);
 
-  if(num_gfiles == 1 && num_igfiles == 0)
+  if(num_gfiles == 1 && num_igfiles == 0 && !sorted_merge)
   {
     // Loading only one file with no intersection files
     // Don't need to store a graph in memory, can filter as stream
@@ -198,6 +218,26 @@ int ctx_join(int argc, char **argv)
     return EXIT_SUCCESS;
   }
 
+  if(sorted_merge)
+  {
+    status("All input graphs are sorted, merging in a single pass");
+
+    GraphFileHeader gheader;
+    memset(&gheader, 0, sizeof(gheader));
+    gheader.version = CTX_GRAPH_FILEFORMAT;
+    graph_reader_merge_headers(&gheader, gfiles, num_gfiles, NULL);
+    if(compress) gheader.version = CTX_GRAPH_FILEFORMAT_BLOCKS;
+
+    graph_files_merge_sorted(out_path, gfiles, num_gfiles, &gheader);
+
+    graph_header_dealloc(&gheader);
+    for(i = 0; i < num_gfiles; i++) graph_file_close(&gfiles[i]);
+    gfile_buf_dealloc(&isec_gfiles_buf);
+    ctx_free(gfiles);
+
+    return EXIT_SUCCESS;
+  }
+
   //
   // Decide on memory
   //
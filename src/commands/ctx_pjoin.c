@@ -24,6 +24,7 @@ const char pjoin_usage[] =
 "  -g, --graph <in.ctx>   Get number of hash table entries from graph file\n"
 "  -c, --outcols <C>      How many 'colours' should the output file have\n"
 "  -r, --noredundant      Remove redundant paths\n"
+"  -b, --binary           Save in binary format (faster to load)\n"
 "\n"
 "  Files can be specified with specific colours: samples.ctp:2,3\n"
 "  Offset specifies where to load the first colour: 3:samples.ctp\n"
@@ -42,6 +43,7 @@ static struct option longopts[] =
   {"graph",        required_argument, NULL, 'g'},
   {"outcols",      required_argument, NULL, 'c'},
   {"noredundant",  required_argument, NULL, 'r'},
+  {"binary",       no_argument,       NULL, 'b'},
   {NULL, 0, NULL, 0}
 };
 
@@ -49,7 +51,7 @@ int ctx_pjoin(int argc, char **argv)
 {
   size_t nthreads = 0;
   struct MemArgs memargs = MEM_ARGS_INIT;
-  bool noredundant = false;
+  bool noredundant = false, binary = false;
   size_t output_ncols = 0;
   char *graph_file = NULL;
   const char *out_ctp_path = NULL;
@@ -76,6 +78,7 @@ int ctx_pjoin(int argc, char **argv)
       case 'g': cmd_check(!graph_file,cmd); graph_file = optarg; break;
       case 'c': cmd_check(!output_ncols, cmd); output_ncols = cmd_uint32_nonzero(cmd, optarg); break;
       case 'r': cmd_check(!noredundant,cmd); noredundant = true; break;
+      case 'b': cmd_check(!binary,cmd); binary = true; break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         // cmd_print_usage(NULL);
@@ -172,7 +175,8 @@ int ctx_pjoin(int argc, char **argv)
 
   // Paths memory
   size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(pfiles, num_pfiles, output_ncols, rem_mem, true);
+  path_mem = gpath_reader_mem_req(pfiles, num_pfiles, output_ncols, rem_mem,
+                                  true, false);
 
   // Shift path store memory from graphs->paths
   graph_mem -= sizeof(GPath*)*kmers_in_hash;
@@ -184,7 +188,10 @@ int ctx_pjoin(int argc, char **argv)
   cmd_check_mem_limit(memargs.mem_to_use, total_mem);
 
   // Open output file
-  gzFile gzout = futil_gzopen_create(out_ctp_path, "w");
+  gzFile gzout = NULL;
+  FILE *fout = NULL;
+  if(binary) fout = futil_open_create(out_ctp_path, "w");
+  else gzout = futil_gzopen_create(out_ctp_path, "w");
 
   // Set up graph and PathStore
   size_t kmer_size = gpath_reader_get_kmer_size(&pfiles[0]);
@@ -193,7 +200,7 @@ int ctx_pjoin(int argc, char **argv)
 
   // Create a path store that tracks path counts
   gpath_reader_alloc_gpstore(pfiles, num_pfiles,
-                             path_mem, true, &db_graph);
+                             path_mem, true, false, &db_graph);
 
   for(i = 0; i < num_pfiles; i++)
     gpath_reader_load_sample_names(&pfiles[i], &db_graph);
@@ -216,7 +223,7 @@ int ctx_pjoin(int argc, char **argv)
 
   // Load path files
   for(i = 0; i < num_pfiles; i++)
-    gpath_reader_load(&pfiles[i], GPATH_ADD_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&pfiles[i], GPATH_ADD_MISSING_KMERS, nthreads, &db_graph);
 
   status("Got %zu path bytes", (size_t)db_graph.gpstore.path_bytes);
 
@@ -226,16 +233,23 @@ int ctx_pjoin(int argc, char **argv)
   for(i = 0; i < num_pfiles; i++) hdrs[i] = pfiles[i].json;
 
   // Write output file
-  gpath_save(gzout, out_ctp_path, output_threads, false,
-             hdrs, num_pfiles, contig_histgrms, output_ncols,
-             &db_graph);
+  if(binary) {
+    gpath_save_bin(fout, out_ctp_path, output_threads,
+                   hdrs, num_pfiles, contig_histgrms, output_ncols,
+                   &db_graph);
+  } else {
+    gpath_save(gzout, out_ctp_path, output_threads, false,
+               hdrs, num_pfiles, contig_histgrms, output_ncols,
+               &db_graph);
+  }
 
   for(i = 0; i < output_ncols; i++)
     zsize_buf_dealloc(&contig_histgrms[i]);
 
   ctx_free(contig_histgrms);
 
-  gzclose(gzout);
+  if(binary) fclose(fout);
+  else gzclose(gzout);
   ctx_free(hdrs);
 
   // Close ctp files
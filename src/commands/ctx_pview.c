@@ -169,7 +169,8 @@ int ctx_pview(int argc, char **argv)
 
   // Paths memory
   size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem, true);
+  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, ncols, rem_mem,
+                                  true, false);
 
   // Shift path store memory from graphs->paths
   graph_mem -= sizeof(GPath*)*kmers_in_hash;
@@ -192,7 +193,8 @@ int ctx_pview(int argc, char **argv)
                  DBG_ALLOC_EDGES | DBG_ALLOC_NODE_IN_COL);
 
   // Paths
-  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem, true, &db_graph);
+  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem,
+                             true, false, &db_graph);
 
   //
   // Load graphs
@@ -216,7 +218,7 @@ int ctx_pview(int argc, char **argv)
 
   // Load path files
   for(i = 0; i < gpfiles.len; i++)
-    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS, 1, &db_graph);
 
   // Generate merged header
   if(!paths_only) {
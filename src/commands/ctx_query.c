@@ -0,0 +1,161 @@
+#include "global.h"
+#include "commands.h"
+#include "cmd.h"
+#include "util.h"
+#include "file_util.h"
+#include "db_graph.h"
+#include "graph_file_index.h"
+
+const char query_usage[] =
+"usage: "CMD" query [options] <in.ctx> [kmers.txt]\n"
+"\n"
+"  Look up kmers in a sorted cortex graph file without loading it into memory.\n"
+"  Kmers are read one per line from <kmers.txt> or STDIN if not given or '-'.\n"
+"  Sort with `"CMD" sort` and index with `"CMD" index -o <in.ctx>.idx` first.\n"
+"  Output is in the same format as `"CMD" view -k`. Kmers not in the graph are\n"
+"  printed with zero coverage and no edges.\n"
+"\n"
+"  -h, --help             This help message\n"
+"  -q, --quiet            Silence status output normally printed to STDERR\n"
+"  -f, --force            Overwrite output files\n"
+"  -o, --out <out.txt>    Output file [default: STDOUT]\n"
+"  -i, --index <in.idx>   Index file [default: <in.ctx>.idx]\n"
+"  -t, --threads <T>      Number of threads to use [default: "QUOTE_VALUE(DEFAULT_NTHREADS)"]\n"
+"\n";
+
+static struct option longopts[] =
+{
+  {"help",         no_argument,       NULL, 'h'},
+  {"force",        no_argument,       NULL, 'f'},
+  {"out",          required_argument, NULL, 'o'},
+  {"index",        required_argument, NULL, 'i'},
+  {"threads",      required_argument, NULL, 't'},
+  {NULL, 0, NULL, 0}
+};
+
+// Number of kmers to look up at once
+#define QUERY_BATCH_SIZE (1<<20)
+
+// Print results for a batch of kmers in input order
+static void query_print_batch(const GraphFileIndex *gidx,
+                              const BinaryKmer *bkeys,
+                              const GraphFileRecord *recs, const bool *found,
+                              size_t n, FILE *fout)
+{
+  const size_t ncols = gidx->file.hdr.num_of_cols;
+  const size_t kmer_size = gidx->file.hdr.kmer_size;
+  Covg covgs[ncols];
+  Edges edges[ncols];
+  size_t i, col;
+
+  for(i = 0; i < n; i++) {
+    if(found[i]) {
+      for(col = 0; col < ncols; col++)
+        covgs[col] = graph_file_record_covg(&recs[i], col);
+      memcpy(edges, recs[i].edges, ncols * sizeof(Edges));
+    } else {
+      memset(covgs, 0, ncols * sizeof(Covg));
+      memset(edges, 0, ncols * sizeof(Edges));
+    }
+    db_graph_print_kmer2(bkeys[i], covgs, edges, ncols, kmer_size, fout);
+  }
+}
+
+int ctx_query(int argc, char **argv)
+{
+  const char *out_path = NULL, *idx_path = NULL;
+  size_t nthreads = 0;
+
+  // Arg parsing
+  char cmd[100];
+  char shortopts[300];
+  cmd_long_opts_to_short(longopts, shortopts, sizeof(shortopts));
+  int c;
+
+  while((c = getopt_long_only(argc, argv, shortopts, longopts, NULL)) != -1) {
+    cmd_get_longopt_str(longopts, c, cmd, sizeof(cmd));
+    switch(c) {
+      case 0: /* flag set */ break;
+      case 'h': cmd_print_usage(NULL); break;
+      case 'o': cmd_check(!out_path, cmd); out_path = optarg; break;
+      case 'i': cmd_check(!idx_path, cmd); idx_path = optarg; break;
+      case 't': cmd_check(!nthreads, cmd); nthreads = cmd_uint32_nonzero(cmd, optarg); break;
+      case ':': /* BADARG */
+      case '?': /* BADCH getopt_long has already printed error */
+        die("`"CMD" query -h` for help. Bad option: %s", argv[optind-1]);
+      default: abort();
+    }
+  }
+
+  if(nthreads == 0) nthreads = DEFAULT_NTHREADS;
+
+  if(optind >= argc || optind+2 < argc)
+    cmd_print_usage("Require one graph file (.ctx) and optionally a kmer file");
+
+  const char *ctx_path = argv[optind];
+  const char *kmers_path = optind+1 < argc ? argv[optind+1] : "-";
+
+  GraphFileIndex gidx;
+  graph_index_open(&gidx, ctx_path, idx_path);
+
+  const size_t kmer_size = gidx.file.hdr.kmer_size;
+
+  FILE *fin = strcmp(kmers_path, "-") == 0 ? stdin : futil_fopen(kmers_path, "r");
+  FILE *fout = out_path ? futil_open_create(out_path, "w") : stdout;
+
+  BinaryKmer *bkeys = ctx_malloc(QUERY_BATCH_SIZE * sizeof(BinaryKmer));
+  GraphFileRecord *recs = ctx_malloc(QUERY_BATCH_SIZE * sizeof(GraphFileRecord));
+  bool *found = ctx_malloc(QUERY_BATCH_SIZE * sizeof(bool));
+
+  size_t i, n = 0, lineno = 0, num_queries = 0, num_found = 0;
+  StrBuf line;
+  strbuf_alloc(&line, 1024);
+
+  while(1)
+  {
+    bool more = strbuf_reset_readline(&line, fin);
+
+    if(more) {
+      lineno++;
+      strbuf_chomp(&line);
+      if(line.end == 0) continue;
+
+      for(i = 0; i < line.end && char_is_acgt(line.b[i]); i++) {}
+      if(i != line.end || line.end != kmer_size) {
+        die("Bad kmer [line %zu; kmer_size: %zu]: %s",
+            lineno, kmer_size, line.b);
+      }
+
+      bkeys[n++] = binary_kmer_get_key(binary_kmer_from_str(line.b, kmer_size),
+                                       kmer_size);
+    }
+
+    if(n == QUERY_BATCH_SIZE || (!more && n > 0)) {
+      num_found += graph_index_find_batch(&gidx, bkeys, n, recs, found, nthreads);
+      query_print_batch(&gidx, bkeys, recs, found, n, fout);
+      num_queries += n;
+      n = 0;
+    }
+
+    if(!more) break;
+  }
+
+  char num_queries_str[50], num_found_str[50];
+  ulong_to_str(num_queries, num_queries_str);
+  ulong_to_str(num_found, num_found_str);
+  status("Found %s / %s (%.2f%%) kmers in %s", num_found_str, num_queries_str,
+         num_queries ? (100.0 * num_found) / num_queries : 0.0, ctx_path);
+
+  if(fout != stdout) status("Saved to %s", out_path);
+
+  strbuf_dealloc(&line);
+  ctx_free(bkeys);
+  ctx_free(recs);
+  ctx_free(found);
+
+  if(fin != stdin) fclose(fin);
+  fclose(fout);
+  graph_index_close(&gidx);
+
+  return EXIT_SUCCESS;
+}
@@ -326,7 +326,8 @@ int ctx_supernodes(int argc, char **argv)
 
   // Paths memory
   size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, 1, rem_mem, false);
+  path_mem = gpath_reader_mem_req(gpfiles.data, gpfiles.len, 1, rem_mem,
+                                  false, false);
 
   total_mem = graph_mem + path_mem;
 
@@ -352,12 +353,14 @@ int ctx_supernodes(int argc, char **argv)
   uint8_t *visited = ctx_calloc(roundup_bits2bytes(db_graph.ht.capacity), 1);
 
   // Paths
-  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem, true, &db_graph);
+  gpath_reader_alloc_gpstore(gpfiles.data, gpfiles.len, path_mem,
+                             true, false, &db_graph);
 
   GraphLoadingPrefs gprefs = {.db_graph = &db_graph,
                               .boolean_covgs = false,
                               .must_exist_in_graph = false,
-                              .empty_colours = false};
+                              .empty_colours = false,
+                              .nthreads = nthreads};
 
   for(i = 0; i < num_gfiles; i++) {
     file_filter_flatten(&gfiles[i].fltr, 0);
@@ -370,7 +373,8 @@ int ctx_supernodes(int argc, char **argv)
 
   // Load path files
   for(i = 0; i < gpfiles.len; i++) {
-    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&gpfiles.data[i], GPATH_DIE_MISSING_KMERS,
+                      nthreads, &db_graph);
     gpath_reader_close(&gpfiles.data[i]);
   }
   gpfile_buf_dealloc(&gpfiles);
@@ -26,6 +26,7 @@ const char thread_usage[] =
 "  -n, --nkmers <N>         Number of hash table entries (e.g. 1G ~ 1 billion)\n"
 "  -t, --threads <T>        Number of threads to use [default: "QUOTE_VALUE(DEFAULT_NTHREADS)"]\n"
 "  -p, --paths <in.ctp>     Load path file (can specify multiple times)\n"
+"  -b, --binary             Save paths in binary format (faster to load)\n"
 "\n"
 "  Input:\n"
 "  -1, --seq <in.fa>        Thread reads from file (supports sam,bam,fq,*.gz\n"
@@ -68,6 +69,7 @@ static struct option longopts[] =
   {"nkmers",        required_argument, NULL, 'n'},
   {"threads",       required_argument, NULL, 't'},
   {"paths",         required_argument, NULL, 'p'},
+  {"binary",        no_argument,       NULL, 'b'},
 // command specific
   {"seq",           required_argument, NULL, '1'},
   {"seq2",          required_argument, NULL, '2'},
@@ -117,14 +119,20 @@ int ctx_thread(int argc, char **argv)
   //
   size_t bits_per_kmer, kmers_in_hash, graph_mem, total_mem;
   size_t path_hash_mem, path_store_mem, path_mem;
+  size_t mem_to_use = args.memargs.mem_to_use;
   bool sep_path_list = (!args.use_new_paths && gpfiles->len > 0);
 
   bits_per_kmer = sizeof(BinaryKmer)*8 + sizeof(Edges)*8 + sizeof(GPath*)*8 +
                   2 * args.nthreads; // Have traversed
 
+  // Batches of reads passed from input threads to worker threads
+  size_t reads_mem = asyncio_pool_mem(MIN2(inputs->len, MAX_IO_THREADS),
+                                      args.nthreads);
+  reads_mem = cmd_reserve_mem(&mem_to_use, reads_mem, "read buffers");
+
   // false -> don't use mem_to_use to decide how many kmers to store in hash
   // since we need some of that memory for storing paths
-  kmers_in_hash = cmd_get_kmers_in_hash(args.memargs.mem_to_use,
+  kmers_in_hash = cmd_get_kmers_in_hash(mem_to_use,
                                         args.memargs.mem_to_use_set,
                                         args.memargs.num_kmers,
                                         args.memargs.num_kmers_set,
@@ -137,12 +145,13 @@ int ctx_thread(int argc, char **argv)
   size_t min_path_mem = 0;
   gpath_reader_sum_mem(gpfiles->data, gpfiles->len, 1, true, true, &min_path_mem);
 
-  if(graph_mem + min_path_mem > args.memargs.mem_to_use) {
+  if(graph_mem + min_path_mem > mem_to_use) {
     char buf[50];
-    die("Require at least %s memory", bytes_to_str(graph_mem+min_path_mem, 1, buf));
+    die("Require at least %s memory",
+        bytes_to_str(graph_mem+min_path_mem+reads_mem, 1, buf));
   }
 
-  path_mem = args.memargs.mem_to_use - graph_mem;
+  path_mem = mem_to_use - graph_mem;
   size_t pentry_hash_mem = sizeof(GPEntry)/0.7;
   size_t pentry_store_mem = sizeof(GPath) + 8 + // struct + sequence
                             1 + // in colour
@@ -155,13 +164,16 @@ int ctx_thread(int argc, char **argv)
   cmd_print_mem(path_hash_mem, "paths hash");
   cmd_print_mem(path_store_mem, "paths store");
 
-  total_mem = graph_mem + path_mem;
+  total_mem = graph_mem + path_mem + reads_mem;
   cmd_check_mem_limit(args.memargs.mem_to_use, total_mem);
 
   //
   // Open output file
   //
-  gzFile gzout = futil_gzopen_create(args.out_ctp_path, "w");
+  gzFile gzout = NULL;
+  FILE *fout = NULL;
+  if(args.binary_out) fout = futil_open_create(args.out_ctp_path, "w");
+  else gzout = futil_gzopen_create(args.out_ctp_path, "w");
 
   status("Creating paths file: %s", futil_outpath_str(args.out_ctp_path));
 
@@ -216,26 +228,33 @@ int ctx_thread(int argc, char **argv)
                               .boolean_covgs = false,
                               .must_exist_in_graph = false,
                               .must_exist_in_edges = NULL,
-                              .empty_colours = false}; // already loaded paths
+                              .empty_colours = false, // already loaded paths
+                              .nthreads = args.nthreads};
 
   // Load graph, print stats, close file
+  ctx_prof_phase("load_graph");
   graph_load(gfile, gprefs, &gstats);
   hash_table_print_stats_brief(&db_graph.ht);
   graph_file_close(gfile);
 
   // Load existing paths
+  ctx_prof_phase("load_paths");
   for(i = 0; i < gpfiles->len; i++)
-    gpath_reader_load(&gpfiles->data[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load(&gpfiles->data[i], GPATH_DIE_MISSING_KMERS,
+                      args.nthreads, &db_graph);
 
   // Deal with a set of files at once
   // Can have different numbers of inputs vs threads
   size_t start, end;
+  ctx_prof_phase("walk");
   for(start = 0; start < inputs->len; start += MAX_IO_THREADS)
   {
     end = MIN2(inputs->len, start+MAX_IO_THREADS);
     generate_paths(inputs->data+start, end-start, workers, args.nthreads);
   }
 
+  gen_paths_merge_stats(workers, args.nthreads);
+
   // Print memory statistics
   gpath_hash_print_stats(&db_graph.gphash);
   gpath_store_print_stats(&db_graph.gpstore);
@@ -254,13 +273,22 @@ int ctx_thread(int argc, char **argv)
   size_t output_threads = MIN2(args.nthreads, MAX_IO_THREADS);
 
   // Write output file
-  gpath_save(gzout, args.out_ctp_path, output_threads, true,
-             hdrs, gpfiles->len,
-             &aln_stats->contig_histgrm, 1,
-             &db_graph);
-
-  gzclose(gzout);
+  ctx_prof_phase("write");
+  if(args.binary_out) {
+    gpath_save_bin(fout, args.out_ctp_path, output_threads,
+                   hdrs, gpfiles->len,
+                   &aln_stats->contig_histgrm, 1,
+                   &db_graph);
+    fclose(fout);
+  } else {
+    gpath_save(gzout, args.out_ctp_path, output_threads, true,
+               hdrs, gpfiles->len,
+               &aln_stats->contig_histgrm, 1,
+               &db_graph);
+    gzclose(gzout);
+  }
   ctx_free(hdrs);
+  ctx_prof_phase_end();
 
   // Optionally run path checks for debugging
   // gpath_checks_all_paths(&db_graph, args.nthreads);
@@ -103,6 +103,7 @@ void read_thread_args_parse(struct ReadThreadCmdArgs *args,
       case 'g': cmd_check(!args->dump_seq_sizes, cmd); args->dump_seq_sizes = optarg; break;
       case 'G': cmd_check(!args->dump_frag_sizes, cmd); args->dump_frag_sizes = optarg; break;
       case 'u': args->use_new_paths = true; break;
+      case 'b': cmd_check(!args->binary_out, cmd); args->binary_out = true; break;
       case 'x': gen_paths_print_contigs = true; break;
       case 'y': gen_paths_print_paths = true; break;
       case 'z': gen_paths_print_reads = true; break;
@@ -17,6 +17,7 @@ struct ReadThreadCmdArgs
   struct MemArgs memargs;
   char *graph_path, *out_ctp_path;
   bool use_new_paths;
+  bool binary_out; // ctx_thread only
   char *dump_seq_sizes, *dump_frag_sizes;
   size_t colour; // ctx_correct only
   seq_format fmt; // ctx_correct only
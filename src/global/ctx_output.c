@@ -131,3 +131,9 @@ void ctx_update(const char *job_name, size_t niter)
     status("[%s] Read %s entries (reads / read pairs)", job_name, num_str);
   }
 }
+
+void ctx_update_batch(const char *job_name, size_t niter, size_t nbatch)
+{
+  size_t report = niter - niter % CTX_UPDATE_REPORT_RATE;
+  if(report > 0 && report > niter - nbatch) ctx_update(job_name, report);
+}
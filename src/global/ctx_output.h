@@ -45,4 +45,7 @@ void ctx_output_destroy();
 
 void ctx_update(const char *job_name, size_t niter);
 
+// Progress after a batch of `nbatch` iterations brought the total to `niter`
+void ctx_update_batch(const char *job_name, size_t niter, size_t nbatch);
+
 #endif /* CTX_OUTPUT_H_ */
@@ -0,0 +1,157 @@
+#include "global.h"
+#include "ctx_profile.h"
+
+#include <time.h> // clock_gettime()
+#include <sys/resource.h> // getrusage()
+
+static CtxProfPhase prof_phases[CTX_PROF_MAX_PHASES];
+static CtxProfHist prof_hists[CTX_PROF_MAX_HISTS];
+static size_t prof_nphases = 0, prof_nhists = 0;
+
+// Current phase, or NULL if not in a phase
+static CtxProfPhase *prof_curr = NULL;
+static double prof_init_secs = 0, prof_phase_secs = 0, prof_phase_cpu = 0;
+
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+
+double ctx_prof_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double _prof_cpu_secs()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+         ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+size_t ctx_prof_peak_rss()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  #ifdef __APPLE__
+    return (size_t)ru.ru_maxrss; // bytes
+  #else
+    return (size_t)ru.ru_maxrss * 1024; // kilobytes
+  #endif
+}
+
+void ctx_prof_init()
+{
+  prof_init_secs = ctx_prof_now();
+}
+
+void ctx_prof_destroy()
+{
+  size_t i;
+  for(i = 0; i < prof_nphases; i++) ctx_free(prof_phases[i].threads);
+  for(i = 0; i < prof_nhists; i++) ctx_free(prof_hists[i].counts);
+  memset(prof_phases, 0, sizeof(prof_phases));
+  memset(prof_hists, 0, sizeof(prof_hists));
+  prof_nphases = prof_nhists = 0;
+  prof_curr = NULL;
+}
+
+double ctx_prof_total_secs()
+{
+  return ctx_prof_now() - prof_init_secs;
+}
+
+// Add time since the current phase was last updated
+// Must hold prof_lock
+static void _prof_phase_update()
+{
+  if(prof_curr == NULL) return;
+  double now = ctx_prof_now(), cpu = _prof_cpu_secs();
+  prof_curr->wall_secs += now - prof_phase_secs;
+  prof_curr->cpu_secs += cpu - prof_phase_cpu;
+  prof_curr->peak_rss = ctx_prof_peak_rss();
+  prof_phase_secs = now;
+  prof_phase_cpu = cpu;
+}
+
+void ctx_prof_phase(const char *name)
+{
+  size_t i;
+  pthread_mutex_lock(&prof_lock);
+  _prof_phase_update();
+
+  for(i = 0; i < prof_nphases && strcmp(prof_phases[i].name, name) != 0; i++) {}
+
+  if(i == prof_nphases) {
+    if(prof_nphases == CTX_PROF_MAX_PHASES) {
+      pthread_mutex_unlock(&prof_lock);
+      warn("Too many profiling phases, ignoring: %s", name);
+      ctx_prof_phase_end();
+      return;
+    }
+    prof_phases[prof_nphases++] = (CtxProfPhase){.name = name};
+  }
+
+  prof_curr = &prof_phases[i];
+  prof_phase_secs = ctx_prof_now();
+  prof_phase_cpu = _prof_cpu_secs();
+  pthread_mutex_unlock(&prof_lock);
+}
+
+void ctx_prof_phase_end()
+{
+  pthread_mutex_lock(&prof_lock);
+  _prof_phase_update();
+  prof_curr = NULL;
+  pthread_mutex_unlock(&prof_lock);
+}
+
+void ctx_prof_add_thread(size_t threadid, double busy_secs, double idle_secs)
+{
+  pthread_mutex_lock(&prof_lock);
+  CtxProfPhase *phase = prof_curr;
+  if(phase != NULL) {
+    if(threadid >= phase->nthreads) {
+      phase->threads = ctx_recallocarray(phase->threads, phase->nthreads,
+                                         threadid+1, sizeof(CtxProfThread));
+      phase->nthreads = threadid+1;
+    }
+    phase->threads[threadid].busy_secs += busy_secs;
+    phase->threads[threadid].idle_secs += idle_secs;
+  }
+  pthread_mutex_unlock(&prof_lock);
+}
+
+void ctx_prof_set_hist(const char *name, const uint64_t *counts, size_t len)
+{
+  size_t i;
+  pthread_mutex_lock(&prof_lock);
+
+  for(i = 0; i < prof_nhists && strcmp(prof_hists[i].name, name) != 0; i++) {}
+
+  if(i < CTX_PROF_MAX_HISTS) {
+    if(i == prof_nhists) prof_nhists++;
+    CtxProfHist *hist = &prof_hists[i];
+    hist->name = name;
+    hist->counts = ctx_reallocarray(hist->counts, len, sizeof(uint64_t));
+    hist->len = len;
+    memcpy(hist->counts, counts, len * sizeof(uint64_t));
+  }
+
+  pthread_mutex_unlock(&prof_lock);
+}
+
+const CtxProfPhase* ctx_prof_get_phases(size_t *nphases)
+{
+  pthread_mutex_lock(&prof_lock);
+  _prof_phase_update();
+  pthread_mutex_unlock(&prof_lock);
+  *nphases = prof_nphases;
+  return prof_phases;
+}
+
+const CtxProfHist* ctx_prof_get_hists(size_t *nhists)
+{
+  *nhists = prof_nhists;
+  return prof_hists;
+}
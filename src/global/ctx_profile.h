@@ -0,0 +1,76 @@
+#ifndef CTX_PROFILE_H_
+#define CTX_PROFILE_H_
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+//
+// Lightweight profiling of a command
+//
+// A command is split into named phases (e.g. "load_graph", "load_paths",
+// "build", "clean", "walk", "write"). Starting a phase ends the previous one.
+// Phases with the same name are combined. For each phase we record wall and
+// CPU time, the process peak RSS when the phase ended and the busy / idle time
+// of each thread run by util_run_threads() during the phase. Threads run
+// outside of a phase are not recorded.
+//
+// Histograms (e.g. hash table probes) are recorded by name and replace any
+// previous histogram of the same name.
+//
+// Everything is written into JSON headers by json_hdr_add_std() and to the
+// file given by --stats-json.
+//
+
+#define CTX_PROF_MAX_PHASES 32
+#define CTX_PROF_MAX_HISTS 8
+
+typedef struct
+{
+  double busy_secs, idle_secs;
+} CtxProfThread;
+
+typedef struct
+{
+  const char *name; // must be a string literal
+  double wall_secs, cpu_secs; // summed over each time the phase ran
+  size_t peak_rss; // process peak RSS in bytes when phase last ended
+  CtxProfThread *threads;
+  size_t nthreads;
+} CtxProfPhase;
+
+typedef struct
+{
+  const char *name; // must be a string literal
+  uint64_t *counts;
+  size_t len;
+} CtxProfHist;
+
+void ctx_prof_init();
+void ctx_prof_destroy();
+
+// Seconds since an arbitrary point, not affected by changes to the clock
+double ctx_prof_now();
+
+// Process peak RSS in bytes
+size_t ctx_prof_peak_rss();
+
+// Start phase `name`, ending the current phase if there is one
+void ctx_prof_phase(const char *name);
+void ctx_prof_phase_end();
+
+// Add the time thread `threadid` of a multithreaded job was busy and idle
+// (waiting for other threads to finish) to the current phase
+void ctx_prof_add_thread(size_t threadid, double busy_secs, double idle_secs);
+
+// Save a copy of histogram `counts`
+void ctx_prof_set_hist(const char *name, const uint64_t *counts, size_t len);
+
+// Phases and histograms recorded so far. The current phase is included with
+// its times up to now. Not thread safe with respect to starting phases.
+const CtxProfPhase* ctx_prof_get_phases(size_t *nphases);
+const CtxProfHist* ctx_prof_get_hists(size_t *nhists);
+
+// Seconds since ctx_prof_init() was called
+double ctx_prof_total_secs();
+
+#endif /* CTX_PROFILE_H_ */
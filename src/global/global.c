@@ -28,6 +28,7 @@ void cortex_init()
   seed_random();
   // Cannot use die/warn/message/timestamp until we have completed setup
   ctx_output_init();
+  ctx_prof_init();
 }
 
 void cortex_destroy()
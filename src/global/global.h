@@ -32,6 +32,7 @@
 //  MIN_KMER_SIZE    Min kmer-size compiled e.g. 3 for maxk=31, 33 for maxk=63
 //  MAX_KMER_SIZE    Max kmer-size compiled e.g. 31 for maxk=31, 63 for maxk=63
 //  USE_CITY_HASH=1  Use Google's CityHash instead of Bob Jenkin's lookup3
+//  USE_HASH_FPRINT=1 Store a fingerprint byte per hash table entry
 
 #define ONE_MEGABYTE (1<<20)
 #define MAX_IO_THREADS 10
@@ -41,6 +42,7 @@
 #include "ctx_assert.h"
 #include "ctx_alloc.h" // Wrappers for malloc, calloc etc.
 #include "ctx_output.h" // Printing status messages
+#include "ctx_profile.h" // Phase timers, per-thread timing
 
 #include "htslib/version.h"
 #define LIBS_VERSION "zlib="ZLIB_VERSION" htslib="HTS_VERSION
@@ -467,11 +467,13 @@ typedef struct {
   pthread_t thread;
   ThreadedJobs *jobs;
   size_t curr_job;
+  double busy_secs; // time spent running jobs
 } ThreadedWorker;
 
 static void threaded_worker_sub(ThreadedWorker *worker)
 {
   ThreadedJobs *jobs = worker->jobs;
+  double start = ctx_prof_now();
   jobs->func((void*)((char*)jobs->args + worker->curr_job*jobs->elsize));
 
   // try to get more work
@@ -481,6 +483,8 @@ static void threaded_worker_sub(ThreadedWorker *worker)
     if(worker->curr_job >= jobs->nel) break;
     jobs->func((void*)((char*)jobs->args + worker->curr_job*jobs->elsize));
   }
+
+  worker->busy_secs = ctx_prof_now() - start;
 }
 
 static void *threaded_worker(void *arg) __attribute__((noreturn));
@@ -503,8 +507,11 @@ void util_run_threads(void *args, size_t nel, size_t elsize,
   // Don't use more threads than elements
   nthreads = MIN2(nel, nthreads);
 
+  double start = ctx_prof_now(), wall;
+
   if(nthreads == 1) {
     for(i = 0; i < nel; i++) func((void*)((char*)args + i*elsize));
+    ctx_prof_add_thread(0, ctx_prof_now() - start, 0);
   }
   else
   {
@@ -536,7 +543,116 @@ void util_run_threads(void *args, size_t nel, size_t elsize,
       if(rc != 0) die("Joining thread failed");
     }
 
+    // Threads are idle once they run out of jobs
+    wall = ctx_prof_now() - start;
+    for(i = 0; i < nthreads; i++) {
+      ctx_prof_add_thread(i, workers[i].busy_secs,
+                          MAX2(wall - workers[i].busy_secs, 0));
+    }
+
     pthread_attr_destroy(&thread_attr);
     ctx_free(workers);
   }
 }
+
+//
+// Work-stealing task scheduler
+//
+
+void task_sched_alloc(TaskScheduler *ts, size_t nitems, size_t nthreads)
+{
+  size_t i;
+  ctx_assert(nthreads > 0);
+  ts->nitems = nitems;
+  ts->nthreads = nthreads;
+  ts->chunk_size = MAX2(nitems / (nthreads * TASK_SCHED_CHUNKS_PER_THREAD),
+                        TASK_SCHED_MIN_CHUNK);
+  ts->ranges = ctx_calloc(nthreads, sizeof(TaskRange));
+
+  for(i = 0; i < nthreads; i++)
+    if(pthread_mutex_init(&ts->ranges[i].lock, NULL) != 0)
+      die("Mutex init failed");
+
+  task_sched_reset(ts);
+}
+
+void task_sched_dealloc(TaskScheduler *ts)
+{
+  size_t i;
+  for(i = 0; i < ts->nthreads; i++)
+    pthread_mutex_destroy(&ts->ranges[i].lock);
+  ctx_free(ts->ranges);
+  memset(ts, 0, sizeof(TaskScheduler));
+}
+
+void task_sched_reset(TaskScheduler *ts)
+{
+  size_t i;
+  for(i = 0; i < ts->nthreads; i++) {
+    ts->ranges[i].start = (ts->nitems * i) / ts->nthreads;
+    ts->ranges[i].end = (ts->nitems * (i+1)) / ts->nthreads;
+  }
+}
+
+// Take up to chunk_size items from the front of range
+static inline bool task_range_take(TaskRange *rng, size_t chunk_size,
+                                   size_t *start, size_t *end)
+{
+  bool success = false;
+  pthread_mutex_lock(&rng->lock);
+  if(rng->start < rng->end) {
+    *start = rng->start;
+    *end = rng->start = MIN2(rng->start + chunk_size, rng->end);
+    success = true;
+  }
+  pthread_mutex_unlock(&rng->lock);
+  return success;
+}
+
+bool task_sched_next(TaskScheduler *ts, size_t threadid,
+                     size_t *start, size_t *end)
+{
+  ctx_assert(threadid < ts->nthreads);
+  TaskRange *rng = &ts->ranges[threadid], *victim;
+  size_t i, s, e, rem, max_rem, steal_start = 0, steal_end = 0;
+
+  while(1)
+  {
+    if(task_range_take(rng, ts->chunk_size, start, end)) return true;
+
+    // Find thread with the most work remaining. Reading without the lock is
+    // safe since start only increases and end is never reduced below start.
+    victim = NULL;
+    max_rem = 0;
+    for(i = 0; i < ts->nthreads; i++) {
+      s = ts->ranges[i].start;
+      e = ts->ranges[i].end;
+      rem = e > s ? e - s : 0;
+      if(rem > max_rem) { max_rem = rem; victim = &ts->ranges[i]; }
+    }
+
+    if(victim == NULL) return false; // all work taken
+
+    // Steal back half of victim's range (or all of it, if it is small)
+    pthread_mutex_lock(&victim->lock);
+    s = victim->start;
+    e = victim->end;
+    if(s < e) {
+      steal_start = e - s > ts->chunk_size ? s + (e - s) / 2 : s;
+      steal_end = e;
+      victim->end = steal_start;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    // Victim may have finished its work before we got the lock, if so retry
+    if(s < e) {
+      *start = steal_start;
+      *end = MIN2(steal_start + ts->chunk_size, steal_end);
+      pthread_mutex_lock(&rng->lock);
+      rng->start = *end;
+      rng->end = steal_end;
+      pthread_mutex_unlock(&rng->lock);
+      return true;
+    }
+  }
+}
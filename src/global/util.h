@@ -151,6 +151,43 @@ size_t seconds_to_str(unsigned long seconds, char *str);
 void util_run_threads(void *args, size_t nel, size_t elsize,
                       size_t nthreads, void (*func)(void*));
 
+//
+// Work-stealing task scheduler
+//
+// Splits the items [0,nitems) between `nthreads` threads. Each thread owns a
+// contiguous range and takes small chunks from the front of it. A thread that
+// runs out of work steals the back half of the largest remaining range, so
+// threads that draw expensive items (e.g. repeats in graph traversal) do not
+// leave the others idle.
+//
+
+// Chunk size is nitems / (nthreads * TASK_SCHED_CHUNKS_PER_THREAD), but no
+// smaller than TASK_SCHED_MIN_CHUNK
+#define TASK_SCHED_CHUNKS_PER_THREAD 64
+#define TASK_SCHED_MIN_CHUNK 1024
+
+typedef struct {
+  volatile size_t start, end;
+  pthread_mutex_t lock;
+} TaskRange;
+
+typedef struct {
+  size_t nitems, nthreads, chunk_size;
+  TaskRange *ranges;
+} TaskScheduler;
+
+void task_sched_alloc(TaskScheduler *ts, size_t nitems, size_t nthreads);
+void task_sched_dealloc(TaskScheduler *ts);
+
+// Give each thread its initial range again so items can be iterated over again
+// Not threadsafe
+void task_sched_reset(TaskScheduler *ts);
+
+// Get next chunk of items [*start,*end) for thread `threadid`
+// Returns false once all items have been taken
+bool task_sched_next(TaskScheduler *ts, size_t threadid,
+                     size_t *start, size_t *end);
+
 //
 // Safe Counting (thread-safe + no overflow)
 //
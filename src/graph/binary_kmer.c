@@ -120,6 +120,38 @@ BinaryKmer binary_kmer_left_shift_one_base(const BinaryKmer bkmer,
 
 #endif /* NUM_BKMER_WORDS > 1 */
 
+// Number of bases converted to Nucleotides at a time by kmer iterators
+#define BKMER_ITER_NUCS 64
+
+void binary_kmer_iter_add_str(BinaryKmerIter *it, const char *str, size_t len)
+{
+  Nucleotide nucs[BKMER_ITER_NUCS];
+  size_t i, j, n;
+
+  for(i = 0; i < len; i += n) {
+    n = MIN2(len - i, BKMER_ITER_NUCS);
+    dna_str_to_nucs(str+i, n, nucs);
+    for(j = 0; j < n; j++) binary_kmer_iter_add(it, nucs[j]);
+  }
+}
+
+void binary_kmer_iter_keys(BinaryKmerIter *it, const char *str, size_t n,
+                           BinaryKmer *bkeys, Orientation *orients)
+{
+  Nucleotide nucs[BKMER_ITER_NUCS];
+  size_t i, j, m;
+
+  for(i = 0; i < n; i += m) {
+    m = MIN2(n - i, BKMER_ITER_NUCS);
+    dna_str_to_nucs(str+i, m, nucs);
+    for(j = 0; j < m; j++) {
+      binary_kmer_iter_add(it, nucs[j]);
+      bkeys[i+j] = binary_kmer_iter_key(it);
+      orients[i+j] = binary_kmer_iter_orient(it);
+    }
+  }
+}
+
 // For profiling see dev/bkmer_revcmp/
 BinaryKmer binary_kmer_reverse_complement(const BinaryKmer bkmer,
                                           size_t kmer_size)
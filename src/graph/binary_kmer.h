@@ -137,6 +137,46 @@ BinaryKmer binary_kmer_right_shift_add(const BinaryKmer bkmer, size_t kmer_size,
 // Reverse complement a binary kmer from kmer into revcmp_kmer
 BinaryKmer binary_kmer_reverse_complement(const BinaryKmer bkmer, size_t kmer_size);
 
+//
+// Rolling kmer iterator
+// Keeps a kmer and its reverse complement as bases are added, one shift each,
+// so kmer keys are found without binary_kmer_reverse_complement()
+//
+
+typedef struct
+{
+  BinaryKmer fw, rv; // kmer and its reverse complement
+  size_t kmer_size;
+} BinaryKmerIter;
+
+// Add the first kmer_size-1 bases after init, then each base gives a kmer
+static inline void binary_kmer_iter_init(BinaryKmerIter *it, size_t kmer_size)
+{
+  it->fw = zero_bkmer;
+  it->rv = binary_kmer_reverse_complement(zero_bkmer, kmer_size);
+  it->kmer_size = kmer_size;
+}
+
+static inline void binary_kmer_iter_add(BinaryKmerIter *it, Nucleotide nuc)
+{
+  it->fw = binary_kmer_left_shift_add(it->fw, it->kmer_size, nuc);
+  it->rv = binary_kmer_right_shift_add(it->rv, it->kmer_size,
+                                       dna_nuc_complement(nuc));
+}
+
+// Key (see binary_kmer_get_key()) and orientation of the current kmer
+#define binary_kmer_iter_is_rev(it) binary_kmer_less_than((it)->rv, (it)->fw)
+#define binary_kmer_iter_key(it) (binary_kmer_iter_is_rev(it) ? (it)->rv : (it)->fw)
+#define binary_kmer_iter_orient(it) (binary_kmer_iter_is_rev(it) ? REVERSE : FORWARD)
+
+// Add bases from a string of [ACGTacgt]
+void binary_kmer_iter_add_str(BinaryKmerIter *it, const char *str, size_t len);
+
+// Add `n` bases from a string of [ACGTacgt], store the key and orientation of
+// the kmer ending at each base
+void binary_kmer_iter_keys(BinaryKmerIter *it, const char *str, size_t n,
+                           BinaryKmer *bkeys, Orientation *orients);
+
 // Get a random binary kmer -- useful for testing
 BinaryKmer binary_kmer_random(size_t kmer_size);
 
@@ -32,6 +32,24 @@ void cmd_print_mem(size_t mem_bytes, const char *name)
   status("[memory] %s: %s", name, mem_str);
 }
 
+// Take `mem_bytes` for buffers other than the graph out of `*mem_to_use`.
+// If that would leave less than half of `*mem_to_use`, print a warning and
+// take nothing. Returns bytes taken.
+size_t cmd_reserve_mem(size_t *mem_to_use, size_t mem_bytes, const char *name)
+{
+  cmd_print_mem(mem_bytes, name);
+
+  if(mem_bytes > *mem_to_use / 2) {
+    char mem_str[100];
+    bytes_to_str(mem_bytes, 1, mem_str);
+    warn("Memory limit too low to include %s (%s), increase -m", name, mem_str);
+    return 0;
+  }
+
+  *mem_to_use -= mem_bytes;
+  return mem_bytes;
+}
+
 // If your command accepts -n <kmers> and -m <mem> this may be useful
 //  `entry_bits` is memory per node, including hash table BinaryKmer
 //  `use_mem_limit` if true, fill args->mem_to_use
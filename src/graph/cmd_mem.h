@@ -35,4 +35,8 @@ void cmd_check_mem_limit(size_t mem_to_use, size_t mem_requested);
 // Print memory being used
 void cmd_print_mem(size_t mem_bytes, const char *name);
 
+// Take memory for buffers other than the graph out of `*mem_to_use`, unless
+// that would leave less than half of it. Returns bytes taken.
+size_t cmd_reserve_mem(size_t *mem_to_use, size_t mem_bytes, const char *name);
+
 #endif /* CMD_MEM_H_ */
@@ -0,0 +1,47 @@
+#include "global.h"
+#include "covg_edge_buf.h"
+#include "util.h"
+
+void covg_edge_buf_alloc(CovgEdgeBuffer *buf, size_t size, dBGraph *db_graph)
+{
+  size_t i;
+  size = roundup2pow(MAX2(size, 1));
+  buf->entries = ctx_malloc(size * sizeof(CovgEdgeBufEntry));
+  buf->mask = size - 1;
+  buf->db_graph = db_graph;
+  for(i = 0; i < size; i++) buf->entries[i].key = HASH_NOT_FOUND;
+}
+
+void covg_edge_buf_dealloc(CovgEdgeBuffer *buf)
+{
+  ctx_free(buf->entries);
+  memset(buf, 0, sizeof(CovgEdgeBuffer));
+}
+
+void covg_edge_buf_entry_flush(CovgEdgeBuffer *buf, CovgEdgeBufEntry *entry)
+{
+  dBGraph *db_graph = buf->db_graph;
+  hkey_t hkey = entry->key;
+  Colour col = entry->col;
+  Colour edge_col = db_graph->num_edge_cols == 1 ? 0 : col;
+
+  if(entry->covg > 0) {
+    if(db_graph->node_in_cols != NULL)
+      db_node_set_col_mt(db_graph, hkey, col);
+    if(db_graph->col_covgs != NULL)
+      db_node_add_col_covg_mt(db_graph, hkey, col, entry->covg);
+  }
+
+  if(entry->edges && db_graph->col_edges != NULL)
+    __sync_or_and_fetch(&db_node_edges(db_graph, hkey, edge_col), entry->edges);
+
+  entry->key = HASH_NOT_FOUND;
+}
+
+void covg_edge_buf_flush(CovgEdgeBuffer *buf)
+{
+  size_t i;
+  for(i = 0; i <= buf->mask; i++)
+    if(buf->entries[i].key != HASH_NOT_FOUND)
+      covg_edge_buf_entry_flush(buf, &buf->entries[i]);
+}
@@ -0,0 +1,90 @@
+#ifndef COVG_EDGE_BUF_H_
+#define COVG_EDGE_BUF_H_
+
+//
+// Thread-local combining buffer for coverage and edge updates
+//
+// During graph construction every kmer of every read increments a coverage
+// and sets two edges with atomic operations on the shared graph. Repeated
+// kmers cause the same cache lines to bounce between threads. Each worker
+// instead accumulates updates in a small direct-mapped buffer keyed by
+// (hkey, colour) and only writes to the graph when an entry is evicted or the
+// buffer is flushed. Coverage addition saturates at COVG_MAX as before.
+//
+
+#include "cortex_types.h"
+#include "db_graph.h"
+#include "db_node.h"
+
+// Number of entries per buffer, must be a power of two
+#define COVG_EDGE_BUF_SIZE 4096
+
+typedef struct
+{
+  hkey_t key; // HASH_NOT_FOUND if entry is empty
+  uint32_t col;
+  Covg covg;
+  Edges edges;
+} CovgEdgeBufEntry;
+
+typedef struct
+{
+  CovgEdgeBufEntry *entries;
+  size_t mask;
+  dBGraph *db_graph;
+} CovgEdgeBuffer;
+
+// @size is rounded up to a power of two
+void covg_edge_buf_alloc(CovgEdgeBuffer *buf, size_t size, dBGraph *db_graph);
+void covg_edge_buf_dealloc(CovgEdgeBuffer *buf);
+
+// Write all buffered updates to the graph and empty the buffer
+// Threadsafe with respect to other buffers on the same graph
+void covg_edge_buf_flush(CovgEdgeBuffer *buf);
+
+// Write one entry to the graph. Called on eviction.
+void covg_edge_buf_entry_flush(CovgEdgeBuffer *buf, CovgEdgeBufEntry *entry);
+
+static inline CovgEdgeBufEntry* covg_edge_buf_get(CovgEdgeBuffer *buf,
+                                                  hkey_t hkey, Colour col)
+{
+  size_t idx = (hkey * buf->db_graph->num_of_cols + col) & buf->mask;
+  CovgEdgeBufEntry *entry = &buf->entries[idx];
+
+  if(entry->key != hkey || entry->col != col) {
+    if(entry->key != HASH_NOT_FOUND) covg_edge_buf_entry_flush(buf, entry);
+    *entry = (CovgEdgeBufEntry){.key = hkey, .col = col, .covg = 0, .edges = 0};
+  }
+
+  return entry;
+}
+
+// Buffered equivalent of db_graph_update_node_mt()
+static inline void covg_edge_buf_update_node(CovgEdgeBuffer *buf,
+                                             dBNode node, Colour col)
+{
+  CovgEdgeBufEntry *entry = covg_edge_buf_get(buf, node.key, col);
+  entry->covg = SAFE_ADD_COVG(entry->covg, 1);
+}
+
+// Buffered equivalent of db_graph_add_edge_mt(). Edges are written to colour
+// `col`, or colour 0 if the graph only has one edge colour.
+static inline void covg_edge_buf_add_edge(CovgEdgeBuffer *buf, Colour col,
+                                          dBNode src, dBNode tgt)
+{
+  const dBGraph *db_graph = buf->db_graph;
+  if(db_graph->col_edges == NULL) return;
+
+  Nucleotide lhs_nuc, rhs_nuc;
+  lhs_nuc = db_node_get_first_nuc(src, db_graph);
+  rhs_nuc = db_node_get_last_nuc(tgt, db_graph);
+
+  CovgEdgeBufEntry *entry;
+  entry = covg_edge_buf_get(buf, src.key, col);
+  entry->edges = edges_set_edge(entry->edges, rhs_nuc, src.orient);
+  entry = covg_edge_buf_get(buf, tgt.key, col);
+  entry->edges = edges_set_edge(entry->edges, dna_nuc_complement(lhs_nuc),
+                                !tgt.orient);
+}
+
+#endif /* COVG_EDGE_BUF_H_ */
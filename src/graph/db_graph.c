@@ -35,7 +35,9 @@ void db_graph_alloc(dBGraph *db_graph, size_t kmer_size,
                  .col_edges = NULL,
                  .col_covgs = NULL,
                  .node_in_cols = NULL,
-                 .readstrt = NULL};
+                 .readstrt = NULL,
+                 .bloom = NULL,
+                 .max_capacity = 0};
 
   ctx_assert(num_of_cols > 0);
   ctx_assert(num_edge_cols == 0 || num_edge_cols == 1 || num_edge_cols == num_of_cols);
@@ -72,6 +74,34 @@ void db_graph_alloc(dBGraph *db_graph, size_t kmer_size,
   db_graph_status(db_graph);
 }
 
+void db_graph_grow_for(dBGraph *db_graph, uint64_t nkmers, size_t nthreads)
+{
+  if(!db_graph_needs_grow(db_graph, nkmers)) return;
+
+  uint64_t old_capacity = db_graph->ht.capacity, capacity = old_capacity;
+  uint64_t max_capacity = db_graph->max_capacity, limit, nbkts;
+  nkmers += db_graph->ht.num_kmers;
+
+  // The old and new tables are held at once, and memory is only budgeted for
+  // the largest table plus half of it. Round down to whole buckets so that
+  // hash_table_alloc() cannot round the new table back up past the limit.
+  limit = MIN2(max_capacity, max_capacity + max_capacity/2 - old_capacity);
+  hash_table_cap(limit, &nbkts, NULL);
+  limit = (limit / nbkts) * nbkts;
+
+  // No room to grow, keep this table
+  if(limit <= old_capacity) { db_graph->max_capacity = old_capacity; return; }
+
+  do { capacity *= 2; }
+  while(db_graph_grow_limit(capacity) < nkmers && capacity < limit);
+
+  capacity = MIN2(capacity, limit);
+  db_graph_grow(db_graph, capacity, nthreads);
+
+  ctx_assert2(old_capacity + db_graph->ht.capacity <= max_capacity + max_capacity/2,
+              "%zu + %zu", (size_t)old_capacity, (size_t)db_graph->ht.capacity);
+}
+
 // Free memory used by all fields as well
 void db_graph_dealloc(dBGraph *db_graph)
 {
@@ -144,6 +174,36 @@ dBNode db_graph_find(const dBGraph *db_graph, BinaryKmer bkmer)
   return node;
 }
 
+void db_graph_find_batch(const dBGraph *db_graph, const BinaryKmer *bkeys,
+                         const Orientation *orients, size_t n, dBNode *nodes)
+{
+  hkey_t hkeys[DB_GRAPH_BATCH];
+  size_t i, j, m;
+
+  for(i = 0; i < n; i += m) {
+    m = MIN2(n - i, DB_GRAPH_BATCH);
+    hash_table_find_batch(&db_graph->ht, bkeys+i, m, hkeys);
+    for(j = 0; j < m; j++)
+      nodes[i+j] = (dBNode){.key = hkeys[j], .orient = orients[i+j]};
+  }
+}
+
+void db_graph_find_or_add_nodes_mt(dBGraph *db_graph, const BinaryKmer *bkeys,
+                                   const Orientation *orients, size_t n,
+                                   dBNode *nodes, bool *found)
+{
+  hkey_t hkeys[DB_GRAPH_BATCH];
+  size_t i, j, m;
+
+  for(i = 0; i < n; i += m) {
+    m = MIN2(n - i, DB_GRAPH_BATCH);
+    hash_table_find_or_insert_batch_mt(&db_graph->ht, bkeys+i, m, hkeys,
+                                       found+i, db_graph->bktlocks);
+    for(j = 0; j < m; j++)
+      nodes[i+j] = (dBNode){.key = hkeys[j], .orient = orients[i+j]};
+  }
+}
+
 // Thread safe
 // In the case of self-loops in palindromes the two edges collapse into one
 void db_graph_add_edge_mt(dBGraph *db_graph, Colour col, dBNode src, dBNode tgt)
@@ -455,6 +515,124 @@ void db_graph_reset(dBGraph *db_graph)
   gpath_store_reset(&db_graph->gpstore);
 }
 
+//
+// Growing the hash table
+//
+
+typedef struct {
+  size_t threadid;
+  TaskScheduler *sched;
+  const dBGraph *src;
+  dBGraph *dst;
+} GraphGrower;
+
+// Insert a node into the new graph and copy its data
+static inline int _db_graph_move_node(hkey_t hkey, const dBGraph *src,
+                                      dBGraph *dst)
+{
+  const size_t ncols = src->num_of_cols, nedgecols = src->num_edge_cols;
+  hkey_t newkey = hash_table_insert_mt(&dst->ht, src->ht.table[hkey],
+                                       dst->bktlocks);
+  size_t col, i;
+
+  if(src->col_edges != NULL) {
+    memcpy(&dst->col_edges[newkey*nedgecols], &src->col_edges[hkey*nedgecols],
+           nedgecols * sizeof(Edges));
+  }
+
+  if(src->col_covgs != NULL) {
+    memcpy(&dst->col_covgs[newkey*ncols], &src->col_covgs[hkey*ncols],
+           ncols * sizeof(Covg));
+  }
+
+  // Bit arrays share bytes between nodes so need atomic writes
+  if(src->node_in_cols != NULL) {
+    for(col = 0; col < ncols; col++)
+      if(db_node_has_col(src, hkey, col))
+        db_node_set_col_mt(dst, newkey, col);
+  }
+
+  if(src->readstrt != NULL) {
+    for(i = 0; i < 2; i++)
+      if(bitset_get(src->readstrt, 2*hkey+i))
+        (void)bitset_set_mt((volatile uint8_t*)dst->readstrt, 2*newkey+i);
+  }
+
+  return 0; // => keep iterating
+}
+
+static void db_graph_grow_thread(void *arg)
+{
+  GraphGrower gr = *(GraphGrower*)arg;
+  HASH_ITERATE_SCHED(&gr.src->ht, gr.sched, gr.threadid,
+                     _db_graph_move_node, gr.src, gr.dst);
+}
+
+// Peak memory is the old and new graph together
+void db_graph_grow(dBGraph *db_graph, uint64_t capacity, size_t nthreads)
+{
+  ctx_assert(db_graph->gpstore.paths_all == NULL);
+  ctx_assert(db_graph->gphash.table == NULL);
+
+  size_t i, ncols = db_graph->num_of_cols, nedgecols = db_graph->num_edge_cols;
+  dBGraph tmp;
+  memcpy(&tmp, db_graph, sizeof(dBGraph));
+
+  char old_cap_str[100];
+  ulong_to_str(db_graph->ht.capacity, old_cap_str);
+  status("[graph] Growing hash table from %s entries...", old_cap_str);
+
+  hash_table_alloc(&tmp.ht, capacity);
+  capacity = tmp.ht.capacity;
+  ctx_assert2(!db_graph->max_capacity || capacity <= db_graph->max_capacity,
+              "%zu > %zu", (size_t)capacity, (size_t)db_graph->max_capacity);
+
+  // Bucket locks are always needed to insert with multiple threads
+  tmp.bktlocks = ctx_calloc(roundup_bits2bytes(tmp.ht.num_of_buckets), 1);
+
+  if(db_graph->col_edges != NULL)
+    tmp.col_edges = ctx_calloc(capacity * nedgecols, sizeof(Edges));
+  if(db_graph->col_covgs != NULL)
+    tmp.col_covgs = ctx_calloc(capacity * ncols, sizeof(Covg));
+  if(db_graph->node_in_cols != NULL)
+    tmp.node_in_cols = ctx_calloc(roundup_bits2bytes(capacity)*ncols, 1);
+  if(db_graph->readstrt != NULL)
+    tmp.readstrt = ctx_calloc(roundup_bits2bytes(capacity)*2, 1);
+
+  GraphGrower *wrkrs = ctx_calloc(nthreads, sizeof(GraphGrower));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, nthreads);
+
+  for(i = 0; i < nthreads; i++) {
+    wrkrs[i] = (GraphGrower){.threadid = i, .sched = &sched,
+                             .src = db_graph, .dst = &tmp};
+  }
+
+  util_run_threads(wrkrs, nthreads, sizeof(GraphGrower),
+                   nthreads, db_graph_grow_thread);
+
+  task_sched_dealloc(&sched);
+  ctx_free(wrkrs);
+
+  ctx_assert2(tmp.ht.num_kmers == db_graph->ht.num_kmers, "%zu vs %zu",
+              (size_t)tmp.ht.num_kmers, (size_t)db_graph->ht.num_kmers);
+
+  hash_table_dealloc(&db_graph->ht);
+  ctx_free(db_graph->col_edges);
+  ctx_free(db_graph->col_covgs);
+  ctx_free(db_graph->node_in_cols);
+  ctx_free(db_graph->readstrt);
+
+  if(db_graph->bktlocks == NULL) {
+    ctx_free(tmp.bktlocks);
+    tmp.bktlocks = NULL;
+  }
+  else ctx_free(db_graph->bktlocks);
+
+  memcpy(db_graph, &tmp, sizeof(dBGraph));
+  db_graph_status(db_graph);
+}
+
 // BEWARE: if num_edge_cols == 1, edges in all colours will be effectively wiped
 void db_graph_wipe_colour(dBGraph *db_graph, Colour col)
 {
@@ -10,6 +10,7 @@
 #include "graph_info.h"
 #include "gpath_store.h"
 #include "gpath_hash.h"
+#include "kmer_bloom.h"
 
 extern const int DBG_ALLOC_EDGES;
 extern const int DBG_ALLOC_COVGS;
@@ -53,6 +54,13 @@ typedef struct
 
   // Loading reads, 2 bits per kmers
   uint8_t *readstrt;
+
+  // Loading reads, if set kmers are only added on their second sighting in
+  // each colour. Not owned by the graph.
+  KmerBloom *bloom;
+
+  // build_graph() may grow the hash table up to this capacity (0 => fixed)
+  uint64_t max_capacity;
 } dBGraph;
 
 #define db_graph_has_path_hash(graph) ((graph)->gphash.table != NULL)
@@ -68,6 +76,27 @@ void db_graph_dealloc(dBGraph *db_graph);
 
 void db_graph_reset(dBGraph *db_graph);
 
+// Move all kmers into a new hash table with at least `capacity` entries,
+// using `nthreads` threads. Coverages, edges and flag bits move with them.
+// Not threadsafe. Paths must not have been loaded, since they use hkeys.
+void db_graph_grow(dBGraph *db_graph, uint64_t capacity, size_t nthreads);
+
+// Tables are grown before they are fuller than this
+#define db_graph_grow_limit(capacity) ((uint64_t)((capacity) * IDEAL_OCCUPANCY))
+
+// Whether the hash table should grow before adding up to `nkmers` new kmers
+static inline bool db_graph_needs_grow(const dBGraph *db_graph, uint64_t nkmers)
+{
+  return db_graph->ht.capacity < db_graph->max_capacity &&
+         db_graph->ht.num_kmers + nkmers > db_graph_grow_limit(db_graph->ht.capacity);
+}
+
+// Double the hash table until there is room for `nkmers` more kmers, or it
+// reaches db_graph->max_capacity. The old and new tables together are no
+// larger than 1.5 * db_graph->max_capacity; if the table cannot grow within
+// that, max_capacity is lowered to its current size. Not threadsafe.
+void db_graph_grow_for(dBGraph *db_graph, uint64_t nkmers, size_t nthreads);
+
 //
 // Add to the de bruijn graph
 //
@@ -89,6 +118,20 @@ dBNode db_graph_find_or_add_node_mt(dBGraph *db_graph, BinaryKmer bkmer,
 dBNode db_graph_find(const dBGraph *db_graph, BinaryKmer bkmer);
 dBNode db_graph_find_str(const dBGraph *db_graph, const char *str);
 
+// Number of kmers to look up at once in batch functions
+#define DB_GRAPH_BATCH 128
+
+// Find/add `n` kmer keys at once, prefetching to hide memory latency
+// nodes[i] is set to {hkey of bkeys[i], orients[i]}
+// Keys and orientations are from a BinaryKmerIter, see binary_kmer.h
+void db_graph_find_batch(const dBGraph *db_graph, const BinaryKmer *bkeys,
+                         const Orientation *orients, size_t n, dBNode *nodes);
+
+// Thread safe
+void db_graph_find_or_add_nodes_mt(dBGraph *db_graph, const BinaryKmer *bkeys,
+                                   const Orientation *orients, size_t n,
+                                   dBNode *nodes, bool *found);
+
 // In the case of self-loops in palindromes the two edges collapse into one
 void db_graph_add_edge(dBGraph *db_graph, Colour colour,
                        hkey_t src_node, hkey_t tgt_node,
@@ -86,8 +86,10 @@ Edges edges_get_union(const Edges *edges_arr, size_t num)
     edges |= tmp;
   }
 
-  memcpy(&tmp, edges_arr+i, sizeof(uint64_t));
-  edges |= tmp & (~(uint64_t)0 >> (64-(8*(num % 8))));
+  // Only read the remaining bytes, the array may end here
+  tmp = 0;
+  memcpy(&tmp, edges_arr+i, num - end);
+  edges |= tmp;
 
   // with unaligned memory access
   // const uint64_t *ptr = (const uint64_t*)((size_t)edges_arr);
@@ -144,6 +146,15 @@ void db_node_increment_coverage_mt(dBGraph *graph, hkey_t hkey, Colour col)
         !__sync_bool_compare_and_swap(&db_node_covg(graph,hkey,col), v, v+1));
 }
 
+// Thread safe, overflow safe, coverage addition
+void db_node_add_col_covg_mt(dBGraph *graph, hkey_t hkey, Colour col, Covg update)
+{
+  Covg v;
+  while((v = db_node_covg(graph,hkey,col)) < COVG_MAX &&
+        !__sync_bool_compare_and_swap(&db_node_covg(graph,hkey,col), v,
+                                      SAFE_ADD_COVG(v, update)));
+}
+
 Covg db_node_sum_covg(const dBGraph *graph, hkey_t hkey)
 {
   const Covg *covgs = &db_node_covg(graph,hkey,0);
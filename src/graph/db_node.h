@@ -246,6 +246,9 @@ void db_node_increment_coverage(dBGraph *graph, hkey_t hkey, Colour col);
 // Thread safe, overflow safe, coverage increment
 void db_node_increment_coverage_mt(dBGraph *graph, hkey_t hkey, Colour col);
 
+// Thread safe, overflow safe, coverage addition
+void db_node_add_col_covg_mt(dBGraph *graph, hkey_t hkey, Colour col, Covg update);
+
 Covg db_node_sum_covg(const dBGraph *graph, hkey_t hkey);
 
 //
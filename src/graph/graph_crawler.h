@@ -89,10 +89,6 @@ uint32_t graph_crawler_load_path_limit(GraphCache *cache, dBNode node,
                                        GraphWalker *wlk, RepeatWalker *rptwlk,
                                        size_t kmer_length_limit);
 
-// Remove traversal marks in RepeatWalker after walking along a given path
-void graph_crawler_reset_rpt_walker(RepeatWalker *rptwlk,
-                                    const GraphCache *cache, uint32_t pathid);
-
 // data[0] is number of kmers so far
 // data[1] is the kmer limit
 static inline bool gcrawler_load_path_limit_kmer_len(GraphCache *cache,
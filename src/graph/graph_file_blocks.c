@@ -0,0 +1,383 @@
+#include "global.h"
+#include "graph_file_blocks.h"
+#include "file_util.h"
+
+// Bytes in an index entry: <B:first_kmer><8:offset><8:nkmers>
+#define GRAPH_BLOCK_IDX_BYTES (sizeof(BinaryKmer) + 2*sizeof(uint64_t))
+
+//
+// Varints: 7 bits per byte, least significant first, top bit set if there
+// are more bytes
+//
+
+static inline void varint_put(uint8_t **ptr, uint64_t v)
+{
+  for(; v >= 0x80; v >>= 7) *(*ptr)++ = (uint8_t)(v | 0x80);
+  *(*ptr)++ = (uint8_t)v;
+}
+
+static inline uint64_t varint_get(const uint8_t **ptr, const uint8_t *end,
+                                  const char *path)
+{
+  uint64_t v = 0;
+  size_t shift = 0;
+  uint8_t c;
+  do {
+    if(*ptr == end || shift > 63) die("Corrupt graph block: %s", path);
+    c = *(*ptr)++;
+    v |= (uint64_t)(c & 0x7f) << shift;
+    shift += 7;
+  } while(c & 0x80);
+  return v;
+}
+
+// Max bytes used to encode a kmer: first changed word, delta and remaining
+// words, number of colours present, then colour, covg and edges per colour
+#define varint_max_bytes 10
+#define graph_blocks_max_kmer_bytes(ncols) \
+        (varint_max_bytes*(2+NUM_BKMER_WORDS) + (ncols)*(2*varint_max_bytes+1))
+
+static inline void buf_ensure_capacity(uint8_t **buf, size_t *cap, size_t len)
+{
+  if(len > *cap) {
+    *cap = roundup2pow(len);
+    *buf = ctx_realloc(*buf, *cap);
+  }
+}
+
+//
+// Reading
+//
+
+static void graph_blocks_load_index(GraphFileReader *file)
+{
+  GraphBlockReader *blks = file->blocks;
+  const char *path = file->fltr.path.b;
+  uint64_t trailer[3], idx_offset, nblocks, nkmers, sum_kmers = 0;
+  GraphBlockIdxEntry entry;
+  size_t i;
+
+  if(file->file_size < file->hdr_size + GRAPH_BLOCK_HDR_BYTES +
+                       GRAPH_BLOCK_TRAILER_BYTES) {
+    die("Truncated graph file: %s", path);
+  }
+
+  if(fseek(file->fh, file->file_size - GRAPH_BLOCK_TRAILER_BYTES, SEEK_SET) != 0)
+    die("fseek failed: %s", strerror(errno));
+
+  safe_fread(file->fh, trailer, sizeof(trailer), "block index trailer", path);
+  idx_offset = trailer[0];
+  nblocks = trailer[1];
+  nkmers = trailer[2];
+
+  if(idx_offset < (uint64_t)file->hdr_size + GRAPH_BLOCK_HDR_BYTES ||
+     idx_offset + nblocks * GRAPH_BLOCK_IDX_BYTES + GRAPH_BLOCK_TRAILER_BYTES
+       != (uint64_t)file->file_size) {
+    die("Corrupt block index in graph file: %s", path);
+  }
+
+  if(fseek(file->fh, idx_offset, SEEK_SET) != 0)
+    die("fseek failed: %s", strerror(errno));
+
+  gblock_idx_buf_capacity(&blks->idx, nblocks);
+
+  for(i = 0; i < nblocks; i++) {
+    safe_fread(file->fh, entry.first.b, sizeof(BinaryKmer), "block kmer", path);
+    safe_fread(file->fh, &entry.offset, sizeof(uint64_t), "block offset", path);
+    safe_fread(file->fh, &entry.nkmers, sizeof(uint64_t), "block kmers", path);
+    if(entry.offset < (uint64_t)file->hdr_size || entry.offset >= idx_offset)
+      die("Corrupt block index in graph file: %s", path);
+    gblock_idx_buf_add(&blks->idx, entry);
+    sum_kmers += entry.nkmers;
+  }
+
+  if(sum_kmers != nkmers)
+    die("Block index does not match number of kmers: %s", path);
+
+  file->num_of_kmers = (int64_t)nkmers;
+
+  if(fseek(file->fh, file->hdr_size, SEEK_SET) != 0)
+    die("fseek failed: %s", strerror(errno));
+}
+
+void graph_blocks_open(GraphFileReader *file, bool regular_file)
+{
+  file->blocks = ctx_calloc(1, sizeof(GraphBlockReader));
+  gblock_idx_buf_alloc(&file->blocks->idx, 16);
+  if(regular_file) graph_blocks_load_index(file);
+}
+
+void graph_blocks_close(GraphFileReader *file)
+{
+  GraphBlockReader *blks = file->blocks;
+  ctx_free(blks->data);
+  ctx_free(blks->enc);
+  ctx_free(blks->zbuf);
+  gblock_idx_buf_dealloc(&blks->idx);
+  ctx_free(blks);
+  file->blocks = NULL;
+}
+
+void graph_blocks_rewind(GraphFileReader *file)
+{
+  file->blocks->nkmers = file->blocks->pos = file->blocks->blockid = 0;
+  file->blocks->eof = false;
+}
+
+// Decode `nkmers` kmers from `enc` into records of `kmer_mem` bytes
+static void graph_blocks_decode(const uint8_t *enc, size_t enc_len,
+                                size_t nkmers, size_t ncols,
+                                char *data, const char *path)
+{
+  const uint8_t *ptr = enc, *end = enc + enc_len;
+  const size_t kmer_mem = sizeof(BinaryKmer) + ncols*(sizeof(Covg)+sizeof(Edges));
+  BinaryKmer bkmer = zero_bkmer;
+  size_t i, j, w, col, npresent;
+  Covg covg;
+  char *rec;
+
+  for(i = 0; i < nkmers; i++)
+  {
+    rec = data + i * kmer_mem;
+    memset(rec, 0, kmer_mem);
+
+    // Kmer: first word that changed, its delta, then the following words
+    w = varint_get(&ptr, end, path);
+    if(w >= NUM_BKMER_WORDS) die("Corrupt graph block: %s", path);
+    bkmer.b[w] += varint_get(&ptr, end, path);
+    for(j = w+1; j < NUM_BKMER_WORDS; j++) bkmer.b[j] = varint_get(&ptr, end, path);
+    memcpy(rec, bkmer.b, sizeof(BinaryKmer));
+
+    // Colours with coverage or edges
+    npresent = varint_get(&ptr, end, path);
+    for(j = 0, col = 0; j < npresent; j++, col++) {
+      col += varint_get(&ptr, end, path);
+      covg = (Covg)varint_get(&ptr, end, path);
+      if(col >= ncols || ptr == end) die("Corrupt graph block: %s", path);
+      memcpy(rec + sizeof(BinaryKmer) + col*sizeof(Covg), &covg, sizeof(Covg));
+      rec[sizeof(BinaryKmer) + ncols*sizeof(Covg) + col] = (char)*ptr++;
+    }
+  }
+
+  if(ptr != end) die("Corrupt graph block: %s", path);
+}
+
+// Read and decode the next block
+// Returns false at the end of the file
+static bool graph_blocks_fetch(GraphFileReader *file)
+{
+  GraphBlockReader *blks = file->blocks;
+  const char *path = file->fltr.path.b;
+  uint8_t hdr[GRAPH_BLOCK_HDR_BYTES];
+  uint32_t nkmers, data_len, enc_len;
+  uLongf len;
+
+  if(blks->eof) return false;
+
+  safe_fread(file->fh, hdr, GRAPH_BLOCK_HDR_BYTES, "block header", path);
+  memcpy(&nkmers,   hdr+1, sizeof(uint32_t));
+  memcpy(&data_len, hdr+5, sizeof(uint32_t));
+  memcpy(&enc_len,  hdr+9, sizeof(uint32_t));
+
+  // Blocks must match the index if we have one
+  bool have_idx = (blks->idx.len > 0);
+  if(have_idx && (blks->blockid == blks->idx.len ?
+                  nkmers != 0 : nkmers != blks->idx.data[blks->blockid].nkmers))
+    die("Graph block does not match index: %s", path);
+
+  // Empty block marks the end of the kmers
+  if(nkmers == 0) { blks->eof = true; return false; }
+
+  if(nkmers > MAX2(GRAPH_BLOCK_MEM / file->kmer_mem, 1))
+    die("Corrupt graph block: %s", path);
+
+  blks->blockid++;
+
+  buf_ensure_capacity(&blks->enc, &blks->enc_cap, enc_len);
+
+  switch(hdr[0]) {
+    case GRAPH_BLOCK_CODEC_NONE:
+      if(data_len != enc_len) die("Corrupt graph block: %s", path);
+      safe_fread(file->fh, blks->enc, enc_len, "block", path);
+      break;
+    case GRAPH_BLOCK_CODEC_ZLIB:
+      buf_ensure_capacity(&blks->zbuf, &blks->zbuf_cap, data_len);
+      safe_fread(file->fh, blks->zbuf, data_len, "block", path);
+      len = enc_len;
+      if(uncompress(blks->enc, &len, blks->zbuf, data_len) != Z_OK || len != enc_len)
+        die("Corrupt compressed graph block: %s", path);
+      break;
+    default: die("Unknown graph block codec %i: %s", (int)hdr[0], path);
+  }
+
+  if(nkmers * file->kmer_mem > blks->data_cap) {
+    blks->data_cap = nkmers * file->kmer_mem;
+    blks->data = ctx_realloc(blks->data, blks->data_cap);
+  }
+
+  graph_blocks_decode(blks->enc, enc_len, nkmers, file->hdr.num_of_cols,
+                      blks->data, path);
+
+  blks->nkmers = nkmers;
+  blks->pos = 0;
+  return true;
+}
+
+size_t graph_blocks_read_records(GraphFileReader *file, char *buf, size_t n)
+{
+  GraphBlockReader *blks = file->blocks;
+  const size_t kmer_mem = file->kmer_mem;
+  size_t m, nread = 0;
+
+  while(nread < n)
+  {
+    if(blks->pos == blks->nkmers && !graph_blocks_fetch(file)) break;
+    m = MIN2(n - nread, blks->nkmers - blks->pos);
+    memcpy(buf + nread * kmer_mem, blks->data + blks->pos * kmer_mem,
+           m * kmer_mem);
+    blks->pos += m;
+    nread += m;
+  }
+
+  return nread;
+}
+
+//
+// Writing
+//
+
+void graph_blocks_writer_alloc(GraphBlockWriter *wtr, FILE *fh,
+                               size_t hdr_size, size_t ncols)
+{
+  size_t kmer_mem = sizeof(BinaryKmer) + ncols*(sizeof(Covg)+sizeof(Edges));
+  memset(wtr, 0, sizeof(*wtr));
+  wtr->fh = fh;
+  wtr->ncols = ncols;
+  wtr->max_nkmers = MAX2(GRAPH_BLOCK_MEM / kmer_mem, 1);
+  wtr->offset = hdr_size;
+  wtr->prev = zero_bkmer;
+  gblock_idx_buf_alloc(&wtr->idx, 64);
+}
+
+void graph_blocks_writer_dealloc(GraphBlockWriter *wtr)
+{
+  ctx_free(wtr->enc);
+  ctx_free(wtr->zbuf);
+  gblock_idx_buf_dealloc(&wtr->idx);
+  memset(wtr, 0, sizeof(*wtr));
+}
+
+static inline void graph_blocks_fwrite(GraphBlockWriter *wtr,
+                                       const void *ptr, size_t len)
+{
+  if(fwrite(ptr, 1, len, wtr->fh) != len)
+    die("Cannot write to file [%s]", strerror(errno));
+  wtr->offset += len;
+}
+
+static void graph_blocks_write_hdr(GraphBlockWriter *wtr, uint8_t codec,
+                                   uint32_t nkmers, uint32_t data_len,
+                                   uint32_t enc_len)
+{
+  uint8_t hdr[GRAPH_BLOCK_HDR_BYTES];
+  hdr[0] = codec;
+  memcpy(hdr+1, &nkmers,   sizeof(uint32_t));
+  memcpy(hdr+5, &data_len, sizeof(uint32_t));
+  memcpy(hdr+9, &enc_len,  sizeof(uint32_t));
+  graph_blocks_fwrite(wtr, hdr, GRAPH_BLOCK_HDR_BYTES);
+}
+
+// Compress the current block with zlib if that makes it smaller, then write
+static void graph_blocks_flush(GraphBlockWriter *wtr)
+{
+  if(wtr->nkmers == 0) return;
+
+  uint8_t codec = GRAPH_BLOCK_CODEC_NONE;
+  const uint8_t *data = wtr->enc;
+  uLongf data_len = compressBound(wtr->enc_len);
+
+  buf_ensure_capacity(&wtr->zbuf, &wtr->zbuf_cap, data_len);
+
+  if(compress2(wtr->zbuf, &data_len, wtr->enc, wtr->enc_len,
+               Z_DEFAULT_COMPRESSION) == Z_OK && data_len < wtr->enc_len) {
+    codec = GRAPH_BLOCK_CODEC_ZLIB;
+    data = wtr->zbuf;
+  }
+  else data_len = wtr->enc_len;
+
+  wtr->idx.data[wtr->idx.len-1].nkmers = wtr->nkmers;
+
+  graph_blocks_write_hdr(wtr, codec, wtr->nkmers, data_len, wtr->enc_len);
+  graph_blocks_fwrite(wtr, data, data_len);
+
+  wtr->num_kmers += wtr->nkmers;
+  wtr->nkmers = wtr->enc_len = 0;
+}
+
+void graph_blocks_write_kmer(GraphBlockWriter *wtr, BinaryKmer bkmer,
+                             const Covg *covgs, const Edges *edges)
+{
+  if(wtr->num_kmers + wtr->nkmers > 0 && binary_kmer_less_than(bkmer, wtr->prev))
+    die("Kmers must be sorted to write a compressed graph file");
+
+  if(wtr->nkmers == 0) {
+    GraphBlockIdxEntry entry = {.first = bkmer, .offset = wtr->offset,
+                                .nkmers = 0};
+    gblock_idx_buf_add(&wtr->idx, entry);
+  }
+
+  size_t w, col, npresent = 0;
+  BinaryKmer prev = wtr->nkmers ? wtr->prev : zero_bkmer;
+
+  buf_ensure_capacity(&wtr->enc, &wtr->enc_cap,
+                      wtr->enc_len + graph_blocks_max_kmer_bytes(wtr->ncols));
+
+  uint8_t *ptr = wtr->enc + wtr->enc_len;
+
+  // Kmer: first word that changed, its delta, then the following words
+  for(w = 0; w+1 < NUM_BKMER_WORDS && bkmer.b[w] == prev.b[w]; w++) {}
+  varint_put(&ptr, w);
+  varint_put(&ptr, bkmer.b[w] - prev.b[w]);
+  for(w++; w < NUM_BKMER_WORDS; w++) varint_put(&ptr, bkmer.b[w]);
+
+  // Colours with coverage or edges, colour is stored as gap from the last one
+  for(col = 0; col < wtr->ncols; col++) npresent += (covgs[col] || edges[col]);
+  varint_put(&ptr, npresent);
+
+  size_t nextcol = 0;
+  for(col = 0; col < wtr->ncols; col++) {
+    if(covgs[col] || edges[col]) {
+      varint_put(&ptr, col - nextcol);
+      varint_put(&ptr, covgs[col]);
+      *ptr++ = edges[col];
+      nextcol = col+1;
+    }
+  }
+
+  wtr->enc_len = ptr - wtr->enc;
+  wtr->prev = bkmer;
+
+  if(++wtr->nkmers == wtr->max_nkmers) graph_blocks_flush(wtr);
+}
+
+size_t graph_blocks_writer_finish(GraphBlockWriter *wtr)
+{
+  size_t i;
+  graph_blocks_flush(wtr);
+
+  // End of blocks marker
+  graph_blocks_write_hdr(wtr, GRAPH_BLOCK_CODEC_NONE, 0, 0, 0);
+
+  uint64_t trailer[3] = {wtr->offset, wtr->idx.len, wtr->num_kmers};
+
+  for(i = 0; i < wtr->idx.len; i++) {
+    const GraphBlockIdxEntry *entry = &wtr->idx.data[i];
+    graph_blocks_fwrite(wtr, entry->first.b, sizeof(BinaryKmer));
+    graph_blocks_fwrite(wtr, &entry->offset, sizeof(uint64_t));
+    graph_blocks_fwrite(wtr, &entry->nkmers, sizeof(uint64_t));
+  }
+
+  graph_blocks_fwrite(wtr, trailer, sizeof(trailer));
+
+  return wtr->num_kmers;
+}
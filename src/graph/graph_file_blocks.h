@@ -0,0 +1,100 @@
+#ifndef GRAPH_FILE_BLOCKS_H_
+#define GRAPH_FILE_BLOCKS_H_
+
+#include "graph_file_reader.h"
+#include "graph_format.h"
+
+//
+// Block compressed graph files (format version 8)
+// See docs/file_formats/graph_format_v8.txt
+//
+// Kmers are sorted and split into blocks that can be decoded independently.
+// Within a block each kmer is delta encoded against the previous one and only
+// colours with coverage or edges are stored, with varint coverages. Each
+// block is then compressed with zlib, unless that does not make it smaller.
+// An index of blocks and the number of kmers is written at the end of the
+// file.
+//
+// GraphFileReader decodes blocks into the uncompressed record layout, so
+// graph_file_read_records() etc. work the same on all graph file versions.
+//
+
+// Max memory for a decoded block, blocks have at least one kmer
+#define GRAPH_BLOCK_MEM (4*ONE_MEGABYTE)
+
+#define GRAPH_BLOCK_CODEC_NONE 0
+#define GRAPH_BLOCK_CODEC_ZLIB 1
+
+// Bytes in a block header: <1:codec><4:nkmers><4:data_len><4:enc_len>
+#define GRAPH_BLOCK_HDR_BYTES 13
+
+// Bytes in the trailer: <8:idx_offset><8:num_blocks><8:num_kmers>
+#define GRAPH_BLOCK_TRAILER_BYTES 24
+
+typedef struct
+{
+  BinaryKmer first; // first kmer in the block
+  uint64_t offset, nkmers; // offset of block header from start of the file
+} GraphBlockIdxEntry;
+
+#include "madcrowlib/madcrow_buffer.h"
+madcrow_buffer(gblock_idx_buf, GraphBlockIdxBuffer, GraphBlockIdxEntry);
+
+struct GraphBlockReaderStruct
+{
+  char *data; // decoded kmer records
+  size_t nkmers, pos, data_cap;
+  uint8_t *enc, *zbuf; // encoded and compressed block
+  size_t enc_cap, zbuf_cap;
+  GraphBlockIdxBuffer idx; // only loaded for regular files
+  size_t blockid; // number of blocks read, checked against the index
+  bool eof;
+};
+
+//
+// Reading, used by GraphFileReader
+//
+
+// Set up reading kmers from a file whose header has just been read.
+// If the file is a regular file, the block index is loaded and
+// file->num_of_kmers is set.
+void graph_blocks_open(GraphFileReader *file, bool regular_file);
+void graph_blocks_close(GraphFileReader *file);
+
+// Go back to the first block, file must already be at the first block
+void graph_blocks_rewind(GraphFileReader *file);
+
+// Copy up to `n` decoded kmer records into `buf`
+// Returns number of records read, only less than `n` at the end of the file
+size_t graph_blocks_read_records(GraphFileReader *file, char *buf, size_t n);
+
+//
+// Writing
+//
+
+typedef struct
+{
+  FILE *fh;
+  size_t ncols, max_nkmers;
+  uint8_t *enc, *zbuf; // encoded and compressed block
+  size_t enc_len, enc_cap, zbuf_cap;
+  size_t nkmers; // kmers in current block
+  uint64_t offset, num_kmers; // bytes and kmers written to the file
+  BinaryKmer prev;
+  GraphBlockIdxBuffer idx;
+} GraphBlockWriter;
+
+// `hdr_size` is the number of bytes already written to `fh` (the header)
+void graph_blocks_writer_alloc(GraphBlockWriter *wtr, FILE *fh,
+                               size_t hdr_size, size_t ncols);
+void graph_blocks_writer_dealloc(GraphBlockWriter *wtr);
+
+// Kmers must be added in sorted order, calls die() otherwise
+void graph_blocks_write_kmer(GraphBlockWriter *wtr, BinaryKmer bkmer,
+                             const Covg *covgs, const Edges *edges);
+
+// Write last block, index and trailer. Does not close the file.
+// Returns number of kmers written
+size_t graph_blocks_writer_finish(GraphBlockWriter *wtr);
+
+#endif /* GRAPH_FILE_BLOCKS_H_ */
@@ -0,0 +1,289 @@
+#include "global.h"
+#include "graph_file_index.h"
+#include "cmd.h"
+#include "file_util.h"
+#include "util.h"
+
+// Check a kmer string from an index file and convert to BinaryKmer
+static BinaryKmer graph_index_parse_kmer(const char *str, size_t kmer_size,
+                                         const char *path, size_t line)
+{
+  size_t i;
+  for(i = 0; i < kmer_size && char_is_acgt(str[i]); i++) {}
+  if(i != kmer_size || str[i] != '\0')
+    die("Bad kmer in index [line: %zu; kmer_size: %zu]: %s", line, kmer_size, path);
+  return binary_kmer_from_str(str, kmer_size);
+}
+
+// Check `n` kmer records at `data` are in strictly increasing order and that
+// the first comes after `prev` (ignored if `have_prev` is false).
+// Sets `prev` to the last kmer checked. Returns false if not sorted.
+static bool graph_index_records_sorted(const char *data, size_t n,
+                                       size_t kmer_mem, BinaryKmer *prev,
+                                       bool have_prev)
+{
+  BinaryKmer bkmer;
+  size_t i;
+  for(i = 0; i < n; i++) {
+    memcpy(bkmer.b, data + i * kmer_mem, sizeof(BinaryKmer));
+    if((i > 0 || have_prev) && binary_kmers_cmp(*prev, bkmer) >= 0)
+      return false;
+    *prev = bkmer;
+  }
+  return true;
+}
+
+static void graph_index_load(GraphFileIndex *gidx, const char *idx_path)
+{
+  const GraphFileReader *file = &gidx->file;
+  size_t kmer_size = file->hdr.kmer_size, lineno = 0, cap = 1024;
+  size_t nkmers, offset, block_size, end = file->hdr_size;
+  StrBuf line;
+
+  FILE *fh = futil_fopen(idx_path, "r");
+  strbuf_alloc(&line, 1024);
+  gidx->blocks = ctx_malloc(cap * sizeof(GraphIndexBlock));
+  gidx->nblocks = 0;
+
+  while(strbuf_reset_readline(&line, fh))
+  {
+    lineno++;
+    strbuf_chomp(&line);
+    if(line.end == 0 || line.b[0] == '#') continue;
+
+    char kstr0[line.end+1], kstr1[line.end+1];
+    if(sscanf(line.b, "%s %s %zu %zu %zu", kstr0, kstr1,
+              &nkmers, &offset, &block_size) != 5)
+      die("Bad index line [line: %zu]: %s", lineno, idx_path);
+
+    // Blocks must be contiguous and match the graph file
+    if(offset != end || nkmers == 0 || block_size != nkmers * file->kmer_mem ||
+       offset + block_size > (size_t)file->file_size)
+      die("Index does not match graph file [line: %zu]: %s", lineno, idx_path);
+
+    if(gidx->nblocks == cap) {
+      cap *= 2;
+      gidx->blocks = ctx_realloc(gidx->blocks, cap * sizeof(GraphIndexBlock));
+    }
+
+    GraphIndexBlock *blk = &gidx->blocks[gidx->nblocks++];
+    blk->first = graph_index_parse_kmer(kstr0, kmer_size, idx_path, lineno);
+    blk->last = graph_index_parse_kmer(kstr1, kmer_size, idx_path, lineno);
+
+    // Blocks must be in order and not overlap
+    if(binary_kmers_cmp(blk->first, blk->last) > 0 ||
+       (nkmers > 1 && binary_kmers_cmp(blk->first, blk->last) == 0) ||
+       (gidx->nblocks > 1 && binary_kmers_cmp(blk[-1].last, blk->first) >= 0))
+      die("Index blocks are not sorted [line: %zu]: %s", lineno, idx_path);
+
+    blk->nkmers = nkmers;
+    blk->offset = offset;
+    end = offset + block_size;
+  }
+
+  if(end != (size_t)file->file_size)
+    die("Index does not cover the whole graph file: %s", idx_path);
+
+  strbuf_dealloc(&line);
+  fclose(fh);
+}
+
+// Treat the whole file as a single block, after checking it is sorted
+static void graph_index_single_block(GraphFileIndex *gidx)
+{
+  GraphFileReader *file = &gidx->file;
+  gidx->blocks = ctx_malloc(sizeof(GraphIndexBlock));
+  gidx->nblocks = file->num_of_kmers > 0;
+
+  if(gidx->nblocks) {
+    GraphFileRecord rec;
+    BinaryKmer prev = zero_bkmer;
+    const char *start = file->mmap_ptr + file->hdr_size;
+
+    if(!graph_index_records_sorted(start, file->num_of_kmers, file->kmer_mem,
+                                   &prev, false)) {
+      die("Graph file is not sorted, sort with `"CMD" sort` first: %s",
+          file_filter_path(&file->fltr));
+    }
+
+    GraphIndexBlock *blk = &gidx->blocks[0];
+    blk->nkmers = file->num_of_kmers;
+    blk->offset = file->hdr_size;
+    graph_file_record_set(&rec, start, file->hdr.num_of_cols);
+    blk->first = graph_file_record_bkmer(&rec);
+    graph_file_record_set(&rec, start + (blk->nkmers-1) * file->kmer_mem,
+                          file->hdr.num_of_cols);
+    blk->last = graph_file_record_bkmer(&rec);
+  }
+}
+
+void graph_index_open(GraphFileIndex *gidx, const char *ctx_path,
+                      const char *idx_path)
+{
+  memset(gidx, 0, sizeof(*gidx));
+  GraphFileReader *file = &gidx->file;
+  graph_file_open(file, ctx_path);
+
+  if(!file_filter_is_direct(&file->fltr))
+    die("Cannot open graph file with a filter ('in.ctx:blah' syntax)");
+
+  if(graph_file_is_compressed(file))
+    die("Cannot search a compressed graph file in place: %s", ctx_path);
+
+  if(!graph_file_is_mmap(file))
+    die("Cannot memory map graph file, is it a stream?: %s", ctx_path);
+
+  if(file->file_size != file->hdr_size + file->num_of_kmers * (off_t)file->kmer_mem)
+    die("Truncated graph file: %s", ctx_path);
+
+  StrBuf tmp_path;
+  strbuf_alloc(&tmp_path, 1024);
+
+  if(idx_path == NULL) {
+    strbuf_sprintf(&tmp_path, "%s.idx", file->fltr.path.b);
+    if(futil_file_exists(tmp_path.b)) idx_path = tmp_path.b;
+  }
+
+  if(idx_path != NULL) graph_index_load(gidx, idx_path);
+  else {
+    warn("No index for graph file, searching whole file: %s", ctx_path);
+    graph_index_single_block(gidx);
+  }
+
+  status("[GraphIndex] %s: %zu blocks", ctx_path, gidx->nblocks);
+  strbuf_dealloc(&tmp_path);
+}
+
+void graph_index_close(GraphFileIndex *gidx)
+{
+  graph_file_close(&gidx->file);
+  ctx_free(gidx->blocks);
+  memset(gidx, 0, sizeof(*gidx));
+}
+
+bool graph_index_find(const GraphFileIndex *gidx, const BinaryKmer bkey,
+                      GraphFileRecord *rec)
+{
+  const GraphFileReader *file = &gidx->file;
+  const size_t kmer_mem = file->kmer_mem, ncols = file->hdr.num_of_cols;
+  size_t lo, hi, mid;
+  BinaryKmer bkmer;
+  int cmp;
+
+  // Find last block with first kmer <= bkey
+  for(lo = 0, hi = gidx->nblocks; lo < hi; ) {
+    mid = (lo + hi) / 2;
+    if(binary_kmers_cmp(gidx->blocks[mid].first, bkey) <= 0) lo = mid+1;
+    else hi = mid;
+  }
+
+  if(lo == 0) return false;
+  const GraphIndexBlock *blk = &gidx->blocks[lo-1];
+  if(binary_kmers_cmp(bkey, blk->last) > 0) return false;
+
+  // Binary search within the block
+  const char *data = file->mmap_ptr + blk->offset;
+
+  for(lo = 0, hi = blk->nkmers; lo < hi; ) {
+    mid = (lo + hi) / 2;
+    memcpy(bkmer.b, data + mid * kmer_mem, sizeof(BinaryKmer));
+    cmp = binary_kmers_cmp(bkmer, bkey);
+    if(cmp == 0) {
+      graph_file_record_set(rec, data + mid * kmer_mem, ncols);
+      return true;
+    }
+    else if(cmp < 0) lo = mid+1;
+    else hi = mid;
+  }
+
+  return false;
+}
+
+size_t graph_index_write(GraphFileReader *file, size_t block_kmers,
+                         FILE *fout, size_t *nblocks_ptr)
+{
+  const size_t kmer_mem = file->kmer_mem, kmer_size = file->hdr.kmer_size;
+  const char *path = file_filter_path(&file->fltr), *block;
+  size_t n, nkmers = 0, nblocks = 0, offset = file->hdr_size;
+  char kmer_start[MAX_KMER_SIZE+1], kmer_end[MAX_KMER_SIZE+1];
+  BinaryKmer bkmer_start, prev = zero_bkmer;
+
+  ctx_assert(block_kmers > 0);
+
+  // Memory mapped files are indexed in place
+  char *buf = graph_file_is_mmap(file) ? NULL : ctx_malloc(block_kmers * kmer_mem);
+
+  fputs("#start_kmer end_kmer num_kmers start_byte block_size\n", fout);
+
+  while((n = graph_file_read_records(file, buf, block_kmers, &block)) > 0)
+  {
+    memcpy(bkmer_start.b, block, sizeof(BinaryKmer));
+
+    // Check every kmer, within the block and against the previous block
+    if(!graph_index_records_sorted(block, n, kmer_mem, &prev, nkmers > 0)) {
+      die("Graph file is not sorted, sort with `"CMD" sort` first "
+          "[block: %zu]: %s", nblocks, path);
+    }
+
+    binary_kmer_to_str(bkmer_start, kmer_size, kmer_start);
+    binary_kmer_to_str(prev, kmer_size, kmer_end);
+    fprintf(fout, "%s %s %zu %zu %zu\n", kmer_start, kmer_end, n,
+                                         offset, n * kmer_mem);
+
+    offset += n * kmer_mem;
+    nkmers += n;
+    nblocks++;
+    if(n < block_kmers) break;
+  }
+
+  ctx_free(buf);
+  if(nblocks_ptr) *nblocks_ptr = nblocks;
+  return nkmers;
+}
+
+typedef struct
+{
+  size_t threadid, nthreads;
+  const GraphFileIndex *gidx;
+  const BinaryKmer *bkeys;
+  GraphFileRecord *recs;
+  bool *found;
+  size_t n, nfound;
+} GraphIndexJob;
+
+static void graph_index_find_job(void *arg)
+{
+  GraphIndexJob *job = (GraphIndexJob*)arg;
+  size_t i, start, end;
+
+  start = job->n *  job->threadid    / job->nthreads;
+  end   = job->n * (job->threadid+1) / job->nthreads;
+
+  for(i = start; i < end; i++) {
+    job->found[i] = graph_index_find(job->gidx, job->bkeys[i], &job->recs[i]);
+    job->nfound += job->found[i];
+  }
+}
+
+size_t graph_index_find_batch(const GraphFileIndex *gidx,
+                              const BinaryKmer *bkeys, size_t n,
+                              GraphFileRecord *recs, bool *found,
+                              size_t nthreads)
+{
+  size_t t, nfound = 0;
+  nthreads = MAX2(MIN2(nthreads, n / 1024), 1);
+  GraphIndexJob jobs[nthreads];
+
+  for(t = 0; t < nthreads; t++) {
+    jobs[t] = (GraphIndexJob){.threadid = t, .nthreads = nthreads,
+                              .gidx = gidx, .bkeys = bkeys,
+                              .recs = recs, .found = found,
+                              .n = n, .nfound = 0};
+  }
+
+  util_run_threads(jobs, nthreads, sizeof(jobs[0]), nthreads,
+                   graph_index_find_job);
+
+  for(t = 0; t < nthreads; t++) nfound += jobs[t].nfound;
+  return nfound;
+}
@@ -0,0 +1,59 @@
+#ifndef GRAPH_FILE_INDEX_H_
+#define GRAPH_FILE_INDEX_H_
+
+#include "graph_file_reader.h"
+
+//
+// Random access kmer lookups on a sorted graph file (see `ctx sort`), using
+// the block index written by `ctx index`. The graph file is memory mapped and
+// searched in place, no hash table is built.
+//
+
+typedef struct
+{
+  BinaryKmer first, last;
+  size_t nkmers, offset; // offset is in bytes from the start of the file
+} GraphIndexBlock;
+
+typedef struct
+{
+  GraphFileReader file;
+  GraphIndexBlock *blocks;
+  size_t nblocks;
+} GraphFileIndex;
+
+/*!
+  Open a sorted graph file and its index. Calls die() on error.
+  @param idx_path Path to index, if NULL use <ctx_path>.idx if it exists,
+                  otherwise the whole graph is checked to be sorted and then
+                  searched as a single block
+ */
+void graph_index_open(GraphFileIndex *gidx, const char *ctx_path,
+                      const char *idx_path);
+
+void graph_index_close(GraphFileIndex *gidx);
+
+// Find a kmer key (see binary_kmer_get_key()) in the graph
+// Returns true and sets `rec` if found, otherwise returns false
+bool graph_index_find(const GraphFileIndex *gidx, const BinaryKmer bkey,
+                      GraphFileRecord *rec);
+
+// Find `n` kmer keys using `nthreads`. found[i] is set to whether bkeys[i] is
+// in the graph and if so recs[i] is set.
+// Returns number of kmers found
+size_t graph_index_find_batch(const GraphFileIndex *gidx,
+                              const BinaryKmer *bkeys, size_t n,
+                              GraphFileRecord *recs, bool *found,
+                              size_t nthreads);
+
+/*!
+  Write an index of `file` to `fout` with one line per block of `block_kmers`
+  kmers. Every kmer is read, calls die() if they are not in strictly
+  increasing order.
+  @param nblocks if not NULL, set to the number of blocks written
+  @return number of kmers in the file
+ */
+size_t graph_index_write(GraphFileReader *file, size_t block_kmers,
+                         FILE *fout, size_t *nblocks);
+
+#endif /* GRAPH_FILE_INDEX_H_ */
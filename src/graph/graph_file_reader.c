@@ -1,10 +1,34 @@
 #include "global.h"
 #include "graph_file_reader.h"
 #include "graph_format.h"
+#include "graph_file_blocks.h"
 #include "db_node.h"
 #include "cmd.h"
 #include "file_util.h"
 
+#include <sys/mman.h>
+
+// Memory map a regular file so that kmers can be read in place
+// Falls back to reading with fread if the file cannot be mapped
+static void graph_file_mmap(GraphFileReader *file)
+{
+  const char *path = file->fltr.path.b;
+  void *ptr = mmap(NULL, file->file_size, PROT_READ, MAP_SHARED,
+                   fileno(file->fh), 0);
+
+  if(ptr == MAP_FAILED) {
+    warn("Cannot memory map file, reading with fread: %s [%s]",
+         path, strerror(errno));
+    return;
+  }
+
+  // We mostly read graph files from start to end
+  madvise(ptr, file->file_size, MADV_SEQUENTIAL);
+
+  file->mmap_ptr = ptr;
+  file->mmap_pos = file->hdr_size;
+}
+
 int graph_file_open(GraphFileReader *file, const char *path)
 {
   return graph_file_open2(file, path, "r", 0);
@@ -25,11 +49,17 @@ int graph_file_open2(GraphFileReader *file, const char *input, const char *mode,
 
   // Stat will fail on streams, so file_size and num_of_kmers with both be -1
   struct stat st;
+  bool regular_file = false;
   file->file_size = -1;
   file->num_of_kmers = -1;
+  file->mmap_ptr = file->kmer_buf = NULL;
+  file->blocks = NULL;
 
   if(strcmp(input,"-") != 0) {
-    if(stat(path, &st) == 0) file->file_size = st.st_size;
+    if(stat(path, &st) == 0) {
+      file->file_size = st.st_size;
+      regular_file = S_ISREG(st.st_mode);
+    }
     else warn("Couldn't get file size: %s", futil_outpath_str(path));
   }
 
@@ -43,13 +73,23 @@ int graph_file_open2(GraphFileReader *file, const char *input, const char *mode,
 
   size_t bytes_per_kmer, bytes_remaining;
 
+  bytes_per_kmer = sizeof(BinaryKmer) +
+                   hdr->num_of_cols * (sizeof(Covg) + sizeof(Edges));
+  file->kmer_mem = bytes_per_kmer;
+
+  if(hdr->version == CTX_GRAPH_FILEFORMAT_BLOCKS)
+  {
+    // Compressed kmers are decoded into kmer_buf, never memory mapped
+    graph_blocks_open(file, regular_file);
+    file->kmer_buf = ctx_malloc(bytes_per_kmer);
+    return 1;
+  }
+
   // If reading from STDIN we don't know file size
   if(file->file_size != -1)
   {
     // File header checks
     // Get number of kmers
-    bytes_per_kmer = sizeof(BinaryKmer) +
-                     hdr->num_of_cols * (sizeof(Covg) + sizeof(Edges));
     bytes_remaining = (size_t)(file->file_size - file->hdr_size);
     file->num_of_kmers = (bytes_remaining / bytes_per_kmer);
 
@@ -62,23 +102,83 @@ int graph_file_open2(GraphFileReader *file, const char *input, const char *mode,
     }
   }
 
+  if(regular_file && file->file_size > file->hdr_size) graph_file_mmap(file);
+  if(!graph_file_is_mmap(file)) file->kmer_buf = ctx_malloc(bytes_per_kmer);
+
   return 1;
 }
 
 // Close file
 void graph_file_close(GraphFileReader *file)
 {
+  if(file->mmap_ptr != NULL && munmap(file->mmap_ptr, file->file_size) == -1)
+    warn("Cannot release mmap file: %s [%s]", file->fltr.path.b, strerror(errno));
+  if(file->blocks != NULL) graph_blocks_close(file);
+  ctx_free(file->kmer_buf);
   if(file->fh) fclose(file->fh);
   file_filter_close(&file->fltr);
   graph_header_dealloc(&file->hdr);
   memset(file, 0, sizeof(*file));
 }
 
+// Seek back to the first kmer in the file, cannot be used on a stream
+void graph_file_rewind(GraphFileReader *file)
+{
+  ctx_assert(!file_filter_isstdin(&file->fltr));
+  if(fseek(file->fh, file->hdr_size, SEEK_SET) != 0)
+    die("fseek failed: %s", strerror(errno));
+  file->mmap_pos = file->hdr_size;
+  if(file->blocks != NULL) graph_blocks_rewind(file);
+}
+
+// Read up to `n` kmer records without parsing them
+// If the file is memory mapped *ptr is set to point into the file, otherwise
+// records are read into `buf` (`n` * file->kmer_mem bytes) and *ptr = buf
+// Returns number of records read, calls die() on a truncated file
+size_t graph_file_read_records(GraphFileReader *file, char *buf, size_t n,
+                               const char **ptr)
+{
+  size_t nbytes;
+
+  if(graph_file_is_compressed(file)) {
+    *ptr = buf;
+    return graph_blocks_read_records(file, buf, n);
+  }
+
+  if(graph_file_is_mmap(file)) {
+    nbytes = MIN2((size_t)file->file_size - file->mmap_pos, n * file->kmer_mem);
+    *ptr = file->mmap_ptr + file->mmap_pos;
+    file->mmap_pos += nbytes;
+  }
+  else {
+    nbytes = fread(buf, 1, n * file->kmer_mem, file->fh);
+    *ptr = buf;
+  }
+
+  if(nbytes % file->kmer_mem != 0)
+    die("Unexpected end of file: %s", file->fltr.path.b);
+
+  return nbytes / file->kmer_mem;
+}
+
+// Read the next kmer record without copying it if the file is memory mapped
+// Pointers in `rec` are valid until the next read
+// returns true on success, false at the end of the file
+bool graph_file_read_record(GraphFileReader *file, GraphFileRecord *rec)
+{
+  const char *ptr;
+
+  if(!graph_file_read_records(file, file->kmer_buf, 1, &ptr)) return false;
+
+  graph_file_record_set(rec, ptr, file->hdr.num_of_cols);
+  return true;
+}
+
 // Read a kmer from the file
 // returns true on success, false otherwise
 // prints warnings if dirty kmers in file
 // be sure to zero covgs, edges before reading in
-bool graph_file_read(const GraphFileReader *file,
+bool graph_file_read(GraphFileReader *file,
                      BinaryKmer *bkmer, Covg *covgs, Edges *edges)
 {
   // status("Header colours: %u", file->hdr.num_of_cols);
@@ -86,9 +186,15 @@ bool graph_file_read(const GraphFileReader *file,
   Edges kmeredges[file->hdr.num_of_cols];
   size_t i, from, into;
   const FileFilter *fltr = &file->fltr;
+  GraphFileRecord rec;
+
+  if(!graph_file_read_record(file, &rec)) return false;
+
+  *bkmer = graph_file_record_bkmer(&rec);
+  memcpy(kmercovgs, rec.covgs, file->hdr.num_of_cols * sizeof(Covg));
+  memcpy(kmeredges, rec.edges, file->hdr.num_of_cols * sizeof(Edges));
 
-  if(!graph_file_read_kmer(file->fh, &file->hdr, fltr->path.b,
-                           bkmer, kmercovgs, kmeredges)) return false;
+  graph_file_check_kmer(&file->hdr, fltr->path.b, *bkmer, kmercovgs, kmeredges);
 
   for(i = 0; i < file_filter_num(fltr); i++) {
     from = file_filter_fromcol(fltr, i);
@@ -104,7 +210,7 @@ bool graph_file_read(const GraphFileReader *file,
 // returns true on success, false otherwise
 // prints warnings if dirty kmers in file
 // @ncols is file_filter_into_ncols(&file->fltr)
-bool graph_file_read_reset(const GraphFileReader *file, size_t ncols,
+bool graph_file_read_reset(GraphFileReader *file, size_t ncols,
                            BinaryKmer *bkmer, Covg *covgs, Edges *edges)
 {
   memset(covgs, 0, ncols*sizeof(Covg));
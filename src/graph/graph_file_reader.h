@@ -14,6 +14,9 @@ typedef struct
   size_t capacity;
 } GraphFileHeader;
 
+// Decoding state for block compressed files, see graph_file_blocks.h
+typedef struct GraphBlockReaderStruct GraphBlockReader;
+
 typedef struct
 {
   FILE *fh;
@@ -21,13 +24,52 @@ typedef struct
   GraphFileHeader hdr;
   off_t hdr_size, file_size;
   int64_t num_of_kmers; // set if reading from file (i.e. not stream) else -1
+  // Regular files are memory mapped and kmers are read in place,
+  // streams are read into kmer_buf with fread
+  char *mmap_ptr, *kmer_buf;
+  size_t kmer_mem, mmap_pos; // bytes per kmer, read position in mmap_ptr
+  GraphBlockReader *blocks; // set if file is block compressed (version 8)
 } GraphFileReader;
 
+// Pointers to a kmer record in a graph file. If the file is memory mapped
+// these point into the mapping and may not be aligned
+typedef struct
+{
+  const char *bkmer, *covgs; // sizeof(BinaryKmer) bytes, num_of_cols Covgs
+  const Edges *edges; // num_of_cols Edges
+} GraphFileRecord;
+
+// Set record pointers for a kmer record starting at `ptr`
+static inline void graph_file_record_set(GraphFileRecord *rec, const char *ptr,
+                                         size_t ncols)
+{
+  rec->bkmer = ptr;
+  rec->covgs = ptr + sizeof(BinaryKmer);
+  rec->edges = (const Edges*)(rec->covgs + ncols * sizeof(Covg));
+}
+
+static inline BinaryKmer graph_file_record_bkmer(const GraphFileRecord *rec)
+{
+  BinaryKmer bkmer;
+  memcpy(bkmer.b, rec->bkmer, sizeof(BinaryKmer));
+  return bkmer;
+}
+
+static inline Covg graph_file_record_covg(const GraphFileRecord *rec, size_t col)
+{
+  Covg covg;
+  memcpy(&covg, rec->covgs + col * sizeof(Covg), sizeof(Covg));
+  return covg;
+}
+
 #define graph_file_reset(rdr) memset(rdr, 0, sizeof(GraphFileReader))
 
 // Returns 0 if not set instead of -1
 #define graph_file_nkmers(rdr) ((uint64_t)MAX2((rdr)->num_of_kmers, 0))
 
+#define graph_file_is_mmap(rdr) ((rdr)->mmap_ptr != NULL)
+#define graph_file_is_compressed(rdr) ((rdr)->blocks != NULL)
+
 #include "madcrowlib/madcrow_buffer.h"
 madcrow_buffer(gfile_buf, GraphFileBuffer, GraphFileReader);
 
@@ -47,19 +89,35 @@ int graph_file_open2(GraphFileReader *file, const char *path, const char *mode,
 // Close file, release all memory
 void graph_file_close(GraphFileReader *file);
 
+// Seek back to the first kmer in the file, cannot be used on a stream
+void graph_file_rewind(GraphFileReader *file);
+
+// Read up to `n` kmer records without parsing them
+// If the file is memory mapped *ptr is set to point into the file, otherwise
+// records are read (or decoded from compressed blocks) into `buf`
+// (`n` * file->kmer_mem bytes) and *ptr = buf
+// Returns number of records read, calls die() on a truncated file
+size_t graph_file_read_records(GraphFileReader *file, char *buf, size_t n,
+                               const char **ptr);
+
+// Read the next kmer record without copying it if the file is memory mapped
+// Pointers in `rec` are valid until the next read
+// returns true on success, false at the end of the file
+bool graph_file_read_record(GraphFileReader *file, GraphFileRecord *rec);
+
 // Read a kmer from the file
 // returns true on success, false otherwise
 // prints warnings if dirty kmers in file
 // Beware: this function does not use file.intocol so you may wish to pass:
 //    graph_file_read(file, &bkmer, covgs+file.intocol, edges+file.intocol);
-bool graph_file_read(const GraphFileReader *file,
+bool graph_file_read(GraphFileReader *file,
                      BinaryKmer *bkmer, Covg *covgs, Edges *edges);
 
 // Read a kmer from the file
 // returns true on success, false otherwise
 // prints warnings if dirty kmers in file
 // @ncols is file_filter_into_ncols(&file->fltr)
-bool graph_file_read_reset(const GraphFileReader *file, size_t ncols,
+bool graph_file_read_reset(GraphFileReader *file, size_t ncols,
                            BinaryKmer *bkmer, Covg *covgs, Edges *edges);
 
 // Returns true if one or more files passed loads data into colour
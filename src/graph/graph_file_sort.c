@@ -0,0 +1,315 @@
+#include "global.h"
+#include "graph_file_sort.h"
+#include "graph_file_index.h"
+#include "file_util.h"
+#include "util.h"
+
+//
+// Sort graph file kmers by radix sorting (BinaryKmer, record) pairs. Runs
+// that do not fit in memory are written to temporary files then merged.
+//
+
+typedef struct
+{
+  BinaryKmer bkmer;
+  const char *rec;
+} GraphSortEntry;
+
+#define RADIX_BITS 8
+#define RADIX_BINS (1<<RADIX_BITS)
+
+#define radix_digit(e,word,shift) (((e)->bkmer.b[word] >> (shift)) & (RADIX_BINS-1))
+
+typedef struct
+{
+  size_t threadid, nthreads;
+  const GraphSortEntry *src;
+  GraphSortEntry *dst;
+  size_t n, word, shift;
+  size_t (*counts)[RADIX_BINS]; // [nthreads][RADIX_BINS]
+} RadixSortJob;
+
+// Count digits in this thread's section of the entries
+static void radix_count(void *arg)
+{
+  const RadixSortJob *job = (const RadixSortJob*)arg;
+  size_t i, start, end, *counts = job->counts[job->threadid];
+
+  start = job->n *  job->threadid    / job->nthreads;
+  end   = job->n * (job->threadid+1) / job->nthreads;
+
+  memset(counts, 0, RADIX_BINS * sizeof(size_t));
+  for(i = start; i < end; i++)
+    counts[radix_digit(&job->src[i], job->word, job->shift)]++;
+}
+
+// Counts have been converted to the offset for each digit in this thread
+static void radix_scatter(void *arg)
+{
+  const RadixSortJob *job = (const RadixSortJob*)arg;
+  size_t i, start, end, *offsets = job->counts[job->threadid];
+
+  start = job->n *  job->threadid    / job->nthreads;
+  end   = job->n * (job->threadid+1) / job->nthreads;
+
+  for(i = start; i < end; i++)
+    job->dst[offsets[radix_digit(&job->src[i], job->word, job->shift)]++] = job->src[i];
+}
+
+// Least significant digit radix sort with `nthreads`
+// `tmp` must be the same size as `entries`
+// Returns pointer to the sorted entries (either `entries` or `tmp`)
+static GraphSortEntry* graph_sort_entries(GraphSortEntry *entries,
+                                          GraphSortEntry *tmp, size_t n,
+                                          size_t kmer_size, size_t nthreads)
+{
+  // Kmers are stored in the lowest 2*k bits of BinaryKmer
+  size_t i, t, b, c, total, num_digits = (2*kmer_size + RADIX_BITS-1) / RADIX_BITS;
+  GraphSortEntry *src = entries, *dst = tmp;
+
+  // Don't use threads on small inputs
+  nthreads = MAX2(MIN2(nthreads, n / (64*RADIX_BINS)), 1);
+
+  size_t (*counts)[RADIX_BINS] = ctx_calloc(nthreads, sizeof(counts[0]));
+  RadixSortJob jobs[nthreads];
+
+  for(i = 0; i < num_digits; i++)
+  {
+    for(t = 0; t < nthreads; t++) {
+      jobs[t] = (RadixSortJob){.threadid = t, .nthreads = nthreads,
+                               .src = src, .dst = dst, .n = n,
+                               .word = NUM_BKMER_WORDS-1 - i / (64/RADIX_BITS),
+                               .shift = RADIX_BITS * (i % (64/RADIX_BITS)),
+                               .counts = counts};
+    }
+
+    util_run_threads(jobs, nthreads, sizeof(jobs[0]), nthreads, radix_count);
+
+    // Skip digit if all kmers share it
+    for(b = 0, c = 0; b < RADIX_BINS && c == 0; b++)
+      for(t = 0; t < nthreads; t++) c += counts[t][b];
+    if(c == n) continue;
+
+    // Convert counts to offsets
+    for(b = 0, total = 0; b < RADIX_BINS; b++) {
+      for(t = 0; t < nthreads; t++) {
+        c = counts[t][b];
+        counts[t][b] = total;
+        total += c;
+      }
+    }
+
+    util_run_threads(jobs, nthreads, sizeof(jobs[0]), nthreads, radix_scatter);
+    SWAP(src, dst);
+  }
+
+  ctx_free(counts);
+  return src;
+}
+
+static void graph_sort_write(const GraphSortEntry *entries, size_t n,
+                             size_t kmer_mem, FILE *fout)
+{
+  size_t i;
+  for(i = 0; i < n; i++)
+    if(fwrite(entries[i].rec, 1, kmer_mem, fout) != kmer_mem)
+      die("Cannot write to file [%s]", strerror(errno));
+}
+
+// Get output file, rewinding the input if we are overwriting it
+static FILE* graph_sort_output(GraphFileReader *file, FILE *fout)
+{
+  if(fout != NULL) return fout;
+  graph_file_rewind(file);
+  return file->fh;
+}
+
+//
+// Merging runs
+//
+
+typedef struct
+{
+  FILE *fh;
+  char *buf;
+  size_t len, pos; // buffered bytes and offset of current record
+  BinaryKmer bkmer; // current kmer
+} GraphSortRun;
+
+// Load the next kmer in the run, returns false if run is finished
+static inline bool sort_run_fetch(GraphSortRun *run, size_t kmer_mem,
+                                  size_t bufsize)
+{
+  if(run->pos == run->len) {
+    run->len = fread(run->buf, 1, bufsize, run->fh);
+    run->pos = 0;
+    if(run->len == 0) return false;
+    if(run->len % kmer_mem != 0) die("Corrupt temporary file");
+  }
+
+  memcpy(run->bkmer.b, run->buf + run->pos, sizeof(BinaryKmer));
+  return true;
+}
+
+#define sort_run_lt(runs,i,j) binary_kmer_less_than(runs[i].bkmer, runs[j].bkmer)
+
+// Min-heap of run indices
+static inline void sort_heap_sift_down(const GraphSortRun *runs,
+                                       size_t *heap, size_t n, size_t i)
+{
+  size_t c, tmp;
+  while((c = 2*i+1) < n) {
+    if(c+1 < n && sort_run_lt(runs, heap[c+1], heap[c])) c++;
+    if(!sort_run_lt(runs, heap[c], heap[i])) break;
+    tmp = heap[i]; heap[i] = heap[c]; heap[c] = tmp;
+    i = c;
+  }
+}
+
+// Merge sorted runs, closes run files
+// Returns number of kmers written
+static size_t graph_sort_merge(FILE **run_fhs, size_t nruns, size_t kmer_mem,
+                               size_t mem, FILE *fout)
+{
+  size_t i, n, nkmers = 0;
+
+  // Split memory between run buffers, multiple of kmer_mem
+  size_t bufsize = MAX2(mem / nruns / kmer_mem, 1) * kmer_mem;
+  bufsize = MIN2(bufsize, MAX2(DEFAULT_IO_BUFSIZE / kmer_mem, 1) * kmer_mem);
+
+  status("[sort] Merging %zu runs", nruns);
+
+  GraphSortRun *runs = ctx_calloc(nruns, sizeof(GraphSortRun));
+  size_t *heap = ctx_malloc(nruns * sizeof(size_t));
+
+  for(i = n = 0; i < nruns; i++) {
+    runs[i].fh = run_fhs[i];
+    runs[i].buf = ctx_malloc(bufsize);
+    if(fseek(runs[i].fh, 0L, SEEK_SET) != 0)
+      die("fseek failed: %s", strerror(errno));
+    if(sort_run_fetch(&runs[i], kmer_mem, bufsize)) heap[n++] = i;
+  }
+
+  for(i = n/2; i > 0; i--) sort_heap_sift_down(runs, heap, n, i-1);
+
+  while(n > 0)
+  {
+    GraphSortRun *run = &runs[heap[0]];
+    if(fwrite(run->buf + run->pos, 1, kmer_mem, fout) != kmer_mem)
+      die("Cannot write to file [%s]", strerror(errno));
+    nkmers++;
+
+    run->pos += kmer_mem;
+    if(!sort_run_fetch(run, kmer_mem, bufsize)) heap[0] = heap[--n];
+    sort_heap_sift_down(runs, heap, n, 0);
+  }
+
+  for(i = 0; i < nruns; i++) {
+    fclose(runs[i].fh);
+    ctx_free(runs[i].buf);
+  }
+
+  ctx_free(runs);
+  ctx_free(heap);
+
+  return nkmers;
+}
+
+size_t graph_file_sort(GraphFileReader *file, FILE *fout,
+                       size_t mem, size_t nthreads, const char *tmp_dir)
+{
+  const size_t kmer_mem = file->kmer_mem, kmer_size = file->hdr.kmer_size;
+  size_t n, nkmers = 0, nruns = 0, runs_cap = 16;
+  size_t run_nkmers = mem / (kmer_mem + GRAPH_SORT_ENTRY_MEM);
+  const char *ptr;
+  char mem_str[50];
+
+  if(run_nkmers == 0) {
+    bytes_to_str(kmer_mem + GRAPH_SORT_ENTRY_MEM, 1, mem_str);
+    die("Require at least %s memory", mem_str);
+  }
+
+  // Don't allocate more memory than we need
+  if(file->num_of_kmers >= 0)
+    run_nkmers = MAX2(MIN2(run_nkmers, (size_t)file->num_of_kmers), 1);
+
+  bytes_to_str(run_nkmers * (kmer_mem + GRAPH_SORT_ENTRY_MEM), 1, mem_str);
+  status("[sort] Up to %zu kmers per run, using %s", run_nkmers, mem_str);
+
+  char *data = ctx_malloc(run_nkmers * kmer_mem);
+  GraphSortEntry *entries = ctx_malloc(run_nkmers * sizeof(GraphSortEntry));
+  GraphSortEntry *tmp = ctx_malloc(run_nkmers * sizeof(GraphSortEntry));
+  GraphSortEntry *sorted;
+  FILE **run_fhs = ctx_malloc(runs_cap * sizeof(FILE*));
+  size_t i;
+
+  while((n = graph_file_read_records(file, data, run_nkmers, &ptr)) > 0)
+  {
+    // Copy out of memory mapped input, we may overwrite it
+    if(ptr != data) memcpy(data, ptr, n * kmer_mem);
+
+    for(i = 0; i < n; i++) {
+      memcpy(entries[i].bkmer.b, data + i*kmer_mem, sizeof(BinaryKmer));
+      entries[i].rec = data + i*kmer_mem;
+    }
+
+    sorted = graph_sort_entries(entries, tmp, n, kmer_size, nthreads);
+
+    // If all kmers fit in one run, write straight to output
+    if(nruns == 0 && (n < run_nkmers || (int64_t)n == file->num_of_kmers)) {
+      graph_sort_write(sorted, n, kmer_mem, graph_sort_output(file, fout));
+      nkmers = n;
+      break;
+    }
+
+    if(nruns == runs_cap) {
+      runs_cap *= 2;
+      run_fhs = ctx_realloc(run_fhs, runs_cap * sizeof(FILE*));
+    }
+
+    status("[sort] Writing run %zu with %zu kmers", nruns, n);
+    run_fhs[nruns] = futil_create_tmp_file(tmp_dir);
+    graph_sort_write(sorted, n, kmer_mem, run_fhs[nruns]);
+    nruns++;
+
+    if(n < run_nkmers) break;
+  }
+
+  ctx_free(data);
+  ctx_free(entries);
+  ctx_free(tmp);
+
+  if(nruns > 0) {
+    nkmers = graph_sort_merge(run_fhs, nruns, kmer_mem, mem,
+                              graph_sort_output(file, fout));
+  }
+
+  ctx_free(run_fhs);
+
+  if(ferror(file->fh)) die("Error reading file: %s", file->fltr.path.b);
+
+  return nkmers;
+}
+
+bool graph_file_is_sorted(const GraphFileReader *file)
+{
+  // Compressed files can only be written sorted
+  if(graph_file_is_compressed(file)) return true;
+
+  // `ctx index` only indexes sorted files
+  const char *path = file_filter_path(&file->fltr);
+  StrBuf idx_path;
+  strbuf_alloc(&idx_path, 1024);
+  strbuf_sprintf(&idx_path, "%s.idx", path);
+  bool sorted = futil_file_exists(idx_path.b);
+
+  // Check the index matches the file, calls die() if not
+  if(sorted && graph_file_is_mmap(file)) {
+    GraphFileIndex gidx;
+    graph_index_open(&gidx, path, idx_path.b);
+    graph_index_close(&gidx);
+  }
+
+  strbuf_dealloc(&idx_path);
+  return sorted;
+}
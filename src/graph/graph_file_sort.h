@@ -0,0 +1,29 @@
+#ifndef GRAPH_FILE_SORT_H_
+#define GRAPH_FILE_SORT_H_
+
+#include "graph_file_reader.h"
+
+// Memory used per kmer when sorting, on top of the kmer record
+#define GRAPH_SORT_ENTRY_MEM (2*(sizeof(BinaryKmer)+sizeof(char*)))
+
+/*!
+  Sort the kmers in a graph file. Kmers are read in runs that fit in `mem`
+  bytes, each run is radix sorted with `nthreads`. If there is more than one
+  run, runs are written to temporary files in `tmp_dir` then merged.
+  @param fout Output for kmer records (header should already be written).
+              If NULL, kmers are written back over the kmers in `file`, which
+              must have been opened with mode "r+"
+  @return number of kmers written
+ */
+size_t graph_file_sort(GraphFileReader *file, FILE *fout,
+                       size_t mem, size_t nthreads, const char *tmp_dir);
+
+/*!
+  Check if a graph file is known to be sorted without reading its kmers.
+  Block compressed files are always sorted, other files are sorted if they
+  have an index (<path>.idx, see `ctx index`). The index of a memory mapped
+  file is checked against the file, calls die() if it does not match.
+ */
+bool graph_file_is_sorted(const GraphFileReader *file);
+
+#endif /* GRAPH_FILE_SORT_H_ */
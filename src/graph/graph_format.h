@@ -9,6 +9,7 @@
 
 // graph file format version
 #define CTX_GRAPH_FILEFORMAT 6
+#define CTX_GRAPH_FILEFORMAT_BLOCKS 8 // block compressed, see graph_file_blocks.h
 
 // Stucture for specifying how to load data
 typedef struct
@@ -20,6 +21,8 @@ typedef struct
   // if empty_colours is true an error is thrown if a kmer from a graph file
   // is already in the graph
   bool empty_colours;
+  // Number of threads to load with, 0 or 1 loads on the calling thread
+  size_t nthreads;
 } GraphLoadingPrefs;
 
 #define LOAD_GPREFS_INIT(graph) {  \
@@ -27,7 +30,8 @@ typedef struct
   .boolean_covgs = false,          \
   .must_exist_in_graph = false,    \
   .must_exist_in_edges = NULL,     \
-  .empty_colours = false}
+  .empty_colours = false,          \
+  .nthreads = 1}
 
 extern bool greader_zero_covg_error, greader_missing_covg_error;
 
@@ -44,6 +48,12 @@ void graph_reader_merge_headers(GraphFileHeader *hdr,
 // Return number of bytes read or die() with error
 size_t graph_file_read_header(FILE *fh, GraphFileHeader *header, const char *path);
 
+// Check a kmer read from a graph file: die if oversized, warn (once) if it
+// has zero coverage or has edges without coverage
+void graph_file_check_kmer(const GraphFileHeader *h, const char *path,
+                           const BinaryKmer bkmer,
+                           const Covg *covgs, const Edges *edges);
+
 // Returns number of bytes read
 size_t graph_file_read_kmer(FILE *fh, const GraphFileHeader *h, const char *path,
                             BinaryKmer *bkmer, Covg *covgs, Edges *edges);
@@ -56,6 +66,8 @@ size_t graph_file_read_kmer(FILE *fh, const GraphFileHeader *h, const char *path
 //   stats->num_kmers_loaded
 //   stats->total_bases_read
 // If header is != NULL, header will be stored there.  Be sure to free.
+// If prefs.nthreads > 1, a reader thread reads blocks of kmers that are
+// inserted into the graph by prefs.nthreads worker threads
 size_t graph_load(GraphFileReader *file, const GraphLoadingPrefs prefs,
                   LoadingStats *stats);
 
@@ -68,7 +80,7 @@ void graph_files_load_flat(GraphFileReader *gfiles, size_t num_files,
 //   (i.e. only keep nodes and edges that are in the graph)
 // Same functionality as graph_files_merge, but faster if dealing with only one
 // input file. Reads in and dumps one kmer at a time
-size_t graph_stream_filter(const char *out_ctx_path, const GraphFileReader *file,
+size_t graph_stream_filter(const char *out_ctx_path, GraphFileReader *file,
                            const dBGraph *db_graph, const GraphFileHeader *hdr,
                            const Edges *only_load_if_in_edges);
 
@@ -83,6 +95,18 @@ size_t graph_files_merge(const char *out_ctx_path,
                          const Edges *only_load_if_in_edges,
                          GraphFileHeader *hdr, dBGraph *db_graph);
 
+// Returns true if all files are sorted (see graph_file_is_sorted())
+bool graph_files_are_sorted(const GraphFileReader *files, size_t num_files);
+
+// Merge sorted graph files in a single pass without building a hash table.
+// Holds one kmer per input in memory. Output is also sorted, and is block
+// compressed if hdr->version is CTX_GRAPH_FILEFORMAT_BLOCKS.
+// Calls die() if an input is found not to be sorted.
+// Returns number of kmers written
+size_t graph_files_merge_sorted(const char *out_ctx_path,
+                                GraphFileReader *files, size_t num_files,
+                                const GraphFileHeader *hdr);
+
 // if intersect only load kmers that are already in the hash table
 // returns number of kmers written
 size_t graph_files_merge_mkhdr(const char *out_ctx_path,
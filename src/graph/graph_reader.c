@@ -1,5 +1,7 @@
 #include "global.h"
 #include "graph_file_reader.h"
+#include "graph_file_sort.h"
+#include "graph_file_blocks.h"
 #include "graph_format.h"
 #include "util.h"
 #include "file_util.h"
@@ -8,8 +10,11 @@
 #include "graph_info.h"
 #include "range.h"
 
+#include "msg-pool/msgpool.h"
+
 // Memory mapped files used in graph_files_merge()
 #include <sys/mman.h>
+#include <pthread.h>
 
 void graph_header_alloc(GraphFileHeader *h, size_t num_of_cols)
 {
@@ -52,7 +57,10 @@ void graph_reader_merge_headers(GraphFileHeader *hdr,
   for(i = 0; i < num_files; i++)
     ncols = MAX2(ncols, file_filter_into_ncols(&files[i].fltr));
 
+  // Block compressed output is only written when asked for
   hdr->version = files[0].hdr.version;
+  if(hdr->version == CTX_GRAPH_FILEFORMAT_BLOCKS)
+    hdr->version = CTX_GRAPH_FILEFORMAT;
   hdr->kmer_size = files[0].hdr.kmer_size;
   hdr->num_of_bitfields = files[0].hdr.num_of_bitfields;
   hdr->num_of_cols = ncols;
@@ -97,9 +105,9 @@ size_t graph_file_read_header(FILE *fh, GraphFileHeader *h, const char *path)
   bytes_read += 4*sizeof(uint32_t);
 
   // Checks
-  if(h->version > 7 || h->version < 4)
+  if(h->version > 8 || h->version < 4)
   {
-    die("Sorry, we only support graph file versions 4, 5, 6 & 7 "
+    die("Sorry, we only support graph file versions 4, 5, 6, 7 & 8 "
         "[version: %u; path: %s]\n", h->version, path);
   }
 
@@ -271,30 +279,23 @@ size_t graph_file_read_header(FILE *fh, GraphFileHeader *h, const char *path)
 // Only print errors once - these are externally visible
 bool greader_zero_covg_error = false, greader_missing_covg_error = false;
 
-size_t graph_file_read_kmer(FILE *fh, const GraphFileHeader *h, const char *path,
-                            BinaryKmer *bkmer, Covg *covgs, Edges *edges)
+// Check a kmer read from a graph file: die if oversized, warn (once) if it
+// has zero coverage or has edges without coverage
+void graph_file_check_kmer(const GraphFileHeader *h, const char *path,
+                           const BinaryKmer bkmer,
+                           const Covg *covgs, const Edges *edges)
 {
-  size_t i, num_bytes_read;
+  size_t i;
   char kstr[MAX_KMER_SIZE+1];
 
-  num_bytes_read = fread(bkmer->b, 1, sizeof(BinaryKmer), fh);
-
-  if(num_bytes_read == 0) return 0;
-  if(num_bytes_read != sizeof(uint64_t)*h->num_of_bitfields)
-    die("Unexpected end of file: %s", path);
-
-  safe_fread(fh, covgs, h->num_of_cols * sizeof(uint32_t), "Coverages", path);
-  safe_fread(fh, edges, h->num_of_cols * sizeof(uint8_t), "Edges", path);
-  num_bytes_read += h->num_of_cols * (sizeof(uint32_t) + sizeof(uint8_t));
-
   // Check top word of each kmer
-  if(binary_kmer_oversized(*bkmer, h->kmer_size))
+  if(binary_kmer_oversized(bkmer, h->kmer_size))
     die("Oversized kmer in path [kmer: %u]: %s", h->kmer_size, path);
 
   // Check covg is not 0 for all colours
   for(i = 0; i < h->num_of_cols && covgs[i] == 0; i++) {}
   if(i == h->num_of_cols && !greader_zero_covg_error) {
-    binary_kmer_to_str(*bkmer, h->kmer_size, kstr);
+    binary_kmer_to_str(bkmer, h->kmer_size, kstr);
     warn("Kmer has zero covg in all colours [kmer: %s; path: %s]", kstr, path);
     greader_zero_covg_error = true;
   }
@@ -302,10 +303,28 @@ size_t graph_file_read_kmer(FILE *fh, const GraphFileHeader *h, const char *path
   // Check edges => coverage
   for(i = 0; i < h->num_of_cols && (!edges[i] || covgs[i]); i++) {}
   if(i < h->num_of_cols && !greader_missing_covg_error) {
-    binary_kmer_to_str(*bkmer, h->kmer_size, kstr);
+    binary_kmer_to_str(bkmer, h->kmer_size, kstr);
     warn("Kmer has edges but no coverage [kmer: %s; path: %s]", kstr, path);
     greader_missing_covg_error = true;
   }
+}
+
+size_t graph_file_read_kmer(FILE *fh, const GraphFileHeader *h, const char *path,
+                            BinaryKmer *bkmer, Covg *covgs, Edges *edges)
+{
+  size_t num_bytes_read;
+
+  num_bytes_read = fread(bkmer->b, 1, sizeof(BinaryKmer), fh);
+
+  if(num_bytes_read == 0) return 0;
+  if(num_bytes_read != sizeof(uint64_t)*h->num_of_bitfields)
+    die("Unexpected end of file: %s", path);
+
+  safe_fread(fh, covgs, h->num_of_cols * sizeof(uint32_t), "Coverages", path);
+  safe_fread(fh, edges, h->num_of_cols * sizeof(uint8_t), "Edges", path);
+  num_bytes_read += h->num_of_cols * (sizeof(uint32_t) + sizeof(uint8_t));
+
+  graph_file_check_kmer(h, path, *bkmer, covgs, edges);
 
   return num_bytes_read;
 }
@@ -326,6 +345,318 @@ static void graph_loading_print_status(const GraphFileReader *file)
   }
 }
 
+// Add a kmer to the graph, covgs and edges have already been aligned to the
+// colours they are updating i.e. covgs[i] -> colour i in the graph
+// If bktlocks is not NULL, we may be called by multiple threads at once
+// Returns true if the kmer was loaded
+static inline bool graph_load_kmer(const GraphLoadingPrefs *prefs,
+                                   const BinaryKmer bkmer,
+                                   Covg *covgs, Edges *edges, size_t ncols,
+                                   volatile uint8_t *bktlocks)
+{
+  dBGraph *graph = prefs->db_graph;
+  size_t i;
+
+  // If kmer has no covg or edges -> don't load
+  Covg keep_kmer = 0;
+  for(i = 0; i < ncols; i++) keep_kmer |= covgs[i] | edges[i];
+  if(keep_kmer == 0) return false;
+
+  if(prefs->boolean_covgs)
+    for(i = 0; i < ncols; i++)
+      covgs[i] = covgs[i] > 0;
+
+  // Fetch node in the de bruijn graph
+  hkey_t node;
+
+  if(prefs->must_exist_in_graph)
+  {
+    node = hash_table_find(&graph->ht, bkmer);
+    if(node == HASH_NOT_FOUND) return false;
+
+    // Edges union_edges = db_node_get_edges_union(graph, node);
+    Edges union_edges = prefs->must_exist_in_edges[node];
+
+    for(i = 0; i < ncols; i++) edges[i] &= union_edges;
+  }
+  else
+  {
+    bool found;
+    if(bktlocks != NULL)
+      node = hash_table_find_or_insert_mt(&graph->ht, bkmer, &found, bktlocks);
+    else
+      node = hash_table_find_or_insert(&graph->ht, bkmer, &found);
+
+    if(prefs->empty_colours && found)
+      die("Duplicate kmer loaded");
+  }
+
+  // Set presence in colours
+  if(graph->node_in_cols != NULL) {
+    for(i = 0; i < ncols; i++) {
+      if(bktlocks == NULL) db_node_or_col(graph, node, i, (covgs[i] || edges[i]));
+      else if(covgs[i] || edges[i]) db_node_set_col_mt(graph, node, i);
+    }
+  }
+
+  if(graph->col_covgs != NULL) {
+    for(i = 0; i < ncols; i++) {
+      if(bktlocks == NULL) db_node_add_col_covg(graph, node, i, covgs[i]);
+      else if(covgs[i]) db_node_add_col_covg_mt(graph, node, i, covgs[i]);
+    }
+  }
+
+  // Merge all edges into one colour
+  if(graph->col_edges != NULL)
+  {
+    Edges *col_edges = &db_node_edges(graph, node, 0);
+
+    if(graph->num_edge_cols == 1) {
+      Edges union_edges = 0;
+      for(i = 0; i < ncols; i++) union_edges |= edges[i];
+      if(bktlocks == NULL) col_edges[0] |= union_edges;
+      else if(union_edges) (void)__sync_or_and_fetch(col_edges, union_edges);
+    }
+    else {
+      for(i = 0; i < ncols; i++) {
+        if(bktlocks == NULL) col_edges[i] |= edges[i];
+        else if(edges[i]) (void)__sync_or_and_fetch(&col_edges[i], edges[i]);
+      }
+    }
+  }
+
+  return true;
+}
+
+// Load kmers one at a time on the calling thread
+// Returns number of kmers loaded, sets *nkmers_parsed_ptr
+static size_t graph_load_kmers(GraphFileReader *file,
+                               const GraphLoadingPrefs *prefs,
+                               size_t *nkmers_parsed_ptr)
+{
+  size_t ncols = file_filter_into_ncols(&file->fltr);
+  size_t nkmers_parsed, num_of_kmers_loaded = 0;
+
+  // Read kmers, align colours to those they are updating
+  //  e.g. covgs[i] -> colour i in the graph
+  BinaryKmer bkmer;
+  Covg covgs[ncols];
+  Edges edges[ncols];
+
+  for(nkmers_parsed = 0;
+      graph_file_read_reset(file, ncols, &bkmer, covgs, edges);
+      nkmers_parsed++)
+  {
+    num_of_kmers_loaded += graph_load_kmer(prefs, bkmer, covgs, edges,
+                                           ncols, NULL);
+  }
+
+  *nkmers_parsed_ptr = nkmers_parsed;
+  return num_of_kmers_loaded;
+}
+
+//
+// Multithreaded graph loading
+//
+
+// Number of bytes read from the file into each block
+#define GLOAD_BLOCK_BYTES (1UL<<20)
+// Number of blocks in the pool per worker thread
+#define GLOAD_BLOCKS_PER_THREAD 4
+
+typedef struct
+{
+  char *buf; // only used if the file is not memory mapped
+  const char *data;
+  size_t nkmers;
+} GraphLoadBlock;
+
+typedef struct
+{
+  MsgPool *pool;
+  GraphFileReader *file;
+  size_t block_nkmers;
+} GraphLoadReader;
+
+typedef struct
+{
+  MsgPool *pool;
+  const GraphFileReader *file;
+  const GraphLoadingPrefs *prefs;
+  volatile uint8_t *bktlocks;
+  size_t kmer_bytes;
+  // Temporary memory for one kmer
+  Covg *kmercovgs, *covgs;
+  Edges *kmeredges, *edges;
+  // Results
+  size_t nkmers_parsed, nkmers_loaded;
+} GraphLoadWorker;
+
+static void graph_load_pool_init(void *el, size_t idx, void *args)
+{
+  GraphLoadBlock *blocks = (GraphLoadBlock*)args, *block = blocks + idx;
+  memcpy(el, &block, sizeof(GraphLoadBlock*));
+}
+
+// pthread method, loop: read a block of kmer records, add to pool
+// Memory mapped files are passed to workers without copying
+static void* graph_load_reader(void *arg)
+{
+  GraphLoadReader *rdr = (GraphLoadReader*)arg;
+  GraphLoadBlock *block;
+  int pos;
+
+  do
+  {
+    pos = msgpool_claim_write(rdr->pool);
+    memcpy(&block, msgpool_get_ptr(rdr->pool, pos), sizeof(GraphLoadBlock*));
+
+    block->nkmers = graph_file_read_records(rdr->file, block->buf,
+                                            rdr->block_nkmers, &block->data);
+
+    msgpool_release(rdr->pool, pos, block->nkmers ? MPOOL_FULL : MPOOL_EMPTY);
+  }
+  while(block->nkmers == rdr->block_nkmers);
+
+  if(ferror(rdr->file->fh))
+    die("Error reading file: %s", rdr->file->fltr.path.b);
+
+  msgpool_close(rdr->pool);
+  return NULL;
+}
+
+// Parse a kmer record, remap colours and add to the graph
+static inline bool graph_load_record(GraphLoadWorker *wrkr, const char *rec)
+{
+  const FileFilter *fltr = &wrkr->file->fltr;
+  const GraphFileHeader *hdr = &wrkr->file->hdr;
+  size_t i, from, into, ncols = file_filter_into_ncols(fltr);
+  BinaryKmer bkmer;
+
+  memcpy(bkmer.b, rec, sizeof(BinaryKmer));
+  rec += sizeof(BinaryKmer);
+  memcpy(wrkr->kmercovgs, rec, hdr->num_of_cols * sizeof(Covg));
+  rec += hdr->num_of_cols * sizeof(Covg);
+  memcpy(wrkr->kmeredges, rec, hdr->num_of_cols * sizeof(Edges));
+
+  graph_file_check_kmer(hdr, fltr->path.b, bkmer,
+                        wrkr->kmercovgs, wrkr->kmeredges);
+
+  memset(wrkr->covgs, 0, ncols * sizeof(Covg));
+  memset(wrkr->edges, 0, ncols * sizeof(Edges));
+
+  for(i = 0; i < file_filter_num(fltr); i++) {
+    from = file_filter_fromcol(fltr, i);
+    into = file_filter_intocol(fltr, i);
+    wrkr->covgs[into] = SAFE_ADD_COVG(wrkr->covgs[into], wrkr->kmercovgs[from]);
+    wrkr->edges[into] |= wrkr->kmeredges[from];
+  }
+
+  return graph_load_kmer(wrkr->prefs, bkmer, wrkr->covgs, wrkr->edges,
+                         ncols, wrkr->bktlocks);
+}
+
+// pthread method, loop: take a block from the pool, load its kmers
+static void graph_load_worker(void *arg)
+{
+  GraphLoadWorker *wrkr = (GraphLoadWorker*)arg;
+  GraphLoadBlock *block;
+  size_t i;
+  int pos;
+
+  while((pos = msgpool_claim_read(wrkr->pool)) != -1)
+  {
+    memcpy(&block, msgpool_get_ptr(wrkr->pool, pos), sizeof(GraphLoadBlock*));
+
+    for(i = 0; i < block->nkmers; i++) {
+      wrkr->nkmers_loaded += graph_load_record(wrkr, block->data +
+                                                     i * wrkr->kmer_bytes);
+    }
+    wrkr->nkmers_parsed += block->nkmers;
+
+    msgpool_release(wrkr->pool, pos, MPOOL_EMPTY);
+  }
+}
+
+// Load kmers with one reader thread and prefs->nthreads worker threads
+// Returns number of kmers loaded, sets *nkmers_parsed_ptr
+static size_t graph_load_kmers_mt(GraphFileReader *file,
+                                  const GraphLoadingPrefs *prefs,
+                                  size_t *nkmers_parsed_ptr)
+{
+  dBGraph *graph = prefs->db_graph;
+  const GraphFileHeader *hdr = &file->hdr;
+  size_t i, nthreads = prefs->nthreads;
+  size_t ncols = file_filter_into_ncols(&file->fltr);
+  size_t kmer_bytes = file->kmer_mem;
+  size_t block_nkmers = MAX2(GLOAD_BLOCK_BYTES / kmer_bytes, 1);
+  size_t nblocks = GLOAD_BLOCKS_PER_THREAD * nthreads;
+  int rc;
+
+  ctx_assert(sizeof(BinaryKmer) == hdr->num_of_bitfields * sizeof(uint64_t));
+
+  // Inserting from multiple threads requires bucket locks
+  uint8_t *bktlocks = graph->bktlocks;
+  if(bktlocks == NULL)
+    bktlocks = ctx_calloc(roundup_bits2bytes(graph->ht.num_of_buckets), 1);
+
+  GraphLoadBlock *blocks = ctx_calloc(nblocks, sizeof(GraphLoadBlock));
+  if(!graph_file_is_mmap(file)) {
+    for(i = 0; i < nblocks; i++)
+      blocks[i].buf = ctx_malloc(block_nkmers * kmer_bytes);
+  }
+
+  MsgPool pool;
+  msgpool_alloc(&pool, nblocks, sizeof(GraphLoadBlock*), USE_MSG_POOL);
+  msgpool_iterate(&pool, graph_load_pool_init, blocks);
+
+  GraphLoadWorker *workers = ctx_calloc(nthreads, sizeof(GraphLoadWorker));
+  for(i = 0; i < nthreads; i++) {
+    workers[i].pool = &pool;
+    workers[i].file = file;
+    workers[i].prefs = prefs;
+    workers[i].bktlocks = bktlocks;
+    workers[i].kmer_bytes = kmer_bytes;
+    workers[i].kmercovgs = ctx_malloc(hdr->num_of_cols * sizeof(Covg));
+    workers[i].kmeredges = ctx_malloc(hdr->num_of_cols * sizeof(Edges));
+    workers[i].covgs = ctx_malloc(ncols * sizeof(Covg));
+    workers[i].edges = ctx_malloc(ncols * sizeof(Edges));
+  }
+
+  GraphLoadReader reader = {.pool = &pool, .file = file,
+                            .block_nkmers = block_nkmers};
+
+  pthread_t reader_thread;
+  rc = pthread_create(&reader_thread, NULL, graph_load_reader, &reader);
+  if(rc != 0) die("Creating thread failed: %s", strerror(rc));
+
+  util_run_threads(workers, nthreads, sizeof(GraphLoadWorker),
+                   nthreads, graph_load_worker);
+
+  rc = pthread_join(reader_thread, NULL);
+  if(rc != 0) die("Joining thread failed: %s", strerror(rc));
+
+  size_t nkmers_parsed = 0, num_of_kmers_loaded = 0;
+
+  for(i = 0; i < nthreads; i++) {
+    nkmers_parsed += workers[i].nkmers_parsed;
+    num_of_kmers_loaded += workers[i].nkmers_loaded;
+    ctx_free(workers[i].kmercovgs);
+    ctx_free(workers[i].kmeredges);
+    ctx_free(workers[i].covgs);
+    ctx_free(workers[i].edges);
+  }
+
+  ctx_free(workers);
+  msgpool_dealloc(&pool);
+  for(i = 0; i < nblocks; i++) ctx_free(blocks[i].buf);
+  ctx_free(blocks);
+  if(bktlocks != graph->bktlocks) ctx_free(bktlocks);
+
+  *nkmers_parsed_ptr = nkmers_parsed;
+  return num_of_kmers_loaded;
+}
+
 // if only_load_if_in_colour is >= 0, only kmers with coverage in existing
 // colour only_load_if_in_colour will be loaded.
 // We assume only_load_if_in_colour < load_first_colour_into
@@ -354,8 +685,7 @@ size_t graph_load(GraphFileReader *file, const GraphLoadingPrefs prefs,
   // Print status
   graph_loading_print_status(file);
 
-  if(!file_filter_isstdin(fltr) && fseek(file->fh, file->hdr_size, SEEK_SET) != 0)
-    die("fseek failed: %s", strerror(errno));
+  if(!file_filter_isstdin(fltr)) graph_file_rewind(file);
 
   // Check we can load this graph file into db_graph (kmer size + num colours)
   if(hdr->kmer_size != graph->kmer_size)
@@ -380,79 +710,17 @@ size_t graph_load(GraphFileReader *file, const GraphLoadingPrefs prefs,
   // Update number of colours loaded
   graph->num_of_cols_used = MAX2(graph->num_of_cols_used, ncols_used);
 
-  // Read kmers, align colours to those they are updating
-  //  e.g. covgs[i] -> colour i in the graph
-  BinaryKmer bkmer;
-  Covg covgs[ncols_used];
-  Edges edges[ncols_used];
-
-  size_t nkmers_parsed, num_of_kmers_loaded = 0;
+  size_t nkmers_parsed = 0, num_of_kmers_loaded, nthreads = 1;
   uint64_t num_of_kmers_already_loaded = graph->ht.num_kmers;
 
-  for(nkmers_parsed = 0;
-      graph_file_read_reset(file, ncols_used, &bkmer, covgs, edges);
-      nkmers_parsed++)
-  {
-    // If kmer has no covg or edges -> don't load
-    Covg keep_kmer = 0;
-    for(i = 0; i < ncols_used; i++) keep_kmer |= covgs[i] | edges[i];
-    if(keep_kmer == 0) continue;
-
-    if(prefs.boolean_covgs)
-      for(i = 0; i < ncols_used; i++)
-        covgs[i] = covgs[i] > 0;
-
-    // Fetch node in the de bruijn graph
-    hkey_t node;
-
-    if(prefs.must_exist_in_graph)
-    {
-      node = hash_table_find(&graph->ht, bkmer);
-      if(node == HASH_NOT_FOUND) continue;
-
-      // Edges union_edges = db_node_get_edges_union(graph, node);
-      Edges union_edges = prefs.must_exist_in_edges[node];
-
-      for(i = 0; i < ncols_used; i++) edges[i] &= union_edges;
-    }
-    else
-    {
-      bool found;
-      node = hash_table_find_or_insert(&graph->ht, bkmer, &found);
-
-      if(prefs.empty_colours && found)
-        die("Duplicate kmer loaded");
-    }
-
-    // Set presence in colours
-    if(graph->node_in_cols != NULL) {
-      for(i = 0; i < ncols_used; i++) {
-        db_node_or_col(graph, node, i, (covgs[i] || edges[i]));
-      }
-    }
-
-    if(graph->col_covgs != NULL) {
-      for(i = 0; i < ncols_used; i++)
-        db_node_add_col_covg(graph, node, i, covgs[i]);
-    }
-
-    // Merge all edges into one colour
-    if(graph->col_edges != NULL)
-    {
-      Edges *col_edges = &db_node_edges(graph, node, 0);
-
-      if(graph->num_edge_cols == 1) {
-        for(i = 0; i < ncols_used; i++)
-          col_edges[0] |= edges[i];
-      }
-      else {
-        for(i = 0; i < ncols_used; i++)
-          col_edges[i] |= edges[i];
-      }
-    }
-
-    num_of_kmers_loaded++;
+  // Multithreaded loading needs kmer records to match our BinaryKmer, if they
+  // don't graph_file_read_kmer() reports the error
+  if(prefs.nthreads > 1 && hdr->num_of_bitfields == NUM_BKMER_WORDS) {
+    nthreads = prefs.nthreads;
+    num_of_kmers_loaded = graph_load_kmers_mt(file, &prefs, &nkmers_parsed);
   }
+  else
+    num_of_kmers_loaded = graph_load_kmers(file, &prefs, &nkmers_parsed);
 
   if(file->num_of_kmers >= 0 && nkmers_parsed != (uint64_t)file->num_of_kmers)
   {
@@ -477,8 +745,9 @@ size_t graph_load(GraphFileReader *file, const GraphLoadingPrefs prefs,
 
   ulong_to_str(num_of_kmers_loaded, loaded_nkmers_str);
   ulong_to_str(nkmers_parsed, parsed_nkmers_str);
-  status("[GReader] Loaded %s / %s (%.2f%%) of kmers parsed",
-         loaded_nkmers_str, parsed_nkmers_str, loaded_nkmers_pct);
+  status("[GReader] Loaded %s / %s (%.2f%%) of kmers parsed [%zu thread%s]",
+         loaded_nkmers_str, parsed_nkmers_str, loaded_nkmers_pct,
+         nthreads, util_plural_str(nthreads));
 
   return num_of_kmers_loaded;
 }
@@ -494,7 +763,7 @@ size_t graph_load(GraphFileReader *file, const GraphLoadingPrefs prefs,
 // input file. Reads in and dumps one kmer at a time
 // parameters:
 //   `only_load_if_in_edges`: Edges to mask edges with, 1 per hash table entry
-size_t graph_stream_filter(const char *out_ctx_path, const GraphFileReader *file,
+size_t graph_stream_filter(const char *out_ctx_path, GraphFileReader *file,
                            const dBGraph *db_graph, const GraphFileHeader *hdr,
                            const Edges *only_load_if_in_edges)
 {
@@ -547,7 +816,7 @@ size_t graph_stream_filter(const char *out_ctx_path, const GraphFileReader *file
   fclose(out);
 
   graph_writer_print_status(nodes_dumped, hdr->num_of_cols,
-                     out_ctx_path, CTX_GRAPH_FILEFORMAT);
+                     out_ctx_path, hdr->version);
 
   return nodes_dumped;
 }
@@ -758,6 +1027,148 @@ size_t graph_files_merge(const char *out_ctx_path,
   return db_graph->ht.num_kmers;
 }
 
+//
+// Streaming merge of sorted graph files
+//
+
+typedef struct
+{
+  GraphFileReader *file;
+  GraphFileRecord rec; // current kmer record, valid until next read
+  BinaryKmer bkmer; // current kmer
+} GraphMergeInput;
+
+// Load the next kmer from an input, returns false at the end of the file
+static inline bool merge_input_fetch(GraphMergeInput *in)
+{
+  BinaryKmer prev = in->bkmer;
+  if(!graph_file_read_record(in->file, &in->rec)) return false;
+  in->bkmer = graph_file_record_bkmer(&in->rec);
+  if(binary_kmer_less_than(in->bkmer, prev)) {
+    die("Graph file is not sorted: %s", file_filter_path(&in->file->fltr));
+  }
+  return true;
+}
+
+// Add the current kmer of an input to output colours
+static inline void merge_input_add(const GraphMergeInput *in,
+                                   Covg *covgs, Edges *edges)
+{
+  const FileFilter *fltr = &in->file->fltr;
+  size_t i, from, into;
+  for(i = 0; i < file_filter_num(fltr); i++) {
+    from = file_filter_fromcol(fltr, i);
+    into = file_filter_intocol(fltr, i);
+    covgs[into] = SAFE_ADD_COVG(covgs[into], graph_file_record_covg(&in->rec, from));
+    edges[into] |= in->rec.edges[from];
+  }
+}
+
+#define merge_input_lt(ins,i,j) binary_kmer_less_than(ins[i].bkmer, ins[j].bkmer)
+
+// Min-heap of input indices
+static inline void merge_heap_sift_down(const GraphMergeInput *ins,
+                                        size_t *heap, size_t n, size_t i)
+{
+  size_t c, tmp;
+  while((c = 2*i+1) < n) {
+    if(c+1 < n && merge_input_lt(ins, heap[c+1], heap[c])) c++;
+    if(!merge_input_lt(ins, heap[c], heap[i])) break;
+    tmp = heap[i]; heap[i] = heap[c]; heap[c] = tmp;
+    i = c;
+  }
+}
+
+// Returns true if all files are sorted (see graph_file_is_sorted())
+bool graph_files_are_sorted(const GraphFileReader *files, size_t num_files)
+{
+  size_t i;
+  for(i = 0; i < num_files; i++)
+    if(!graph_file_is_sorted(&files[i])) return false;
+  return true;
+}
+
+size_t graph_files_merge_sorted(const char *out_ctx_path,
+                                GraphFileReader *files, size_t num_files,
+                                const GraphFileHeader *hdr)
+{
+  size_t i, n, nodes_dumped = 0, ncols = hdr->num_of_cols;
+
+  for(i = 0; i < num_files; i++) {
+    ctx_assert(file_filter_into_ncols(&files[i].fltr) <= ncols);
+    if(files[i].hdr.kmer_size != hdr->kmer_size) {
+      die("Kmer-size mismatch %u vs %u [%s]", hdr->kmer_size,
+          files[i].hdr.kmer_size, files[i].fltr.path.b);
+    }
+  }
+
+  status("Merging %zu sorted graph files into %s with streaming merge",
+         num_files, futil_outpath_str(out_ctx_path));
+
+  FILE *out = futil_fopen(out_ctx_path, "w");
+  size_t hdr_size = graph_write_header(out, hdr);
+
+  bool compress = (hdr->version == CTX_GRAPH_FILEFORMAT_BLOCKS);
+  GraphBlockWriter blkwtr;
+  if(compress) graph_blocks_writer_alloc(&blkwtr, out, hdr_size, ncols);
+
+  GraphMergeInput *ins = ctx_calloc(num_files, sizeof(GraphMergeInput));
+  size_t *heap = ctx_malloc(num_files * sizeof(size_t));
+
+  for(i = n = 0; i < num_files; i++) {
+    graph_loading_print_status(&files[i]);
+    ins[i].file = &files[i];
+    ins[i].bkmer = zero_bkmer;
+    if(merge_input_fetch(&ins[i])) heap[n++] = i;
+  }
+
+  for(i = n/2; i > 0; i--) merge_heap_sift_down(ins, heap, n, i-1);
+
+  BinaryKmer bkmer;
+  Covg covgs[ncols];
+  Edges edges[ncols];
+
+  while(n > 0)
+  {
+    bkmer = ins[heap[0]].bkmer;
+    memset(covgs, 0, ncols * sizeof(Covg));
+    memset(edges, 0, ncols * sizeof(Edges));
+
+    // Combine this kmer from all inputs
+    do {
+      merge_input_add(&ins[heap[0]], covgs, edges);
+      if(!merge_input_fetch(&ins[heap[0]])) heap[0] = heap[--n];
+      merge_heap_sift_down(ins, heap, n, 0);
+    }
+    while(n > 0 && binary_kmers_are_equal(ins[heap[0]].bkmer, bkmer));
+
+    // If kmer has no covg or edges -> don't write
+    Covg keep_kmer = 0;
+    for(i = 0; i < ncols; i++) keep_kmer |= covgs[i] | edges[i];
+
+    if(keep_kmer) {
+      if(compress) graph_blocks_write_kmer(&blkwtr, bkmer, covgs, edges);
+      else graph_write_kmer(out, hdr->num_of_bitfields, ncols, bkmer, covgs, edges);
+      nodes_dumped++;
+    }
+  }
+
+  if(compress) {
+    graph_blocks_writer_finish(&blkwtr);
+    graph_blocks_writer_dealloc(&blkwtr);
+  }
+
+  ctx_free(ins);
+  ctx_free(heap);
+
+  fflush(out);
+  fclose(out);
+
+  graph_writer_print_status(nodes_dumped, ncols, out_ctx_path, hdr->version);
+
+  return nodes_dumped;
+}
+
 // if intersect_gname != NULL: only load kmers that are already in the hash table
 //    and use string as name for cleaning against
 // returns the number of kmers written
@@ -145,6 +145,24 @@ static inline void _gw_gseg_update(GraphWalker *wlk,
   first->num_nodes += num_nodes;
 }
 
+// Add a path with the right orientation if it is in the colour we are using
+static inline void _pickup_path(GPathFollowBuffer *pbuf, const GPath *gpath,
+                                size_t ncols, size_t ctpcol,
+                                bool cntr_filter_nuc0, Nucleotide next_nuc)
+{
+  if(gpath_has_colour(gpath, ncols, ctpcol))
+  {
+    GPathFollow fpath = gpath_follow_create(gpath);
+
+    if(!cntr_filter_nuc0) gpath_follow_buf_add(pbuf, fpath);
+    else if(gpath_follow_get_base(&fpath, 0) == next_nuc) {
+      // Loading a counter path at a fork
+      fpath.pos++; // already took a base
+      gpath_follow_buf_add(pbuf, fpath);
+    }
+  }
+}
+
 // Returns number of paths picked up
 // next_nuc only used if counter == true and node has out-degree > 1
 static inline size_t pickup_paths(GraphWalker *wlk, dBNode node,
@@ -165,20 +183,26 @@ static inline size_t pickup_paths(GraphWalker *wlk, dBNode node,
   bool cntr_filter_nuc0
     = (counter && db_node_outdegree_in_col(node, wlk->ctxcol, db_graph) > 1);
 
-  GPath *gpath = gpath_store_fetch_traverse(gpstore, node.key);
+  GPath *gpath;
+  size_t i, n;
 
-  for(; gpath != NULL; gpath = gpath->next)
+  if(gpath_store_is_compact(gpstore))
   {
-    if(node.orient == gpath->orient && gpath_has_colour(gpath, ncols, wlk->ctpcol))
-    {
-      GPathFollow fpath = gpath_follow_create(gpath);
-
-      if(!cntr_filter_nuc0) gpath_follow_buf_add(pbuf, fpath);
-      else if(gpath_follow_get_base(&fpath, 0) == next_nuc) {
-        // Loading a counter path at a fork
-        fpath.pos++; // already took a base
-        gpath_follow_buf_add(pbuf, fpath);
-      }
+    // Paths are sorted by orientation, scan the range for node.orient
+    gpath = gpath_store_fetch_range(gpstore, node.key, &n);
+    for(i = 0; i < n && gpath[i].orient <= node.orient; i++) {
+      if(gpath[i].orient == node.orient)
+        _pickup_path(pbuf, &gpath[i], ncols, wlk->ctpcol,
+                     cntr_filter_nuc0, next_nuc);
+    }
+  }
+  else
+  {
+    gpath = gpath_store_fetch_traverse(gpstore, node.key);
+    for(; gpath != NULL; gpath = gpath->next) {
+      if(gpath->orient == node.orient)
+        _pickup_path(pbuf, gpath, ncols, wlk->ctpcol,
+                     cntr_filter_nuc0, next_nuc);
     }
   }
 
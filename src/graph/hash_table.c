@@ -6,12 +6,74 @@
 // bit macros from BitArray library used for spinlocking
 #include "bit_array/bit_macros.h"
 
+#ifdef USE_HASH_FPRINT
+  #if defined(__AVX2__) || defined(__SSE2__)
+    #include <immintrin.h>
+  #endif
+#endif
+
 // Hash table prefetching doesn't appear to be faster
 #define HASH_PREFETCH 1
 
+// Number of keys ahead to hash and prefetch in batch lookups, power of two
+#define HT_BATCH_PREFETCH 16
+
 static const BinaryKmer unset_bkmer = {.b = {UNSET_BKMER_WORD}};
 
 #define ht_bckt_ptr(ht,bckt) ((ht)->table + (size_t)bckt * (ht)->bucket_size)
+#define ht_hash(ht,key,i) (binary_kmer_hash(key,(ht)->seed+(i)) & (ht)->hash_mask)
+
+// Prefetch bucket metadata and entries, rw is 0 for read, 1 for write
+#define ht_prefetch(ht,bckt,rw) do { \
+  __builtin_prefetch(&(ht)->buckets[bckt], rw, 1); \
+  __builtin_prefetch(ht_bckt_ptr(ht, bckt), rw, 1); \
+} while(0)
+
+#ifdef USE_HASH_FPRINT
+
+// Fingerprints and bucket sizes must fit in the bucket metadata
+#if MAX_BUCKET_SIZE + 2 > HT_BKT_BYTES
+  #error MAX_BUCKET_SIZE too large for fingerprints
+#endif
+
+// Fingerprint byte for a kmer, independent of the bucket hash. Never zero.
+static inline uint8_t ht_fprint(const BinaryKmer bkmer)
+{
+  uint64_t h = bkmer.b[0];
+  size_t i;
+  for(i = 1; i < NUM_BKMER_WORDS; i++) h = (h * 0x9E3779B97F4A7C15UL) ^ bkmer.b[i];
+  h = (h * 0x9E3779B97F4A7C15UL) >> 56;
+  return h ? (uint8_t)h : 1;
+}
+
+// Compare HT_FPRINT_VEC fingerprints at once, returns bitmask of matches
+#if defined(__AVX2__)
+  #define HT_FPRINT_VEC 32
+  static inline uint64_t ht_fprint_match(const uint8_t *fprints, uint8_t fp)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i*)fprints);
+    __m256i m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)fp));
+    return (uint32_t)_mm256_movemask_epi8(m);
+  }
+#elif defined(__SSE2__)
+  #define HT_FPRINT_VEC 16
+  static inline uint64_t ht_fprint_match(const uint8_t *fprints, uint8_t fp)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)fprints);
+    __m128i m = _mm_cmpeq_epi8(v, _mm_set1_epi8((char)fp));
+    return (uint16_t)_mm_movemask_epi8(m);
+  }
+#else
+  #define HT_FPRINT_VEC 8
+  static inline uint64_t ht_fprint_match(const uint8_t *fprints, uint8_t fp)
+  {
+    uint64_t i, m = 0;
+    for(i = 0; i < HT_FPRINT_VEC; i++) m |= (uint64_t)(fprints[i] == fp) << i;
+    return m;
+  }
+#endif
+
+#endif /* USE_HASH_FPRINT */
 
 void hash_table_alloc(HashTable *ht, uint64_t req_capacity)
 {
@@ -22,7 +84,7 @@ void hash_table_alloc(HashTable *ht, uint64_t req_capacity)
   uint_fast32_t hash_mask = (uint_fast32_t)(num_of_buckets - 1);
 
   size_t mem = capacity * sizeof(BinaryKmer) +
-               num_of_buckets * sizeof(uint8_t[2]);
+               num_of_buckets * HT_BKT_BYTES;
 
   char num_bkts_str[100], bkt_size_str[100], cap_str[100], mem_str[100];
   ulong_to_str(num_of_buckets, num_bkts_str);
@@ -35,7 +97,16 @@ void hash_table_alloc(HashTable *ht, uint64_t req_capacity)
   // calloc is required for bucket_data to set the first element of each bucket
   // to the 0th pos
   BinaryKmer *table = ctx_malloc(capacity * sizeof(BinaryKmer));
-  uint8_t (*const buckets)[2] = ctx_calloc(num_of_buckets, sizeof(uint8_t[2]));
+
+  #ifdef USE_HASH_FPRINT
+    // Align bucket metadata to cache lines
+    void *bkts_mem = ctx_calloc(num_of_buckets+1, HT_BKT_BYTES);
+    uint8_t (*const buckets)[HT_BKT_BYTES]
+      = (void*)(((uintptr_t)bkts_mem + HT_BKT_BYTES-1) & ~(uintptr_t)(HT_BKT_BYTES-1));
+  #else
+    uint8_t (*const buckets)[HT_BKT_BYTES] = ctx_calloc(num_of_buckets,
+                                                        HT_BKT_BYTES);
+  #endif
 
   size_t i;
   for(i = 0; i < capacity; i++) table[i] = unset_bkmer;
@@ -47,6 +118,9 @@ void hash_table_alloc(HashTable *ht, uint64_t req_capacity)
     .bucket_size = bucket_size,
     .capacity = capacity,
     .buckets = buckets,
+    #ifdef USE_HASH_FPRINT
+      .bkts_mem = bkts_mem,
+    #endif
     .num_kmers = 0,
     .collisions = {0},
     .seed = rand()};
@@ -56,8 +130,13 @@ void hash_table_alloc(HashTable *ht, uint64_t req_capacity)
 
 void hash_table_dealloc(HashTable *hash_table)
 {
+  if(hash_table->num_kmers > 0) hash_table_record_probes(hash_table);
   ctx_free(hash_table->table);
-  ctx_free(hash_table->buckets);
+  #ifdef USE_HASH_FPRINT
+    ctx_free(hash_table->bkts_mem);
+  #else
+    ctx_free(hash_table->buckets);
+  #endif
 }
 
 void hash_table_empty(HashTable *const ht)
@@ -65,7 +144,7 @@ void hash_table_empty(HashTable *const ht)
   size_t i;
   BinaryKmer *table = ht->table;
   for(i = 0; i < ht->capacity; i++) table[i] = unset_bkmer;
-  memset(ht->buckets, 0, ht->num_of_buckets * sizeof(uint8_t[2]));
+  memset(ht->buckets, 0, ht->num_of_buckets * HT_BKT_BYTES);
 
   HashTable data = {
     .table = ht->table,
@@ -74,6 +153,9 @@ void hash_table_empty(HashTable *const ht)
     .bucket_size = ht->bucket_size,
     .capacity = ht->capacity,
     .buckets = ht->buckets,
+    #ifdef USE_HASH_FPRINT
+      .bkts_mem = ht->bkts_mem,
+    #endif
     .num_kmers = 0,
     .collisions = {0}};
 
@@ -85,13 +167,31 @@ static inline const BinaryKmer* hash_table_find_in_bucket_mt(const HashTable *co
                                                              const BinaryKmer bkmer)
 {
   const BinaryKmer *ptr = ht_bckt_ptr(ht, bucket);
-  const BinaryKmer *end = ptr + *(volatile __typeof(ht->buckets[0][0])*)&ht->buckets[bucket][HT_BSIZE];
+  const size_t bsize = *(volatile __typeof(ht->buckets[0][0])*)&ht->buckets[bucket][HT_BSIZE];
+
+  #ifdef USE_HASH_FPRINT
+    // Only compare kmers where the fingerprint matches
+    const uint8_t fp = ht_fprint(bkmer), *fprints = ht->buckets[bucket];
+    uint64_t matches;
+    size_t i, j;
+
+    for(i = 0; i < bsize; i += HT_FPRINT_VEC) {
+      matches = ht_fprint_match(fprints + i, fp);
+      if(bsize - i < HT_FPRINT_VEC) matches &= (1UL << (bsize - i)) - 1;
+      for(; matches; matches &= matches - 1) {
+        j = i + (size_t)__builtin_ctzl(matches);
+        BinaryKmer tgt = *(volatile const BinaryKmer*)(ptr + j);
+        if(binary_kmers_are_equal(bkmer, tgt)) return ptr + j;
+      }
+    }
+  #else
+    const BinaryKmer *end = ptr + bsize;
+    for(; ptr < end; ptr++) {
+      BinaryKmer tgt = *(volatile const BinaryKmer*)ptr;
+      if(binary_kmers_are_equal(bkmer, tgt)) return ptr;
+    }
+  #endif
 
-  while(ptr < end) {
-    BinaryKmer tgt = *(volatile BinaryKmer*)ptr;
-    if(binary_kmers_are_equal(bkmer, tgt)) return ptr;
-    ptr++;
-  }
   return NULL; // Not found
 }
 
@@ -151,6 +251,9 @@ static inline BinaryKmer* hash_table_insert_in_bucket(HashTable *ht,
   }
 
   *ptr = bkmer;
+  #ifdef USE_HASH_FPRINT
+    ht->buckets[bucket][ptr - ht_bckt_ptr(ht, bucket)] = ht_fprint(bkmer);
+  #endif
   ht->buckets[bucket][HT_BITEMS]++;
   return ptr;
 }
@@ -161,37 +264,73 @@ static inline BinaryKmer* hash_table_insert_in_bucket(HashTable *ht,
   die("Hash table is full"); \
 } while(0)
 
-hkey_t hash_table_find(const HashTable *const ht, const BinaryKmer key)
+// h2 is the bucket from the first hash i.e. ht_hash(ht,key,0)
+static inline hkey_t _hash_table_find(const HashTable *const ht,
+                                      const BinaryKmer key, uint_fast32_t h2)
 {
   const BinaryKmer *ptr;
   size_t i;
   uint_fast32_t h;
 
-  #ifdef HASH_PREFETCH
-    uint_fast32_t h2 = binary_kmer_hash(key,ht->seed+0) & ht->hash_mask;
-    __builtin_prefetch(ht_bckt_ptr(ht, h2), 0, 1);
-  #endif
-
   for(i = 0; i < REHASH_LIMIT; i++)
   {
     #ifdef HASH_PREFETCH
       h = h2;
       if(ht->buckets[h][HT_BSIZE] == ht->bucket_size) {
-        h2 = binary_kmer_hash(key,ht->seed+i+1) & ht->hash_mask;
+        h2 = ht_hash(ht, key, i+1);
         __builtin_prefetch(ht_bckt_ptr(ht, h2), 0, 1);
       }
     #else
-      h = binary_kmer_hash(key,ht->seed+i) & ht->hash_mask;
+      h = i ? ht_hash(ht, key, i) : h2;
     #endif
 
     ptr = hash_table_find_in_bucket_mt(ht, h, key);
     if(ptr != NULL) return (hkey_t)(ptr - ht->table);
     if(ht->buckets[h][HT_BSIZE] < ht->bucket_size) return HASH_NOT_FOUND;
+
+    #ifdef HASH_PREFETCH
+      // Bucket may have been filled by another thread after we checked it
+      // above, in which case h2 was not moved on to the next bucket
+      h2 = ht_hash(ht, key, i+1);
+    #endif
   }
 
   rehash_error_exit(ht);
 }
 
+hkey_t hash_table_find(const HashTable *const ht, const BinaryKmer key)
+{
+  uint_fast32_t h = ht_hash(ht, key, 0);
+
+  #ifdef HASH_PREFETCH
+    __builtin_prefetch(ht_bckt_ptr(ht, h), 0, 1);
+  #endif
+
+  return _hash_table_find(ht, key, h);
+}
+
+void hash_table_find_batch(const HashTable *const ht, const BinaryKmer *keys,
+                           size_t n, hkey_t *hkeys)
+{
+  uint_fast32_t h, hashes[HT_BATCH_PREFETCH];
+  size_t i, j;
+
+  for(i = 0; i < n && i < HT_BATCH_PREFETCH; i++) {
+    hashes[i] = ht_hash(ht, keys[i], 0);
+    ht_prefetch(ht, hashes[i], 0);
+  }
+
+  for(i = 0; i < n; i++) {
+    j = i & (HT_BATCH_PREFETCH-1);
+    h = hashes[j];
+    if(i + HT_BATCH_PREFETCH < n) {
+      hashes[j] = ht_hash(ht, keys[i+HT_BATCH_PREFETCH], 0);
+      ht_prefetch(ht, hashes[j], 0);
+    }
+    hkeys[i] = _hash_table_find(ht, keys[i], h);
+  }
+}
+
 // This methods inserts an element in the next available bucket
 // It doesn't check whether another element with the same key is present in the
 // table used for fast loading when it is known that all the elements in the
@@ -217,6 +356,34 @@ hkey_t hash_table_insert(HashTable *const ht, const BinaryKmer key)
   rehash_error_exit(ht);
 }
 
+// Threadsafe version of hash_table_insert(), using bucket level locks
+// Key must not already be in the table
+hkey_t hash_table_insert_mt(HashTable *const ht, const BinaryKmer key,
+                            volatile uint8_t *bktlocks)
+{
+  const BinaryKmer *ptr;
+  size_t i;
+  uint_fast32_t h;
+
+  for(i = 0; i < REHASH_LIMIT; i++)
+  {
+    h = ht_hash(ht, key, i);
+    bitlock_yield_acquire(bktlocks, h);
+
+    if(ht->buckets[h][HT_BITEMS] < ht->bucket_size) {
+      ptr = hash_table_insert_in_bucket(ht, h, key);
+      bitlock_release(bktlocks, h);
+      __sync_add_and_fetch((volatile uint64_t*)&ht->collisions[i], 1);
+      __sync_add_and_fetch((volatile uint64_t*)&ht->num_kmers, 1);
+      return (hkey_t)(ptr - ht->table);
+    }
+
+    bitlock_release(bktlocks, h);
+  }
+
+  rehash_error_exit(ht);
+}
+
 hkey_t hash_table_find_or_insert(HashTable *ht, const BinaryKmer key,
                                  bool *found)
 {
@@ -259,28 +426,26 @@ hkey_t hash_table_find_or_insert(HashTable *ht, const BinaryKmer key,
   rehash_error_exit(ht);
 }
 
-hkey_t hash_table_find_or_insert_mt(HashTable *ht, const BinaryKmer key,
-                                    bool *found, volatile uint8_t *bktlocks)
+// h2 is the bucket from the first hash i.e. ht_hash(ht,key,0)
+static inline hkey_t _hash_table_find_or_insert_mt(HashTable *ht,
+                                                   const BinaryKmer key,
+                                                   uint_fast32_t h2, bool *found,
+                                                   volatile uint8_t *bktlocks)
 {
   const BinaryKmer *ptr;
   size_t i;
   uint_fast32_t h;
 
-  #ifdef HASH_PREFETCH
-    uint_fast32_t h2 = binary_kmer_hash(key,ht->seed+0) & ht->hash_mask;
-    __builtin_prefetch(ht_bckt_ptr(ht, h2), 0, 1);
-  #endif
-
   for(i = 0; i < REHASH_LIMIT; i++)
   {
     #ifdef HASH_PREFETCH
       h = h2;
       if(ht->buckets[h][HT_BSIZE] == ht->bucket_size) {
-        h2 = binary_kmer_hash(key,ht->seed+i+1) & ht->hash_mask;
+        h2 = ht_hash(ht, key, i+1);
         __builtin_prefetch(ht_bckt_ptr(ht, h2), 0, 1);
       }
     #else
-      h = binary_kmer_hash(key,ht->seed+i) & ht->hash_mask;
+      h = i ? ht_hash(ht, key, i) : h2;
     #endif
 
     bitlock_yield_acquire(bktlocks, h);
@@ -305,12 +470,52 @@ hkey_t hash_table_find_or_insert_mt(HashTable *ht, const BinaryKmer key,
     }
     else {
       bitlock_release(bktlocks, h);
+      #ifdef HASH_PREFETCH
+        // Filled since we checked its size, see _hash_table_find()
+        h2 = ht_hash(ht, key, i+1);
+      #endif
     }
   }
 
   rehash_error_exit(ht);
 }
 
+hkey_t hash_table_find_or_insert_mt(HashTable *ht, const BinaryKmer key,
+                                    bool *found, volatile uint8_t *bktlocks)
+{
+  uint_fast32_t h = ht_hash(ht, key, 0);
+
+  #ifdef HASH_PREFETCH
+    __builtin_prefetch(ht_bckt_ptr(ht, h), 0, 1);
+  #endif
+
+  return _hash_table_find_or_insert_mt(ht, key, h, found, bktlocks);
+}
+
+void hash_table_find_or_insert_batch_mt(HashTable *ht, const BinaryKmer *keys,
+                                        size_t n, hkey_t *hkeys, bool *found,
+                                        volatile uint8_t *bktlocks)
+{
+  uint_fast32_t h, hashes[HT_BATCH_PREFETCH];
+  size_t i, j;
+
+  for(i = 0; i < n && i < HT_BATCH_PREFETCH; i++) {
+    hashes[i] = ht_hash(ht, keys[i], 0);
+    ht_prefetch(ht, hashes[i], 1);
+  }
+
+  for(i = 0; i < n; i++) {
+    j = i & (HT_BATCH_PREFETCH-1);
+    h = hashes[j];
+    if(i + HT_BATCH_PREFETCH < n) {
+      hashes[j] = ht_hash(ht, keys[i+HT_BATCH_PREFETCH], 0);
+      ht_prefetch(ht, hashes[j], 1);
+    }
+    hkeys[i] = _hash_table_find_or_insert_mt(ht, keys[i], h, &found[i],
+                                             bktlocks);
+  }
+}
+
 // Safe to call on different entries at the same time
 // NOT safe to do find() whilst doing delete()
 void hash_table_delete(HashTable *const ht, hkey_t pos)
@@ -323,6 +528,9 @@ void hash_table_delete(HashTable *const ht, hkey_t pos)
   ctx_assert(HASH_ENTRY_ASSIGNED(ht->table[pos]));
 
   ht->table[pos] = unset_bkmer;
+  #ifdef USE_HASH_FPRINT
+    ht->buckets[bucket][pos % ht->bucket_size] = 0;
+  #endif
   __sync_fetch_and_sub((volatile uint8_t *)&ht->buckets[bucket][HT_BITEMS], 1);
   __sync_fetch_and_sub((volatile uint64_t *)&ht->num_kmers, 1);
 
@@ -334,7 +542,7 @@ void hash_table_print_stats_brief(const HashTable *const ht)
   size_t nbytes, nkeybits;
   double occupancy = (100.0 * ht->num_kmers) / ht->capacity;
   nbytes = ht->capacity * sizeof(BinaryKmer) +
-           ht->num_of_buckets * sizeof(uint8_t[2]);
+           ht->num_of_buckets * HT_BKT_BYTES;
   nkeybits = (size_t)__builtin_ctzl(ht->num_of_buckets);
 
   char mem_str[50], num_buckets_str[100], num_entries_str[100], capacity_str[100];
@@ -363,6 +571,10 @@ void hash_table_print_stats(const HashTable *const ht)
   }
 }
 
+void hash_table_record_probes(const HashTable *const ht)
+{
+  ctx_prof_set_hist("hash_table_probes", ht->collisions, REHASH_LIMIT);
+}
 
 static inline void increment_count(hkey_t hkey, uint64_t *count)
 {
@@ -4,12 +4,19 @@
 #include <inttypes.h>
 
 #include "hash_mem.h"
+#include "util.h"
 #include "binary_kmer.h"
 
 #define UNSET_BKMER_WORD (1UL<<63)
 
-#define HT_BSIZE 0
-#define HT_BITEMS 1
+#ifdef USE_HASH_FPRINT
+  // buckets[b][0..MAX_BUCKET_SIZE-1] are fingerprints of entries, 0 if empty
+  #define HT_BSIZE MAX_BUCKET_SIZE
+  #define HT_BITEMS (MAX_BUCKET_SIZE+1)
+#else
+  #define HT_BSIZE 0
+  #define HT_BITEMS 1
+#endif
 
 #define HASH_NOT_FOUND (UINT64_MAX>>1)
 #define HASH_ENTRY_ASSIGNED(bkmer) (!((bkmer).b[0] & UNSET_BKMER_WORD))
@@ -22,9 +29,12 @@ typedef struct
   const uint_fast32_t hash_mask; // this is num_of_buckets - 1
   const uint8_t bucket_size; // max value 255
   const uint64_t capacity; // num_of_buckets * bucket_size
-  // buckets[b][0] is the size of the bucket (can only increase)
-  // buckets[b][1] is the number of filled entries in a bucket (can go up/down)
-  uint8_t (*const buckets)[2];
+  // buckets[b][HT_BSIZE] is the size of the bucket (can only increase)
+  // buckets[b][HT_BITEMS] is the number of filled entries in a bucket (can go up/down)
+  uint8_t (*const buckets)[HT_BKT_BYTES];
+  #ifdef USE_HASH_FPRINT
+    void *const bkts_mem; // allocated memory, buckets is aligned to a cache line
+  #endif
   uint64_t num_kmers;
   uint64_t collisions[REHASH_LIMIT];
   const uint32_t seed; // random seed used in hashing
@@ -39,10 +49,26 @@ hkey_t hash_table_insert(HashTable *const htable, const BinaryKmer bkmer);
 hkey_t hash_table_find_or_insert(HashTable *htable, const BinaryKmer bkmer,
                                  bool *found);
 
+// Threadsafe insert of a key that is not already in the table,
+// using bucket level locks
+hkey_t hash_table_insert_mt(HashTable *const htable, const BinaryKmer bkmer,
+                            volatile uint8_t *bktlocks);
+
 // Threadsafe find or insert, using bucket level locks
 hkey_t hash_table_find_or_insert_mt(HashTable *htable, const BinaryKmer key,
                                     bool *found, volatile uint8_t *bktlocks);
 
+// Batch versions of find and find_or_insert_mt. Hashes are computed and
+// buckets prefetched for keys ahead of the one being looked up, to hide
+// memory latency. Results are the same as calling per key, in order.
+void hash_table_find_batch(const HashTable *const htable,
+                           const BinaryKmer *keys, size_t n, hkey_t *hkeys);
+
+void hash_table_find_or_insert_batch_mt(HashTable *htable,
+                                        const BinaryKmer *keys, size_t n,
+                                        hkey_t *hkeys, bool *found,
+                                        volatile uint8_t *bktlocks);
+
 // Safe to call on different entries at the same time
 // NOT safe to do find() whilst doing delete()
 void hash_table_delete(HashTable *const htable, hkey_t pos);
@@ -51,6 +77,8 @@ void hash_table_delete(HashTable *const htable, hkey_t pos);
 void hash_table_empty(HashTable *const htable);
 
 void hash_table_print_stats(const HashTable *const htable);
+// Save histogram of rehashes needed per insert (collisions) for profiling
+void hash_table_record_probes(const HashTable *const htable);
 void hash_table_print_stats_brief(const HashTable *const htable);
 
 // This is for debugging
@@ -87,17 +115,22 @@ uint64_t hash_table_count_kmers(const HashTable *const htable);
   }                                                                            \
 } while(0)
 
+// Iterate over the entries given to thread `threadid` by a TaskScheduler
+// (see util.h) allocated with ht->capacity items. Threads steal work from each
+// other, so use this instead of a static partition when the cost of func()
+// varies between entries.
 // This iterator allows adding/removing items
-// Stops if func() returns non-zero value
-#define HASH_ITERATE_PART(ht,job,njobs,func, ...) do {                         \
-  ctx_assert((job) < (njobs));                                                 \
-  const size_t _step = (ht)->capacity / (njobs);                               \
-  const BinaryKmer *_start, *_end, *_bkptr;                                    \
-  _start = (ht)->table + (job) * _step;                                        \
-  _end = ((job)+1 == (njobs) ? (ht)->table + (ht)->capacity : _start+_step);   \
-  for(_bkptr = _start; _bkptr < _end; _bkptr++) {                              \
-    if(HASH_ENTRY_ASSIGNED(*_bkptr)) {                                         \
-      if(func((hkey_t)(_bkptr - (ht)->table), ##__VA_ARGS__)) break;           \
+// Thread stops if func() returns non-zero value
+#define HASH_ITERATE_SCHED(ht,sched,threadid,func, ...) do {                   \
+  size_t _s, _e; bool _stop = false;                                           \
+  const BinaryKmer *_bkptr, *_bkend;                                           \
+  while(!_stop && task_sched_next((sched), (threadid), &_s, &_e)) {            \
+    _bkend = (ht)->table + _e;                                                 \
+    for(_bkptr = (ht)->table + _s; _bkptr < _bkend; _bkptr++) {                \
+      if(HASH_ENTRY_ASSIGNED(*_bkptr) &&                                       \
+         func((hkey_t)(_bkptr - (ht)->table), ##__VA_ARGS__)) {                \
+        _stop = true; break;                                                   \
+      }                                                                        \
     }                                                                          \
   }                                                                            \
 } while(0)
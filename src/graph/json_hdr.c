@@ -2,14 +2,117 @@
 #include "json_hdr.h"
 #include "cmd.h"
 #include "util.h"
+#include "file_util.h"
 
 // #include <unistd.h> // gethostname()
 #include <sys/utsname.h> // utsname()
 #include <pwd.h>
+#include <pthread.h>
 
 
 #define load_check(x,msg,...) if(!(x)) { die("[JSON] "msg, ##__VA_ARGS__); }
 
+// Per-thread statistics of this command, added to each header written
+static cJSON *thread_stats_json = NULL;
+static pthread_mutex_t thread_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void json_hdr_add_thread_stats(const char *name, cJSON *threads)
+{
+  cJSON *entry = cJSON_CreateObject();
+  cJSON_AddStringToObject(entry, "name", name);
+  cJSON_AddItemToObject(entry, "threads", threads);
+
+  pthread_mutex_lock(&thread_stats_lock);
+  if(thread_stats_json == NULL) thread_stats_json = cJSON_CreateArray();
+  cJSON_AddItemToArray(thread_stats_json, entry);
+  pthread_mutex_unlock(&thread_stats_lock);
+}
+
+const cJSON* json_hdr_get_thread_stats()
+{
+  return thread_stats_json;
+}
+
+void json_hdr_clear_thread_stats()
+{
+  pthread_mutex_lock(&thread_stats_lock);
+  if(thread_stats_json != NULL) cJSON_Delete(thread_stats_json);
+  thread_stats_json = NULL;
+  pthread_mutex_unlock(&thread_stats_lock);
+}
+
+static cJSON* json_hdr_prof_hist(const uint64_t *counts, size_t len)
+{
+  size_t i;
+  cJSON *hist = cJSON_CreateArray();
+  for(i = 0; i < len; i++)
+    cJSON_AddItemToArray(hist, cJSON_CreateNumber(counts[i]));
+  return hist;
+}
+
+cJSON* json_hdr_profile()
+{
+  size_t i, t, nphases, nhists;
+  const CtxProfPhase *phases = ctx_prof_get_phases(&nphases);
+  const CtxProfHist *hists = ctx_prof_get_hists(&nhists);
+
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddNumberToObject(json, "wall_secs", ctx_prof_total_secs());
+  cJSON_AddNumberToObject(json, "peak_rss", ctx_prof_peak_rss());
+
+  cJSON *jphases = cJSON_CreateArray();
+  cJSON_AddItemToObject(json, "phases", jphases);
+
+  for(i = 0; i < nphases; i++) {
+    cJSON *phase = cJSON_CreateObject();
+    cJSON_AddStringToObject(phase, "name", phases[i].name);
+    cJSON_AddNumberToObject(phase, "wall_secs", phases[i].wall_secs);
+    cJSON_AddNumberToObject(phase, "cpu_secs", phases[i].cpu_secs);
+    cJSON_AddNumberToObject(phase, "peak_rss", phases[i].peak_rss);
+    cJSON *threads = cJSON_CreateArray();
+    for(t = 0; t < phases[i].nthreads; t++) {
+      cJSON *thread = cJSON_CreateObject();
+      cJSON_AddNumberToObject(thread, "busy_secs", phases[i].threads[t].busy_secs);
+      cJSON_AddNumberToObject(thread, "idle_secs", phases[i].threads[t].idle_secs);
+      cJSON_AddItemToArray(threads, thread);
+    }
+    cJSON_AddItemToObject(phase, "threads", threads);
+    cJSON_AddItemToArray(jphases, phase);
+  }
+
+  cJSON *jhists = cJSON_CreateObject();
+  cJSON_AddItemToObject(json, "histograms", jhists);
+
+  for(i = 0; i < nhists; i++) {
+    cJSON_AddItemToObject(jhists, hists[i].name,
+                          json_hdr_prof_hist(hists[i].counts, hists[i].len));
+  }
+
+  return json;
+}
+
+void json_hdr_save_stats(const char *path)
+{
+  FILE *fout = futil_fopen(path, "w");
+
+  cJSON *json = cJSON_CreateObject();
+  cJSON *cmdargs = cJSON_CreateStringArray(cmd_get_argv(), cmd_get_argc());
+  cJSON_AddItemToObject(json, "cmd", cmdargs);
+  cJSON_AddStringToObject(json, "cortex", CTX_VERSION);
+  cJSON_AddItemToObject(json, "profile", json_hdr_profile());
+
+  pthread_mutex_lock(&thread_stats_lock);
+  if(thread_stats_json != NULL) {
+    cJSON_AddItemToObject(json, "thread_stats",
+                          cJSON_Duplicate(thread_stats_json, 1));
+  }
+  pthread_mutex_unlock(&thread_stats_lock);
+
+  json_hdr_fprint(json, fout);
+  cJSON_Delete(json);
+  fclose(fout);
+}
+
 void json_hdr_read(FILE *fh, gzFile gz, const char *path, StrBuf *hdrstr)
 {
   ctx_assert(fh == NULL || gz == NULL);
@@ -141,6 +244,18 @@ void json_hdr_add_std(cJSON *json, const char *path,
   cJSON_AddStringToObject(command, "htslib", HTS_VERSION);
   cJSON_AddStringToObject(command, "zlib",   ZLIB_VERSION);
 
+  pthread_mutex_lock(&thread_stats_lock);
+  if(thread_stats_json != NULL) {
+    cJSON_AddItemToObject(command, "thread_stats",
+                          cJSON_Duplicate(thread_stats_json, 1));
+  }
+  pthread_mutex_unlock(&thread_stats_lock);
+
+  // Record current hash table state then add profile
+  if(db_graph->ht.num_kmers > 0) hash_table_record_probes(&db_graph->ht);
+  if(db_graph->gphash.num_entries > 0) gpath_hash_record_fill(&db_graph->gphash);
+  cJSON_AddItemToObject(command, "profile", json_hdr_profile());
+
   // Get username
   // struct passwd *pw = getpwuid(geteuid());
   // if(pw != NULL)
@@ -222,12 +337,14 @@ void json_hdr_gzprint(cJSON *json, gzFile gzout)
   free(jstr);
 }
 
-void json_hdr_fprint(cJSON *json, FILE *fout)
+size_t json_hdr_fprint(cJSON *json, FILE *fout)
 {
   char *jstr = cJSON_Print(json);
+  size_t len = strlen(jstr);
   fputs(jstr, fout);
   fputs("\n\n", fout);
   free(jstr);
+  return len + 2;
 }
 
 cJSON* json_hdr_get(cJSON *json, const char *field, int type, const char *path)
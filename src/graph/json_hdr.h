@@ -17,8 +17,25 @@ void json_hdr_add_std(cJSON *json, const char *path,
                       cJSON **hdrs, size_t nhdrs,
                       const dBGraph *db_graph);
 
+// Record per-thread statistics `threads` (a JSON array with one entry per
+// thread) under `name`. Every later json_hdr_add_std() adds all recorded
+// statistics to the command as "thread_stats". Takes ownership of `threads`.
+void json_hdr_add_thread_stats(const char *name, cJSON *threads);
+
+// Returns NULL if no statistics have been recorded
+const cJSON* json_hdr_get_thread_stats();
+void json_hdr_clear_thread_stats();
+
+// Phase timings, per-thread busy/idle time and histograms recorded with
+// ctx_prof_*() (see ctx_profile.h)
+cJSON* json_hdr_profile();
+
+// Write profile and per-thread statistics of this command to `path`
+void json_hdr_save_stats(const char *path);
+
 void json_hdr_gzprint(cJSON *json, gzFile gzout);
-void json_hdr_fprint(cJSON *json, FILE *fout);
+// Returns number of bytes written
+size_t json_hdr_fprint(cJSON *json, FILE *fout);
 
 // Get values from a JSON header
 cJSON* json_hdr_get(cJSON *json, const char *field, int type, const char *path);
@@ -0,0 +1,54 @@
+#include "global.h"
+#include "kmer_bloom.h"
+
+size_t kmer_bloom_mem(size_t mem)
+{
+  size_t nwords = 1;
+  while(nwords * 2 * sizeof(uint64_t) <= mem) nwords *= 2;
+  return nwords * sizeof(uint64_t);
+}
+
+void kmer_bloom_alloc(KmerBloom *bf, size_t mem)
+{
+  size_t nbytes = kmer_bloom_mem(mem);
+  bf->bits = ctx_calloc(nbytes, 1);
+  bf->mask = nbytes / sizeof(uint64_t) - 1;
+}
+
+void kmer_bloom_dealloc(KmerBloom *bf)
+{
+  ctx_free(bf->bits);
+  memset(bf, 0, sizeof(KmerBloom));
+}
+
+// Finaliser from MurmurHash3
+static inline uint64_t bloom_mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdUL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53UL;
+  h ^= h >> 33;
+  return h;
+}
+
+bool kmer_bloom_add_mt(KmerBloom *bf, BinaryKmer bkey, Colour col)
+{
+  uint64_t h = col, mask = 0, old;
+  size_t i;
+
+  for(i = 0; i < NUM_BKMER_WORDS; i++)
+    h = bloom_mix(h ^ bkey.b[i]);
+
+  // One hash picks the word, a second picks the bits in the word
+  volatile uint64_t *word = bf->bits + (bloom_mix(h + 0x9E3779B97F4A7C15UL) &
+                                        bf->mask);
+
+  for(i = 0; i < KMER_BLOOM_NHASH; i++, h >>= 6)
+    mask |= 1UL << (h & 63);
+
+  // Set all bits at once, so only one thread sees a new key as absent
+  if((*word & mask) == mask) return true;
+  old = __sync_fetch_and_or(word, mask);
+  return (old & mask) == mask;
+}
@@ -0,0 +1,38 @@
+#ifndef KMER_BLOOM_H_
+#define KMER_BLOOM_H_
+
+//
+// Threadsafe Bloom filter of (kmer, colour) pairs
+//
+// Used when building a graph to remember kmers that have only been seen once,
+// so that erroneous singleton kmers never reach the hash table. The filter is
+// blocked: all bits for a key are in one 64 bit word, so each lookup touches
+// one cache line and all bits are set with a single atomic OR. If several
+// threads add the same new key at once, exactly one of them sees it as absent.
+//
+
+#include "cortex_types.h"
+#include "binary_kmer.h"
+
+// Bits set per key, each picked with 6 bits of a 64 bit hash
+#define KMER_BLOOM_NHASH 4
+
+typedef struct
+{
+  uint64_t *bits;
+  uint64_t mask; // number of words - 1
+} KmerBloom;
+
+// Uses the largest power of two number of words that fits in `mem` bytes
+void kmer_bloom_alloc(KmerBloom *bf, size_t mem);
+void kmer_bloom_dealloc(KmerBloom *bf);
+
+// Memory used by a filter allocated with `mem` bytes
+size_t kmer_bloom_mem(size_t mem);
+
+// Add a key to the filter. Returns true if it was already in the filter
+// (or is a false positive). Threadsafe, concurrent adds of the same new key
+// return false exactly once.
+bool kmer_bloom_add_mt(KmerBloom *bf, BinaryKmer bkey, Colour col);
+
+#endif /* KMER_BLOOM_H_ */
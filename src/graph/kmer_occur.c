@@ -133,27 +133,31 @@ static inline size_t add_ref_seq_to_graph_mt(const char *seq, size_t len,
                                              dBGraph *db_graph)
 {
   const size_t kmer_size = db_graph->kmer_size;
-  size_t i, num_novel_kmers = 0;
-  BinaryKmer bkmer;
-  Nucleotide nuc;
-  dBNode prev, curr;
-  bool found;
+  const size_t nkmers = len + 1 - kmer_size;
+  size_t i, j, m, num_novel_kmers = 0;
+  BinaryKmerIter kmer_iter;
+  BinaryKmer bkeys[DB_GRAPH_BATCH];
+  Orientation orients[DB_GRAPH_BATCH];
+  dBNode prev = DB_NODE_INIT, nodes[DB_GRAPH_BATCH];
+  bool found[DB_GRAPH_BATCH];
 
   ctx_assert(len >= kmer_size);
 
-  bkmer = binary_kmer_from_str(seq, kmer_size);
-  prev = db_graph_find_or_add_node_mt(db_graph, bkmer, &found);
-  __sync_fetch_and_add((volatile uint32_t*)&klists[prev.key].count, 1); // count++
-  num_novel_kmers += !found;
+  binary_kmer_iter_init(&kmer_iter, kmer_size);
+  binary_kmer_iter_add_str(&kmer_iter, seq, kmer_size-1);
 
-  for(i = kmer_size; i < len; i++, prev = curr)
+  for(i = 0; i < nkmers; i += m)
   {
-    nuc = dna_char_to_nuc(seq[i]);
-    bkmer = binary_kmer_left_shift_add(bkmer, kmer_size, nuc);
-    curr = db_graph_find_or_add_node_mt(db_graph, bkmer, &found);
-    __sync_fetch_and_add((volatile uint32_t*)&klists[curr.key].count, 1); // count++
-    db_graph_add_edge_mt(db_graph, 0, prev, curr);
-    num_novel_kmers += !found;
+    m = MIN2(nkmers - i, DB_GRAPH_BATCH);
+    binary_kmer_iter_keys(&kmer_iter, seq+kmer_size-1+i, m, bkeys, orients);
+    db_graph_find_or_add_nodes_mt(db_graph, bkeys, orients, m, nodes, found);
+
+    for(j = 0; j < m; j++) {
+      __sync_fetch_and_add((volatile uint32_t*)&klists[nodes[j].key].count, 1);
+      if(i+j > 0) db_graph_add_edge_mt(db_graph, 0, prev, nodes[j]);
+      num_novel_kmers += !found[j];
+      prev = nodes[j];
+    }
   }
 
   return num_novel_kmers;
@@ -186,15 +190,52 @@ static inline size_t add_ref_read_to_graph_mt(const read_t *r,
   return num_novel_kmers;
 }
 
+// Look up every kmer of a read in the graph, in batches, and call `func` with
+// each node found and the offset of its kmer in the read. Kmers missing from
+// the graph are skipped.
+static void read_find_nodes(const read_t *r, const dBGraph *db_graph,
+                            void (*func)(dBNode node, size_t offset, void *arg),
+                            void *arg)
+{
+  const size_t kmer_size = db_graph->kmer_size;
+  size_t i, j, m, search_start = 0, contig_start, contig_end, contig_kmers;
+  BinaryKmerIter kmer_iter;
+  BinaryKmer bkeys[DB_GRAPH_BATCH];
+  Orientation orients[DB_GRAPH_BATCH];
+  dBNode nodes[DB_GRAPH_BATCH];
+
+  if(r->seq.end < kmer_size) return;
+
+  while((contig_start = seq_contig_start(r, search_start, kmer_size,
+                                         0, 0)) < r->seq.end)
+  {
+    contig_end = seq_contig_end(r, contig_start, kmer_size, 0, 0, &search_start);
+    contig_kmers = contig_end - contig_start + 1 - kmer_size;
+
+    binary_kmer_iter_init(&kmer_iter, kmer_size);
+    binary_kmer_iter_add_str(&kmer_iter, r->seq.b+contig_start, kmer_size-1);
+
+    for(i = 0; i < contig_kmers; i += m)
+    {
+      m = MIN2(contig_kmers - i, DB_GRAPH_BATCH);
+      binary_kmer_iter_keys(&kmer_iter, r->seq.b+contig_start+kmer_size-1+i, m,
+                            bkeys, orients);
+      db_graph_find_batch(db_graph, bkeys, orients, m, nodes);
+
+      for(j = 0; j < m; j++)
+        if(nodes[j].key != HASH_NOT_FOUND)
+          func(nodes[j], contig_start+i+j, arg);
+    }
+  }
+}
+
 // Same as above but don't add missing kmers
 // Threadsafe
-static inline void bkmer_update_counts_find_mt(BinaryKmer bkmer,
-                                               KONodeList *klists,
-                                               const dBGraph *db_graph)
+static void node_update_counts_mt(dBNode node, size_t offset, void *arg)
 {
-  hkey_t hkey = hash_table_find(&db_graph->ht, bkmer);
-  if(hkey != HASH_NOT_FOUND)
-    __sync_fetch_and_add((volatile uint32_t*)&klists[hkey].count, 1); // count++
+  (void)offset;
+  KONodeList *klists = (KONodeList*)arg;
+  __sync_fetch_and_add((volatile uint32_t*)&klists[node.key].count, 1); // count++
 }
 
 struct ReadUpdateCounts {
@@ -215,38 +256,35 @@ static void read_update_counts(void *arg)
     add_ref_read_to_graph_mt(r, data.klists, data.db_graph);
   }
   else {
-    LoadingStats stats = LOAD_STATS_INIT_MACRO;
-    READ_TO_BKMERS(r, data.db_graph->kmer_size, 0, 0, &stats,
-                   bkmer_update_counts_find_mt, data.klists, data.db_graph);
+    read_find_nodes(r, data.db_graph, node_update_counts_mt, data.klists);
   }
 }
 
-static void bkmer_store_kmer_pos(BinaryKmer bkmer, const dBGraph *db_graph,
-                                 KONodeList *klists, KOccur *koccurs,
-                                 size_t chrom_id, uint64_t offset)
+struct StoreKmerPos {
+  KONodeList *klists;
+  KOccur *koccurs;
+  size_t chrom_id;
+};
+
+static void node_store_kmer_pos(dBNode node, size_t offset, void *arg)
 {
   // bkmers were already added to graph -> don't need to find_or_insert
-  // if missing kmers weren't added then kmer might be missing -> skip
-  dBNode node = db_graph_find(db_graph, bkmer);
-
-  if(node.key != HASH_NOT_FOUND)
-  {
-    KONodeList *kl = &klists[node.key];
-    koccurs[kl->start+kl->count] = (KOccur){.chrom = chrom_id,
-                                            .offset = offset,
-                                            .orient = node.orient};
-    kl->count++;
-  }
+  // if missing kmers weren't added then kmer might be missing -> skipped
+  const struct StoreKmerPos *data = (const struct StoreKmerPos*)arg;
+  KONodeList *kl = &data->klists[node.key];
+  data->koccurs[kl->start+kl->count] = (KOccur){.chrom = data->chrom_id,
+                                                .offset = offset,
+                                                .orient = node.orient};
+  kl->count++;
 }
 
 static void read_store_kmer_pos(const read_t *r, size_t chrom_id,
                                 KONodeList *klists, KOccur *koccurs,
                                 const dBGraph *db_graph)
 {
-  const size_t kmer_size = db_graph->kmer_size;
-  LoadingStats stats = LOAD_STATS_INIT_MACRO;
-  READ_TO_BKMERS(r, kmer_size, 0, 0, &stats, bkmer_store_kmer_pos,
-                 db_graph, klists, koccurs, chrom_id, _offset);
+  struct StoreKmerPos data = {.klists = klists, .koccurs = koccurs,
+                              .chrom_id = chrom_id};
+  read_find_nodes(r, db_graph, node_store_kmer_pos, &data);
 }
 
 static void load_reads_count_kmers(const read_t *reads, size_t num_reads,
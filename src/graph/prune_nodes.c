@@ -80,9 +80,47 @@ int prune_nodes_lacking_flag_no_edges(hkey_t hkey, const uint8_t *flags,
 }
 
 
+// Remove a kmer from colour `col` if it lacks its flag, otherwise remove its
+// edges in `col` to kmers lacking their flag
+static inline
+int prune_col_node_lacking_flag(hkey_t hkey, const uint8_t *flags, Colour col,
+                                dBGraph *db_graph)
+{
+  Edges edges = db_node_edges(db_graph, hkey, col), keep_edges = edges;
+  Orientation orient;
+  Nucleotide nuc;
+  dBNode next_node;
+  BinaryKmer bkmer;
+
+  if(!bitset_get(flags, hkey)) {
+    db_node_covg(db_graph, hkey, col) = 0;
+    db_node_edges(db_graph, hkey, col) = 0;
+    return 0;
+  }
+
+  if(edges)
+  {
+    bkmer = db_node_get_bkmer(db_graph, hkey);
+
+    for(orient = 0; orient < 2; orient++)
+      for(nuc = 0; nuc < 4; nuc++)
+        if(edges_has_edge(edges, nuc, orient)) {
+          next_node = db_graph_next_node(db_graph, bkmer, nuc, orient);
+          if(!bitset_get(flags, next_node.key))
+            keep_edges = edges_del_edge(keep_edges, nuc, orient);
+        }
+
+    db_node_edges(db_graph, hkey, col) = keep_edges;
+  }
+
+  return 0; // => keep iterating
+}
+
 typedef struct {
   size_t threadid, nthreads;
+  TaskScheduler *sched;
   const uint8_t *keep_flags;
+  Colour col;
   dBGraph *db_graph;
 } GraphCleaner;
 
@@ -91,9 +129,17 @@ static void worker_prune_node_edges(void *arg)
   GraphCleaner cl = *(GraphCleaner*)arg;
 
   // printf("== Edges == Thread %zu / %zu\n", cl.threadid, cl.nthreads);
-  HASH_ITERATE_PART(&cl.db_graph->ht, cl.threadid, cl.nthreads,
-                    prune_edges_to_nodes_lacking_flag,
-                    cl.keep_flags, cl.db_graph);
+  HASH_ITERATE_SCHED(&cl.db_graph->ht, cl.sched, cl.threadid,
+                     prune_edges_to_nodes_lacking_flag,
+                     cl.keep_flags, cl.db_graph);
+}
+
+static void worker_prune_col_nodes(void *arg)
+{
+  GraphCleaner cl = *(GraphCleaner*)arg;
+  HASH_ITERATE_SCHED(&cl.db_graph->ht, cl.sched, cl.threadid,
+                     prune_col_node_lacking_flag,
+                     cl.keep_flags, cl.col, cl.db_graph);
 }
 
 static void worker_prune_nodes(void *arg)
@@ -101,9 +147,9 @@ static void worker_prune_nodes(void *arg)
   GraphCleaner cl = *(GraphCleaner*)arg;
 
   // printf("== Nodes == Thread %zu / %zu\n", cl.threadid, cl.nthreads);
-  HASH_ITERATE_PART(&cl.db_graph->ht, cl.threadid, cl.nthreads,
-                    prune_nodes_lacking_flag_no_edges,
-                    cl.keep_flags, cl.db_graph);
+  HASH_ITERATE_SCHED(&cl.db_graph->ht, cl.sched, cl.threadid,
+                     prune_nodes_lacking_flag_no_edges,
+                     cl.keep_flags, cl.db_graph);
 }
 
 // Remove all nodes that do not have a given flag
@@ -112,22 +158,28 @@ void prune_nodes_lacking_flag(size_t num_threads, const uint8_t *flags,
 {
   size_t i;
   GraphCleaner *cleaners = ctx_calloc(num_threads, sizeof(GraphCleaner));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, num_threads);
 
   for(i = 0; i < num_threads; i++) {
     cleaners[i] = (GraphCleaner){.threadid = i, .nthreads = num_threads,
-                                 .keep_flags = flags, .db_graph = db_graph};
+                                 .sched = &sched,
+                                 .keep_flags = flags, .col = 0,
+                                 .db_graph = db_graph};
   }
 
   // Trim edges from valid nodes
   if(db_graph->col_edges != NULL) {
     util_run_threads(cleaners, num_threads, sizeof(GraphCleaner),
                      num_threads, worker_prune_node_edges);
+    task_sched_reset(&sched);
   }
 
   // Removed dead nodes
   util_run_threads(cleaners, num_threads, sizeof(GraphCleaner),
                    num_threads, worker_prune_nodes);
 
+  task_sched_dealloc(&sched);
   ctx_free(cleaners);
 }
 
@@ -205,6 +257,31 @@ static void db_graph_remove_node_if_uncoloured(hkey_t node, dBGraph *db_graph)
     prune_node(db_graph, node);
 }
 
+void prune_col_nodes_lacking_flag(size_t num_threads, const uint8_t *flags,
+                                  Colour col, dBGraph *db_graph)
+{
+  ctx_assert(col < db_graph->num_of_cols);
+  ctx_assert(col < db_graph->num_edge_cols);
+
+  size_t i;
+  GraphCleaner *cleaners = ctx_calloc(num_threads, sizeof(GraphCleaner));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, num_threads);
+
+  for(i = 0; i < num_threads; i++) {
+    cleaners[i] = (GraphCleaner){.threadid = i, .nthreads = num_threads,
+                                 .sched = &sched,
+                                 .keep_flags = flags, .col = col,
+                                 .db_graph = db_graph};
+  }
+
+  util_run_threads(cleaners, num_threads, sizeof(GraphCleaner),
+                   num_threads, worker_prune_col_nodes);
+
+  task_sched_dealloc(&sched);
+  ctx_free(cleaners);
+}
+
 void prune_uncoloured_nodes(dBGraph *db_graph)
 {
   HASH_ITERATE_SAFE(&db_graph->ht, db_graph_remove_node_if_uncoloured, db_graph);
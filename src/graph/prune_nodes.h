@@ -21,6 +21,12 @@ void prune_supernode(dBNode *nodes, size_t len, dBGraph *db_graph);
 void prune_nodes_lacking_flag(size_t num_threads, const uint8_t *flags,
                               dBGraph *db_graph);
 
+// Remove kmers lacking flag from colour `col` only, by zeroing their coverage
+// and edges in that colour. Edges in `col` to these kmers are also removed.
+// Kmers stay in the hash table even if they are no longer in any colour.
+void prune_col_nodes_lacking_flag(size_t num_threads, const uint8_t *flags,
+                                  Colour col, dBGraph *db_graph);
+
 // Currently unused
 // remove nodes if not in any colour
 // i.e. db_node_has_col(graph,node,colour) == false for all colours
@@ -3,10 +3,12 @@
 
 #include "graph_walker.h"
 #include "db_node.h"
+#include "visited_set.h"
 
 typedef struct
 {
-  uint64_t *const visited, *const bloom;
+  VisitedSet visited; // oriented nodes seen on this walk
+  uint64_t *const bloom;
   const size_t bloom_nbits, mem_bytes;
   const uint32_t mask;
   size_t nbloom_entries;
@@ -21,8 +23,7 @@ static inline bool rpt_walker_attempt_traverse(RepeatWalker *rpt,
   uint64_t h[3], hash64;
   bool collision;
 
-  if(!db_node_has_traversed(rpt->visited, wlk->node)) {
-    db_node_set_traversed(rpt->visited, wlk->node);
+  if(visited_set_add(&rpt->visited, wlk->node)) {
     return true;
   }
   else {
@@ -48,58 +49,42 @@ static inline bool rpt_walker_attempt_traverse(RepeatWalker *rpt,
   }
 }
 
+// Memory usually used by a RepeatWalker. Walks longer than about
+// hash_capacity/128 kmers briefly use up to visited_set_peak_mem() more, until
+// the walker is next cleared.
 static inline size_t rpt_walker_est_mem(size_t hash_capacity, size_t nbits)
 {
-  size_t visited_words = roundup_bits2words64(hash_capacity*2);
   size_t repeat_words = roundup_bits2words64(1UL<<nbits);
-  return (visited_words+repeat_words) * sizeof(uint64_t);
+  return visited_set_est_mem(hash_capacity) + repeat_words * sizeof(uint64_t);
 }
 
 static inline void rpt_walker_alloc(RepeatWalker *rpt,
                                     size_t hash_capacity, size_t nbits)
 {
   ctx_assert(nbits > 0 && nbits < 32);
-  size_t visited_words = roundup_bits2words64(hash_capacity*2);
   size_t repeat_words = roundup_bits2words64(1UL<<nbits);
-  size_t nbytes = (visited_words + repeat_words) * sizeof(uint64_t);
-  uint64_t *mem = ctx_calloc(visited_words+repeat_words, sizeof(uint64_t));
+  size_t nbytes = repeat_words * sizeof(uint64_t);
+  uint64_t *bloom = ctx_calloc(repeat_words, sizeof(uint64_t));
   uint32_t mask = bitmask(nbits,uint32_t);
-  RepeatWalker tmp = {.visited = mem, .bloom = mem+visited_words,
+  RepeatWalker tmp = {.bloom = bloom,
                       .bloom_nbits = nbits, .mem_bytes = nbytes, .mask = mask,
                       .nbloom_entries = 0};
   memcpy(rpt, &tmp, sizeof(RepeatWalker));
+  visited_set_alloc(&rpt->visited, hash_capacity);
 }
 
 static inline void rpt_walker_dealloc(RepeatWalker *rpt)
 {
-  ctx_free(rpt->visited);
-}
-
-static inline void _rpt_walker_clear_bloom(RepeatWalker *rpt)
-{
-  size_t bmem = roundup_bits2words64(1UL<<rpt->bloom_nbits)*sizeof(uint64_t);
-  if(rpt->nbloom_entries) memset(rpt->bloom, 0, bmem);
-  rpt->nbloom_entries = 0;
+  visited_set_dealloc(&rpt->visited);
+  ctx_free(rpt->bloom);
 }
 
+// Forget all nodes seen. Cost does not depend on length of the last walk.
 static inline void rpt_walker_clear(RepeatWalker *rpt)
 {
-  memset(rpt->visited, 0, rpt->mem_bytes);
-  _rpt_walker_clear_bloom(rpt);
-}
-
-static inline void rpt_walker_fast_clear(RepeatWalker *rpt,
-                                         const dBNode *nodes, size_t n)
-{
-  size_t i;
-  for(i = 0; i < n; i++) db_node_fast_clear_traversed(rpt->visited, nodes[i].key);
-  _rpt_walker_clear_bloom(rpt);
-}
-
-static inline void rpt_walker_fast_clear_single_node(RepeatWalker *rpt,
-                                                     const dBNode node)
-{
-  db_node_fast_clear_traversed(rpt->visited, node.key);
+  visited_set_clear(&rpt->visited);
+  if(rpt->nbloom_entries) memset(rpt->bloom, 0, rpt->mem_bytes);
+  rpt->nbloom_entries = 0;
 }
 
 #endif /* REPEAT_WALKER_H_ */
@@ -6,19 +6,27 @@
 #include "db_node.h"
 #include "supernode.h"
 
+// Edges in colour `col` or the union of all colours if col < 0
+static inline Edges supernode_edges(const dBGraph *db_graph, hkey_t hkey,
+                                    int col)
+{
+  return col < 0 ? db_node_get_edges_union(db_graph, hkey)
+                 : db_node_get_edges(db_graph, hkey, col);
+}
+
 static bool supernode_is_closed_cycle(const dBNode *nlist, size_t len,
                                          BinaryKmer bkmer0, BinaryKmer bkmer1,
-                                         const dBGraph *db_graph)
+                                         int col, const dBGraph *db_graph)
 {
   Edges edges0, edges1;
   BinaryKmer shiftkmer;
   Nucleotide nuc;
   const size_t kmer_size = db_graph->kmer_size;
 
-  edges0 = db_node_get_edges_union(db_graph, nlist[0].key);
+  edges0 = supernode_edges(db_graph, nlist[0].key, col);
   if(edges_get_indegree(edges0, nlist[0].orient) != 1) return false;
 
-  edges1 = db_node_get_edges_union(db_graph, nlist[len-1].key);
+  edges1 = supernode_edges(db_graph, nlist[len-1].key, col);
   if(edges_get_outdegree(edges1, nlist[len-1].orient) != 1) return false;
 
   nuc = bkmer_get_last_nuc(bkmer0, nlist[0].orient, kmer_size);
@@ -33,7 +41,8 @@ static bool supernode_is_closed_cycle(const dBNode *nlist, size_t len,
 // Orient supernode
 // Once oriented, supernode has lowest possible kmerkey at the beginning,
 // oriented FORWARDs if possible
-void supernode_normalise(dBNode *nlist, size_t len, const dBGraph *db_graph)
+void supernode_normalise_col(dBNode *nlist, size_t len, int col,
+                             const dBGraph *db_graph)
 {
   // Sort supernode into forward orientation
   ctx_assert(len > 0);
@@ -47,7 +56,7 @@ void supernode_normalise(dBNode *nlist, size_t len, const dBGraph *db_graph)
   BinaryKmer bkmer1 = db_node_get_bkmer(db_graph, nlist[len-1].key);
 
   // Check if closed cycle
-  if(supernode_is_closed_cycle(nlist, len, bkmer0, bkmer1, db_graph))
+  if(supernode_is_closed_cycle(nlist, len, bkmer0, bkmer1, col, db_graph))
   {
     // find lowest kmer to start from
     BinaryKmer lowest = bkmer0, tmp;
@@ -85,8 +94,8 @@ void supernode_normalise(dBNode *nlist, size_t len, const dBGraph *db_graph)
 // Walk along nodes starting from node/or, storing the supernode in nlist
 // Returns the number of nodes added, adds no more than `limit`
 // return false if out of space and limit > 0
-bool supernode_extend(dBNodeBuffer *nbuf, size_t limit,
-                         const dBGraph *db_graph)
+bool supernode_extend_col(dBNodeBuffer *nbuf, size_t limit, int col,
+                          const dBGraph *db_graph)
 {
   ctx_assert(nbuf->len > 0);
 
@@ -94,17 +103,17 @@ bool supernode_extend(dBNodeBuffer *nbuf, size_t limit,
   dBNode node0 = nbuf->data[0], node1 = nbuf->data[nbuf->len-1], node = node1;
 
   BinaryKmer bkmer = db_node_oriented_bkmer(db_graph, node);
-  Edges edges = db_node_get_edges_union(db_graph, node.key);
+  Edges edges = supernode_edges(db_graph, node.key, col);
   Nucleotide nuc;
 
   while(edges_has_precisely_one_edge(edges, node.orient, &nuc))
   {
     bkmer = binary_kmer_left_shift_add(bkmer, kmer_size, nuc);
     node = db_graph_find(db_graph, bkmer);
-    edges = db_node_get_edges_union(db_graph, node.key);
-
     ctx_assert(node.key != HASH_NOT_FOUND);
 
+    edges = supernode_edges(db_graph, node.key, col);
+
     if(edges_has_precisely_one_edge(edges, rev_orient(node.orient), &nuc))
     {
       if(node.key == node0.key || node.key == nbuf->data[nbuf->len-1].key) {
@@ -122,14 +131,31 @@ bool supernode_extend(dBNodeBuffer *nbuf, size_t limit,
   return true;
 }
 
-void supernode_find(hkey_t hkey, dBNodeBuffer *nbuf, const dBGraph *db_graph)
+bool supernode_extend(dBNodeBuffer *nbuf, size_t limit,
+                         const dBGraph *db_graph)
+{
+  return supernode_extend_col(nbuf, limit, -1, db_graph);
+}
+
+void supernode_normalise(dBNode *nlist, size_t len, const dBGraph *db_graph)
+{
+  supernode_normalise_col(nlist, len, -1, db_graph);
+}
+
+void supernode_find_col(hkey_t hkey, int col, dBNodeBuffer *nbuf,
+                        const dBGraph *db_graph)
 {
   dBNode first = {.key = hkey, .orient = REVERSE};
   size_t offset = nbuf->len;
   db_node_buf_add(nbuf, first);
-  supernode_extend(nbuf, 0, db_graph);
+  supernode_extend_col(nbuf, 0, col, db_graph);
   db_nodes_reverse_complement(nbuf->data+offset, nbuf->len-offset);
-  supernode_extend(nbuf, 0, db_graph);
+  supernode_extend_col(nbuf, 0, col, db_graph);
+}
+
+void supernode_find(hkey_t hkey, dBNodeBuffer *nbuf, const dBGraph *db_graph)
+{
+  supernode_find_col(hkey, -1, nbuf, db_graph);
 }
 
 // Count number of read starts using coverage data
@@ -166,7 +192,7 @@ size_t supernode_covg_mean(const Covg *covgs, size_t len)
 
 static inline int supernode_iterate_node(hkey_t hkey, size_t threadid,
                                          dBNodeBuffer *nbuf,
-                                         uint8_t *visited,
+                                         uint8_t *visited, int col,
                                          const dBGraph *db_graph,
                                          void (*func)(dBNodeBuffer _nbuf,
                                                       size_t threadid,
@@ -176,10 +202,12 @@ static inline int supernode_iterate_node(hkey_t hkey, size_t threadid,
   bool got_lock = false;
   size_t i;
 
+  if(col >= 0 && db_node_get_covg(db_graph, hkey, col) == 0) return 0;
+
   if(!bitset_get_mt(visited, hkey))
   {
     db_node_buf_reset(nbuf);
-    supernode_find(hkey, nbuf, db_graph);
+    supernode_find_col(hkey, col, nbuf, db_graph);
 
     // Mark first node (lowest hkey_t value) as visited
     hkey_t node0 = MIN2(nbuf->data[0].key, nbuf->data[nbuf->len-1].key);
@@ -201,7 +229,9 @@ static inline int supernode_iterate_node(hkey_t hkey, size_t threadid,
 
 typedef struct {
   const size_t threadid, nthreads;
+  TaskScheduler *const sched;
   uint8_t *const visited;
+  const int col;
   const dBGraph *db_graph;
   void (*func)(dBNodeBuffer _nbuf, size_t threadid, void *_arg);
   void *arg;
@@ -214,27 +244,33 @@ static void supernodes_iterate_thread(void *arg)
   dBNodeBuffer nbuf;
   db_node_buf_alloc(&nbuf, 2048);
 
-  HASH_ITERATE_PART(&cl.db_graph->ht, cl.threadid, cl.nthreads,
-                    supernode_iterate_node,
-                    cl.threadid, &nbuf, cl.visited, cl.db_graph,
-                    cl.func, cl.arg);
+  HASH_ITERATE_SCHED(&cl.db_graph->ht, cl.sched, cl.threadid,
+                     supernode_iterate_node,
+                     cl.threadid, &nbuf, cl.visited, cl.col, cl.db_graph,
+                     cl.func, cl.arg);
 
   db_node_buf_dealloc(&nbuf);
 }
 
-void supernodes_iterate(size_t nthreads, uint8_t *visited,
-                        const dBGraph *db_graph,
-                        void (*func)(dBNodeBuffer _nbuf,
-                                     size_t threadid,
-                                     void *_arg),
-                        void *arg)
+void supernodes_iterate_col(size_t nthreads, int col, uint8_t *visited,
+                            const dBGraph *db_graph,
+                            void (*func)(dBNodeBuffer _nbuf,
+                                         size_t threadid,
+                                         void *_arg),
+                            void *arg)
 {
+  ctx_assert(col < 0 || db_graph->col_covgs != NULL);
+
   size_t i;
   SupernodeIterator *workers = ctx_calloc(nthreads, sizeof(SupernodeIterator));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, nthreads);
 
   for(i = 0; i < nthreads; i++) {
     SupernodeIterator tmp = {.threadid = i, .nthreads = nthreads,
-                             .visited = visited, .db_graph = db_graph,
+                             .sched = &sched,
+                             .visited = visited, .col = col,
+                             .db_graph = db_graph,
                              .func = func, .arg = arg};
     memcpy(&workers[i], &tmp, sizeof(SupernodeIterator));
   }
@@ -242,5 +278,16 @@ void supernodes_iterate(size_t nthreads, uint8_t *visited,
   util_run_threads(workers, nthreads, sizeof(SupernodeIterator),
                    nthreads, supernodes_iterate_thread);
 
+  task_sched_dealloc(&sched);
   ctx_free(workers);
 }
+
+void supernodes_iterate(size_t nthreads, uint8_t *visited,
+                        const dBGraph *db_graph,
+                        void (*func)(dBNodeBuffer _nbuf,
+                                     size_t threadid,
+                                     void *_arg),
+                        void *arg)
+{
+  supernodes_iterate_col(nthreads, -1, visited, db_graph, func, arg);
+}
@@ -35,4 +35,22 @@ void supernodes_iterate(size_t nthreads, uint8_t *visited,
                                      void *_arg),
                         void *arg);
 
+//
+// Supernodes of a single colour
+// Only follow edges in colour `col`, or the union of all colours if col < 0.
+// supernodes_iterate_col() only starts from kmers with coverage in `col`.
+//
+void supernode_normalise_col(dBNode *nlist, size_t len, int col,
+                             const dBGraph *db_graph);
+bool supernode_extend_col(dBNodeBuffer *nbuf, size_t limit, int col,
+                          const dBGraph *db_graph);
+void supernode_find_col(hkey_t node, int col, dBNodeBuffer *nbuf,
+                        const dBGraph *db_graph);
+void supernodes_iterate_col(size_t nthreads, int col, uint8_t *visited,
+                            const dBGraph *db_graph,
+                            void (*func)(dBNodeBuffer _nbuf,
+                                         size_t threadid,
+                                         void *_arg),
+                            void *arg);
+
 #endif
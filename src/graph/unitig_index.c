@@ -0,0 +1,617 @@
+#include "global.h"
+#include "util.h"
+#include "file_util.h"
+#include "supernode.h"
+#include "prune_nodes.h"
+#include "unitig_index.h"
+
+#define UNITIG_INDEX_VERSION 1
+
+// Define a vector of Covg
+madcrow_buffer(covg_buf,CovgBuffer,Covg);
+
+void unitig_index_alloc(UnitigIndex *uidx, size_t capacity)
+{
+  UnitigIndex tmp = {.ids = ctx_malloc(capacity * sizeof(ukey_t)),
+                     .capacity = capacity,
+                     .num_utigs = 0, .num_kmers = 0, .colour = -1};
+
+  memset(tmp.ids, 0xff, capacity * sizeof(ukey_t)); // UNITIG_NONE
+  unitig_buf_alloc(&tmp.utigs, 1024);
+  if(pthread_mutex_init(&tmp.lock, NULL) != 0) die("Mutex init failed");
+
+  memcpy(uidx, &tmp, sizeof(UnitigIndex));
+}
+
+void unitig_index_dealloc(UnitigIndex *uidx)
+{
+  ctx_free(uidx->ids);
+  unitig_buf_dealloc(&uidx->utigs);
+  pthread_mutex_destroy(&uidx->lock);
+  memset(uidx, 0, sizeof(UnitigIndex));
+}
+
+static void unitig_index_reset(UnitigIndex *uidx)
+{
+  memset(uidx->ids, 0xff, uidx->capacity * sizeof(ukey_t));
+  unitig_buf_reset(&uidx->utigs);
+  uidx->num_utigs = uidx->num_kmers = 0;
+}
+
+// Kmer is in the graph (union) or in colour `col`
+static inline bool unitig_kmer_in_col(hkey_t hkey, int col,
+                                      const dBGraph *db_graph)
+{
+  return HASH_ENTRY_ASSIGNED(db_graph->ht.table[hkey]) &&
+         (col < 0 || db_node_get_covg(db_graph, hkey, col) > 0);
+}
+
+// Set coverage fields of utig from its nodes
+static void utig_set_covg(Unitig *utig, const dBNode *nodes, size_t len,
+                          int col, CovgBuffer *cbuf, const dBGraph *db_graph)
+{
+  size_t i, read_starts;
+  Covg covg_max = 0;
+
+  covg_buf_reset(cbuf);
+  covg_buf_capacity(cbuf, len);
+  cbuf->len = len;
+
+  for(i = 0; i < len; i++) {
+    cbuf->data[i] = col < 0 ? db_node_sum_covg(db_graph, nodes[i].key)
+                            : db_node_get_covg(db_graph, nodes[i].key, col);
+    covg_max = MAX2(covg_max, cbuf->data[i]);
+  }
+
+  read_starts = supernode_read_starts(cbuf->data, len);
+
+  utig->covg_mean = supernode_covg_mean(cbuf->data, len);
+  utig->covg_max = covg_max;
+  utig->read_starts = MIN2(read_starts, COVG_MAX);
+}
+
+//
+// Building
+//
+
+typedef struct
+{
+  const size_t nthreads;
+  CovgBuffer *cbufs;
+  UnitigIndex *uidx;
+  const dBGraph *db_graph;
+} UnitigBuilder;
+
+static void unitig_builder_alloc(UnitigBuilder *ub, size_t nthreads,
+                                 UnitigIndex *uidx, const dBGraph *db_graph)
+{
+  size_t i;
+  CovgBuffer *cbufs = ctx_calloc(nthreads, sizeof(CovgBuffer));
+  for(i = 0; i < nthreads; i++) covg_buf_alloc(&cbufs[i], 1024);
+
+  UnitigBuilder tmp = {.nthreads = nthreads, .cbufs = cbufs,
+                       .uidx = uidx, .db_graph = db_graph};
+  memcpy(ub, &tmp, sizeof(UnitigBuilder));
+}
+
+static void unitig_builder_dealloc(UnitigBuilder *ub)
+{
+  size_t i;
+  for(i = 0; i < ub->nthreads; i++) covg_buf_dealloc(&ub->cbufs[i]);
+  ctx_free(ub->cbufs);
+}
+
+static void unitig_add(dBNodeBuffer nbuf, size_t threadid, void *arg)
+{
+  const UnitigBuilder *ub = (const UnitigBuilder*)arg;
+  UnitigIndex *uidx = ub->uidx;
+  size_t i;
+  ukey_t id;
+
+  supernode_normalise_col(nbuf.data, nbuf.len, uidx->colour, ub->db_graph);
+
+  Unitig utig = {.first = nbuf.data[0], .last = nbuf.data[nbuf.len-1],
+                 .len = (uint32_t)nbuf.len};
+  utig_set_covg(&utig, nbuf.data, nbuf.len, uidx->colour,
+                &ub->cbufs[threadid], ub->db_graph);
+
+  pthread_mutex_lock(&uidx->lock);
+  id = unitig_buf_add(&uidx->utigs, utig);
+  uidx->num_utigs++;
+  uidx->num_kmers += nbuf.len;
+  pthread_mutex_unlock(&uidx->lock);
+
+  for(i = 0; i < nbuf.len; i++) {
+    ctx_assert(uidx->ids[nbuf.data[i].key] == UNITIG_NONE);
+    uidx->ids[nbuf.data[i].key] = id;
+  }
+}
+
+// Add unitigs for all kmers without their bit set in `visited`
+static void unitig_index_add_unvisited(UnitigIndex *uidx, size_t nthreads,
+                                       uint8_t *visited,
+                                       const dBGraph *db_graph)
+{
+  UnitigBuilder ub;
+  unitig_builder_alloc(&ub, nthreads, uidx, db_graph);
+  supernodes_iterate_col(nthreads, uidx->colour, visited, db_graph,
+                         unitig_add, &ub);
+  unitig_builder_dealloc(&ub);
+}
+
+void unitig_index_build_col(UnitigIndex *uidx, size_t nthreads, int col,
+                            const dBGraph *db_graph)
+{
+  ctx_assert(uidx->capacity == db_graph->ht.capacity);
+  ctx_assert(col < (int)db_graph->num_of_cols);
+  ctx_assert(col < (int)db_graph->num_edge_cols);
+
+  if(col < 0)
+    status("[unitigs] Building unitig index with %zu threads...", nthreads);
+  else
+    status("[unitigs] Building unitig index of colour %i with %zu threads...",
+           col, nthreads);
+
+  unitig_index_reset(uidx);
+  uidx->colour = col;
+
+  uint8_t *visited = ctx_calloc(roundup_bits2bytes(db_graph->ht.capacity), 1);
+  unitig_index_add_unvisited(uidx, nthreads, visited, db_graph);
+  ctx_free(visited);
+
+  ctx_assert(col >= 0 || uidx->num_kmers == db_graph->ht.num_kmers);
+
+  char nutigs_str[50];
+  ulong_to_str(uidx->num_utigs, nutigs_str);
+  status("[unitigs]   found %s unitigs", nutigs_str);
+}
+
+void unitig_index_build(UnitigIndex *uidx, size_t nthreads,
+                        const dBGraph *db_graph)
+{
+  unitig_index_build_col(uidx, nthreads, -1, db_graph);
+}
+
+//
+// Iterating
+//
+
+typedef struct
+{
+  const size_t threadid;
+  TaskScheduler *const sched;
+  const UnitigIndex *uidx;
+  void (*func)(ukey_t id, const Unitig *utig, size_t threadid, void *arg);
+  void *arg;
+} UnitigIterator;
+
+static void unitig_iterate_thread(void *arg)
+{
+  const UnitigIterator *it = (const UnitigIterator*)arg;
+  const Unitig *utigs = it->uidx->utigs.data;
+  size_t start, end, i;
+
+  while(task_sched_next(it->sched, it->threadid, &start, &end)) {
+    for(i = start; i < end; i++)
+      if(utigs[i].len > 0)
+        it->func(i, &utigs[i], it->threadid, it->arg);
+  }
+}
+
+void unitig_index_iterate(const UnitigIndex *uidx, size_t nthreads,
+                          void (*func)(ukey_t id, const Unitig *utig,
+                                       size_t threadid, void *arg),
+                          void *arg)
+{
+  size_t i;
+  UnitigIterator *workers = ctx_calloc(nthreads, sizeof(UnitigIterator));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, uidx->utigs.len, nthreads);
+
+  for(i = 0; i < nthreads; i++) {
+    UnitigIterator tmp = {.threadid = i, .sched = &sched, .uidx = uidx,
+                          .func = func, .arg = arg};
+    memcpy(&workers[i], &tmp, sizeof(UnitigIterator));
+  }
+
+  util_run_threads(workers, nthreads, sizeof(UnitigIterator),
+                   nthreads, unitig_iterate_thread);
+
+  task_sched_dealloc(&sched);
+  ctx_free(workers);
+}
+
+//
+// Flagging and pruning
+//
+
+typedef struct
+{
+  const size_t threadid;
+  TaskScheduler *const sched;
+  const UnitigIndex *uidx;
+  const uint8_t *const flags; // kmer or unitig flags
+  uint8_t *const out; // kmer or unitig flags
+  const dBGraph *db_graph;
+} UnitigPruner;
+
+static inline int unitig_flag_kmer(hkey_t hkey, const UnitigPruner *pr)
+{
+  ukey_t id = pr->uidx->ids[hkey];
+  if(id != UNITIG_NONE && bitset_get(pr->flags, id))
+    (void)bitset_set_mt(pr->out, hkey);
+  return 0; // => keep iterating
+}
+
+static void unitig_flag_kmers_thread(void *arg)
+{
+  const UnitigPruner *pr = (const UnitigPruner*)arg;
+  HASH_ITERATE_SCHED(&pr->db_graph->ht, pr->sched, pr->threadid,
+                     unitig_flag_kmer, pr);
+}
+
+// Mark the unitig of kmer `hkey` and of every kmer within `dist` kmers of it
+static void unitig_mark_near(const UnitigPruner *pr, hkey_t hkey, size_t dist)
+{
+  const dBGraph *db_graph = pr->db_graph;
+  const int col = pr->uidx->colour;
+  ukey_t id = pr->uidx->ids[hkey];
+
+  if(id != UNITIG_NONE) (void)bitset_set_mt(pr->out, id);
+  if(dist == 0) return;
+
+  BinaryKmer bkmer = db_node_get_bkmer(db_graph, hkey);
+  Edges edges = col < 0 ? db_node_get_edges_union(db_graph, hkey)
+                        : db_node_get_edges(db_graph, hkey, col);
+  dBNode nodes[4];
+  Nucleotide nucs[4];
+  Orientation orient;
+  size_t i, n;
+
+  for(orient = 0; orient < 2; orient++) {
+    n = db_graph_next_nodes(db_graph, bkmer, orient, edges, nodes, nucs);
+    for(i = 0; i < n; i++) unitig_mark_near(pr, nodes[i].key, dist-1);
+  }
+}
+
+// Removing a kmer changes the degree of its neighbours, which can only
+// split or join the unitigs that contain a neighbour or are adjacent to one
+static inline int unitig_mark_dirty(hkey_t hkey, const UnitigPruner *pr)
+{
+  if(!bitset_get(pr->flags, hkey) && pr->uidx->ids[hkey] != UNITIG_NONE)
+    unitig_mark_near(pr, hkey, 2);
+  return 0; // => keep iterating
+}
+
+static void unitig_mark_dirty_thread(void *arg)
+{
+  const UnitigPruner *pr = (const UnitigPruner*)arg;
+  HASH_ITERATE_SCHED(&pr->db_graph->ht, pr->sched, pr->threadid,
+                     unitig_mark_dirty, pr);
+}
+
+// Clear ids of removed kmers and of kmers in dirty unitigs,
+// set `out` bit for all other kmers
+static void unitig_clear_dirty_thread(void *arg)
+{
+  const UnitigPruner *pr = (const UnitigPruner*)arg;
+  const int col = pr->uidx->colour;
+  ukey_t *ids = pr->uidx->ids;
+  size_t start, end, i;
+
+  while(task_sched_next(pr->sched, pr->threadid, &start, &end)) {
+    for(i = start; i < end; i++) {
+      if(ids[i] == UNITIG_NONE) continue;
+      if(!unitig_kmer_in_col(i, col, pr->db_graph) ||
+         bitset_get(pr->flags, ids[i]))
+        ids[i] = UNITIG_NONE;
+      else
+        (void)bitset_set_mt(pr->out, i);
+    }
+  }
+}
+
+static void unitig_pruners_run(const UnitigIndex *uidx, size_t nthreads,
+                               size_t nitems,
+                               const uint8_t *flags, uint8_t *out,
+                               const dBGraph *db_graph,
+                               void (*func)(void*))
+{
+  size_t i;
+  UnitigPruner *workers = ctx_calloc(nthreads, sizeof(UnitigPruner));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, nitems, nthreads);
+
+  for(i = 0; i < nthreads; i++) {
+    UnitigPruner tmp = {.threadid = i, .sched = &sched, .uidx = uidx,
+                        .flags = flags, .out = out, .db_graph = db_graph};
+    memcpy(&workers[i], &tmp, sizeof(UnitigPruner));
+  }
+
+  util_run_threads(workers, nthreads, sizeof(UnitigPruner), nthreads, func);
+
+  task_sched_dealloc(&sched);
+  ctx_free(workers);
+}
+
+void unitig_index_flag_kmers(const UnitigIndex *uidx, size_t nthreads,
+                             const uint8_t *utig_flags, uint8_t *kmer_flags,
+                             const dBGraph *db_graph)
+{
+  unitig_pruners_run(uidx, nthreads, db_graph->ht.capacity,
+                     utig_flags, kmer_flags, db_graph,
+                     unitig_flag_kmers_thread);
+}
+
+void unitig_index_prune(UnitigIndex *uidx, size_t nthreads,
+                        const uint8_t *keep, dBGraph *db_graph)
+{
+  ctx_assert(uidx->capacity == db_graph->ht.capacity);
+  ctx_assert(uidx->colour >= 0 || uidx->num_kmers == db_graph->ht.num_kmers);
+
+  size_t i, ndirty = 0, nutigs = uidx->utigs.len;
+  uint8_t *dirty = ctx_calloc(roundup_bits2bytes(nutigs), 1);
+
+  // Find unitigs that may change, before edges are removed
+  unitig_pruners_run(uidx, nthreads, db_graph->ht.capacity, keep, dirty,
+                     db_graph, unitig_mark_dirty_thread);
+
+  if(uidx->colour < 0)
+    prune_nodes_lacking_flag(nthreads, keep, db_graph);
+  else
+    prune_col_nodes_lacking_flag(nthreads, keep, uidx->colour, db_graph);
+
+  for(i = 0; i < nutigs; i++) {
+    if(bitset_get(dirty, i) && uidx->utigs.data[i].len > 0) {
+      uidx->num_kmers -= uidx->utigs.data[i].len;
+      uidx->utigs.data[i].len = 0;
+      uidx->num_utigs--;
+      ndirty++;
+    }
+  }
+
+  // Find unitigs again for kmers in dirty unitigs
+  uint8_t *visited = ctx_calloc(roundup_bits2bytes(db_graph->ht.capacity), 1);
+  unitig_pruners_run(uidx, nthreads, db_graph->ht.capacity, dirty, visited,
+                     db_graph, unitig_clear_dirty_thread);
+  ctx_free(dirty);
+
+  size_t num_utigs_before = uidx->num_utigs;
+  unitig_index_add_unvisited(uidx, nthreads, visited, db_graph);
+  ctx_free(visited);
+
+  ctx_assert(uidx->colour >= 0 || uidx->num_kmers == db_graph->ht.num_kmers);
+
+  char ndirty_str[50], nnew_str[50];
+  ulong_to_str(ndirty, ndirty_str);
+  ulong_to_str(uidx->num_utigs - num_utigs_before, nnew_str);
+  status("[unitigs] Updated unitig index: %s unitigs replaced by %s",
+         ndirty_str, nnew_str);
+}
+
+//
+// Fetching
+//
+
+void unitig_index_fetch(const UnitigIndex *uidx, ukey_t id,
+                        dBNodeBuffer *nbuf, const dBGraph *db_graph)
+{
+  ctx_assert(id < uidx->utigs.len);
+  const Unitig *utig = &uidx->utigs.data[id];
+  ctx_assert(utig->len > 0);
+
+  // supernode_extend() looks for cycles back to nbuf->data[0], so walk in a
+  // separate buffer if nbuf already has nodes
+  size_t offset = nbuf->len;
+  db_node_buf_capacity(nbuf, offset + utig->len);
+  dBNodeBuffer walk = {.data = nbuf->data + offset, .len = 1,
+                       .capacity = utig->len};
+  walk.data[0] = utig->first;
+  supernode_extend_col(&walk, utig->len, uidx->colour, db_graph);
+  ctx_assert(walk.data == nbuf->data + offset);
+  ctx_assert2(walk.len == utig->len, "%zu vs %u", walk.len, utig->len);
+  nbuf->len += walk.len;
+}
+
+uint8_t unitig_index_next(const UnitigIndex *uidx, ukey_t id,
+                          Orientation orient,
+                          ukey_t next[4], Orientation orients[4],
+                          const dBGraph *db_graph)
+{
+  ctx_assert(id < uidx->utigs.len);
+  const Unitig *utig = &uidx->utigs.data[id], *nutig;
+  ctx_assert(utig->len > 0);
+
+  dBNode end = (orient == FORWARD ? utig->last : db_node_reverse(utig->first));
+  BinaryKmer bkmer = db_node_get_bkmer(db_graph, end.key);
+  Edges edges = uidx->colour < 0 ? db_node_get_edges_union(db_graph, end.key)
+                                 : db_node_get_edges(db_graph, end.key,
+                                                     uidx->colour);
+  dBNode nodes[4];
+  Nucleotide nucs[4];
+  uint8_t i, n;
+
+  n = db_graph_next_nodes(db_graph, bkmer, end.orient, edges, nodes, nucs);
+
+  for(i = 0; i < n; i++) {
+    next[i] = uidx->ids[nodes[i].key];
+    nutig = &uidx->utigs.data[next[i]];
+    orients[i] = (nodes[i].key == nutig->first.key &&
+                  nodes[i].orient == nutig->first.orient) ? FORWARD : REVERSE;
+  }
+
+  return n;
+}
+
+//
+// Saving / loading
+//
+
+static const char utig_magic[4] = "UTIG";
+
+void unitig_index_save(const UnitigIndex *uidx, const char *path,
+                       const dBGraph *db_graph)
+{
+  ctx_assert(uidx->colour < 0);
+  ctx_assert(uidx->num_kmers == db_graph->ht.num_kmers);
+
+  status("[unitigs] Saving unitig index to: %s", futil_outpath_str(path));
+
+  FILE *fout = futil_fopen(path, "w");
+  uint32_t version = UNITIG_INDEX_VERSION, kmer_size = db_graph->kmer_size;
+  uint32_t num_of_bitfields = NUM_BKMER_WORDS;
+  uint64_t num_utigs = uidx->num_utigs;
+  size_t i, written = 0, expwrite;
+  BinaryKmer bkmer;
+  uint8_t orient;
+
+  written += fwrite(utig_magic, 1, sizeof(utig_magic), fout);
+  written += fwrite(&version, 1, sizeof(version), fout);
+  written += fwrite(&kmer_size, 1, sizeof(kmer_size), fout);
+  written += fwrite(&num_of_bitfields, 1, sizeof(num_of_bitfields), fout);
+  written += fwrite(&num_utigs, 1, sizeof(num_utigs), fout);
+
+  for(i = 0; i < uidx->utigs.len; i++) {
+    const Unitig *utig = &uidx->utigs.data[i];
+    if(utig->len == 0) continue;
+    bkmer = db_node_get_bkmer(db_graph, utig->first.key);
+    orient = utig->first.orient;
+    written += fwrite(bkmer.b, 1, sizeof(BinaryKmer), fout);
+    written += fwrite(&orient, 1, sizeof(orient), fout);
+    written += fwrite(&utig->len, 1, sizeof(utig->len), fout);
+  }
+
+  expwrite = 24 + num_utigs * (sizeof(BinaryKmer) + 1 + sizeof(uint32_t));
+  if(written != expwrite || fclose(fout) != 0)
+    die("Cannot write unitig index [%s]: %s", strerror(errno), path);
+
+  char nutigs_str[50];
+  ulong_to_str(num_utigs, nutigs_str);
+  status("[unitigs]   wrote %s unitigs", nutigs_str);
+}
+
+typedef struct
+{
+  const size_t threadid;
+  TaskScheduler *const sched;
+  UnitigIndex *const uidx;
+  const char *path;
+  const dBGraph *db_graph;
+} UnitigLoader;
+
+static void unitig_load_thread(void *arg)
+{
+  const UnitigLoader *ld = (const UnitigLoader*)arg;
+  UnitigIndex *uidx = ld->uidx;
+  const dBGraph *db_graph = ld->db_graph;
+  size_t start, end, i, j;
+  Unitig *utig;
+
+  dBNodeBuffer nbuf;
+  CovgBuffer cbuf;
+  db_node_buf_alloc(&nbuf, 2048);
+  covg_buf_alloc(&cbuf, 2048);
+
+  while(task_sched_next(ld->sched, ld->threadid, &start, &end)) {
+    for(i = start; i < end; i++) {
+      utig = &uidx->utigs.data[i];
+      db_node_buf_reset(&nbuf);
+      db_node_buf_add(&nbuf, utig->first);
+      supernode_extend(&nbuf, (size_t)utig->len+1, db_graph);
+
+      if(nbuf.len != utig->len)
+        die("Unitig index does not match graph [unitig: %zu]: %s", i, ld->path);
+
+      for(j = 0; j < nbuf.len; j++) {
+        if(!__sync_bool_compare_and_swap(&uidx->ids[nbuf.data[j].key],
+                                         UNITIG_NONE, (ukey_t)i)) {
+          die("Unitig index has overlapping unitigs: %s", ld->path);
+        }
+      }
+
+      utig->last = nbuf.data[nbuf.len-1];
+      utig_set_covg(utig, nbuf.data, nbuf.len, -1, &cbuf, db_graph);
+    }
+  }
+
+  db_node_buf_dealloc(&nbuf);
+  covg_buf_dealloc(&cbuf);
+}
+
+void unitig_index_load(UnitigIndex *uidx, const char *path, size_t nthreads,
+                       const dBGraph *db_graph)
+{
+  ctx_assert(uidx->capacity == db_graph->ht.capacity);
+
+  status("[unitigs] Loading unitig index from: %s", path);
+
+  unitig_index_reset(uidx);
+  uidx->colour = -1;
+
+  FILE *fh = futil_fopen(path, "r");
+  char magic[4];
+  uint32_t version, kmer_size, num_of_bitfields, len;
+  uint64_t num_utigs, i;
+  BinaryKmer bkmer;
+  uint8_t orient;
+  dBNode node;
+
+  safe_fread(fh, magic, sizeof(magic), "magic", path);
+  safe_fread(fh, &version, sizeof(version), "version", path);
+  safe_fread(fh, &kmer_size, sizeof(kmer_size), "kmer size", path);
+  safe_fread(fh, &num_of_bitfields, sizeof(num_of_bitfields), "bitfields", path);
+  safe_fread(fh, &num_utigs, sizeof(num_utigs), "number of unitigs", path);
+
+  if(memcmp(magic, utig_magic, sizeof(magic)) != 0)
+    die("Not a unitig index file: %s", path);
+  if(version != UNITIG_INDEX_VERSION)
+    die("Unitig index version %u not supported: %s", version, path);
+  if(kmer_size != db_graph->kmer_size || num_of_bitfields != NUM_BKMER_WORDS)
+    die("Unitig index kmer size %u does not match graph: %s", kmer_size, path);
+
+  unitig_buf_capacity(&uidx->utigs, num_utigs);
+
+  for(i = 0; i < num_utigs; i++) {
+    safe_fread(fh, bkmer.b, sizeof(BinaryKmer), "unitig kmer", path);
+    safe_fread(fh, &orient, sizeof(orient), "unitig orientation", path);
+    safe_fread(fh, &len, sizeof(len), "unitig length", path);
+
+    node = db_graph_find(db_graph, bkmer);
+    if(node.key == HASH_NOT_FOUND || orient > 1 || len == 0)
+      die("Unitig index does not match graph [unitig: %zu]: %s", (size_t)i, path);
+
+    node.orient = orient;
+    unitig_buf_add(&uidx->utigs, (Unitig){.first = node, .len = len});
+    uidx->num_kmers += len;
+  }
+
+  if(fgetc(fh) != EOF) die("Unitig index has trailing data: %s", path);
+  fclose(fh);
+
+  if(uidx->num_kmers != db_graph->ht.num_kmers)
+    die("Unitig index does not cover the graph: %s", path);
+
+  uidx->num_utigs = num_utigs;
+
+  // Assign ids and coverage by walking unitigs
+  size_t t;
+  UnitigLoader *loaders = ctx_calloc(nthreads, sizeof(UnitigLoader));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, uidx->utigs.len, nthreads);
+
+  for(t = 0; t < nthreads; t++) {
+    UnitigLoader tmp = {.threadid = t, .sched = &sched, .uidx = uidx,
+                        .path = path, .db_graph = db_graph};
+    memcpy(&loaders[t], &tmp, sizeof(UnitigLoader));
+  }
+
+  util_run_threads(loaders, nthreads, sizeof(UnitigLoader),
+                   nthreads, unitig_load_thread);
+
+  task_sched_dealloc(&sched);
+  ctx_free(loaders);
+
+  char nutigs_str[50];
+  ulong_to_str(num_utigs, nutigs_str);
+  status("[unitigs]   loaded %s unitigs", nutigs_str);
+}
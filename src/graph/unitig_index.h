@@ -0,0 +1,110 @@
+#ifndef UNITIG_INDEX_H_
+#define UNITIG_INDEX_H_
+
+//
+// Unitig index
+//
+// Records the unitig (supernode) that each kmer belongs to, so that the
+// unitigs of a graph are found once with multiple threads instead of by each
+// caller with supernode_find(). ids[hkey] is the id of the unitig containing
+// kmer hkey. Each unitig stores its first and last node, length and coverage.
+// Unitigs are found with union edges, as supernode_find() does, and coverage
+// is summed over colours. Alternatively an index can be built for the
+// subgraph of a single colour: kmers with coverage in that colour and the
+// edges of that colour.
+//
+// unitig_index_prune() removes kmers from the graph and updates the index by
+// recomputing only unitigs within two kmers of a removed kmer; all other
+// unitigs keep their ids. Removed unitigs stay in the array with len == 0.
+//
+// The index is only valid while the graph is unchanged (other than by
+// unitig_index_prune()) and the hash table is not resized.
+//
+
+#include <pthread.h>
+
+#include "db_graph.h"
+#include "db_node.h"
+
+typedef uint64_t ukey_t;
+#define UNITIG_NONE UINT64_MAX
+
+typedef struct
+{
+  dBNode first, last; // walking forward from first reaches last
+  uint32_t len; // number of kmers, zero if the unitig has been removed
+  Covg covg_mean, covg_max, read_starts;
+} Unitig;
+
+#include "madcrowlib/madcrow_buffer.h"
+madcrow_buffer(unitig_buf, UnitigBuffer, Unitig);
+
+typedef struct
+{
+  ukey_t *ids; // one per hash table entry, UNITIG_NONE if not a kmer
+  size_t capacity;
+  UnitigBuffer utigs;
+  uint64_t num_utigs, num_kmers; // unitigs with len > 0 and kmers in them
+  int colour; // colour of unitigs, -1 for the union of all colours
+  pthread_mutex_t lock;
+} UnitigIndex;
+
+// Memory needed per hash table entry (unitig records are extra)
+#define UNITIG_INDEX_KMER_BYTES (sizeof(ukey_t))
+
+void unitig_index_alloc(UnitigIndex *uidx, size_t capacity);
+void unitig_index_dealloc(UnitigIndex *uidx);
+
+// Find all unitigs in the graph, replacing any previous contents
+void unitig_index_build(UnitigIndex *uidx, size_t nthreads,
+                        const dBGraph *db_graph);
+
+// Find unitigs in colour `col` (or the union of colours if col < 0),
+// replacing any previous contents
+void unitig_index_build_col(UnitigIndex *uidx, size_t nthreads, int col,
+                            const dBGraph *db_graph);
+
+// Remove kmers that lack their bit in `keep` from the graph
+// (see prune_nodes_lacking_flag()) and update the index to match
+// If the index is of a single colour, kmers are only removed from that colour
+// (see prune_col_nodes_lacking_flag())
+void unitig_index_prune(UnitigIndex *uidx, size_t nthreads,
+                        const uint8_t *keep, dBGraph *db_graph);
+
+// Set the bit of every kmer in a unitig whose bit is set in `utig_flags`
+void unitig_index_flag_kmers(const UnitigIndex *uidx, size_t nthreads,
+                             const uint8_t *utig_flags, uint8_t *kmer_flags,
+                             const dBGraph *db_graph);
+
+// Call func on each unitig with len > 0 using `nthreads` threads
+void unitig_index_iterate(const UnitigIndex *uidx, size_t nthreads,
+                          void (*func)(ukey_t id, const Unitig *utig,
+                                       size_t threadid, void *arg),
+                          void *arg);
+
+// Append the nodes of unitig `id` to nbuf, from first to last
+void unitig_index_fetch(const UnitigIndex *uidx, ukey_t id,
+                        dBNodeBuffer *nbuf, const dBGraph *db_graph);
+
+// Get the unitigs that follow unitig `id`, read in orientation `orient`
+// (FORWARD: after its last node; REVERSE: before its first node)
+// orients[i] is FORWARD if next[i] is entered at its first node
+// Returns number of unitigs (0-4)
+uint8_t unitig_index_next(const UnitigIndex *uidx, ukey_t id,
+                          Orientation orient,
+                          ukey_t next[4], Orientation orients[4],
+                          const dBGraph *db_graph);
+
+// File format:
+//   <4:"UTIG"><4:version><4:kmer_size><4:num_of_bitfields><8:num_unitigs>
+//   [ <B:first kmer><1:orient><4:len> ]x num_unitigs
+// Hash table positions differ between runs so ids are assigned again on
+// loading by walking each unitig from its first kmer. Coverage is recomputed
+// from the loaded graph. Loading dies if the file does not match the graph.
+// Only indexes of the union of colours can be saved.
+void unitig_index_save(const UnitigIndex *uidx, const char *path,
+                       const dBGraph *db_graph);
+void unitig_index_load(UnitigIndex *uidx, const char *path, size_t nthreads,
+                       const dBGraph *db_graph);
+
+#endif /* UNITIG_INDEX_H_ */
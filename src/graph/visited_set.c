@@ -0,0 +1,99 @@
+#include "global.h"
+#include "visited_set.h"
+
+void visited_set_alloc(VisitedSet *vset, size_t hash_capacity)
+{
+  // Use a bitmap instead once the set would use more memory
+  size_t max_size = visited_set_max_size(hash_capacity);
+
+  VisitedSet tmp = {.slots = ctx_calloc(VISITED_SET_INIT_SIZE,
+                                        sizeof(VisitedSetSlot)),
+                    .size = VISITED_SET_INIT_SIZE, .nentries = 0,
+                    .max_size = max_size, .epoch = 1,
+                    .hash_capacity = hash_capacity, .nsmall_clears = 0,
+                    .bitmap = NULL, .use_bitmap = false};
+
+  memcpy(vset, &tmp, sizeof(VisitedSet));
+}
+
+void visited_set_dealloc(VisitedSet *vset)
+{
+  ctx_free(vset->slots);
+  ctx_free(vset->bitmap);
+  memset(vset, 0, sizeof(VisitedSet));
+}
+
+// Replace the slots with an empty set of VISITED_SET_INIT_SIZE
+static void visited_set_shrink(VisitedSet *vset)
+{
+  ctx_free(vset->slots);
+  vset->slots = ctx_calloc(VISITED_SET_INIT_SIZE, sizeof(VisitedSetSlot));
+  vset->size = VISITED_SET_INIT_SIZE;
+  vset->nentries = 0;
+  vset->epoch = 1;
+  vset->nsmall_clears = 0;
+}
+
+void visited_set_clear(VisitedSet *vset)
+{
+  if(vset->use_bitmap) {
+    // Only happens after very long walks, don't hold on to the bitmap
+    ctx_free(vset->bitmap);
+    vset->bitmap = NULL;
+    vset->use_bitmap = false;
+  }
+  else if(vset->size > VISITED_SET_INIT_SIZE) {
+    if(2*vset->nentries > VISITED_SET_INIT_SIZE) vset->nsmall_clears = 0;
+    else if(++vset->nsmall_clears == VISITED_SET_SHRINK_CLEARS) {
+      visited_set_shrink(vset);
+      return;
+    }
+  }
+
+  // Epoch zero marks slots that have never been used
+  if(++vset->epoch == 0) {
+    memset(vset->slots, 0, vset->size * sizeof(VisitedSetSlot));
+    vset->epoch = 1;
+  }
+
+  vset->nentries = 0;
+}
+
+void visited_set_grow(VisitedSet *vset)
+{
+  VisitedSetSlot *old_slots = vset->slots, *slot, *end = old_slots + vset->size;
+  const uint32_t old_epoch = vset->epoch;
+  size_t new_size = vset->size * 2;
+  dBNode node;
+
+  if(new_size > vset->max_size)
+  {
+    // Switch to a bitmap until the set is next cleared
+    ctx_assert(vset->bitmap == NULL);
+    vset->bitmap = ctx_calloc(roundup_bits2words64(vset->hash_capacity*2),
+                              sizeof(uint64_t));
+
+    for(slot = old_slots; slot < end; slot++)
+      if(slot->epoch == old_epoch) bitset_set(vset->bitmap, slot->key);
+
+    vset->use_bitmap = true;
+    visited_set_shrink(vset);
+    return;
+  }
+
+  vset->slots = ctx_calloc(new_size, sizeof(VisitedSetSlot));
+  vset->size = new_size;
+  vset->epoch = 1;
+  vset->nentries = 0;
+  vset->nsmall_clears = 0;
+
+  for(slot = old_slots; slot < end; slot++) {
+    if(slot->epoch == old_epoch) {
+      node.key = slot->key >> 1;
+      node.orient = slot->key & 1;
+      visited_set_add(vset, node);
+    }
+  }
+
+  ctx_free(old_slots);
+}
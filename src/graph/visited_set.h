@@ -0,0 +1,131 @@
+#ifndef VISITED_SET_H_
+#define VISITED_SET_H_
+
+//
+// Set of oriented nodes visited by a single walk
+//
+// Walks usually visit a few thousand nodes, so a bitmap over the whole hash
+// table (2 bits per entry, per thread) wastes memory and is slow to clear.
+// Instead we use a small open-addressed hash set. Each slot is tagged with
+// the epoch it was written in, so clearing the set is just incrementing the
+// epoch. If a walk gets so long that the set would use more memory than a
+// bitmap, we switch to a bitmap until the next clear. The bitmap is freed when
+// the set is cleared, and a set that has grown is shrunk back once walks are
+// short again, so between long walks a thread only holds a small set.
+//
+
+#include "db_node.h"
+
+#define VISITED_SET_INIT_SIZE 1024
+
+// Shrink a grown set after this many clears in a row of walks that would have
+// fitted in a set of VISITED_SET_INIT_SIZE
+#define VISITED_SET_SHRINK_CLEARS 64
+
+typedef struct
+{
+  uint64_t key; // 2*hkey+orient
+  uint32_t epoch; // slot only valid if equal to VisitedSet.epoch
+} VisitedSetSlot;
+
+typedef struct
+{
+  VisitedSetSlot *slots;
+  size_t size, nentries, max_size;
+  uint32_t epoch;
+  size_t hash_capacity; // number of entries in the graph hash table
+  size_t nsmall_clears; // clears in a row with few entries, while grown
+  uint64_t *bitmap; // allocated when a walk gets too long, freed on clear
+  bool use_bitmap;
+} VisitedSet;
+
+void visited_set_alloc(VisitedSet *vset, size_t hash_capacity);
+void visited_set_dealloc(VisitedSet *vset);
+
+// Remove all nodes from the set, freeing the bitmap if one was used
+void visited_set_clear(VisitedSet *vset);
+
+// Double the size of the set, or switch to a bitmap if the set would be
+// larger than a bitmap of the whole hash table, shrinking the set back to
+// VISITED_SET_INIT_SIZE. Called by visited_set_add().
+void visited_set_grow(VisitedSet *vset);
+
+// Bytes used by a bitmap of both orientations of every hash table entry
+static inline size_t visited_set_bitmap_mem(size_t hash_capacity)
+{
+  return roundup_bits2words64(hash_capacity*2) * sizeof(uint64_t);
+}
+
+// Largest size of the set before switching to a bitmap: 16 bytes per slot vs
+// 2 bits per hash table entry
+static inline size_t visited_set_max_size(size_t hash_capacity)
+{
+  size_t max_size = VISITED_SET_INIT_SIZE;
+  while(max_size*sizeof(VisitedSetSlot)*2 <= visited_set_bitmap_mem(hash_capacity))
+    max_size *= 2;
+  return max_size;
+}
+
+// Memory usually used by a visited set: a set of VISITED_SET_INIT_SIZE.
+// A very long walk can briefly use up to visited_set_peak_mem() while it
+// switches to a bitmap; the bitmap is freed when the set is next cleared.
+static inline size_t visited_set_est_mem(size_t hash_capacity)
+{
+  (void)hash_capacity;
+  return VISITED_SET_INIT_SIZE * sizeof(VisitedSetSlot);
+}
+
+// Peak memory used by a visited set: the set at its largest plus the bitmap,
+// while copying the set into the bitmap
+static inline size_t visited_set_peak_mem(size_t hash_capacity)
+{
+  return visited_set_max_size(hash_capacity) * sizeof(VisitedSetSlot) +
+         visited_set_bitmap_mem(hash_capacity);
+}
+
+static inline size_t _visited_set_hash(uint64_t key, size_t size)
+{
+  return (size_t)((key * 0x9E3779B97F4A7C15UL) >> 32) & (size - 1);
+}
+
+static inline bool visited_set_has(const VisitedSet *vset, dBNode node)
+{
+  if(vset->use_bitmap) return db_node_has_traversed(vset->bitmap, node);
+
+  const uint64_t key = 2*node.key + node.orient;
+  const size_t mask = vset->size - 1;
+  size_t i = _visited_set_hash(key, vset->size);
+
+  for(; vset->slots[i].epoch == vset->epoch; i = (i+1) & mask)
+    if(vset->slots[i].key == key) return true;
+
+  return false;
+}
+
+// Add a node to the set
+// Returns true if node was added, false if it was already in the set
+static inline bool visited_set_add(VisitedSet *vset, dBNode node)
+{
+  if(vset->use_bitmap) {
+    if(db_node_has_traversed(vset->bitmap, node)) return false;
+    db_node_set_traversed(vset->bitmap, node);
+    return true;
+  }
+
+  const uint64_t key = 2*node.key + node.orient;
+  const size_t mask = vset->size - 1;
+  size_t i = _visited_set_hash(key, vset->size);
+
+  for(; vset->slots[i].epoch == vset->epoch; i = (i+1) & mask)
+    if(vset->slots[i].key == key) return false;
+
+  vset->slots[i] = (VisitedSetSlot){.key = key, .epoch = vset->epoch};
+  vset->nentries++;
+
+  // Keep load below one half
+  if(2*vset->nentries > vset->size) visited_set_grow(vset);
+
+  return true;
+}
+
+#endif /* VISITED_SET_H_ */
@@ -365,7 +365,7 @@ static int _kmer_check_paths(hkey_t hkey, const dBGraph *db_graph,
   GPath *gpath;
   int exp_klen = -1;
 
-  for(gpath = gpstore->paths_all[hkey]; gpath != NULL; gpath = gpath->next)
+  for(gpath = gpath_store_fetch(gpstore, hkey); gpath != NULL; gpath = gpath->next)
   {
     if(gpath_set_has_nseen(gpset)) exp_klen = gpath_set_get_klen(gpset, gpath);
     ctx_assert_ret(gpath_checks_path(hkey, gpath, exp_klen, db_graph));
@@ -381,6 +381,7 @@ static int _kmer_check_paths(hkey_t hkey, const dBGraph *db_graph,
 typedef struct
 {
   size_t threadid, nthreads;
+  TaskScheduler *sched;
   size_t num_gpaths, num_kmers;
   const dBGraph *db_graph;
 } GPathChecker;
@@ -391,8 +392,8 @@ void _gpath_check_all_paths_thread(void *arg)
   const dBGraph *db_graph = ch->db_graph;
   size_t num_gpaths = 0, num_kmers = 0;
 
-  HASH_ITERATE_PART(&db_graph->ht, ch->threadid, ch->nthreads,
-                    _kmer_check_paths, db_graph, &num_gpaths, &num_kmers);
+  HASH_ITERATE_SCHED(&db_graph->ht, ch->sched, ch->threadid,
+                     _kmer_check_paths, db_graph, &num_gpaths, &num_kmers);
 
   ch->num_gpaths = num_gpaths;
   ch->num_kmers = num_kmers;
@@ -404,10 +405,13 @@ bool gpath_checks_all_paths(const dBGraph *db_graph, size_t nthreads)
 
   size_t i;
   GPathChecker *checkers = ctx_calloc(nthreads, sizeof(GPathChecker));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, nthreads);
 
   for(i = 0; i < nthreads; i++) {
     checkers[i].threadid = i;
     checkers[i].nthreads = nthreads;
+    checkers[i].sched = &sched;
     checkers[i].db_graph = db_graph;
   }
 
@@ -420,6 +424,7 @@ bool gpath_checks_all_paths(const dBGraph *db_graph, size_t nthreads)
     num_gpaths += checkers[i].num_gpaths;
     num_kmers += checkers[i].num_kmers;
   }
+  task_sched_dealloc(&sched);
   ctx_free(checkers);
 
   size_t act_num_gpaths = db_graph->gpstore.gpset.entries.len;
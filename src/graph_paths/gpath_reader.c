@@ -3,6 +3,7 @@
 #include "file_util.h"
 #include "util.h"
 #include "hash_mem.h"
+#include "cmd_mem.h"
 #include "common_buffers.h"
 #include "binary_seq.h"
 #include "binary_kmer.h"
@@ -11,6 +12,14 @@
 #include "gpath_store.h"
 #include "gpath_subset.h"
 #include "json_hdr.h"
+#include "gpath_save.h" // binary format
+
+#include "msg-pool/msgpool.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 /*
 // File format:
@@ -177,6 +186,10 @@ void gpath_reader_open2(GPathReader *file, const char *path, const char *mode,
   // DEV: validate json header
   _parse_json_header(file);
 
+  cJSON *version = cJSON_GetObjectItem(file->json, "format_version");
+  file->binary = (version != NULL && version->type == cJSON_Number &&
+                  version->valueint == CTP_FORMAT_VERSION_BIN);
+
   // The following functions call die() if kmer_size or ncols header fields
   // are missing
   size_t kmer_size = gpath_reader_get_kmer_size(file);
@@ -228,8 +241,10 @@ typedef struct
   bool looked_up; // Whether we have tried to find the key in the graph
 } LoadPathKmer;
 
+// If bktlocks is not NULL, we may be called by multiple threads at once
 static void _validate_new_path(LoadPathKmer *load, const char *path,
                                uint8_t *nseen, size_t nseencols,
+                               volatile uint8_t *bktlocks,
                                dBGraph *db_graph)
 {
   if(load->looked_up) return;
@@ -238,7 +253,11 @@ static void _validate_new_path(LoadPathKmer *load, const char *path,
 
   switch(load->kmer_flags) {
     case GPATH_ADD_MISSING_KMERS:
-      load->hkey = hash_table_find_or_insert(&db_graph->ht, load->bkey, &found);
+      if(bktlocks != NULL)
+        load->hkey = hash_table_find_or_insert_mt(&db_graph->ht, load->bkey,
+                                                  &found, bktlocks);
+      else
+        load->hkey = hash_table_find_or_insert(&db_graph->ht, load->bkey, &found);
       break;
     case GPATH_DIE_MISSING_KMERS:
       load->hkey = hash_table_find(&db_graph->ht, load->bkey);
@@ -259,8 +278,10 @@ static void _validate_new_path(LoadPathKmer *load, const char *path,
   // If inserted, add to colour
   size_t i;
   if(!found && load->hkey != HASH_NOT_FOUND && db_graph->node_in_cols) {
-    for(i = 0; i < nseencols; i++)
-      db_node_or_col(db_graph, load->hkey, i, nseen[i] > 0);
+    for(i = 0; i < nseencols; i++) {
+      if(bktlocks == NULL) db_node_or_col(db_graph, load->hkey, i, nseen[i] > 0);
+      else if(nseen[i] > 0) db_node_set_col_mt(db_graph, load->hkey, i);
+    }
   }
 
   load->found = found;
@@ -309,26 +330,100 @@ static void _gpath_reader_load_kmer_line(const char *path,
   memcpy(result, &load, sizeof(LoadPathKmer));
 }
 
+/**
+ * Add a path to `gpset` once it has been parsed
+ * @param file_nseen  counts for file->fltr.filencols colours
+ * @param tmp_nseen2  temporary memory of length intoncols(file->fltr)
+ * @param bktlocks    if not NULL, may be called by multiple threads at once
+ */
+static void _gpath_reader_add_path(const GPathReader *file,
+                                   const uint8_t *file_nseen,
+                                   uint8_t *tmp_nseen2,
+                                   uint8_t *seq, Orientation orient,
+                                   size_t num_kmers, size_t num_juncs,
+                                   LoadPathKmer *load_kmer,
+                                   const size_t *max_contigs,
+                                   volatile uint8_t *bktlocks,
+                                   GPathSet *gpset,
+                                   dBGraph *db_graph)
+{
+  const char *path = file_filter_path(&file->fltr);
+  size_t into_ncols = file_filter_into_ncols(&file->fltr);
+  size_t i;
+
+  // Filter colours
+  bool path_in_cols = false;
+  size_t contig_len = num_kmers + db_graph->kmer_size - 1;
+  size_t fromcol, intocol;
+  memset(tmp_nseen2, 0, sizeof(uint8_t) * into_ncols);
+
+  for(i = 0; i < file_filter_num(&file->fltr); i++)
+  {
+    fromcol = file_filter_fromcol(&file->fltr, i);
+    intocol = file_filter_intocol(&file->fltr, i);
+    tmp_nseen2[intocol] = MIN2((size_t)UINT8_MAX,
+                               (size_t)tmp_nseen2[intocol] + file_nseen[fromcol]);
+
+    if(tmp_nseen2[intocol] > 0) {
+      path_in_cols = true;
+      if(contig_len > max_contigs[intocol]) die("Invalid CTP contig histogram");
+    }
+  }
+
+  if(path_in_cols)
+  {
+    // Load kmer
+    _validate_new_path(load_kmer, path, tmp_nseen2, into_ncols,
+                       bktlocks, db_graph);
+
+    if(load_kmer->hkey != HASH_NOT_FOUND)
+    {
+      // Add to GPathSet
+      GPathNew newgpath = {.seq = seq,
+                           .colset = NULL, .nseen = NULL,
+                           .orient = orient,
+                           .klen = num_kmers,
+                           .num_juncs = num_juncs};
+
+      GPath *gpath = gpath_set_add_mt(gpset, newgpath);
+
+      ctx_assert(into_ncols <= gpset->ncols);
+
+      // Update nseen / colour bitset
+      uint8_t *nseen = gpath_set_get_nseen(gpset, gpath);
+      uint8_t *colset = gpath_get_colset(gpath, gpset->ncols);
+
+      for(i = 0; i < into_ncols; i++) {
+        nseen[i] = MIN2((size_t)UINT8_MAX, (size_t)nseen[i] + tmp_nseen2[i]);
+        bitset_or(colset, i, nseen[i] > 0);
+      }
+    }
+  }
+
+  load_kmer->num_paths_seen++;
+}
+
 /**
  * Format: [FR] [nkmers] [njuncs] [nseen,nseen,nseen] [seq:ACAGT] .. (ignored)
  * @param line        buffer holding input line to parse
  * @param tmp_nseen1  temporary memory of length file->fltr.filencols
  * @param tmp_nseen2  temporary memory of length intoncols(file->fltr)
  * @param tmp_seqbuf  temporary memory buffer
+ * @param bktlocks    if not NULL, may be called by multiple threads at once
  * @param gpset       GPathSet to add new path to
  * @param db_graph    We look up and add kmers to this graph
  */
-static void _gpath_reader_load_path_line(GPathReader *file, StrBuf *line,
+static void _gpath_reader_load_path_line(const GPathReader *file, StrBuf *line,
                                          uint8_t *tmp_nseen1,
                                          uint8_t *tmp_nseen2,
                                          ByteBuffer *tmp_seqbuf,
                                          LoadPathKmer *load_kmer,
-                                         size_t *max_contigs,
+                                         const size_t *max_contigs,
+                                         volatile uint8_t *bktlocks,
                                          GPathSet *gpset,
                                          dBGraph *db_graph)
 {
   const char *path = file_filter_path(&file->fltr);
-  size_t into_ncols = file_filter_into_ncols(&file->fltr);
   size_t i, num_kmers, num_juncs;
   Orientation orient;
   char *pstr, *endpstr;
@@ -374,55 +469,9 @@ static void _gpath_reader_load_path_line(GPathReader *file, StrBuf *line,
   byte_buf_capacity(tmp_seqbuf, (num_juncs+3)/4);
   binary_seq_from_str(pstr, num_juncs, tmp_seqbuf->data);
 
-  // Filter colours
-  bool path_in_cols = false;
-  size_t contig_len = num_kmers + db_graph->kmer_size - 1;
-  size_t fromcol, intocol;
-  memset(tmp_nseen2, 0, sizeof(uint8_t) * into_ncols);
-
-  for(i = 0; i < file_filter_num(&file->fltr); i++)
-  {
-    fromcol = file_filter_fromcol(&file->fltr, i);
-    intocol = file_filter_intocol(&file->fltr, i);
-    tmp_nseen2[intocol] = MIN2((size_t)UINT8_MAX,
-                               (size_t)tmp_nseen2[intocol] + tmp_nseen1[fromcol]);
-
-    if(tmp_nseen2[intocol] > 0) {
-      path_in_cols = true;
-      if(contig_len > max_contigs[intocol]) die("Invalid CTP contig histogram");
-    }
-  }
-
-  if(path_in_cols)
-  {
-    // Load kmer
-    _validate_new_path(load_kmer, path, tmp_nseen2, into_ncols, db_graph);
-
-    if(load_kmer->hkey != HASH_NOT_FOUND)
-    {
-      // Add to GPathSet
-      GPathNew newgpath = {.seq = tmp_seqbuf->data,
-                           .colset = NULL, .nseen = NULL,
-                           .orient = orient,
-                           .klen = num_kmers,
-                           .num_juncs = num_juncs};
-
-      GPath *gpath = gpath_set_add_mt(gpset, newgpath);
-
-      ctx_assert(into_ncols <= gpset->ncols);
-
-      // Update nseen / colour bitset
-      uint8_t *nseen = gpath_set_get_nseen(gpset, gpath);
-      uint8_t *colset = gpath_get_colset(gpath, gpset->ncols);
-
-      for(i = 0; i < into_ncols; i++) {
-        nseen[i] = MIN2((size_t)UINT8_MAX, (size_t)nseen[i] + tmp_nseen2[i]);
-        bitset_or(colset, i, nseen[i] > 0);
-      }
-    }
-  }
-
-  load_kmer->num_paths_seen++;
+  _gpath_reader_add_path(file, tmp_nseen1, tmp_nseen2, tmp_seqbuf->data,
+                         orient, num_kmers, num_juncs,
+                         load_kmer, max_contigs, bktlocks, gpset, db_graph);
 }
 
 // @subset0 and @subset1 are temporary memory to be used in the loading
@@ -476,34 +525,101 @@ static size_t _load_paths_from_set(dBGraph *db_graph, GPathSet *gpset,
   return subset1->list.len;
 }
 
-/**
- * @param kmer_flags must be one of:
- *   * GPATH_ADD_MISSING_KMERS - add kmers to the graph before loading path
- *   * GPATH_DIE_MISSING_KMERS - die with error if cannot find kmer
- *   * GPATH_SKIP_MISSING_KMERS - skip paths where kmer is not in graph
- */
-void gpath_reader_load(GPathReader *file, int kmer_flags, dBGraph *db_graph)
+//
+// Binary format
+//
+
+typedef struct
+{
+  char *data; // byte at file offset x is data[x-start]
+  size_t start, len;
+  void *mmap_ptr; // if mapped, otherwise data was allocated
+  size_t mmap_len;
+} GPathBinData;
+
+// Memory map a binary path file, or read the rest of it into memory if we
+// cannot (e.g. it has been compressed or is a pipe)
+static void _gpath_reader_bin_open(GPathReader *file, GPathBinData *bin)
 {
-  gzFile gzin = file->gz;
-  const char *path = file->fltr.path.b;
+  const char *path = file_filter_path(&file->fltr);
+  struct stat st;
+  int fd = -1;
 
-  file_filter_status(&file->fltr);
+  memset(bin, 0, sizeof(*bin));
 
-  // Read kmer lines
-  // <KMER> <num>
-  // [FR] [nkmers] [njuncs] [nseen,nseen,nseen] [seq:ACAGT] .. ignored
-  StrBuf line;
-  strbuf_alloc(&line, 2048);
+  if(gzdirect(file->gz) && (fd = open(path, O_RDONLY)) >= 0 &&
+     fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(ptr != MAP_FAILED) {
+      bin->mmap_ptr = ptr;
+      bin->mmap_len = st.st_size;
+      bin->data = ptr;
+      bin->start = 0;
+      bin->len = st.st_size;
+    }
+    else warn("Cannot memory map file, reading: %s [%s]", path, strerror(errno));
+  }
 
-  size_t into_ncols = file_filter_into_ncols(&file->fltr);
-  uint8_t *nseenbuf1 = ctx_calloc(file->fltr.filencols, sizeof(uint8_t));
-  uint8_t *nseenbuf2 = ctx_calloc(into_ncols, sizeof(uint8_t));
+  if(fd >= 0) close(fd);
+  if(bin->data != NULL) return;
 
-  size_t *max_contigs = ctx_calloc(into_ncols, sizeof(size_t));
-  gpath_reader_get_max_contig_lens(file, max_contigs);
+  // Read remainder of the file
+  size_t cap = 16 * ONE_MEGABYTE, len = 0;
+  char *buf = ctx_malloc(cap);
+  int n;
 
-  ByteBuffer seqbuf;
-  byte_buf_alloc(&seqbuf, 64);
+  bin->start = gztell(file->gz);
+  while((n = gzread(file->gz, buf+len, MIN2(cap-len, (size_t)INT_MAX))) > 0) {
+    len += n;
+    if(len == cap) { cap *= 2; buf = ctx_realloc(buf, cap); }
+  }
+  if(n < 0) die("Cannot read file: %s", path);
+
+  bin->data = buf;
+  bin->len = len;
+}
+
+static void _gpath_reader_bin_close(GPathBinData *bin)
+{
+  if(bin->mmap_ptr != NULL) munmap(bin->mmap_ptr, bin->mmap_len);
+  else ctx_free(bin->data);
+  memset(bin, 0, sizeof(*bin));
+}
+
+typedef struct
+{
+  size_t threadid, nthreads;
+  const GPathReader *file;
+  const GPathBinData *bin;
+  const CtpBinBlock *blocks;
+  size_t nblocks, table_offset;
+  int kmer_flags;
+  const size_t *max_contigs;
+  volatile uint8_t *bktlocks;
+  dBGraph *db_graph;
+  // Stats
+  size_t num_kmers, num_kmers_loaded, num_paths_loaded;
+} GPathBinLoader;
+
+// Check there are `n` bytes at `ptr` and return pointer to the next byte
+#define bin_next(ptr,n,end,path) \
+  ({ load_check((size_t)((end)-(ptr)) >= (n), "Truncated file: %s", path); \
+     (ptr) + (n); })
+
+// pthread method, load blocks threadid, threadid+nthreads, ...
+static void _gpath_reader_load_bin_blocks(void *arg)
+{
+  GPathBinLoader *ldr = (GPathBinLoader*)arg;
+  const GPathReader *file = ldr->file;
+  const GPathBinData *bin = ldr->bin;
+  dBGraph *db_graph = ldr->db_graph;
+  const char *path = file_filter_path(&file->fltr);
+  const size_t kmer_size = db_graph->kmer_size;
+  const size_t filencols = file->fltr.filencols;
+  const size_t colset_bytes = (filencols+7)/8;
+
+  uint8_t *nseenbuf = ctx_calloc(file_filter_into_ncols(&file->fltr), 1);
 
   // Load paths into this temporary set for each kmer
   GPathSet gpset;
@@ -513,68 +629,500 @@ void gpath_reader_load(GPathReader *file, int kmer_flags, dBGraph *db_graph)
   gpath_subset_alloc(&subset0);
   gpath_subset_alloc(&subset1);
 
+  size_t b, k, p, block_end, num_juncs;
+  uint32_t npaths, klen;
+  uint16_t juncs_orient;
+  char *ptr, *end, *nseen, *seq;
+  BinaryKmer bkey;
   LoadPathKmer load_kmer;
-  size_t num_kmers = 0, num_kmers_exp = gpath_reader_get_num_kmers(file);
-  size_t num_paths_loaded = 0, num_kmers_loaded = 0;
-
-  while(strbuf_reset_gzreadline(&line, gzin) > 0) {
-    strbuf_chomp(&line);
-    if(line.end > 0 && line.b[0] != '#') {
-      if(line.b[0] == 'F' || line.b[0] == 'R') {
-        // Assume path line
-        // status("Path line: %s", line.b);
-        load_check(num_kmers != 0, "Path before kmer: %s", path);
-
-        _gpath_reader_load_path_line(file, &line,
-                                     nseenbuf1, nseenbuf2, &seqbuf,
-                                     &load_kmer, max_contigs,
-                                     &gpset, db_graph);
+
+  for(b = ldr->threadid; b < ldr->nblocks; b += ldr->nthreads)
+  {
+    const CtpBinBlock *blk = &ldr->blocks[b];
+    block_end = b+1 < ldr->nblocks ? ldr->blocks[b+1].offset : ldr->table_offset;
+    load_check(bin->start <= blk->offset && blk->offset <= block_end &&
+               block_end <= ldr->table_offset, "Bad block offset: %s", path);
+
+    ptr = bin->data + (blk->offset - bin->start);
+    end = bin->data + (block_end - bin->start);
+    size_t block_npaths = 0;
+
+    for(k = 0; k < blk->nkmers; k++)
+    {
+      memcpy(bkey.b, ptr, sizeof(BinaryKmer));
+      ptr = bin_next(ptr, sizeof(BinaryKmer), end, path);
+      memcpy(&npaths, ptr, sizeof(npaths));
+      ptr = bin_next(ptr, sizeof(npaths), end, path);
+
+      load_check(binary_kmers_are_equal(bkey, binary_kmer_get_key(bkey, kmer_size)),
+                 "Bkmer not bkey: %s", path);
+
+      load_kmer = (LoadPathKmer){.bkey = bkey, .hkey = HASH_NOT_FOUND,
+                                 .found = false, .looked_up = false,
+                                 .kmer_flags = ldr->kmer_flags,
+                                 .num_paths_exp = npaths,
+                                 .num_paths_seen = 0};
+
+      for(p = 0; p < npaths; p++)
+      {
+        memcpy(&klen, ptr, sizeof(klen));
+        ptr = bin_next(ptr, sizeof(klen), end, path);
+        memcpy(&juncs_orient, ptr, sizeof(juncs_orient));
+        ptr = bin_next(ptr, sizeof(juncs_orient), end, path);
+
+        num_juncs = juncs_orient & GPATH_MAX_JUNCS;
+        load_check(klen > num_juncs, "%zu %zu", (size_t)klen, num_juncs);
+
+        nseen = ptr;
+        seq = bin_next(ptr, filencols + colset_bytes, end, path);
+        ptr = bin_next(seq, (num_juncs+3)/4, end, path);
+
+        _gpath_reader_add_path(file, (uint8_t*)nseen, nseenbuf,
+                               (uint8_t*)seq, juncs_orient >> 15,
+                               klen, num_juncs, &load_kmer, ldr->max_contigs,
+                               ldr->bktlocks, &gpset, db_graph);
       }
-      else {
-        // Assume kmer line
-        // Load previous paths if this is not the first kmer
-        if(num_kmers > 0 && load_kmer.hkey != HASH_NOT_FOUND) {
-          num_kmers_loaded += (gpset.entries.len > 0);
-          num_paths_loaded += _load_paths_from_set(db_graph, &gpset,
-                                                   &subset0, &subset1,
-                                                   &load_kmer, path);
-        }
-
-        _gpath_reader_load_kmer_line(path, &line, kmer_flags, &load_kmer, db_graph);
-
-        num_kmers++;
+
+      if(load_kmer.hkey != HASH_NOT_FOUND) {
+        ldr->num_kmers_loaded += (gpset.entries.len > 0);
+        ldr->num_paths_loaded += _load_paths_from_set(db_graph, &gpset,
+                                                      &subset0, &subset1,
+                                                      &load_kmer, path);
       }
+
+      block_npaths += npaths;
     }
+
+    load_check(ptr == end && block_npaths == blk->npaths,
+               "Block does not match contents: %s", path);
+
+    ldr->num_kmers += blk->nkmers;
+  }
+
+  gpath_subset_dealloc(&subset0);
+  gpath_subset_dealloc(&subset1);
+  gpath_set_dealloc(&gpset);
+  ctx_free(nseenbuf);
+}
+
+static void _gpath_reader_load_bin(GPathReader *file, int kmer_flags,
+                                   size_t nthreads, dBGraph *db_graph)
+{
+  const char *path = file_filter_path(&file->fltr);
+  const size_t footer_len = 2*sizeof(uint64_t) + CTP_BIN_MAGIC_LEN;
+  size_t i, nblocks, table_offset, file_len;
+  uint64_t footer[2];
+
+  GPathBinData bin;
+  _gpath_reader_bin_open(file, &bin);
+  file_len = bin.start + bin.len;
+
+  load_check(bin.len >= footer_len &&
+             memcmp(bin.data + bin.len - CTP_BIN_MAGIC_LEN,
+                    CTP_BIN_MAGIC, CTP_BIN_MAGIC_LEN) == 0,
+             "Binary path file missing footer: %s", path);
+
+  memcpy(footer, bin.data + bin.len - footer_len, sizeof(footer));
+  nblocks = footer[0];
+  table_offset = footer[1];
+
+  load_check(table_offset >= bin.start &&
+             table_offset + nblocks * sizeof(CtpBinBlock) + footer_len == file_len,
+             "Bad block table: %s", path);
+
+  CtpBinBlock *blocks = ctx_malloc(nblocks * sizeof(CtpBinBlock));
+  memcpy(blocks, bin.data + (table_offset - bin.start),
+         nblocks * sizeof(CtpBinBlock));
+
+  size_t *max_contigs = ctx_calloc(file_filter_into_ncols(&file->fltr),
+                                   sizeof(size_t));
+  gpath_reader_get_max_contig_lens(file, max_contigs);
+
+  nthreads = MAX2(MIN2(nthreads, nblocks), 1);
+
+  // Inserting from multiple threads requires bucket locks
+  uint8_t *bktlocks = NULL;
+  if(nthreads > 1) {
+    bktlocks = db_graph->bktlocks;
+    if(bktlocks == NULL)
+      bktlocks = ctx_calloc(roundup_bits2bytes(db_graph->ht.num_of_buckets), 1);
+  }
+
+  GPathBinLoader *ldrs = ctx_calloc(nthreads, sizeof(GPathBinLoader));
+
+  for(i = 0; i < nthreads; i++) {
+    ldrs[i] = (GPathBinLoader){.threadid = i, .nthreads = nthreads,
+                               .file = file, .bin = &bin,
+                               .blocks = blocks, .nblocks = nblocks,
+                               .table_offset = table_offset,
+                               .kmer_flags = kmer_flags,
+                               .max_contigs = max_contigs,
+                               .bktlocks = bktlocks,
+                               .db_graph = db_graph};
   }
 
-  if(num_kmers > 0 && load_kmer.hkey != HASH_NOT_FOUND) {
-    num_kmers_loaded += (gpset.entries.len > 0);
-    num_paths_loaded += _load_paths_from_set(db_graph, &gpset,
-                                             &subset0, &subset1,
-                                             &load_kmer, path);
+  util_run_threads(ldrs, nthreads, sizeof(*ldrs), nthreads,
+                   _gpath_reader_load_bin_blocks);
+
+  size_t num_kmers = 0, num_kmers_loaded = 0, num_paths_loaded = 0;
+  for(i = 0; i < nthreads; i++) {
+    num_kmers += ldrs[i].num_kmers;
+    num_kmers_loaded += ldrs[i].num_kmers_loaded;
+    num_paths_loaded += ldrs[i].num_paths_loaded;
   }
 
-  load_check(num_kmers == (size_t)num_kmers_exp,
-             "num_kmers don't match (exp %zu vs %zu)",
-             num_kmers, (size_t)num_kmers_exp);
+  size_t num_kmers_exp = gpath_reader_get_num_kmers(file);
+  load_check(num_kmers == num_kmers_exp,
+             "num_kmers don't match (exp %zu vs %zu)", num_kmers, num_kmers_exp);
 
   // Print status update
   char npaths_str[50], nkmers_str[50];
   ulong_to_str(num_paths_loaded, npaths_str);
   ulong_to_str(num_kmers_loaded, nkmers_str);
-  status("Loaded %s paths from %s kmers", npaths_str, nkmers_str);
+  status("Loaded %s paths from %s kmers [%zu blocks, %zu threads]",
+         npaths_str, nkmers_str, nblocks, nthreads);
 
-  gpath_subset_dealloc(&subset0);
-  gpath_subset_dealloc(&subset1);
+  if(bktlocks != db_graph->bktlocks) ctx_free(bktlocks);
+  ctx_free(ldrs);
+  ctx_free(max_contigs);
+  ctx_free(blocks);
+  _gpath_reader_bin_close(&bin);
+}
 
-  gpath_set_dealloc(&gpset);
-  strbuf_dealloc(&line);
-  byte_buf_dealloc(&seqbuf);
-  ctx_free(nseenbuf1);
-  ctx_free(nseenbuf2);
+//
+// Text format
+//
+
+// Number of bytes of text decompressed into each block at a time
+#define GPLOAD_BLOCK_BYTES (1UL<<20)
+// Number of blocks in the pool per worker thread
+#define GPLOAD_BLOCKS_PER_THREAD 4
+
+// Parses text lines and loads paths, one per thread
+typedef struct
+{
+  MsgPool *pool; // NULL if not using blocks
+  const GPathReader *file;
+  int kmer_flags;
+  const size_t *max_contigs;
+  volatile uint8_t *bktlocks;
+  dBGraph *db_graph;
+  // Temporary memory
+  StrBuf line;
+  uint8_t *nseenbuf1, *nseenbuf2;
+  ByteBuffer seqbuf;
+  GPathSet gpset; // Load paths into this temporary set for each kmer
+  GPathSubset subset0, subset1;
+  LoadPathKmer load_kmer;
+  bool have_kmer;
+  // Stats
+  size_t num_kmers, num_kmers_loaded, num_paths_loaded;
+} GPathTextLoader;
+
+typedef struct
+{
+  char *data;
+  size_t len, size;
+} GPathTextBlock;
+
+typedef struct
+{
+  MsgPool *pool;
+  gzFile gz;
+  const char *path;
+} GPathTextReader;
+
+static void _gpath_text_loader_alloc(GPathTextLoader *ldr, MsgPool *pool,
+                                     const GPathReader *file, int kmer_flags,
+                                     const size_t *max_contigs,
+                                     volatile uint8_t *bktlocks,
+                                     dBGraph *db_graph)
+{
+  memset(ldr, 0, sizeof(*ldr));
+  ldr->pool = pool;
+  ldr->file = file;
+  ldr->kmer_flags = kmer_flags;
+  ldr->max_contigs = max_contigs;
+  ldr->bktlocks = bktlocks;
+  ldr->db_graph = db_graph;
+
+  strbuf_alloc(&ldr->line, 2048);
+  ldr->nseenbuf1 = ctx_calloc(file->fltr.filencols, sizeof(uint8_t));
+  ldr->nseenbuf2 = ctx_calloc(file_filter_into_ncols(&file->fltr),
+                              sizeof(uint8_t));
+  byte_buf_alloc(&ldr->seqbuf, 64);
+  gpath_set_alloc(&ldr->gpset, db_graph->num_of_cols, ONE_MEGABYTE, true, true);
+  gpath_subset_alloc(&ldr->subset0);
+  gpath_subset_alloc(&ldr->subset1);
+}
+
+static void _gpath_text_loader_dealloc(GPathTextLoader *ldr)
+{
+  gpath_subset_dealloc(&ldr->subset0);
+  gpath_subset_dealloc(&ldr->subset1);
+  gpath_set_dealloc(&ldr->gpset);
+  byte_buf_dealloc(&ldr->seqbuf);
+  strbuf_dealloc(&ldr->line);
+  ctx_free(ldr->nseenbuf1);
+  ctx_free(ldr->nseenbuf2);
+}
+
+// Add paths for the current kmer to the graph
+static void _gpath_text_loader_flush(GPathTextLoader *ldr)
+{
+  const char *path = file_filter_path(&ldr->file->fltr);
+
+  if(ldr->have_kmer && ldr->load_kmer.hkey != HASH_NOT_FOUND) {
+    ldr->num_kmers_loaded += (ldr->gpset.entries.len > 0);
+    ldr->num_paths_loaded += _load_paths_from_set(ldr->db_graph, &ldr->gpset,
+                                                  &ldr->subset0, &ldr->subset1,
+                                                  &ldr->load_kmer, path);
+  }
+
+  ldr->have_kmer = false;
+}
+
+// Parse the line in ldr->line
+// <KMER> <num>
+// [FR] [nkmers] [njuncs] [nseen,nseen,nseen] [seq:ACAGT] .. ignored
+static void _gpath_text_loader_line(GPathTextLoader *ldr)
+{
+  StrBuf *line = &ldr->line;
+  const char *path = file_filter_path(&ldr->file->fltr);
+
+  strbuf_chomp(line);
+  if(line->end == 0 || line->b[0] == '#') return;
+
+  if(line->b[0] == 'F' || line->b[0] == 'R') {
+    // Assume path line
+    load_check(ldr->have_kmer, "Path before kmer: %s", path);
+
+    _gpath_reader_load_path_line(ldr->file, line,
+                                 ldr->nseenbuf1, ldr->nseenbuf2, &ldr->seqbuf,
+                                 &ldr->load_kmer, ldr->max_contigs,
+                                 ldr->bktlocks, &ldr->gpset, ldr->db_graph);
+  }
+  else {
+    // Assume kmer line
+    // Load paths for the previous kmer
+    _gpath_text_loader_flush(ldr);
+
+    _gpath_reader_load_kmer_line(path, line, ldr->kmer_flags,
+                                 &ldr->load_kmer, ldr->db_graph);
+
+    ldr->have_kmer = true;
+    ldr->num_kmers++;
+  }
+}
+
+static void _gpath_text_pool_init(void *el, size_t idx, void *args)
+{
+  GPathTextBlock *blocks = (GPathTextBlock*)args, *block = blocks + idx;
+  memcpy(el, &block, sizeof(GPathTextBlock*));
+}
+
+static void _gpath_text_block_capacity(GPathTextBlock *block, size_t size)
+{
+  if(block->size < size) {
+    block->size = roundup2pow(size);
+    block->data = ctx_realloc(block->data, block->size);
+  }
+}
+
+// Find the start of the last kmer line beginning in data[start..end-1]
+// Returns 0 if there isn't one (the first line is never returned)
+static size_t _gpath_text_last_kmer_line(const char *data,
+                                         size_t start, size_t end)
+{
+  size_t i;
+  for(i = end; i > MAX2(start, 1); i--)
+    if(data[i-2] == '\n' && char_is_acgt(data[i-1])) return i-1;
+  return 0;
+}
+
+// pthread method, loop: decompress text into a block, add to pool
+// Blocks are split before kmer lines, so each kmer and its paths are passed
+// to a single worker. Text after the split is carried over to the next block.
+static void* _gpath_text_read_blocks(void *arg)
+{
+  GPathTextReader *rdr = (GPathTextReader*)arg;
+  GPathTextBlock *block, carry = {.data = NULL, .len = 0, .size = 0};
+  size_t split, prev_len;
+  bool eof = false;
+  int pos, n;
+
+  while(!eof)
+  {
+    pos = msgpool_claim_write(rdr->pool);
+    memcpy(&block, msgpool_get_ptr(rdr->pool, pos), sizeof(GPathTextBlock*));
+
+    _gpath_text_block_capacity(block, carry.len + GPLOAD_BLOCK_BYTES);
+    if(carry.len) memcpy(block->data, carry.data, carry.len);
+    block->len = carry.len;
+
+    // Read until we can split before a kmer line or we reach the end
+    for(split = 0; !eof && split == 0; )
+    {
+      _gpath_text_block_capacity(block, block->len + GPLOAD_BLOCK_BYTES);
+      n = gzread(rdr->gz, block->data + block->len, GPLOAD_BLOCK_BYTES);
+      if(n < 0) die("Error reading file: %s", rdr->path);
+      prev_len = block->len;
+      block->len += (size_t)n;
+      eof = (n == 0);
+      split = _gpath_text_last_kmer_line(block->data, prev_len, block->len);
+    }
+
+    if(eof) split = block->len;
+
+    carry.len = block->len - split;
+    _gpath_text_block_capacity(&carry, carry.len);
+    if(carry.len) memcpy(carry.data, block->data + split, carry.len);
+    block->len = split;
+
+    msgpool_release(rdr->pool, pos, block->len ? MPOOL_FULL : MPOOL_EMPTY);
+  }
+
+  ctx_free(carry.data);
+  msgpool_close(rdr->pool);
+  return NULL;
+}
+
+// pthread method, loop: take a block from the pool, load its lines
+static void _gpath_text_load_blocks(void *arg)
+{
+  GPathTextLoader *ldr = (GPathTextLoader*)arg;
+  GPathTextBlock *block;
+  const char *ptr, *end, *eol;
+  int pos;
+
+  while((pos = msgpool_claim_read(ldr->pool)) != -1)
+  {
+    memcpy(&block, msgpool_get_ptr(ldr->pool, pos), sizeof(GPathTextBlock*));
+
+    for(ptr = block->data, end = ptr + block->len; ptr < end; ptr = eol)
+    {
+      eol = memchr(ptr, '\n', (size_t)(end - ptr));
+      eol = eol ? eol+1 : end;
+      strbuf_reset(&ldr->line);
+      strbuf_append_strn(&ldr->line, ptr, (size_t)(eol - ptr));
+      _gpath_text_loader_line(ldr);
+    }
+
+    // Block ends before a kmer line so we have all paths for the last kmer
+    _gpath_text_loader_flush(ldr);
+
+    msgpool_release(ldr->pool, pos, MPOOL_EMPTY);
+  }
+}
+
+// Load text paths with one thread decompressing and `nthreads` parsing
+static void _gpath_reader_load_text(GPathReader *file, int kmer_flags,
+                                    size_t nthreads, dBGraph *db_graph)
+{
+  const char *path = file_filter_path(&file->fltr);
+  size_t i, nblocks = GPLOAD_BLOCKS_PER_THREAD * nthreads;
+  int rc;
+
+  size_t *max_contigs = ctx_calloc(file_filter_into_ncols(&file->fltr),
+                                   sizeof(size_t));
+  gpath_reader_get_max_contig_lens(file, max_contigs);
+
+  nthreads = MAX2(nthreads, 1);
+
+  // Inserting from multiple threads requires bucket locks
+  uint8_t *bktlocks = NULL;
+  if(nthreads > 1) {
+    bktlocks = db_graph->bktlocks;
+    if(bktlocks == NULL)
+      bktlocks = ctx_calloc(roundup_bits2bytes(db_graph->ht.num_of_buckets), 1);
+  }
+
+  GPathTextLoader *ldrs = ctx_calloc(nthreads, sizeof(GPathTextLoader));
+
+  if(nthreads == 1)
+  {
+    _gpath_text_loader_alloc(&ldrs[0], NULL, file, kmer_flags, max_contigs,
+                             NULL, db_graph);
+
+    while(strbuf_reset_gzreadline(&ldrs[0].line, file->gz) > 0)
+      _gpath_text_loader_line(&ldrs[0]);
+
+    _gpath_text_loader_flush(&ldrs[0]);
+  }
+  else
+  {
+    GPathTextBlock *blocks = ctx_calloc(nblocks, sizeof(GPathTextBlock));
+
+    MsgPool pool;
+    msgpool_alloc(&pool, nblocks, sizeof(GPathTextBlock*), USE_MSG_POOL);
+    msgpool_iterate(&pool, _gpath_text_pool_init, blocks);
+
+    for(i = 0; i < nthreads; i++) {
+      _gpath_text_loader_alloc(&ldrs[i], &pool, file, kmer_flags, max_contigs,
+                               bktlocks, db_graph);
+    }
+
+    GPathTextReader reader = {.pool = &pool, .gz = file->gz, .path = path};
+
+    pthread_t reader_thread;
+    rc = pthread_create(&reader_thread, NULL, _gpath_text_read_blocks, &reader);
+    if(rc != 0) die("Creating thread failed: %s", strerror(rc));
+
+    util_run_threads(ldrs, nthreads, sizeof(*ldrs), nthreads,
+                     _gpath_text_load_blocks);
+
+    rc = pthread_join(reader_thread, NULL);
+    if(rc != 0) die("Joining thread failed: %s", strerror(rc));
+
+    msgpool_dealloc(&pool);
+    for(i = 0; i < nblocks; i++) ctx_free(blocks[i].data);
+    ctx_free(blocks);
+  }
+
+  size_t num_kmers = 0, num_kmers_loaded = 0, num_paths_loaded = 0;
+  for(i = 0; i < nthreads; i++) {
+    num_kmers += ldrs[i].num_kmers;
+    num_kmers_loaded += ldrs[i].num_kmers_loaded;
+    num_paths_loaded += ldrs[i].num_paths_loaded;
+    _gpath_text_loader_dealloc(&ldrs[i]);
+  }
+
+  size_t num_kmers_exp = gpath_reader_get_num_kmers(file);
+  load_check(num_kmers == num_kmers_exp,
+             "num_kmers don't match (exp %zu vs %zu)", num_kmers, num_kmers_exp);
+
+  // Print status update
+  char npaths_str[50], nkmers_str[50];
+  ulong_to_str(num_paths_loaded, npaths_str);
+  ulong_to_str(num_kmers_loaded, nkmers_str);
+  status("Loaded %s paths from %s kmers [%zu threads]",
+         npaths_str, nkmers_str, nthreads);
+
+  if(bktlocks != db_graph->bktlocks) ctx_free(bktlocks);
+  ctx_free(ldrs);
   ctx_free(max_contigs);
 }
 
+/**
+ * @param kmer_flags must be one of:
+ *   * GPATH_ADD_MISSING_KMERS - add kmers to the graph before loading path
+ *   * GPATH_DIE_MISSING_KMERS - die with error if cannot find kmer
+ *   * GPATH_SKIP_MISSING_KMERS - skip paths where kmer is not in graph
+ * @param nthreads number of threads to use
+ */
+void gpath_reader_load(GPathReader *file, int kmer_flags, size_t nthreads,
+                       dBGraph *db_graph)
+{
+  file_filter_status(&file->fltr);
+
+  if(file->binary) {
+    _gpath_reader_load_bin(file, kmer_flags, nthreads, db_graph);
+    return;
+  }
+
+  _gpath_reader_load_text(file, kmer_flags, nthreads, db_graph);
+}
+
 void gpath_reader_load_sample_names(const GPathReader *file, dBGraph *db_graph)
 {
   const FileFilter *fltr = &file->fltr;
@@ -665,9 +1213,17 @@ size_t gpath_reader_sum_mem(GPathReader *files, size_t nfiles,
 
 size_t gpath_reader_mem_req(GPathReader *files, size_t nfiles,
                             size_t ncols, size_t max_mem,
-                            bool count_nseen)
+                            bool count_nseen, bool compact)
 {
-  size_t max_file_mem = 0, path_sum_mem;
+  size_t max_file_mem = 0, path_sum_mem, compact_mem = 0;
+
+  // Compacting the path store copies the path sequences
+  if(compact) {
+    compact_mem = gpath_reader_compact_mem(files, nfiles, ncols);
+    if(compact_mem) cmd_print_mem(compact_mem, "path compaction");
+    max_mem -= MIN2(max_mem, compact_mem);
+  }
+
   path_sum_mem = gpath_reader_sum_mem(files, nfiles, ncols, count_nseen, false,
                                       &max_file_mem);
 
@@ -677,16 +1233,39 @@ size_t gpath_reader_mem_req(GPathReader *files, size_t nfiles,
     die("Require at least %s memory for paths", memstr);
   }
 
-  return MIN2(max_mem, path_sum_mem);
+  return MIN2(max_mem, path_sum_mem) + compact_mem;
+}
+
+// Extra memory needed to compact a store holding the paths of these files
+// (see gpath_store_compact()): a copy of the colsets and sequences, plus one
+// bit per path
+size_t gpath_reader_compact_mem(GPathReader *files, size_t nfiles, size_t ncols)
+{
+  size_t i, npaths, mem = 0;
+
+  for(i = 0; i < nfiles; i++) {
+    npaths = gpath_reader_get_num_paths(&files[i]);
+    mem += gpath_reader_get_path_bytes(&files[i]) + // Sequence
+           npaths * ((ncols+7)/8) + // Colset
+           roundup_bits2bytes(npaths); // listed bitset
+  }
+
+  return mem;
 }
 
 // Create a path store that does not tracks path counts
 void gpath_reader_alloc_gpstore(GPathReader *files, size_t nfiles,
-                                size_t mem, bool count_nseen,
+                                size_t mem, bool count_nseen, bool compact,
                                 dBGraph *db_graph)
 {
   if(nfiles == 0) return;
 
+  if(compact) {
+    size_t compact_mem = gpath_reader_compact_mem(files, nfiles,
+                                                  db_graph->num_of_cols);
+    mem -= MIN2(mem, compact_mem);
+  }
+
   size_t sum_mem = gpath_reader_sum_mem(files, nfiles, db_graph->num_of_cols,
                                         count_nseen, false, NULL);
 
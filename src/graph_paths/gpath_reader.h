@@ -17,6 +17,7 @@ typedef struct
   // size_t kmer_size, num_paths, path_bytes, kmers_with_paths;
   size_t ncolours;
   cJSON **colours_json;
+  bool binary; // binary format (format_version 4)
 } GPathReader;
 
 #define GPATH_ADD_MISSING_KMERS   0
@@ -43,7 +44,10 @@ void gpath_reader_check(const GPathReader *file, size_t kmer_size, size_t ncols)
 //   GPATH_ADD_MISSING_KMERS - add kmers to the graph before loading path
 //   GPATH_DIE_MISSING_KMERS - die with error if cannot find kmer
 //   GPATH_SKIP_MISSING_KMERS - skip paths where kmer is not in graph
-void gpath_reader_load(GPathReader *file, int kmer_flags, dBGraph *db_graph);
+// Paths are loaded with `nthreads`: binary files by block, text files are
+// decompressed by one thread and parsed by `nthreads`
+void gpath_reader_load(GPathReader *file, int kmer_flags, size_t nthreads,
+                       dBGraph *db_graph);
 void gpath_reader_close(GPathReader *file);
 
 // Fetch information from header
@@ -76,13 +80,23 @@ size_t gpath_reader_sum_mem(GPathReader *files, size_t nfiles,
                             size_t ncols, bool count_nseen, bool use_gphash,
                             size_t *max_file_mem_ptr);
 
+// Memory for a path store holding these files, at most @max_mem
+// If @compact, also includes the memory to compact the store later (see
+// gpath_store_compact()), which is taken out of @max_mem first.
+// Pass the same @compact to gpath_reader_alloc_gpstore()
 size_t gpath_reader_mem_req(GPathReader *files, size_t nfiles,
                             size_t ncols, size_t max_mem,
-                            bool count_nseen);
+                            bool count_nseen, bool compact);
+
+// Extra memory needed to compact a store holding the paths of these files
+// (see gpath_store_compact()): a copy of the colsets and sequences, plus one
+// bit per path
+size_t gpath_reader_compact_mem(GPathReader *files, size_t nfiles, size_t ncols);
 
 // Create a path store that does not tracks path counts
+// If @compact, memory to compact the store is kept free out of @mem
 void gpath_reader_alloc_gpstore(GPathReader *files, size_t nfiles,
-                                size_t mem, bool count_nseen,
+                                size_t mem, bool count_nseen, bool compact,
                                 dBGraph *db_graph);
 
 #endif /* GPATH_READER_H_ */
@@ -66,7 +66,7 @@ cJSON* gpath_save_mkhdr(const char *path,
   cJSON *json = cJSON_CreateObject();
 
   cJSON_AddStringToObject(json, "file_format", "ctp");
-  cJSON_AddNumberToObject(json, "format_version", 3);
+  cJSON_AddNumberToObject(json, "format_version", CTP_FORMAT_VERSION_TEXT);
 
   // Add standard cortex header info
   json_hdr_add_std(json, path, hdrs, nhdrs, db_graph);
@@ -206,6 +206,7 @@ static inline int _gpath_gzsave_node(hkey_t hkey,
 typedef struct
 {
   size_t threadid, nthreads;
+  TaskScheduler *sched;
   bool save_seq; // write seq=... juncpos=...
   gzFile gzout;
   pthread_mutex_t *outlock;
@@ -229,12 +230,12 @@ static void gpath_save_thread(void *arg)
   db_node_buf_alloc(&nbuf, 1024);
   size_buf_alloc(&jposbuf, 256);
 
-  HASH_ITERATE_PART(&db_graph->ht, wrkr->threadid, wrkr->nthreads,
-                    _gpath_gzsave_node,
-                    &sbuf, &subset,
-                    wrkr->save_seq ? &nbuf : NULL, wrkr->save_seq ? &jposbuf : NULL,
-                    wrkr->gzout, wrkr->outlock,
-                    db_graph);
+  HASH_ITERATE_SCHED(&db_graph->ht, wrkr->sched, wrkr->threadid,
+                     _gpath_gzsave_node,
+                     &sbuf, &subset,
+                     wrkr->save_seq ? &nbuf : NULL, wrkr->save_seq ? &jposbuf : NULL,
+                     wrkr->gzout, wrkr->outlock,
+                     db_graph);
 
   _gpath_save_flush(wrkr->gzout, &sbuf, wrkr->outlock);
 
@@ -275,13 +276,16 @@ void gpath_save(gzFile gzout, const char *path,
   // Multithreaded
   GPathSaver *wrkrs = ctx_calloc(nthreads, sizeof(GPathSaver));
   pthread_mutex_t outlock;
+  TaskScheduler sched;
   size_t i;
 
   if(pthread_mutex_init(&outlock, NULL) != 0) die("Mutex init failed");
+  task_sched_alloc(&sched, db_graph->ht.capacity, nthreads);
 
   for(i = 0; i < nthreads; i++) {
     wrkrs[i] = (GPathSaver){.threadid = i,
                             .nthreads = nthreads,
+                            .sched = &sched,
                             .save_seq = save_path_seq,
                             .gzout = gzout,
                             .outlock = &outlock,
@@ -292,7 +296,188 @@ void gpath_save(gzFile gzout, const char *path,
   util_run_threads(wrkrs, nthreads, sizeof(*wrkrs), nthreads, gpath_save_thread);
 
   pthread_mutex_destroy(&outlock);
+  task_sched_dealloc(&sched);
   ctx_free(wrkrs);
 
   status("[GPathSave] Graph paths saved to %s", path);
 }
+
+//
+// Binary format
+//
+
+typedef struct
+{
+  BinaryKmer bkey;
+  hkey_t hkey;
+} GPathSaveKmer;
+
+static int _gpath_save_kmer_cmp(const void *a, const void *b)
+{
+  return binary_kmers_cmp(((const GPathSaveKmer*)a)->bkey,
+                          ((const GPathSaveKmer*)b)->bkey);
+}
+
+static inline void _gpath_save_get_kmer(hkey_t hkey, GPathSaveKmer **kmers,
+                                        size_t *nkmers, size_t *cap,
+                                        const dBGraph *db_graph)
+{
+  if(gpath_store_fetch(&db_graph->gpstore, hkey) == NULL) return;
+  if(*nkmers == *cap) {
+    *cap *= 2;
+    *kmers = ctx_realloc(*kmers, *cap * sizeof(GPathSaveKmer));
+  }
+  (*kmers)[(*nkmers)++] = (GPathSaveKmer){.bkey = db_graph->ht.table[hkey],
+                                          .hkey = hkey};
+}
+
+static inline void _bin_append(ByteBuffer *buf, const void *ptr, size_t n)
+{
+  byte_buf_capacity(buf, buf->len + n);
+  memcpy(buf->data + buf->len, ptr, n);
+  buf->len += n;
+}
+
+typedef struct
+{
+  const GPathSaveKmer *kmers;
+  size_t nkmers, npaths;
+  ByteBuffer buf;
+  GPathSubset subset;
+  const dBGraph *db_graph;
+} GPathBinSaver;
+
+// Encode a block of kmers and their paths into wrkr->buf
+static void gpath_save_bin_block(void *arg)
+{
+  GPathBinSaver *wrkr = (GPathBinSaver*)arg;
+  const GPathStore *gpstore = &wrkr->db_graph->gpstore;
+  const GPathSet *gpset = &gpstore->gpset;
+  const size_t ncols = gpset->ncols, colset_bytes = (ncols+7)/8;
+  const GPath *gpath;
+  size_t i, j;
+  uint32_t npaths, klen;
+  uint16_t juncs_orient;
+
+  wrkr->buf.len = 0;
+  wrkr->npaths = 0;
+
+  for(i = 0; i < wrkr->nkmers; i++)
+  {
+    gpath_subset_reset(&wrkr->subset);
+    gpath_subset_load_llist(&wrkr->subset,
+                            gpath_store_fetch(gpstore, wrkr->kmers[i].hkey));
+    gpath_subset_sort(&wrkr->subset);
+
+    npaths = wrkr->subset.list.len;
+    _bin_append(&wrkr->buf, wrkr->kmers[i].bkey.b, sizeof(BinaryKmer));
+    _bin_append(&wrkr->buf, &npaths, sizeof(npaths));
+
+    for(j = 0; j < npaths; j++)
+    {
+      gpath = wrkr->subset.list.data[j];
+      klen = gpath_set_get_klen(gpset, gpath);
+      juncs_orient = gpath->num_juncs | ((uint16_t)gpath->orient << 15);
+      _bin_append(&wrkr->buf, &klen, sizeof(klen));
+      _bin_append(&wrkr->buf, &juncs_orient, sizeof(juncs_orient));
+      _bin_append(&wrkr->buf, gpath_set_get_nseen(gpset, gpath), ncols);
+      _bin_append(&wrkr->buf, gpath_get_colset(gpath, ncols),
+                  colset_bytes + (gpath->num_juncs+3)/4);
+    }
+
+    wrkr->npaths += npaths;
+  }
+}
+
+static inline void _gpath_save_fwrite(const void *ptr, size_t n, FILE *fout)
+{
+  if(fwrite(ptr, 1, n, fout) != n)
+    die("Cannot write to file [%s]", strerror(errno));
+}
+
+void gpath_save_bin(FILE *fout, const char *path, size_t nthreads,
+                    cJSON **hdrs, size_t nhdrs,
+                    const ZeroSizeBuffer *contig_hists, size_t ncols,
+                    dBGraph *db_graph)
+{
+  ctx_assert(nthreads > 0);
+  ctx_assert(gpath_set_has_nseen(&db_graph->gpstore.gpset));
+  ctx_assert(ncols == db_graph->gpstore.gpset.ncols);
+
+  char npaths_str[50];
+  ulong_to_str(db_graph->gpstore.num_paths, npaths_str);
+
+  status("Saving %s paths to: %s [binary]", npaths_str, path);
+  status("  using %zu threads", nthreads);
+
+  // Write header
+  cJSON *json = gpath_save_mkhdr(path, hdrs, nhdrs, contig_hists, ncols, db_graph);
+  cJSON_ReplaceItemInObject(json, "format_version",
+                            cJSON_CreateNumber(CTP_FORMAT_VERSION_BIN));
+  size_t offset = json_hdr_fprint(json, fout);
+  cJSON_Delete(json);
+
+  // Pad to 8 bytes
+  const uint8_t zeros[8] = {0};
+  size_t padding = (8 - offset % 8) % 8;
+  _gpath_save_fwrite(zeros, padding, fout);
+  offset += padding;
+
+  // Get kmers with paths, sorted
+  size_t i, nkmers = 0, kmers_cap = 1024;
+  GPathSaveKmer *kmers = ctx_malloc(kmers_cap * sizeof(GPathSaveKmer));
+  HASH_ITERATE(&db_graph->ht, _gpath_save_get_kmer,
+               &kmers, &nkmers, &kmers_cap, db_graph);
+  qsort(kmers, nkmers, sizeof(GPathSaveKmer), _gpath_save_kmer_cmp);
+
+  size_t nblocks = (nkmers + CTP_BIN_BLOCK_KMERS - 1) / CTP_BIN_BLOCK_KMERS;
+  CtpBinBlock *blocks = ctx_calloc(nblocks, sizeof(CtpBinBlock));
+
+  GPathBinSaver *wrkrs = ctx_calloc(nthreads, sizeof(GPathBinSaver));
+
+  for(i = 0; i < nthreads; i++) {
+    wrkrs[i].db_graph = db_graph;
+    byte_buf_alloc(&wrkrs[i].buf, ONE_MEGABYTE);
+    gpath_subset_alloc(&wrkrs[i].subset);
+    gpath_subset_init(&wrkrs[i].subset, &db_graph->gpstore.gpset);
+  }
+
+  // Encode nthreads blocks at a time, write them out in order
+  size_t b, n, start;
+  for(b = 0; b < nblocks; b += n)
+  {
+    n = MIN2(nthreads, nblocks - b);
+    for(i = 0; i < n; i++) {
+      start = (b+i) * CTP_BIN_BLOCK_KMERS;
+      wrkrs[i].kmers = kmers + start;
+      wrkrs[i].nkmers = MIN2(CTP_BIN_BLOCK_KMERS, nkmers - start);
+    }
+
+    util_run_threads(wrkrs, n, sizeof(*wrkrs), n, gpath_save_bin_block);
+
+    for(i = 0; i < n; i++) {
+      blocks[b+i] = (CtpBinBlock){.offset = offset,
+                                  .nkmers = wrkrs[i].nkmers,
+                                  .npaths = wrkrs[i].npaths};
+      _gpath_save_fwrite(wrkrs[i].buf.data, wrkrs[i].buf.len, fout);
+      offset += wrkrs[i].buf.len;
+    }
+  }
+
+  // Write block table and footer
+  uint64_t footer[2] = {nblocks, offset};
+  _gpath_save_fwrite(blocks, nblocks * sizeof(CtpBinBlock), fout);
+  _gpath_save_fwrite(footer, sizeof(footer), fout);
+  _gpath_save_fwrite(CTP_BIN_MAGIC, CTP_BIN_MAGIC_LEN, fout);
+
+  for(i = 0; i < nthreads; i++) {
+    byte_buf_dealloc(&wrkrs[i].buf);
+    gpath_subset_dealloc(&wrkrs[i].subset);
+  }
+
+  ctx_free(wrkrs);
+  ctx_free(blocks);
+  ctx_free(kmers);
+
+  status("[GPathSave] Graph paths saved to %s in %zu blocks", path, nblocks);
+}
@@ -15,6 +15,38 @@ kmer [num] .. ignored
 
 extern const char ctp_explanation_comment[];
 
+/*
+// Binary file format (format_version 4):
+<JSON_HEADER><zero padding to 8 bytes>
+<kmer record> x num_kmers_with_paths, sorted by kmer, split into blocks
+<CtpBinBlock> x num_blocks
+<uint64_t:num_blocks><uint64_t:block_table_offset><char[8]:CTP_BIN_MAGIC>
+
+kmer record: <BinaryKmer:bkey><uint32_t:num_paths><path record> x num_paths
+path record: <uint32_t:nkmers><uint16_t:njuncs | orient<<15>
+             <uint8_t x ncols:nseen><uint8_t x (ncols+7)/8:colset>
+             <uint8_t x (njuncs+3)/4:seq>
+
+colset+seq are laid out as in GPathSet.seqs. Offsets are from the start of
+the file. Blocks can be loaded independently.
+*/
+
+#define CTP_FORMAT_VERSION_TEXT 3
+#define CTP_FORMAT_VERSION_BIN  4
+
+#define CTP_BIN_MAGIC "CTPBLOCK"
+#define CTP_BIN_MAGIC_LEN 8
+#define CTP_BIN_BLOCK_KMERS (1<<14)
+
+typedef struct
+{
+  uint64_t offset, nkmers, npaths;
+} CtpBinBlock;
+
+// Bytes in a path record
+#define ctp_bin_path_bytes(ncols,njuncs) \
+  (sizeof(uint32_t)+sizeof(uint16_t)+(ncols)+((ncols)+7)/8+((njuncs)+3)/4)
+
 cJSON* gpath_save_mkhdr(const char *path,
                         cJSON **hdrs, size_t nhdrs,
                         const ZeroSizeBuffer *contig_hists, size_t ncols,
@@ -43,4 +75,14 @@ void gpath_save(gzFile gzout, const char *path,
                 const ZeroSizeBuffer *contig_hists, size_t ncols,
                 dBGraph *db_graph);
 
+/**
+ * Save paths to a file in the binary format. Does not seek so `fout` may be
+ * a pipe.
+ * @param hdrs is array of JSON headers of input files
+ */
+void gpath_save_bin(FILE *fout, const char *path, size_t nthreads,
+                    cJSON **hdrs, size_t nhdrs,
+                    const ZeroSizeBuffer *contig_hists, size_t ncols,
+                    dBGraph *db_graph);
+
 #endif /* GPATH_SAVE_H_ */
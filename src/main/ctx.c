@@ -4,6 +4,7 @@
 #include "commands.h"
 #include "util.h"
 #include "file_util.h"
+#include "json_hdr.h"
 
 // To add a new command to ctx31 <cmd>:
 // 0. create a file src/commands/ctx_X.c
@@ -35,6 +36,11 @@ CtxCmd cmdobjs[] = {
   .blurb = "index a sorted cortex graph file",
   .usage = index_usage
 },
+{
+  .cmd = "query", .func = ctx_query, .hide = false,
+  .blurb = "look up kmers in a sorted, indexed graph file",
+  .usage = query_usage
+},
 {
   .cmd = "view", .func = ctx_view, .hide = false,
   .blurb = "text view of a cortex graph file (.ctx)",
@@ -155,6 +161,7 @@ static const char options[] =
 "  -t, --threads <T>     Limit on proccessing threads [default: 2]\n"
 "  -o, --out <file>      Output file\n"
 "  -p, --paths <in.ctp>  Assembly file to load (can specify multiple times)\n"
+"  --stats-json <out>    Write timings, memory and thread statistics as JSON\n"
 "\n";
 
 static int ctxcmd_cmp(const void *aa, const void *bb)
@@ -245,14 +252,33 @@ int main(int argc, char **argv)
       argv[argi] = argv[argi+1];
   }
 
+  // Look for --stats-json <out> argument
+  const char *stats_path = NULL;
+  argi = 1;
+  while(argi < argc && strcmp(argv[argi],"--stats-json") != 0)
+    argi++;
+
+  if(argi < argc) {
+    if(argi+1 == argc) cmd_print_usage("--stats-json <out> requires an argument");
+    stats_path = argv[argi+1];
+    // Remove argument and its value
+    for(argc -= 2; argi < argc; argi++)
+      argv[argi] = argv[argi+2];
+  }
+
   // Print status header
   cmd_print_status_header();
 
   SWAP(argv[1],argv[0]);
   int ret = cmd->func(argc-1, argv+1);
+  ctx_prof_phase_end();
+
+  if(stats_path != NULL) json_hdr_save_stats(stats_path);
 
   time(&end);
   cmd_destroy();
+  json_hdr_clear_thread_stats();
+  ctx_prof_destroy();
 
   // Warn if more allocations than deallocations
   size_t still_alloced = alloc_get_num_allocs() - alloc_get_num_frees();
@@ -46,7 +46,7 @@ int main(int argc, char **argv)
   }
 
   // Load path files, add kmers that are missing
-  gpath_reader_load(&pfile, GPATH_ADD_MISSING_KMERS, &db_graph);
+  gpath_reader_load(&pfile, GPATH_ADD_MISSING_KMERS, 1, &db_graph);
 
   hash_table_print_stats(&db_graph.ht);
 
@@ -26,10 +26,18 @@ int main(int argc, char **argv)
     test_hash_table();
     test_db_node();
     test_build_graph();
+    test_covg_edge_buf();
+    test_db_graph_grow();
+    test_build_graph_grow_mt();
+    test_build_graph_bloom();
+    test_kmer_bloom_mt();
+    test_build_graph_parts();
     test_supernode();
     test_subgraph();
     test_cleaning();
     test_paths();
+    test_seq_shard();
+    test_graph_file_blocks();
     // test_path_sets(); // DEV: replace with test_path_subset()
     test_graph_walker();
     test_corrected_aln();
@@ -41,6 +49,7 @@ int main(int argc, char **argv)
   #endif
 
   cmd_destroy();
+  ctx_prof_destroy();
 
   // Check we free'd all our memory
   size_t still_alloced = alloc_get_num_allocs() - alloc_get_num_frees();
@@ -61,6 +61,7 @@ void gpath_hash_alloc(GPathHash *gphash, GPathStore *gpstore, size_t mem_in_byte
 
 void gpath_hash_dealloc(GPathHash *gphash)
 {
+  if(gphash->num_entries > 0) gpath_hash_record_fill(gphash);
   ctx_free(gphash->bucket_nitems);
   ctx_free(gphash->bktlocks);
   ctx_free(gphash->table);
@@ -83,6 +84,14 @@ void gpath_hash_print_stats(const GPathHash *gphash)
          (100.0 * gphash->num_entries) / gphash->capacity);
 }
 
+void gpath_hash_record_fill(const GPathHash *gphash)
+{
+  uint64_t fill[256] = {0};
+  size_t i;
+  for(i = 0; i < gphash->num_of_buckets; i++) fill[gphash->bucket_nitems[i]]++;
+  ctx_prof_set_hist("gpath_hash_bucket_fill", fill, gphash->bucket_size+1);
+}
+
 static inline bool _gphash_entries_match(const GPathSet *gpset, GPEntry entry,
                                          hkey_t hkey, GPathNew newgpath)
 {
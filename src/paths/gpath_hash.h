@@ -47,6 +47,8 @@ void gpath_hash_dealloc(GPathHash *phash);
 void gpath_hash_reset(GPathHash *phash);
 
 void gpath_hash_print_stats(const GPathHash *phash);
+// Save histogram of number of entries per bucket for profiling
+void gpath_hash_record_fill(const GPathHash *phash);
 
 // Returns NULL if out of memory
 // Thread Safe: uses bucket level locks
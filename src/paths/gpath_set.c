@@ -105,6 +105,40 @@ void gpath_set_print_stats(const GPathSet *gpset)
          (100.0 * gpset->seqs.len) / gpset->seqs.capacity);
 }
 
+// Drop all but the first `npaths` paths and copy their colsets and sequences
+// into a new buffer in path order, so neighbouring paths are adjacent in memory
+void gpath_set_compact(GPathSet *gpset, size_t npaths)
+{
+  ctx_assert(npaths <= gpset->entries.len);
+
+  const size_t colset_bytes = (gpset->ncols+7)/8;
+  size_t i, nbytes, seq_bytes = 0;
+  GPath *gpath;
+  ByteBuffer seqs;
+
+  for(i = 0; i < npaths; i++)
+    seq_bytes += colset_bytes + (gpset->entries.data[i].num_juncs+3)/4;
+
+  byte_buf_alloc(&seqs, seq_bytes+STORE_PADDING);
+
+  for(i = 0; i < npaths; i++) {
+    gpath = &gpset->entries.data[i];
+    nbytes = colset_bytes + (gpath->num_juncs+3)/4;
+    memcpy(seqs.data + seqs.len, gpath->seq - colset_bytes, nbytes);
+    gpath->seq = seqs.data + seqs.len + colset_bytes;
+    seqs.len += nbytes;
+  }
+
+  byte_buf_dealloc(&gpset->seqs);
+  gpset->seqs = seqs;
+  gpset->entries.len = npaths;
+
+  if(gpath_set_has_nseen(gpset)) {
+    gpset->klen_buf.len = npaths;
+    gpset->nseen_buf.len = npaths * gpset->ncols;
+  }
+}
+
 // Get kmer length of a GPath
 uint32_t gpath_set_get_klen(const GPathSet *gpset, const GPath *gpath)
 {
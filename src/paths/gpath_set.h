@@ -54,6 +54,11 @@ void gpath_set_reset(GPathSet *set);
 
 void gpath_set_print_stats(const GPathSet *gpset);
 
+// Drop all but the first `npaths` paths and copy their colsets and sequences
+// into a new buffer in path order, so neighbouring paths are adjacent in memory
+// Not threadsafe
+void gpath_set_compact(GPathSet *gpset, size_t npaths);
+
 // Always adds new path. If newpath could be a duplicate, use gpathhash
 // Threadsafe only if resize is false. GPath* not safe to edit until it returns
 // Copies newgpath.seq over and wipe new colset
@@ -1,5 +1,6 @@
 #include "global.h"
 #include "gpath_store.h"
+#include "gpath_subset.h"
 #include "util.h"
 
 // @split_linked_lists whether you intend to have traverse linked list and
@@ -39,6 +40,7 @@ void gpath_store_dealloc(GPathStore *gpstore)
   gpath_set_dealloc(&gpstore->gpset);
   gpath_store_merge_read_write(gpstore);
   ctx_free(gpstore->paths_all);
+  ctx_free(gpstore->offsets);
   memset(gpstore, 0, sizeof(*gpstore));
 }
 
@@ -46,6 +48,16 @@ void gpath_store_reset(GPathStore *gpstore)
 {
   gpath_set_reset(&gpstore->gpset);
   gpstore->num_kmers_with_paths = gpstore->num_paths = gpstore->path_bytes = 0;
+
+  if(gpath_store_is_compact(gpstore)) {
+    // Go back to linked lists
+    gpstore->paths_all = ctx_calloc(gpstore->graph_capacity, sizeof(GPath*));
+    gpstore->paths_traverse = gpstore->paths_all;
+    ctx_free(gpstore->offsets);
+    gpstore->offsets = NULL;
+    return;
+  }
+
   memset(gpstore->paths_all, 0, gpstore->graph_capacity * sizeof(GPath*));
   if(gpstore->paths_traverse != gpstore->paths_all)
     memset(gpstore->paths_traverse, 0, gpstore->graph_capacity * sizeof(GPath*));
@@ -84,16 +96,119 @@ void gpath_store_merge_read_write(GPathStore *gpstore)
   }
 }
 
+static inline GPath* _gpstore_fetch_compact(const GPathStore *gpstore,
+                                            hkey_t hkey)
+{
+  size_t num_paths;
+  GPath *gpath = gpath_store_fetch_range(gpstore, hkey, &num_paths);
+  return num_paths ? gpath : NULL;
+}
+
 GPath* gpath_store_fetch(const GPathStore *gpstore, hkey_t hkey)
 {
+  if(gpath_store_is_compact(gpstore))
+    return _gpstore_fetch_compact(gpstore, hkey);
   return gpstore->paths_all[hkey];
 }
 
 GPath* gpath_store_fetch_traverse(const GPathStore *gpstore, hkey_t hkey)
 {
+  if(gpath_store_is_compact(gpstore))
+    return _gpstore_fetch_compact(gpstore, hkey);
   return gpstore->paths_traverse[hkey];
 }
 
+static inline void _gpstore_swap_paths(GPathSet *gpset, pkey_t a, pkey_t b)
+{
+  uint8_t *nseen_a, *nseen_b;
+  size_t i;
+
+  SWAP(gpset->entries.data[a], gpset->entries.data[b]);
+
+  if(gpath_set_has_nseen(gpset)) {
+    SWAP(gpset->klen_buf.data[a], gpset->klen_buf.data[b]);
+    nseen_a = gpset->nseen_buf.data + a*gpset->ncols;
+    nseen_b = gpset->nseen_buf.data + b*gpset->ncols;
+    for(i = 0; i < gpset->ncols; i++) SWAP(nseen_a[i], nseen_b[i]);
+  }
+}
+
+// Convert to the read-only CSR layout. Paths that have been dropped from the
+// linked lists are removed. Peak memory is an extra copy of the path sequences.
+void gpath_store_compact(GPathStore *gpstore)
+{
+  if(gpstore->paths_all == NULL) return; // store not allocated
+
+  ctx_assert(!gpath_store_is_compact(gpstore));
+  ctx_assert(gpstore->paths_traverse == gpstore->paths_all);
+  ctx_assert(sizeof(pkey_t) == sizeof(GPath*));
+
+  GPathSet *gpset = &gpstore->gpset;
+  GPath *entries = gpset->entries.data, *gpath;
+  const size_t npaths = gpset->entries.len;
+  size_t i, n;
+  pkey_t dst, nlisted = 0;
+  hkey_t hkey;
+
+  status("[GPathStore] Compacting paths...");
+
+  // Paths that are still in a linked list
+  uint8_t *listed = ctx_calloc(roundup_bits2bytes(npaths), 1);
+  GPathPtrBuffer list;
+  gpath_ptr_buf_alloc(&list, 64);
+
+  // Offsets are written over the linked list heads as we go
+  pkey_t *offsets = ctx_realloc(gpstore->paths_all,
+                                (gpstore->graph_capacity+1) * sizeof(pkey_t));
+  gpstore->paths_all = gpstore->paths_traverse = NULL;
+
+  // Pick where each path goes, using gpath->next to store its new position
+  for(hkey = 0; hkey < gpstore->graph_capacity; hkey++)
+  {
+    gpath_ptr_buf_reset(&list);
+    memcpy(&gpath, &offsets[hkey], sizeof(GPath*));
+    for(; gpath != NULL; gpath = gpath->next)
+      gpath_ptr_buf_add(&list, gpath);
+
+    qsort(list.data, list.len, sizeof(GPath*), gpath_cmp_void);
+
+    offsets[hkey] = nlisted;
+    for(i = 0; i < list.len; i++, nlisted++) {
+      bitset_set(listed, list.data[i] - entries);
+      list.data[i]->next = entries + nlisted;
+    }
+  }
+
+  offsets[gpstore->graph_capacity] = nlisted;
+
+  // Dropped paths go at the end
+  for(i = 0, dst = nlisted; i < npaths; i++)
+    if(!bitset_get(listed, i)) entries[i].next = entries + dst++;
+
+  // Permute paths in place by following cycles
+  for(i = 0; i < npaths; i++)
+    while((dst = (pkey_t)(entries[i].next - entries)) != i)
+      _gpstore_swap_paths(gpset, i, dst);
+
+  gpath_set_compact(gpset, nlisted);
+
+  // Linked lists point to the next path of the same kmer
+  for(hkey = 0; hkey < gpstore->graph_capacity; hkey++) {
+    n = offsets[hkey+1];
+    for(i = offsets[hkey]; i < n; i++)
+      entries[i].next = (i+1 < n ? entries+i+1 : NULL);
+  }
+
+  gpstore->offsets = offsets;
+
+  ctx_free(listed);
+  gpath_ptr_buf_dealloc(&list);
+
+  char paths_str[50];
+  ulong_to_str(nlisted, paths_str);
+  status("[GPathStore]  %s paths compacted", paths_str);
+}
+
 // Update stats after removing a path
 void gpstore_path_removal_update_stats(GPathStore *gpstore, GPath *gpath)
 {
@@ -138,6 +253,7 @@ GPath* gpstore_find(const GPathStore *gpstore, hkey_t hkey, GPathNew find)
 GPath* gpath_store_add_mt(GPathStore *gpstore, hkey_t hkey, GPathNew newgpath)
 {
   ctx_assert(newgpath.seq != NULL);
+  ctx_assert2(!gpath_store_is_compact(gpstore), "Store is read-only");
 
   GPath *gpath = gpath_set_add_mt(&gpstore->gpset, newgpath);
   _gpstore_add_to_llist_mt(gpstore, hkey, gpath);
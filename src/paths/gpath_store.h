@@ -4,6 +4,12 @@
 #include "gpath_set.h"
 
 // GPathStore is a map from {[kmer/hkey] -> [GPath linked list]}
+//
+// Once no more paths are to be added, the store can be compacted into a
+// read-only CSR layout: the paths of each kmer are then consecutive entries of
+// gpset, sorted by orientation then sequence, with their colsets and sequences
+// adjacent in gpset.seqs. offsets[hkey]..offsets[hkey+1]-1 are the paths of
+// hkey. Linked list pointers are kept, pointing to the next entry.
 typedef struct
 {
   // num_paths may not match gpset->num_paths if we have dropped paths
@@ -11,6 +17,7 @@ typedef struct
   uint64_t graph_capacity;
   GPathSet gpset;
   GPath **paths_all, **paths_traverse;
+  pkey_t *offsets; // graph_capacity+1 entries if compacted, otherwise NULL
 } GPathStore;
 
 // @split_linked_lists whether you intend to have traverse linked list and
@@ -31,11 +38,28 @@ void gpath_store_print_stats(const GPathStore *gpstore);
 void gpath_store_split_read_write(GPathStore *gpstore);
 void gpath_store_merge_read_write(GPathStore *gpstore);
 
+// Convert to the read-only CSR layout. Paths that have been dropped from the
+// linked lists are removed. Peak memory is an extra copy of the path sequences,
+// see gpath_reader_compact_mem().
+void gpath_store_compact(GPathStore *gpstore);
+
+#define gpath_store_is_compact(gpstore) ((gpstore)->offsets != NULL)
+
 // Traversal paths are a subset of all paths
-#define gpath_store_use_traverse(gpstore) ((gpstore)->paths_traverse != NULL)
+#define gpath_store_use_traverse(gpstore) \
+        ((gpstore)->paths_traverse != NULL || gpath_store_is_compact(gpstore))
 GPath* gpath_store_fetch(const GPathStore *gpstore, hkey_t hkey);
 GPath* gpath_store_fetch_traverse(const GPathStore *gpstore, hkey_t hkey);
 
+// Compacted store only: returns the first of the `*num_paths` paths of `hkey`
+static inline GPath* gpath_store_fetch_range(const GPathStore *gpstore,
+                                             hkey_t hkey, size_t *num_paths)
+{
+  ctx_assert(gpath_store_is_compact(gpstore));
+  *num_paths = gpstore->offsets[hkey+1] - gpstore->offsets[hkey];
+  return gpstore->gpset.entries.data + gpstore->offsets[hkey];
+}
+
 GPath* gpstore_find(const GPathStore *gpstore, hkey_t hkey, GPathNew find);
 
 // Always adds
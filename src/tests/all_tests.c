@@ -53,6 +53,17 @@ void bitarr_tostr(const uint8_t *arr, size_t len, char *str)
   *str = '\0';
 }
 
+// Create an empty temporary file ending with `suffix` in /tmp, the path is
+// written to `path`. Calls die() on error
+FILE* all_tests_tmp_file(char path[PATH_MAX+1], const char *suffix)
+{
+  snprintf(path, PATH_MAX+1, "/tmp/ctx_tests.XXXXXX%s", suffix);
+  int fd = mkstemps(path, (int)strlen(suffix));
+  FILE *fh = fd == -1 ? NULL : fdopen(fd, "w");
+  if(fh == NULL) die("Cannot create temporary file: %s", path);
+  return fh;
+}
+
 //
 // Graph setup
 //
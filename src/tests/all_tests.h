@@ -57,6 +57,10 @@ void rand_nucs(Nucleotide *nucs, size_t len);
 void rand_bases(char *bases, size_t len);
 void bitarr_tostr(const uint8_t *arr, size_t len, char *str);
 
+// Create an empty temporary file ending with `suffix` in /tmp, the path is
+// written to `path`. Calls die() on error
+FILE* all_tests_tmp_file(char path[PATH_MAX+1], const char *suffix);
+
 static inline void seq_read_set(read_t *r, const char *s) {
   size_t len = strlen(s);
   buffer_ensure_capacity(&r->seq, len+1);
@@ -110,6 +114,12 @@ void test_db_node();
 
 // build_graph_tests.c
 void test_build_graph();
+void test_covg_edge_buf();
+void test_db_graph_grow();
+void test_build_graph_grow_mt();
+void test_build_graph_bloom();
+void test_kmer_bloom_mt();
+void test_build_graph_parts();
 
 // supernode_tests.c
 void test_supernode();
@@ -123,6 +133,12 @@ void test_subgraph();
 // path_tests.c
 void test_paths();
 
+// seq_shard_tests.c
+void test_seq_shard();
+
+// graph_file_blocks_tests.c
+void test_graph_file_blocks();
+
 // path_set_tests.c
 // void test_path_sets();
 
@@ -149,6 +149,47 @@ static void test_bkmer_first_last_nuc()
   }
 }
 
+static void test_bkmer_iter()
+{
+  test_status("Testing BinaryKmerIter rolling kmer keys");
+
+  #define ITER_SEQLEN 300
+  char seq[ITER_SEQLEN+1];
+  BinaryKmer bkmer, bkey, bkeys[ITER_SEQLEN];
+  Orientation orients[ITER_SEQLEN];
+  BinaryKmerIter it;
+  size_t i, k, nkmers;
+
+  for(k = MIN_KMER_SIZE; k <= MAX_KMER_SIZE; k+=2)
+  {
+    dna_rand_str(seq, ITER_SEQLEN);
+    nkmers = ITER_SEQLEN + 1 - k;
+
+    // All keys in one call
+    binary_kmer_iter_init(&it, k);
+    binary_kmer_iter_add_str(&it, seq, k-1);
+    binary_kmer_iter_keys(&it, seq+k-1, nkmers, bkeys, orients);
+
+    for(i = 0; i < nkmers; i++) {
+      bkmer = binary_kmer_from_str(seq+i, k);
+      bkey = binary_kmer_get_key(bkmer, k);
+      TASSERT(binary_kmers_are_equal(bkeys[i], bkey));
+      TASSERT(orients[i] == (binary_kmers_are_equal(bkmer, bkey) ? FORWARD : REVERSE));
+    }
+
+    // One base at a time
+    binary_kmer_iter_init(&it, k);
+    for(i = 0; i < ITER_SEQLEN; i++) {
+      binary_kmer_iter_add(&it, dna_char_to_nuc(seq[i]));
+      if(i+1 >= k) {
+        TASSERT(binary_kmers_are_equal(binary_kmer_iter_key(&it), bkeys[i+1-k]));
+        TASSERT(binary_kmer_iter_orient(&it) == orients[i+1-k]);
+      }
+    }
+  }
+  #undef ITER_SEQLEN
+}
+
 void test_bkmer_functions()
 {
   TASSERT(sizeof(BinaryKmer) == NUM_BKMER_WORDS * 8);
@@ -156,5 +197,6 @@ void test_bkmer_functions()
   test_bkmer_revcmp();
   test_bkmer_shifts();
   test_bkmer_first_last_nuc();
+  test_bkmer_iter();
   // TODO: equal, less than, cmp
 }
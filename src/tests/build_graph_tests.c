@@ -3,6 +3,8 @@
 #include "db_graph.h"
 #include "db_node.h"
 #include "build_graph.h"
+#include "covg_edge_buf.h"
+#include "graph_format.h"
 
 #include <math.h>
 
@@ -145,3 +147,418 @@ void test_build_graph()
 
   db_graph_dealloc(&graph);
 }
+
+// Check both graphs have the same kmers with the same coverage, edges and,
+// where both graphs have them, colour and read start bits
+static void assert_graphs_equal(const dBGraph *a, const dBGraph *b)
+{
+  size_t col, ncols = MIN2(a->num_of_cols, b->num_of_cols);
+  hkey_t hkey;
+  dBNode node;
+
+  TASSERT(a->num_of_cols == b->num_of_cols);
+  TASSERT(a->ht.num_kmers == b->ht.num_kmers);
+
+  for(hkey = 0; hkey < a->ht.capacity; hkey++)
+  {
+    if(!HASH_ENTRY_ASSIGNED(a->ht.table[hkey])) continue;
+    node = db_graph_find(b, a->ht.table[hkey]);
+    TASSERT(node.key != HASH_NOT_FOUND);
+    if(node.key == HASH_NOT_FOUND) continue;
+    ctx_assert(node.orient == FORWARD);
+
+    for(col = 0; col < ncols; col++) {
+      TASSERT(db_node_get_covg(a, hkey, col) == db_node_get_covg(b, node.key, col));
+      TASSERT(db_node_get_edges(a, hkey, col) == db_node_get_edges(b, node.key, col));
+      if(a->node_in_cols != NULL && b->node_in_cols != NULL) {
+        TASSERT(db_node_has_col(a, hkey, col) == db_node_has_col(b, node.key, col));
+      }
+    }
+
+    if(a->readstrt != NULL && b->readstrt != NULL) {
+      TASSERT(bitset_get(a->readstrt, 2*hkey) ==
+              bitset_get(b->readstrt, 2*node.key));
+      TASSERT(bitset_get(a->readstrt, 2*hkey+1) ==
+              bitset_get(b->readstrt, 2*node.key+1));
+    }
+  }
+}
+
+// Coverage and edges added through a small CovgEdgeBuffer (forcing evictions)
+// should match those written directly to the graph
+void test_covg_edge_buf()
+{
+  test_status("Testing buffered coverage and edge updates");
+
+  dBGraph graphs[2];
+  size_t kmer_size = 19, ncols = 2, col, i, j;
+  char seq[200];
+  dBNode prev = DB_NODE_INIT, node;
+  BinaryKmer bkmer;
+  bool found;
+
+  for(i = 0; i < 2; i++) {
+    db_graph_alloc(&graphs[i], kmer_size, ncols, ncols, 1024,
+                   DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS);
+  }
+
+  CovgEdgeBuffer cebuf;
+  covg_edge_buf_alloc(&cebuf, 8, &graphs[1]);
+
+  dna_rand_str(seq, sizeof(seq)-1);
+
+  for(col = 0; col < ncols; col++)
+  {
+    // Load the sequence twice per colour so coverage is combined
+    for(j = 0; j < 2; j++)
+    {
+      build_graph_from_str_mt(&graphs[0], col, seq, strlen(seq));
+
+      for(i = 0; i + kmer_size <= strlen(seq); i++) {
+        bkmer = binary_kmer_from_str(seq+i, kmer_size);
+        node = db_graph_find_or_add_node_mt(&graphs[1], bkmer, &found);
+        covg_edge_buf_update_node(&cebuf, node, col);
+        if(i > 0) covg_edge_buf_add_edge(&cebuf, col, prev, node);
+        prev = node;
+      }
+    }
+  }
+
+  covg_edge_buf_flush(&cebuf);
+  covg_edge_buf_dealloc(&cebuf);
+
+  assert_graphs_equal(&graphs[0], &graphs[1]);
+
+  for(i = 0; i < 2; i++) db_graph_dealloc(&graphs[i]);
+}
+
+// Growing the hash table part way through loading should give the same graph
+// as loading into a large enough table
+void test_db_graph_grow()
+{
+  test_status("Testing growing the graph hash table");
+
+  dBGraph graphs[2];
+  size_t kmer_size = 19, ncols = 2, g, len;
+  char seq[1501];
+  dBNode node;
+  BinaryKmer bkmer;
+  int flags = DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS |
+              DBG_ALLOC_READSTRT | DBG_ALLOC_NODE_IN_COL;
+
+  db_graph_alloc(&graphs[0], kmer_size, ncols, ncols, 8192, flags);
+  db_graph_alloc(&graphs[1], kmer_size, ncols, ncols, 1024, flags);
+
+  dna_rand_str(seq, sizeof(seq)-1);
+  len = strlen(seq);
+
+  // Load first third of the sequence into colour 0, then the whole sequence
+  // into colour 1, growing the second graph in between
+  for(g = 0; g < 2; g++) {
+    build_graph_from_str_mt(&graphs[g], 0, seq, len/3);
+    bkmer = binary_kmer_from_str(seq, kmer_size);
+    node = db_graph_find(&graphs[g], bkmer);
+    bitset_set(graphs[g].readstrt, 2*node.key+node.orient);
+  }
+
+  db_graph_grow(&graphs[1], 4096, 2);
+  TASSERT(graphs[1].ht.capacity >= 4096);
+  TASSERT(graphs[1].ht.num_kmers == graphs[0].ht.num_kmers);
+
+  for(g = 0; g < 2; g++)
+    build_graph_from_str_mt(&graphs[g], 1, seq, len);
+
+  assert_graphs_equal(&graphs[0], &graphs[1]);
+
+  // The old and new tables must fit in 1.5 * max_capacity, so the last step
+  // is less than a doubling, then the table stops growing
+  graphs[1].max_capacity = 7000;
+  db_graph_grow_for(&graphs[1], 1UL<<20, 2);
+  TASSERT(graphs[1].ht.capacity > 4096);
+  TASSERT(4096 + graphs[1].ht.capacity <= 7000 + 7000/2);
+  db_graph_grow_for(&graphs[1], 1UL<<20, 2);
+  TASSERT(graphs[1].max_capacity == graphs[1].ht.capacity);
+  assert_graphs_equal(&graphs[0], &graphs[1]);
+
+  for(g = 0; g < 2; g++) db_graph_dealloc(&graphs[g]);
+}
+
+#define GROW_TEST_NFILES 4
+#define GROW_TEST_NREADS 4096
+#define GROW_TEST_NSEQS 6000
+#define GROW_TEST_READLEN 50
+#define GROW_TEST_NTHREADS 4
+
+// Build with several threads, loading file f into colour f/2
+static void _grow_test_build(dBGraph *graph, char paths[][PATH_MAX+1])
+{
+  seq_file_t *files[2];
+  size_t col, f;
+
+  for(col = 0; col < 2; col++) {
+    for(f = 0; f < 2; f++)
+      if((files[f] = seq_open(paths[2*col+f])) == NULL)
+        die("Cannot open: %s", paths[2*col+f]);
+    build_graph_from_seq(graph, files, 2, GROW_TEST_NTHREADS, col);
+    for(f = 0; f < 2; f++) seq_close(files[f]);
+  }
+}
+
+// Building with several threads into a table that has to grow more than
+// once should give the same graph as building into a table that is big enough
+void test_build_graph_grow_mt()
+{
+  test_status("Testing growing the hash table during threaded build_graph()");
+
+  dBGraph graphs[2];
+  size_t kmer_size = 19, ncols = 2, i, f, g;
+  char (*seqs)[GROW_TEST_READLEN+1];
+  char paths[GROW_TEST_NFILES][PATH_MAX+1];
+  FILE *fh;
+  int flags = DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS |
+              DBG_ALLOC_NODE_IN_COL;
+
+  // Every sequence is in each colour, and some are in both files of a colour,
+  // so the same kmers are added by batches on different threads at once
+  seqs = ctx_malloc(GROW_TEST_NSEQS * sizeof(seqs[0]));
+  for(i = 0; i < GROW_TEST_NSEQS; i++)
+    dna_rand_str(seqs[i], GROW_TEST_READLEN);
+
+  for(f = 0; f < GROW_TEST_NFILES; f++) {
+    fh = all_tests_tmp_file(paths[f], ".fa");
+    for(i = 0; i < GROW_TEST_NREADS; i++)
+      fprintf(fh, ">r%zu\n%s\n", i, seqs[(i + f*GROW_TEST_NREADS) % GROW_TEST_NSEQS]);
+    fclose(fh);
+  }
+
+  // A batch can add at most ASYNCIO_BATCH_SIZE*GROW_TEST_READLEN kmers, so the
+  // first grow is to a table with room for about that many. The graph has
+  // several times as many kmers, so the table grows more than once.
+  size_t batch_kmers = ASYNCIO_BATCH_SIZE * GROW_TEST_READLEN;
+  size_t ngraph_kmers = GROW_TEST_NSEQS * (GROW_TEST_READLEN - kmer_size + 1);
+  TASSERT(ngraph_kmers > 3 * batch_kmers);
+
+  db_graph_alloc(&graphs[0], kmer_size, ncols, ncols, 1UL<<20, flags);
+  db_graph_alloc(&graphs[1], kmer_size, ncols, ncols, 1024, flags);
+  graphs[1].max_capacity = 1UL<<20;
+
+  for(g = 0; g < 2; g++) _grow_test_build(&graphs[g], paths);
+
+  TASSERT(graphs[1].ht.capacity > 2 * batch_kmers);
+  TASSERT(graphs[1].ht.num_kmers > 3 * batch_kmers);
+  assert_graphs_equal(&graphs[0], &graphs[1]);
+
+  for(g = 0; g < 2; g++) db_graph_dealloc(&graphs[g]);
+  for(f = 0; f < GROW_TEST_NFILES; f++) unlink(paths[f]);
+  ctx_free(seqs);
+}
+
+// With a Bloom filter kmers are only added on their second sighting in a
+// colour, with coverage including the first sighting
+void test_build_graph_bloom()
+{
+  test_status("Testing Bloom filter of singleton kmers in build_graph.c");
+
+  dBGraph graph;
+  KmerBloom bloom;
+  size_t kmer_size = 19, ncols = 2, i;
+  char seq[101];
+  dBNode node, next;
+  BinaryKmer bkmer;
+
+  db_graph_alloc(&graph, kmer_size, ncols, ncols, 1024,
+                 DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS |
+                 DBG_ALLOC_NODE_IN_COL);
+  kmer_bloom_alloc(&bloom, 1<<20);
+  graph.bloom = &bloom;
+
+  dna_rand_str(seq, sizeof(seq)-1);
+
+  // Seen once: nothing in the graph
+  build_graph_from_str_mt(&graph, 0, seq, strlen(seq));
+  TASSERT(graph.ht.num_kmers == 0);
+
+  // Seen twice in colour 0, once in colour 1
+  build_graph_from_str_mt(&graph, 0, seq, strlen(seq));
+  build_graph_from_str_mt(&graph, 1, seq, strlen(seq));
+  TASSERT(graph.ht.num_kmers == strlen(seq)+1-kmer_size);
+
+  for(i = 0; i + kmer_size <= strlen(seq); i++) {
+    bkmer = binary_kmer_from_str(seq+i, kmer_size);
+    node = db_graph_find(&graph, bkmer);
+    TASSERT(node.key != HASH_NOT_FOUND);
+    TASSERT(db_node_get_covg(&graph, node.key, 0) == 2);
+    TASSERT(db_node_get_covg(&graph, node.key, 1) == 0);
+    if(i + kmer_size < strlen(seq)) {
+      next = db_graph_find(&graph, binary_kmer_from_str(seq+i+1, kmer_size));
+      TASSERT(!db_graph_check_edges(&graph, node, next));
+    }
+  }
+
+  // Seen three times in colour 0, twice in colour 1
+  build_graph_from_str_mt(&graph, 0, seq, strlen(seq));
+  build_graph_from_str_mt(&graph, 1, seq, strlen(seq));
+
+  for(i = 0; i + kmer_size <= strlen(seq); i++) {
+    bkmer = binary_kmer_from_str(seq+i, kmer_size);
+    node = db_graph_find(&graph, bkmer);
+    TASSERT(db_node_get_covg(&graph, node.key, 0) == 3);
+    TASSERT(db_node_get_covg(&graph, node.key, 1) == 2);
+  }
+
+  kmer_bloom_dealloc(&bloom);
+  db_graph_dealloc(&graph);
+}
+
+#define BLOOM_TEST_NKEYS 10000
+#define BLOOM_TEST_NTHREADS 4
+
+typedef struct
+{
+  KmerBloom *bloom;
+  const BinaryKmer *bkeys;
+  size_t *nabsent; // number of adds returning false per key
+} BloomTestAdder;
+
+// Every thread adds every key, in the same order to make them race
+static void bloom_test_add_thread(void *arg)
+{
+  BloomTestAdder *adder = (BloomTestAdder*)arg;
+  size_t i;
+  for(i = 0; i < BLOOM_TEST_NKEYS; i++)
+    if(!kmer_bloom_add_mt(adder->bloom, adder->bkeys[i], 0))
+      __sync_fetch_and_add(&adder->nabsent[i], 1);
+}
+
+// When several threads add the same new key, exactly one should see it as
+// absent, otherwise a kmer seen twice could be dropped
+void test_kmer_bloom_mt()
+{
+  test_status("Testing threaded adds to the Bloom filter of singleton kmers");
+
+  KmerBloom bloom;
+  BloomTestAdder adders[BLOOM_TEST_NTHREADS];
+  size_t kmer_size = 19, i;
+  BinaryKmer *bkeys = ctx_malloc(BLOOM_TEST_NKEYS * sizeof(BinaryKmer));
+  size_t *nabsent = ctx_calloc(BLOOM_TEST_NKEYS, sizeof(size_t));
+
+  for(i = 0; i < BLOOM_TEST_NKEYS; i++)
+    bkeys[i] = binary_kmer_get_key(binary_kmer_random(kmer_size), kmer_size);
+
+  // Large enough that false positives are very unlikely
+  kmer_bloom_alloc(&bloom, 1<<24);
+
+  for(i = 0; i < BLOOM_TEST_NTHREADS; i++)
+    adders[i] = (BloomTestAdder){.bloom = &bloom, .bkeys = bkeys,
+                                 .nabsent = nabsent};
+
+  util_run_threads(adders, BLOOM_TEST_NTHREADS, sizeof(BloomTestAdder),
+                   BLOOM_TEST_NTHREADS, bloom_test_add_thread);
+
+  for(i = 0; i < BLOOM_TEST_NKEYS; i++)
+    TASSERT2(nabsent[i] == 1, "key %zu seen as absent %zu times", i, nabsent[i]);
+
+  // Every key is now present
+  for(i = 0; i < BLOOM_TEST_NKEYS; i++)
+    TASSERT(kmer_bloom_add_mt(&bloom, bkeys[i], 0));
+
+  kmer_bloom_dealloc(&bloom);
+  ctx_free(nabsent);
+  ctx_free(bkeys);
+}
+
+#define PARTS_TEST_NSEQS 40
+#define PARTS_TEST_NTHREADS 4
+
+typedef struct
+{
+  BuildGraphPartsBuffer buf;
+  size_t threadid;
+  char (*seqs)[201];
+} PartsTestAdder;
+
+// Threads take turns adding sequences to both colours. Each sequence is a copy
+// of its neighbour, so the same kmers are written by several threads
+static void parts_test_add_thread(void *arg)
+{
+  PartsTestAdder *adder = (PartsTestAdder*)arg;
+  size_t i, col;
+  for(i = adder->threadid; i < PARTS_TEST_NSEQS; i += PARTS_TEST_NTHREADS)
+    for(col = 0; col < 2; col++)
+      build_graph_parts_add_str(&adder->buf, col, adder->seqs[i],
+                                strlen(adder->seqs[i]));
+  build_graph_parts_buf_flush(&adder->buf);
+}
+
+// Building through partitions with several threads should give the same
+// graph as building in memory
+void test_build_graph_parts()
+{
+  test_status("Testing out-of-core graph building with partitions");
+
+  dBGraph graphs[3];
+  size_t kmer_size = 19, ncols = 2, nparts = 5, i, col;
+  char seqs[PARTS_TEST_NSEQS][201], path[PATH_MAX+1];
+  int flags = DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS;
+
+  // Every other sequence is a copy of the previous one, to give coverage > 1
+  for(i = 0; i < PARTS_TEST_NSEQS; i++) {
+    if(i & 1) strcpy(seqs[i], seqs[i-1]);
+    else dna_rand_str(seqs[i], sizeof(seqs[i])-1);
+  }
+
+  // In memory
+  db_graph_alloc(&graphs[0], kmer_size, ncols, ncols, 16384, flags);
+  for(i = 0; i < PARTS_TEST_NSEQS; i++)
+    for(col = 0; col < ncols; col++)
+      build_graph_from_str_mt(&graphs[0], col, seqs[i], strlen(seqs[i]));
+
+  // Through partitions, loaded into a small table that has to grow
+  BuildGraphParts parts;
+  PartsTestAdder adders[PARTS_TEST_NTHREADS];
+  build_graph_parts_alloc(&parts, nparts, kmer_size, "/tmp");
+
+  for(i = 0; i < PARTS_TEST_NTHREADS; i++) {
+    build_graph_parts_buf_alloc(&adders[i].buf, &parts);
+    adders[i].threadid = i;
+    adders[i].seqs = seqs;
+  }
+
+  util_run_threads(adders, PARTS_TEST_NTHREADS, sizeof(PartsTestAdder),
+                   PARTS_TEST_NTHREADS, parts_test_add_thread);
+
+  for(i = 0; i < PARTS_TEST_NTHREADS; i++)
+    build_graph_parts_buf_dealloc(&adders[i].buf);
+
+  for(i = 0; i < nparts; i++) TASSERT(parts.nrecords[i] > 0);
+
+  fclose(all_tests_tmp_file(path, ".ctx"));
+  db_graph_alloc(&graphs[1], kmer_size, ncols, ncols, 1024, flags);
+  graphs[1].max_capacity = 16384;
+
+  uint64_t nkmers = build_graph_parts_save(&parts, &graphs[1], path,
+                                           PARTS_TEST_NTHREADS);
+  build_graph_parts_dealloc(&parts);
+
+  TASSERT2(nkmers == graphs[0].ht.num_kmers, "%zu vs %zu",
+           (size_t)nkmers, (size_t)graphs[0].ht.num_kmers);
+  TASSERT(graphs[1].ht.num_kmers == 0);
+  TASSERT(graphs[1].ht.capacity > 1024);
+
+  // Load the output file and compare
+  GraphFileReader file;
+  memset(&file, 0, sizeof(file));
+  graph_file_open(&file, path);
+  TASSERT(file.hdr.num_of_cols == ncols);
+  TASSERT(file.num_of_kmers == (int64_t)nkmers);
+
+  db_graph_alloc(&graphs[2], kmer_size, ncols, ncols, 16384, flags);
+  GraphLoadingPrefs gprefs = LOAD_GPREFS_INIT(&graphs[2]);
+  graph_load(&file, gprefs, NULL);
+  graph_file_close(&file);
+  unlink(path);
+
+  assert_graphs_equal(&graphs[0], &graphs[2]);
+
+  for(i = 0; i < 3; i++) db_graph_dealloc(&graphs[i]);
+}
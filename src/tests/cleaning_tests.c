@@ -2,6 +2,7 @@
 #include "all_tests.h"
 
 #include "db_graph.h"
+#include "db_node.h"
 #include "build_graph.h"
 #include "clean_graph.h"
 
@@ -41,8 +42,10 @@ void _test_graph_cleaning()
   db_graph_alloc(&graph, kmer_size, ncols, ncols, 2000,
                  DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS);
 
-  uint8_t *visited = ctx_calloc(roundup_bits2bytes(graph.ht.capacity), 1);
-  uint8_t *keep    = ctx_calloc(roundup_bits2bytes(graph.ht.capacity), 1);
+  uint8_t *keep = ctx_calloc(roundup_bits2bytes(graph.ht.capacity), 1);
+
+  UnitigIndex uidx;
+  unitig_index_alloc(&uidx, graph.ht.capacity);
 
   // Simple graph - 1000 bases, should all be cleaned off
   char graphseq[] =
@@ -67,18 +70,20 @@ void _test_graph_cleaning()
   // Use supernode coverage rather than kmer coverage
   const bool use_supernode_covg = false;
 
+  unitig_index_build(&uidx, nthreads, &graph);
+
   // No change (min_tip_len must be > 1)
-  clean_graph(nthreads, use_supernode_covg, 0, 2, NULL, NULL, visited, keep, &graph);
+  clean_graph(nthreads, use_supernode_covg, 0, 2, NULL, NULL, keep, &uidx, &graph);
   TASSERT(graph.ht.num_kmers == 1000-19+1);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
 
   // No change (min_tip_len must be > 1)
-  clean_graph(nthreads, use_supernode_covg, 0, 1000-19+1, NULL, NULL, visited, keep, &graph);
+  clean_graph(nthreads, use_supernode_covg, 0, 1000-19+1, NULL, NULL, keep, &uidx, &graph);
   TASSERT(graph.ht.num_kmers == 1000-19+1);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
 
   // All removed
-  clean_graph(nthreads, use_supernode_covg, 0, 1000-19+2, NULL, NULL, visited, keep, &graph);
+  clean_graph(nthreads, use_supernode_covg, 0, 1000-19+2, NULL, NULL, keep, &uidx, &graph);
   TASSERT2(graph.ht.num_kmers == 0, "%"PRIu64" kmers", graph.ht.num_kmers);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
 
@@ -95,8 +100,9 @@ void _test_graph_cleaning()
 
   build_graph_from_str_mt(&graph, 0, tmp, strlen(tmp));
 
-  size_t thresh = cleaning_get_threshold(nthreads, true, 4, NULL, NULL, visited, &graph);
-  clean_graph(nthreads, use_supernode_covg, thresh, 0, NULL, NULL, visited, keep, &graph);
+  unitig_index_build(&uidx, nthreads, &graph);
+  size_t thresh = cleaning_get_threshold(nthreads, true, 4, NULL, NULL, &uidx, &graph);
+  clean_graph(nthreads, use_supernode_covg, thresh, 0, NULL, NULL, keep, &uidx, &graph);
   TASSERT2(thresh > 1, "threshold: %zu", thresh);
 
   TASSERT2(graph.ht.num_kmers == 200-19+1, "%"PRIu64" kmers", graph.ht.num_kmers);
@@ -111,7 +117,8 @@ void _test_graph_cleaning()
   TASSERT2(graph.ht.num_kmers == 200-19+1 + 23-19+1,
            "%"PRIu64" kmers", graph.ht.num_kmers);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
-  clean_graph(nthreads, use_supernode_covg, 0, 2*19-1, NULL, NULL, visited, keep, &graph);
+  unitig_index_build(&uidx, nthreads, &graph);
+  clean_graph(nthreads, use_supernode_covg, 0, 2*19-1, NULL, NULL, keep, &uidx, &graph);
   TASSERT2(graph.ht.num_kmers == 200-19+1, "%"PRIu64" kmers", graph.ht.num_kmers);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
 
@@ -125,12 +132,98 @@ void _test_graph_cleaning()
   build_graph_from_str_mt(&graph, 0, tmp3, strlen(tmp3));
   TASSERT2(graph.ht.num_kmers == 1, "%zu", (size_t)graph.ht.num_kmers);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
-  clean_graph(nthreads, use_supernode_covg, 0, 2*19-1, NULL, NULL, visited, keep, &graph);
+  unitig_index_build(&uidx, nthreads, &graph);
+  clean_graph(nthreads, use_supernode_covg, 0, 2*19-1, NULL, NULL, keep, &uidx, &graph);
   TASSERT(graph.ht.num_kmers == 0, "%"PRIu64" kmers", graph.ht.num_kmers);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
 
-  ctx_free(visited);
   ctx_free(keep);
+  unitig_index_dealloc(&uidx);
+
+  db_graph_dealloc(&graph);
+}
+
+void _test_colour_cleaning()
+{
+  test_status("Testing graph cleaning per colour...");
+
+  // Construct 2 colour graph with kmer-size=19
+  dBGraph graph;
+  const size_t kmer_size = 19, ncols = 2, nthreads = 2;
+  size_t i;
+
+  db_graph_alloc(&graph, kmer_size, ncols, ncols, 2000,
+                 DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS);
+
+  uint8_t *keep = ctx_calloc(roundup_bits2bytes(graph.ht.capacity), 1);
+
+  UnitigIndex uidx;
+  unitig_index_alloc(&uidx, graph.ht.capacity);
+
+  // 200bp in colour 0
+  char seq[] =
+"GGCTACCTAACCAGATATCTCTGTATACAGCTGCATTGTGTTTAGTCTACAACGACAGAAATCCCCTTCGACGCCCGC"
+"GACCTCTCTTAACGGACGACGCCTTCCGGTTGCGATATCGATGGATCGACAGAACAAGCCGCTTCCCTAACAACTGCG"
+"CATGAAATCCAAAGTGCGCCGATGCTTGCTTGACGATTCCAAAT";
+
+  // First 78 bp with a single SNP creating a tip 23bp -> 5kmers long in
+  // colour 0. In colour 1 on its own it is one long supernode.
+  char tip[] =
+"GGCTACCTAACCAGATATCTCTGTATACAGCTGCATTGTGTTTAGTCTACAACGACAGAAATCCCCTTCGACGgCCGC";
+
+  // Single kmer only in colour 0
+  char lone[] = "AGATGTGGTTCACGGCTAG";
+
+  build_graph_from_str_mt(&graph, 0, seq, strlen(seq));
+  build_graph_from_str_mt(&graph, 0, tip, strlen(tip));
+  build_graph_from_str_mt(&graph, 0, lone, strlen(lone));
+  build_graph_from_str_mt(&graph, 1, tip, strlen(tip));
+  TASSERT2(graph.ht.num_kmers == 200-19+1 + 23-19+1 + 1,
+           "%"PRIu64" kmers", graph.ht.num_kmers);
+
+  for(i = 0; i < ncols; i++) {
+    unitig_index_build_col(&uidx, nthreads, i, &graph);
+    clean_graph(nthreads, false, 0, 2*19-1, NULL, NULL, keep, &uidx, &graph);
+  }
+
+  // Tip removed from colour 0 but not colour 1
+  TASSERT2(graph.ht.num_kmers == 200-19+1 + 23-19+1 + 1,
+           "%"PRIu64" kmers", graph.ht.num_kmers);
+
+  dBNode node;
+  for(i = 0; i+19 <= 23; i++) {
+    node = db_graph_find_str(&graph, tip+78-23+i);
+    TASSERT(node.key != HASH_NOT_FOUND);
+    TASSERT(db_node_get_covg(&graph, node.key, 0) == 0);
+    TASSERT(db_node_get_edges(&graph, node.key, 0) == 0);
+    TASSERT(db_node_get_covg(&graph, node.key, 1) > 0);
+    TASSERT(db_node_get_edges(&graph, node.key, 1) != 0);
+  }
+
+  // Kmer before the SNP only has an edge to the tip in colour 1
+  node = db_graph_find_str(&graph, tip+78-23-1);
+  TASSERT(node.key != HASH_NOT_FOUND);
+  TASSERT(edges_get_outdegree(db_node_get_edges(&graph, node.key, 0),
+                              node.orient) == 1);
+  TASSERT(edges_get_outdegree(db_node_get_edges(&graph, node.key, 1),
+                              node.orient) == 1);
+  TASSERT(db_node_get_edges(&graph, node.key, 0) !=
+          db_node_get_edges(&graph, node.key, 1));
+
+  // Lone kmer is in no colour and is removed from the graph
+  node = db_graph_find_str(&graph, lone);
+  TASSERT(node.key != HASH_NOT_FOUND);
+  TASSERT(db_node_sum_covg(&graph, node.key) == 0);
+
+  cleaning_remove_uncoloured(nthreads, keep, &graph);
+  TASSERT2(graph.ht.num_kmers == 200-19+1 + 23-19+1,
+           "%"PRIu64" kmers", graph.ht.num_kmers);
+  TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
+  node = db_graph_find_str(&graph, lone);
+  TASSERT(node.key == HASH_NOT_FOUND);
+
+  ctx_free(keep);
+  unitig_index_dealloc(&uidx);
 
   db_graph_dealloc(&graph);
 }
@@ -139,5 +232,6 @@ void test_cleaning()
 {
   _test_pick_theshold();
   _test_graph_cleaning();
+  _test_colour_cleaning();
 }
 
@@ -0,0 +1,293 @@
+#include "global.h"
+#include "all_tests.h"
+#include "graph_file_blocks.h"
+#include "graph_format.h"
+#include "file_util.h"
+
+#include <sys/wait.h>
+
+#define BLOCKS_TEST_KMER_SIZE 31
+#define BLOCKS_TEST_NCOLS 3
+#define BLOCKS_TEST_NKMERS 5000
+#define BLOCKS_TEST_BLOCK_NKMERS 700
+
+typedef struct
+{
+  BinaryKmer bkmer;
+  Covg covgs[BLOCKS_TEST_NCOLS];
+  Edges edges[BLOCKS_TEST_NCOLS];
+} BlocksTestKmer;
+
+static int _blocks_kmer_cmp(const void *a, const void *b)
+{
+  const BlocksTestKmer *x = (const BlocksTestKmer*)a, *y = (const BlocksTestKmer*)b;
+  if(binary_kmers_are_equal(x->bkmer, y->bkmer)) return 0;
+  return binary_kmer_less_than(x->bkmer, y->bkmer) ? -1 : 1;
+}
+
+// Generate sorted unique kmers. The first half are consecutive with the same
+// coverage so that their blocks compress, the rest are random.
+// Colour 0 always has coverage, other colours may be empty.
+// Returns number of kmers
+static size_t _blocks_make_kmers(BlocksTestKmer *kmers, size_t n)
+{
+  char seq[BLOCKS_TEST_KMER_SIZE+1];
+  size_t i, j, col;
+  seq[BLOCKS_TEST_KMER_SIZE] = '\0';
+
+  rand_bases(seq, BLOCKS_TEST_KMER_SIZE);
+  BinaryKmer first = binary_kmer_from_str(seq, BLOCKS_TEST_KMER_SIZE);
+  first.b[NUM_BKMER_WORDS-1] &= ~(uint64_t)0xffff;
+
+  for(i = 0; i < n; i++) {
+    if(i < n/2) {
+      kmers[i].bkmer = first;
+      kmers[i].bkmer.b[NUM_BKMER_WORDS-1] += i;
+    } else {
+      rand_bases(seq, BLOCKS_TEST_KMER_SIZE);
+      kmers[i].bkmer = binary_kmer_from_str(seq, BLOCKS_TEST_KMER_SIZE);
+    }
+    for(col = 0; col < BLOCKS_TEST_NCOLS; col++) {
+      bool empty = (col > 0 && (i < n/2 || rand() % 3 == 0));
+      kmers[i].covgs[col] = empty ? 0 : (i < n/2 ? 1 : 1 + rand() % 1000);
+      kmers[i].edges[col] = empty ? 0 : (i < n/2 ? 0x11 : rand() & 0xff);
+    }
+  }
+
+  qsort(kmers, n, sizeof(BlocksTestKmer), _blocks_kmer_cmp);
+
+  // Remove duplicates
+  for(i = j = 1; i < n; i++)
+    if(!binary_kmers_are_equal(kmers[i].bkmer, kmers[j-1].bkmer))
+      kmers[j++] = kmers[i];
+
+  return j;
+}
+
+// Write a block compressed graph file with small blocks
+static void _blocks_write_file(const char *path, const BlocksTestKmer *kmers,
+                               size_t n)
+{
+  GraphFileHeader hdr = {.version = CTX_GRAPH_FILEFORMAT_BLOCKS,
+                         .kmer_size = BLOCKS_TEST_KMER_SIZE,
+                         .num_of_bitfields = NUM_BKMER_WORDS,
+                         .num_of_cols = BLOCKS_TEST_NCOLS,
+                         .capacity = 0};
+  graph_header_alloc(&hdr, BLOCKS_TEST_NCOLS);
+
+  FILE *fh = futil_fopen(path, "w");
+  size_t i, hdr_size = graph_write_header(fh, &hdr);
+
+  GraphBlockWriter wtr;
+  graph_blocks_writer_alloc(&wtr, fh, hdr_size, BLOCKS_TEST_NCOLS);
+  wtr.max_nkmers = BLOCKS_TEST_BLOCK_NKMERS;
+
+  for(i = 0; i < n; i++)
+    graph_blocks_write_kmer(&wtr, kmers[i].bkmer, kmers[i].covgs, kmers[i].edges);
+
+  TASSERT(graph_blocks_writer_finish(&wtr) == n);
+  TASSERT(wtr.idx.len == (n + BLOCKS_TEST_BLOCK_NKMERS-1) / BLOCKS_TEST_BLOCK_NKMERS);
+
+  graph_blocks_writer_dealloc(&wtr);
+  fclose(fh);
+  graph_header_dealloc(&hdr);
+}
+
+// Read the file twice (rewinding in between) and compare with `kmers`
+static void _blocks_check_file(const char *path, const BlocksTestKmer *kmers,
+                               size_t n)
+{
+  GraphFileReader file;
+  memset(&file, 0, sizeof(file));
+  graph_file_open(&file, path);
+
+  TASSERT(graph_file_is_compressed(&file));
+  TASSERT2(file.num_of_kmers == (int64_t)n, "%zi vs %zu",
+           (ssize_t)file.num_of_kmers, n);
+
+  BinaryKmer bkmer;
+  Covg covgs[BLOCKS_TEST_NCOLS];
+  Edges edges[BLOCKS_TEST_NCOLS];
+  size_t i, pass;
+  bool match;
+
+  for(pass = 0; pass < 2; pass++) {
+    for(i = 0; graph_file_read_reset(&file, BLOCKS_TEST_NCOLS, &bkmer, covgs, edges); i++) {
+      match = (i < n && binary_kmers_are_equal(bkmer, kmers[i].bkmer) &&
+               memcmp(covgs, kmers[i].covgs, sizeof(covgs)) == 0 &&
+               memcmp(edges, kmers[i].edges, sizeof(edges)) == 0);
+      TASSERT2(match, "kmer %zu of %zu", i, n);
+      if(!match) break;
+    }
+    TASSERT2(i == n, "%zu vs %zu", i, n);
+    graph_file_rewind(&file);
+  }
+
+  graph_file_close(&file);
+}
+
+// Returns true if reading the file calls die(), false if it can be read or
+// crashes
+static bool _blocks_read_dies(const char *path)
+{
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t pid = fork();
+  if(pid < 0) die("Cannot fork: %s", strerror(errno));
+
+  if(pid == 0) {
+    // Silence errors from die()
+    if(freopen("/dev/null", "w", stderr) == NULL) _exit(2);
+    GraphFileReader file;
+    BinaryKmer bkmer;
+    Covg covgs[BLOCKS_TEST_NCOLS];
+    Edges edges[BLOCKS_TEST_NCOLS];
+    memset(&file, 0, sizeof(file));
+    graph_file_open(&file, path);
+    while(graph_file_read_reset(&file, BLOCKS_TEST_NCOLS, &bkmer, covgs, edges)) {}
+    graph_file_close(&file);
+    _exit(0);
+  }
+
+  int status;
+  if(waitpid(pid, &status, 0) != pid) die("waitpid failed: %s", strerror(errno));
+  return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE;
+}
+
+static void _blocks_write_bytes(const char *path, const uint8_t *data,
+                                size_t len)
+{
+  FILE *fh = futil_fopen(path, "w");
+  if(fwrite(data, 1, len, fh) != len) die("Cannot write: %s", path);
+  fclose(fh);
+}
+
+// Truncate the file and corrupt blocks and the index, reading must die.
+// Sets have_codec[c] if a block uses codec c.
+static void _blocks_check_corrupt(const char *path, size_t n, bool have_codec[2])
+{
+  char bad_path[PATH_MAX+1];
+  fclose(all_tests_tmp_file(bad_path, ".ctx"));
+
+  // Load good file
+  size_t i, fsize = (size_t)futil_get_file_size(path);
+  uint8_t *data = ctx_malloc(fsize), *bad = ctx_malloc(fsize);
+  FILE *fh = futil_fopen(path, "r");
+  if(fread(data, 1, fsize, fh) != fsize) die("Cannot read: %s", path);
+  fclose(fh);
+
+  // Trailer and index
+  uint64_t idx_offset, nblocks;
+  const size_t idx_bytes = sizeof(BinaryKmer) + 2*sizeof(uint64_t);
+  memcpy(&idx_offset, data + fsize - GRAPH_BLOCK_TRAILER_BYTES, sizeof(uint64_t));
+  memcpy(&nblocks, data + fsize - GRAPH_BLOCK_TRAILER_BYTES + 8, sizeof(uint64_t));
+  TASSERT(nblocks > 0);
+  TASSERT(idx_offset + nblocks*idx_bytes + GRAPH_BLOCK_TRAILER_BYTES == fsize);
+
+  // Offsets of block headers and codecs used
+  uint64_t *blks = ctx_calloc(nblocks, sizeof(uint64_t));
+  for(i = 0; i < nblocks; i++) {
+    memcpy(&blks[i], data + idx_offset + i*idx_bytes + sizeof(BinaryKmer),
+           sizeof(uint64_t));
+    TASSERT(data[blks[i]] <= GRAPH_BLOCK_CODEC_ZLIB);
+    have_codec[data[blks[i]] & 1] = true;
+  }
+
+  // Good file can be read
+  TASSERT(!_blocks_read_dies(path));
+
+  // Truncated inside a block, the index and the trailer
+  size_t cuts[] = {blks[0]+5, (blks[0]+idx_offset)/2, blks[nblocks-1]+3,
+                   idx_offset+1, fsize-GRAPH_BLOCK_TRAILER_BYTES, fsize-1};
+  for(i = 0; i < sizeof(cuts)/sizeof(cuts[0]); i++) {
+    _blocks_write_bytes(bad_path, data, cuts[i]);
+    TASSERT2(_blocks_read_dies(bad_path), "truncated at %zu of %zu", cuts[i], fsize);
+  }
+
+  // Corrupt one block header or one byte of block data in each block
+  for(i = 0; i < nblocks; i++) {
+    uint8_t codec = data[blks[i]];
+    uint32_t nkmers, enc_len;
+    memcpy(&nkmers, data+blks[i]+1, sizeof(uint32_t));
+    memcpy(&enc_len, data+blks[i]+9, sizeof(uint32_t));
+
+    // Unknown codec
+    memcpy(bad, data, fsize);
+    bad[blks[i]] = 7;
+    _blocks_write_bytes(bad_path, bad, fsize);
+    TASSERT2(_blocks_read_dies(bad_path), "block %zu codec", i);
+
+    // Too many / too few kmers for the encoded data
+    memcpy(bad, data, fsize);
+    nkmers++;
+    memcpy(bad+blks[i]+1, &nkmers, sizeof(uint32_t));
+    _blocks_write_bytes(bad_path, bad, fsize);
+    TASSERT2(_blocks_read_dies(bad_path), "block %zu nkmers+1", i);
+
+    memcpy(bad, data, fsize);
+    nkmers -= 2;
+    memcpy(bad+blks[i]+1, &nkmers, sizeof(uint32_t));
+    _blocks_write_bytes(bad_path, bad, fsize);
+    TASSERT2(_blocks_read_dies(bad_path), "block %zu nkmers-1", i);
+
+    // Decoded length larger than the buffer
+    memcpy(bad, data, fsize);
+    enc_len += 100;
+    memcpy(bad+blks[i]+9, &enc_len, sizeof(uint32_t));
+    _blocks_write_bytes(bad_path, bad, fsize);
+    TASSERT2(_blocks_read_dies(bad_path), "block %zu enc_len", i);
+
+    // Compressed data fails its checksum
+    if(codec == GRAPH_BLOCK_CODEC_ZLIB) {
+      memcpy(bad, data, fsize);
+      bad[blks[i] + GRAPH_BLOCK_HDR_BYTES + 10] ^= 0x5a;
+      _blocks_write_bytes(bad_path, bad, fsize);
+      TASSERT2(_blocks_read_dies(bad_path), "block %zu zlib data", i);
+    }
+  }
+
+  // Index offset, block offset and kmer count out of range
+  uint64_t vals[3] = {fsize, fsize, n+1};
+  size_t offsets[3] = {fsize - GRAPH_BLOCK_TRAILER_BYTES,
+                       idx_offset + sizeof(BinaryKmer),
+                       fsize - GRAPH_BLOCK_TRAILER_BYTES + 16};
+  for(i = 0; i < 3; i++) {
+    memcpy(bad, data, fsize);
+    memcpy(bad + offsets[i], &vals[i], sizeof(uint64_t));
+    _blocks_write_bytes(bad_path, bad, fsize);
+    TASSERT2(_blocks_read_dies(bad_path), "index %zu", i);
+  }
+
+  unlink(bad_path);
+  ctx_free(blks);
+  ctx_free(bad);
+  ctx_free(data);
+}
+
+void test_graph_file_blocks()
+{
+  test_status("Testing block compressed graph files");
+
+  char path[PATH_MAX+1];
+  fclose(all_tests_tmp_file(path, ".ctx"));
+  bool have_codec[2] = {false, false};
+
+  BlocksTestKmer *kmers = ctx_calloc(BLOCKS_TEST_NKMERS, sizeof(BlocksTestKmer));
+  size_t n = _blocks_make_kmers(kmers, BLOCKS_TEST_NKMERS);
+
+  _blocks_write_file(path, kmers, n);
+  _blocks_check_file(path, kmers, n);
+  _blocks_check_corrupt(path, n, have_codec);
+
+  // A single kmer is not worth compressing
+  _blocks_write_file(path, kmers+n-1, 1);
+  _blocks_check_file(path, kmers+n-1, 1);
+  _blocks_check_corrupt(path, 1, have_codec);
+
+  TASSERT(have_codec[GRAPH_BLOCK_CODEC_NONE]);
+  TASSERT(have_codec[GRAPH_BLOCK_CODEC_ZLIB]);
+
+  unlink(path);
+  ctx_free(kmers);
+}
@@ -13,6 +13,110 @@ static void check_bkmers(hkey_t key, HashTable *ht, BinaryKmer *ptr, size_t *c)
   (*c)++;
 }
 
+// Batch lookups should give the same results as one at a time
+static void test_hash_table_batch()
+{
+  test_status("Test batch find/insert in hash_table");
+
+  HashTable ht;
+  BinaryKmer bkeys[NTESTS];
+  hkey_t hkeys0[NTESTS], hkeys1[NTESTS];
+  bool found0[NTESTS], found1[NTESTS];
+  size_t i, kmer_size = MAX_KMER_SIZE;
+  uint8_t *bktlocks;
+
+  hash_table_alloc(&ht, NTESTS*2);
+  bktlocks = ctx_calloc(roundup_bits2bytes(ht.num_of_buckets), 1);
+
+  // Repeat some kmers so we find kmers inserted earlier in the same batch
+  for(i = 0; i < NTESTS; i++) {
+    if(i % 5 == 4) bkeys[i] = bkeys[i/2];
+    else bkeys[i] = binary_kmer_get_key(binary_kmer_random(kmer_size), kmer_size);
+  }
+
+  // First half are in the table
+  hash_table_find_or_insert_batch_mt(&ht, bkeys, NTESTS/2, hkeys0, found0,
+                                     bktlocks);
+
+  for(i = 0; i < NTESTS/2; i++) {
+    hkeys1[i] = hash_table_find_or_insert(&ht, bkeys[i], &found1[i]);
+    TASSERT(found1[i]);
+    TASSERT(hkeys0[i] == hkeys1[i]);
+    TASSERT(found0[i] == (i % 5 == 4));
+  }
+
+  hash_table_find_batch(&ht, bkeys, NTESTS, hkeys0);
+
+  for(i = 0; i < NTESTS; i++) {
+    hkeys1[i] = hash_table_find(&ht, bkeys[i]);
+    TASSERT(hkeys0[i] == hkeys1[i]);
+    TASSERT((hkeys0[i] != HASH_NOT_FOUND) == (i < NTESTS/2 || i % 5 == 4));
+  }
+
+  ctx_free(bktlocks);
+  hash_table_dealloc(&ht);
+}
+
+#define MT_NTHREADS 4
+#define MT_CAPACITY (1<<16)
+
+typedef struct
+{
+  size_t threadid, nkeys;
+  HashTable *ht;
+  const BinaryKmer *bkeys;
+  volatile uint8_t *bktlocks;
+} HashTableInserter;
+
+static void hash_table_insert_thread(void *arg)
+{
+  const HashTableInserter *ins = (const HashTableInserter*)arg;
+  size_t i;
+  bool found;
+  for(i = ins->threadid; i < ins->nkeys; i += MT_NTHREADS)
+    hash_table_find_or_insert_mt(ins->ht, ins->bkeys[i], &found, ins->bktlocks);
+}
+
+// Fill a table to 90% from several threads, so that buckets fill up while
+// other threads are probing them. Every key should then be found.
+static void test_hash_table_mt()
+{
+  test_status("Test multithreaded insert into a nearly full hash_table");
+
+  HashTable ht;
+  BinaryKmer *bkeys = ctx_malloc(MT_CAPACITY * sizeof(BinaryKmer));
+  HashTableInserter inserters[MT_NTHREADS];
+  size_t i, nkeys, round, kmer_size = MAX_KMER_SIZE;
+  uint8_t *bktlocks;
+
+  for(round = 0; round < 10; round++)
+  {
+    hash_table_alloc(&ht, MT_CAPACITY);
+    bktlocks = ctx_calloc(roundup_bits2bytes(ht.num_of_buckets), 1);
+    nkeys = MIN2(ht.capacity, MT_CAPACITY) / 10 * 9;
+
+    for(i = 0; i < nkeys; i++)
+      bkeys[i] = binary_kmer_get_key(binary_kmer_random(kmer_size), kmer_size);
+
+    for(i = 0; i < MT_NTHREADS; i++) {
+      inserters[i] = (HashTableInserter){.threadid = i, .nkeys = nkeys,
+                                         .ht = &ht, .bkeys = bkeys,
+                                         .bktlocks = bktlocks};
+    }
+
+    util_run_threads(inserters, MT_NTHREADS, sizeof(HashTableInserter),
+                     MT_NTHREADS, hash_table_insert_thread);
+
+    for(i = 0; i < nkeys; i++)
+      TASSERT(hash_table_find(&ht, bkeys[i]) != HASH_NOT_FOUND);
+
+    ctx_free(bktlocks);
+    hash_table_dealloc(&ht);
+  }
+
+  ctx_free(bkeys);
+}
+
 void test_hash_table()
 {
   test_status("Test add/delete to hash_table");
@@ -67,4 +171,7 @@ void test_hash_table()
   TASSERT(binary_kmers_are_equal(bkxor, bkresult));
 
   hash_table_dealloc(&ht);
+
+  test_hash_table_batch();
+  test_hash_table_mt();
 }
@@ -1,9 +1,13 @@
 #include "global.h"
 #include "all_tests.h"
+#include "file_util.h"
 #include "db_graph.h"
 #include "build_graph.h"
 #include "generate_paths.h"
 #include "gpath_checks.h"
+#include "gpath_save.h"
+#include "gpath_reader.h"
+#include "gpath_subset.h"
 
 //       junctions:  >     >           <     <     <
 const char seq0[] = "CCTGGGTGCGAATGACACCAAATCGAATGAC"; // a->d
@@ -122,6 +126,24 @@ static void _check_node_paths(const char *kmer,
   size_buf_dealloc(&jposbuf);
 }
 
+static void _check_all_node_paths(const dBGraph *graph)
+{
+  // Test path store
+  gpath_checks_all_paths(graph, 1); // use one thread
+
+  // Test path content
+  _check_node_paths(kmerA,  kmerApaths,  NPATHS_A,  0, graph);
+  _check_node_paths(kmerB,  kmerBpaths,  NPATHS_B,  0, graph);
+  _check_node_paths(kmerAB, kmerABpaths, NPATHS_AB, 0, graph);
+  _check_node_paths(kmerC,  kmerCpaths,  NPATHS_C,  0, graph);
+  _check_node_paths(kmerG,  kmerGpaths,  NPATHS_G,  0, graph);
+  _check_node_paths(kmerF,  kmerFpaths,  NPATHS_F,  0, graph);
+  _check_node_paths(kmerE,  kmerEpaths,  NPATHS_E,  0, graph);
+  _check_node_paths(kmerD,  kmerDpaths,  NPATHS_D,  0, graph);
+  _check_node_paths(kmerDEF,kmerDEFpaths,NPATHS_DEF,0, graph);
+  _check_node_paths(kmerDE, kmerDEpaths, NPATHS_DE, 0, graph);
+}
+
 static void _test_add_paths()
 {
   test_status("Testing adding paths in generate_paths.c and gpath_fetch()");
@@ -159,20 +181,195 @@ static void _test_add_paths()
   all_tests_add_paths(&graph, seq2, params, 3, 2); // path lens: 1+1+1
   all_tests_add_paths(&graph, seq3, params, 2, 1); // path lens: 1+1
 
-  // Test path store
-  gpath_checks_all_paths(&graph, 1); // use one thread
+  _check_all_node_paths(&graph);
 
-  // Test path content
-  _check_node_paths(kmerA,  kmerApaths,  NPATHS_A,  0, &graph);
-  _check_node_paths(kmerB,  kmerBpaths,  NPATHS_B,  0, &graph);
-  _check_node_paths(kmerAB, kmerABpaths, NPATHS_AB, 0, &graph);
-  _check_node_paths(kmerC,  kmerCpaths,  NPATHS_C,  0, &graph);
-  _check_node_paths(kmerG,  kmerGpaths,  NPATHS_G,  0, &graph);
-  _check_node_paths(kmerF,  kmerFpaths,  NPATHS_F,  0, &graph);
-  _check_node_paths(kmerE,  kmerEpaths,  NPATHS_E,  0, &graph);
-  _check_node_paths(kmerD,  kmerDpaths,  NPATHS_D,  0, &graph);
-  _check_node_paths(kmerDEF,kmerDEFpaths,NPATHS_DEF,0, &graph);
-  _check_node_paths(kmerDE, kmerDEpaths, NPATHS_DE, 0, &graph);
+  // Compacted store should give the same paths, sorted for each kmer
+  size_t npaths = graph.gpstore.num_paths, i, n;
+  hkey_t hkey;
+  const GPath *gpath;
+
+  gpath_store_compact(&graph.gpstore);
+  TASSERT(gpath_store_is_compact(&graph.gpstore));
+  TASSERT(graph.gpstore.offsets[graph.ht.capacity] == npaths);
+
+  for(hkey = 0; hkey < graph.ht.capacity; hkey++) {
+    gpath = gpath_store_fetch_range(&graph.gpstore, hkey, &n);
+    for(i = 1; i < n; i++) TASSERT(gpath_cmp(&gpath[i-1], &gpath[i]) <= 0);
+  }
+
+  _check_all_node_paths(&graph);
+
+  db_graph_dealloc(&graph);
+}
+
+//
+// Save and reload paths
+//
+
+static void _save_paths_txt(const char *path, const ZeroSizeBuffer *hists,
+                            dBGraph *graph)
+{
+  futil_set_force(true);
+  gzFile gzout = futil_gzopen_create(path, "w");
+  futil_set_force(false);
+  gpath_save(gzout, path, 1, false, NULL, 0, hists, graph->num_of_cols, graph);
+  gzclose(gzout);
+}
+
+static void _save_paths_bin(const char *path, const ZeroSizeBuffer *hists,
+                            dBGraph *graph)
+{
+  futil_set_force(true);
+  FILE *fout = futil_open_create(path, "w");
+  futil_set_force(false);
+  gpath_save_bin(fout, path, 2, NULL, 0, hists, graph->num_of_cols, graph);
+  fclose(fout);
+}
+
+// Load paths from a file into an empty graph
+static void _load_paths(const char *path, size_t kmer_size, size_t ncols,
+                        size_t nthreads, dBGraph *graph)
+{
+  db_graph_alloc(graph, kmer_size, ncols, ncols, 1024,
+                 DBG_ALLOC_EDGES | DBG_ALLOC_COVGS |
+                 DBG_ALLOC_BKTLOCKS | DBG_ALLOC_NODE_IN_COL);
+
+  gpath_store_alloc(&graph->gpstore, ncols, graph->ht.capacity,
+                    0, ONE_MEGABYTE, true, false);
+
+  GPathReader gpfile;
+  memset(&gpfile, 0, sizeof(gpfile));
+  gpath_reader_open(&gpfile, path);
+  TASSERT(gpfile.ncolours == ncols);
+  gpath_reader_load(&gpfile, GPATH_ADD_MISSING_KMERS, nthreads, graph);
+  gpath_reader_close(&gpfile);
+}
+
+// Check graphs `a` and `b` have the same paths on every kmer
+static void _check_same_paths(dBGraph *a, dBGraph *b)
+{
+  TASSERT(a->gpstore.num_paths == b->gpstore.num_paths);
+  TASSERT(a->gpstore.num_kmers_with_paths == b->gpstore.num_kmers_with_paths);
+
+  StrBuf sbufa, sbufb;
+  strbuf_alloc(&sbufa, 1024);
+  strbuf_alloc(&sbufb, 1024);
+
+  GPathSubset subseta, subsetb;
+  gpath_subset_alloc(&subseta);
+  gpath_subset_alloc(&subsetb);
+  gpath_subset_init(&subseta, &a->gpstore.gpset);
+  gpath_subset_init(&subsetb, &b->gpstore.gpset);
+
+  hkey_t hkeya, hkeyb;
+  size_t nkmers_with_paths = 0;
+
+  for(hkeya = 0; hkeya < a->ht.capacity; hkeya++) {
+    if(!HASH_ENTRY_ASSIGNED(a->ht.table[hkeya])) continue;
+    strbuf_reset(&sbufa);
+    strbuf_reset(&sbufb);
+    gpath_save_sbuf(hkeya, &sbufa, &subseta, NULL, NULL, a);
+    hkeyb = hash_table_find(&b->ht, a->ht.table[hkeya]);
+    if(hkeyb != HASH_NOT_FOUND)
+      gpath_save_sbuf(hkeyb, &sbufb, &subsetb, NULL, NULL, b);
+    TASSERT2(strcmp(sbufa.b, sbufb.b) == 0, "%s vs %s", sbufa.b, sbufb.b);
+    nkmers_with_paths += (sbufa.end > 0);
+  }
+
+  TASSERT(nkmers_with_paths == a->gpstore.num_kmers_with_paths);
+
+  gpath_subset_dealloc(&subseta);
+  gpath_subset_dealloc(&subsetb);
+  strbuf_dealloc(&sbufa);
+  strbuf_dealloc(&sbufb);
+}
+
+// Save paths in text and binary formats, reload and compare
+static void _check_save_load_paths(dBGraph *graph)
+{
+  char txt_path[PATH_MAX+1], bin_path[PATH_MAX+1];
+  dBGraph txt_graph, txt_mt_graph, bin_graph;
+  fclose(all_tests_tmp_file(txt_path, ".ctp.gz"));
+  fclose(all_tests_tmp_file(bin_path, ".ctp"));
+
+  // Contig length histograms only need to cover the longest path
+  size_t i, ncols = graph->num_of_cols;
+  ZeroSizeBuffer hists[ncols];
+  for(i = 0; i < ncols; i++) {
+    zsize_buf_alloc(&hists[i], 128);
+    zsize_buf_extend(&hists[i], 100);
+    hists[i].data[99] = 1;
+  }
+
+  _save_paths_txt(txt_path, hists, graph);
+  _save_paths_bin(bin_path, hists, graph);
+
+  for(i = 0; i < ncols; i++) zsize_buf_dealloc(&hists[i]);
+
+  _load_paths(txt_path, graph->kmer_size, graph->num_of_cols, 1, &txt_graph);
+  _load_paths(txt_path, graph->kmer_size, graph->num_of_cols, 4, &txt_mt_graph);
+  _load_paths(bin_path, graph->kmer_size, graph->num_of_cols, 2, &bin_graph);
+
+  _check_same_paths(graph, &txt_graph);
+  _check_same_paths(&txt_graph, &bin_graph);
+  _check_same_paths(&bin_graph, &txt_graph);
+  _check_same_paths(&txt_graph, &txt_mt_graph);
+
+  db_graph_dealloc(&txt_graph);
+  db_graph_dealloc(&txt_mt_graph);
+  db_graph_dealloc(&bin_graph);
+  unlink(txt_path);
+  unlink(bin_path);
+}
+
+static void _test_save_load_paths()
+{
+  test_status("Testing saving and loading text and binary path files");
+
+  // Construct 2 colour graph with kmer-size=11, generating paths requires a
+  // single edge colour
+  dBGraph graph;
+  size_t kmer_size = 11, ncols = 2;
+
+  db_graph_alloc(&graph, kmer_size, ncols, 1, 1024,
+                 DBG_ALLOC_EDGES | DBG_ALLOC_COVGS |
+                 DBG_ALLOC_BKTLOCKS | DBG_ALLOC_NODE_IN_COL);
+
+  gpath_store_alloc(&graph.gpstore,
+                    graph.num_of_cols, graph.ht.capacity,
+                    0, ONE_MEGABYTE, true, false);
+
+  gpath_hash_alloc(&graph.gphash, &graph.gpstore, ONE_MEGABYTE);
+
+  build_graph_from_str_mt(&graph, 0, seq0, strlen(seq0));
+  build_graph_from_str_mt(&graph, 0, seq1, strlen(seq1));
+  build_graph_from_str_mt(&graph, 0, seq2, strlen(seq2));
+  build_graph_from_str_mt(&graph, 0, seq3, strlen(seq3));
+  build_graph_from_str_mt(&graph, 1, seq0, strlen(seq0));
+  build_graph_from_str_mt(&graph, 1, seq2, strlen(seq2));
+
+  // Empty path files
+  _check_save_load_paths(&graph);
+
+  CorrectAlnParam params = {.ctpcol = 0, .ctxcol = 0,
+                            .frag_len_min = 0, .frag_len_max = 0,
+                            .one_way_gap_traverse = true, .use_end_check = true,
+                            .max_context = 10,
+                            .gap_variance = 0.1, .gap_wiggle = 5};
+
+  all_tests_add_paths(&graph, seq0, params, 5, 5);
+  all_tests_add_paths(&graph, seq1, params, 5, 2);
+  all_tests_add_paths(&graph, seq2, params, 3, 2);
+  all_tests_add_paths(&graph, seq3, params, 2, 1);
+
+  // Paths in colour 1 are a subset of those in colour 0, so some paths are
+  // in both colours and some in only one
+  params.ctpcol = params.ctxcol = 1;
+  all_tests_add_paths(&graph, seq0, params, -1, -1);
+  all_tests_add_paths(&graph, seq2, params, -1, -1);
+  all_tests_add_paths(&graph, seq2, params, -1, -1);
+
+  _check_save_load_paths(&graph);
 
   db_graph_dealloc(&graph);
 }
@@ -180,4 +377,5 @@ static void _test_add_paths()
 void test_paths()
 {
   _test_add_paths();
+  _test_save_load_paths();
 }
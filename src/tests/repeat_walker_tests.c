@@ -28,7 +28,7 @@ static void test_walk(GraphWalker *gwlk, RepeatWalker *rptwlk,
   TASSERT2(strcmp(tmp,ans) == 0, "%s vs %s", tmp, ans);
 
   graph_walker_finish(gwlk);
-  rpt_walker_fast_clear(rptwlk, nbuf->data, nbuf->len);
+  rpt_walker_clear(rptwlk);
 }
 
 static void test_repeat_loop()
@@ -104,8 +104,68 @@ static void test_repeat_loop()
   db_graph_dealloc(&graph);
 }
 
+// Add nodes 0..n-1 (both orientations) with a stride, check and clear
+static void _test_visited_set_fill(VisitedSet *vset, size_t n, size_t stride)
+{
+  size_t i;
+  dBNode node;
+
+  for(i = 0; i < n; i++) {
+    node = (dBNode){.key = (i*stride) % vset->hash_capacity, .orient = i&1};
+    TASSERT(!visited_set_has(vset, node));
+    TASSERT(visited_set_add(vset, node));
+    TASSERT(!visited_set_add(vset, node));
+    TASSERT(visited_set_has(vset, node));
+    TASSERT(!visited_set_has(vset, db_node_reverse(node)));
+  }
+
+  visited_set_clear(vset);
+
+  for(i = 0; i < n; i++) {
+    node = (dBNode){.key = (i*stride) % vset->hash_capacity, .orient = i&1};
+    TASSERT(!visited_set_has(vset, node));
+  }
+}
+
+static void test_visited_set()
+{
+  VisitedSet vset;
+  size_t i;
+
+  // Large graph: set grows but never needs a bitmap
+  visited_set_alloc(&vset, 1UL<<24);
+  _test_visited_set_fill(&vset, 100, 7919);
+  _test_visited_set_fill(&vset, 10000, 7919);
+  TASSERT(vset.size > VISITED_SET_INIT_SIZE);
+  TASSERT(vset.bitmap == NULL);
+
+  // Many clears to check epochs, short walks shrink the set again
+  for(i = 0; i < 1000; i++) _test_visited_set_fill(&vset, 10, i+1);
+  TASSERT(vset.size == VISITED_SET_INIT_SIZE);
+  visited_set_dealloc(&vset);
+
+  // Small graph: long walk switches to a bitmap, then back after clearing
+  visited_set_alloc(&vset, 1UL<<16);
+  for(i = 0; i < 5000; i++)
+    visited_set_add(&vset, (dBNode){.key = (i*13) % vset.hash_capacity,
+                                    .orient = i&1});
+  TASSERT(vset.use_bitmap && vset.bitmap != NULL);
+  TASSERT(vset.size == VISITED_SET_INIT_SIZE);
+  TASSERT(vset.size * sizeof(VisitedSetSlot) +
+          visited_set_bitmap_mem(vset.hash_capacity) <=
+          visited_set_peak_mem(vset.hash_capacity));
+  visited_set_clear(&vset);
+  TASSERT(!vset.use_bitmap && vset.bitmap == NULL);
+  _test_visited_set_fill(&vset, 5000, 13);
+  TASSERT(vset.bitmap == NULL);
+  _test_visited_set_fill(&vset, 100, 13);
+  TASSERT(!vset.use_bitmap);
+  visited_set_dealloc(&vset);
+}
+
 void test_repeat_walker()
 {
   test_status("Testing repeat_walker.h");
+  test_visited_set();
   test_repeat_loop();
 }
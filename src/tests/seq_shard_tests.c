@@ -0,0 +1,257 @@
+#include "global.h"
+#include "all_tests.h"
+#include "seq_shard.h"
+#include "seq_reader.h"
+#include "file_util.h"
+#include "htslib/bgzf.h"
+
+#define SHARD_TEST_NREADS 60
+#define SHARD_TEST_MAX_SHARDS 20
+
+// File offsets of a record: first byte, '+' line, quality line and one past
+// the end. For FASTA only start and end are set.
+typedef struct
+{
+  off_t start, plus, qual, end;
+} ShardTestRecord;
+
+// Reads collected as strings, one per read or pair
+typedef struct
+{
+  char **strs;
+  size_t len, capacity;
+} ShardTestReads;
+
+static void _reads_add(read_t *r1, read_t *r2, uint8_t qoffset1,
+                       uint8_t qoffset2, void *ptr)
+{
+  (void)qoffset1; (void)qoffset2;
+  ShardTestReads *reads = (ShardTestReads*)ptr;
+  StrBuf sbuf;
+  strbuf_alloc(&sbuf, 256);
+  strbuf_sprintf(&sbuf, "%s %s %s", r1->name.b, r1->seq.b, r1->qual.b);
+  if(r2 != NULL)
+    strbuf_sprintf(&sbuf, " | %s %s %s", r2->name.b, r2->seq.b, r2->qual.b);
+
+  if(reads->len == reads->capacity) {
+    reads->capacity = reads->capacity ? reads->capacity*2 : 64;
+    reads->strs = ctx_reallocarray(reads->strs, reads->capacity, sizeof(char*));
+  }
+  reads->strs[reads->len] = ctx_malloc(sbuf.end+1);
+  memcpy(reads->strs[reads->len++], sbuf.b, sbuf.end+1);
+  strbuf_dealloc(&sbuf);
+}
+
+static void _reads_reset(ShardTestReads *reads)
+{
+  size_t i;
+  for(i = 0; i < reads->len; i++) ctx_free(reads->strs[i]);
+  reads->len = 0;
+}
+
+static int _cmp_strs(const void *a, const void *b)
+{
+  return strcmp(*(char*const*)a, *(char*const*)b);
+}
+
+// Append a read to `sbuf`, recording its offsets. Every other FASTQ quality
+// string starts with '@' so that it looks like a read header.
+static void _write_read(StrBuf *sbuf, bool fastq, const char *name,
+                        ShardTestRecord *rec)
+{
+  char seq[100];
+  size_t i, len = 20 + rand() % 60;
+  rand_bases(seq, len);
+  seq[len] = '\0';
+
+  rec->start = (off_t)sbuf->end;
+
+  if(fastq) {
+    strbuf_sprintf(sbuf, "@%s\n%s\n", name, seq);
+    rec->plus = (off_t)sbuf->end;
+    strbuf_append_str(sbuf, "+\n");
+    rec->qual = (off_t)sbuf->end;
+    for(i = 0; i < len; i++) seq[i] = (char)('A' + rand() % 10);
+    if(rand() & 1) seq[0] = '@';
+    strbuf_sprintf(sbuf, "%s\n", seq);
+  }
+  else {
+    // Multiline FASTA
+    strbuf_sprintf(sbuf, ">%s\n", name);
+    for(i = 0; i < len; i += 30) {
+      strbuf_append_strn(sbuf, seq+i, MIN2(30, len-i));
+      strbuf_append_char(sbuf, '\n');
+    }
+  }
+
+  rec->end = (off_t)sbuf->end;
+}
+
+// Check that the union of all shards is the same as a single pass parse of
+// the file for shard counts 1..SHARD_TEST_MAX_SHARDS and `last_nshards`
+// `recs` are the records written, with pairs in consecutive records. They are
+// NULL for compressed files, where file offsets are not record offsets.
+static void _check_shards(const char *path, bool interleaved,
+                          const ShardTestRecord *recs, size_t nrecs,
+                          const char *fqchars, size_t last_nshards)
+{
+  ShardTestReads expect = {.len = 0}, found = {.len = 0};
+  read_t r1, r2;
+  SeqShard sh;
+  uint8_t qoffset, qmin, qmax;
+  size_t n, nshards, idx, i;
+  off_t fsize = futil_get_file_size(path);
+  bool straddle = false, at_qual = false, split_pair = false;
+
+  seq_read_alloc(&r1);
+  seq_read_alloc(&r2);
+
+  // Single pass
+  seq_file_t *sf = seq_open(path);
+  if(sf == NULL) die("Cannot open: %s", path);
+  if(interleaved) seq_parse_interleaved_sf(sf, 0, &r1, &r2, _reads_add, &expect);
+  else seq_parse_se_sf(sf, 0, &r1, _reads_add, &expect);
+  seq_close(sf);
+
+  TASSERT2(expect.len == (interleaved ? nrecs/2 : nrecs),
+           "%zu vs %zu", expect.len, nrecs);
+  qsort(expect.strs, expect.len, sizeof(char*), _cmp_strs);
+
+  sf = seq_open(path);
+  if(sf == NULL) die("Cannot open: %s", path);
+  seq_guess_qual_range(sf, 0, &qoffset, &qmin, &qmax);
+
+  for(n = 1; n <= SHARD_TEST_MAX_SHARDS+1; n++)
+  {
+    nshards = n <= SHARD_TEST_MAX_SHARDS ? n : last_nshards;
+    for(idx = 0; idx < nshards; idx++) {
+      seq_shard_open(&sh, sf, idx, nshards, 1);
+      seq_parse_shard(&sh, interleaved, qoffset, qmin, qmax, &r1, &r2,
+                      _reads_add, &found);
+
+      // Record which cases shard boundaries have hit
+      for(i = 0; recs != NULL && i < nrecs && sh.start > 0; i++) {
+        straddle |= (recs[i].start < sh.start && sh.start < recs[i].end);
+        at_qual |= (fqchars != NULL && fqchars[i] == '@' &&
+                    recs[i].plus < sh.start && sh.start <= recs[i].qual);
+        split_pair |= (interleaved && (i&1) &&
+                       recs[i-1].start < sh.start && sh.start <= recs[i].start);
+      }
+
+      seq_shard_close(&sh);
+    }
+
+    // No reads dropped or duplicated
+    qsort(found.strs, found.len, sizeof(char*), _cmp_strs);
+    TASSERT2(found.len == expect.len, "nshards: %zu; %zu vs %zu",
+             nshards, found.len, expect.len);
+    for(i = 0; i < found.len && i < expect.len; i++) {
+      TASSERT2(strcmp(found.strs[i], expect.strs[i]) == 0,
+               "nshards: %zu; '%s' vs '%s'", nshards,
+               found.strs[i], expect.strs[i]);
+    }
+    _reads_reset(&found);
+  }
+
+  seq_close(sf);
+
+  // Check the file was cut in the places we wanted to test
+  TASSERT2(fsize > 0 && (recs == NULL || straddle), "%s", path);
+  TASSERT2(fqchars == NULL || at_qual, "%s", path);
+  TASSERT2(!interleaved || split_pair, "%s", path);
+
+  _reads_reset(&expect);
+  ctx_free(expect.strs);
+  ctx_free(found.strs);
+  seq_read_dealloc(&r1);
+  seq_read_dealloc(&r2);
+}
+
+static void _test_shard_file(bool fastq, bool interleaved)
+{
+  test_status("Testing sharding %s %s", fastq ? "FASTQ" : "FASTA",
+              interleaved ? "interleaved pairs" : "single reads");
+
+  ShardTestRecord recs[SHARD_TEST_NREADS];
+  char fqchars[SHARD_TEST_NREADS], name[50], path[PATH_MAX+1];
+  StrBuf sbuf;
+  size_t i;
+
+  strbuf_alloc(&sbuf, 4096);
+
+  for(i = 0; i < SHARD_TEST_NREADS; i++) {
+    if(interleaved) sprintf(name, "r%zu/%zu", i/2, (i&1)+1);
+    else sprintf(name, "r%zu", i);
+    _write_read(&sbuf, fastq, name, &recs[i]);
+    fqchars[i] = fastq ? sbuf.b[recs[i].qual] : '\0';
+  }
+
+  FILE *fh = all_tests_tmp_file(path, fastq ? ".fq" : ".fa");
+  if(fwrite(sbuf.b, 1, sbuf.end, fh) != sbuf.end) die("Cannot write: %s", path);
+  fclose(fh);
+
+  // Start a shard at every byte of the file
+  _check_shards(path, interleaved, recs, SHARD_TEST_NREADS,
+                fastq ? fqchars : NULL, (size_t)sbuf.end);
+
+  unlink(path);
+  strbuf_dealloc(&sbuf);
+}
+
+// Bgzipped FASTQ with a BGZF block starting at each read, inside each read
+// and at each quality string, so that reads straddle blocks and the last
+// character before a block may or may not be a new line
+static void _test_shard_bgzf(bool interleaved)
+{
+  test_status("Testing sharding bgzipped FASTQ %s",
+              interleaved ? "interleaved pairs" : "single reads");
+
+  ShardTestRecord recs[SHARD_TEST_NREADS];
+  char name[50], path[PATH_MAX+1];
+  StrBuf sbuf;
+  size_t i, n, pos = 0, nblocks = 0;
+  off_t cut;
+
+  strbuf_alloc(&sbuf, 4096);
+
+  for(i = 0; i < SHARD_TEST_NREADS; i++) {
+    if(interleaved) sprintf(name, "r%zu/%zu", i/2, (i&1)+1);
+    else sprintf(name, "r%zu", i);
+    _write_read(&sbuf, true, name, &recs[i]);
+  }
+
+  fclose(all_tests_tmp_file(path, ".fq.gz"));
+  BGZF *bgzf = bgzf_open(path, "w");
+  if(bgzf == NULL) die("Cannot open: %s", path);
+
+  for(i = 0; i <= SHARD_TEST_NREADS; i++) {
+    if(i == SHARD_TEST_NREADS) cut = (off_t)sbuf.end;
+    else if(i % 3 == 0) cut = recs[i].start;
+    else if(i % 3 == 1) cut = (recs[i].start + recs[i].plus) / 2;
+    else cut = recs[i].qual;
+
+    if((n = (size_t)cut - pos) == 0) continue;
+    if(bgzf_write(bgzf, sbuf.b+pos, n) != (ssize_t)n || bgzf_flush(bgzf) != 0)
+      die("Cannot write: %s", path);
+    pos += n;
+    nblocks++;
+  }
+
+  if(bgzf_close(bgzf) != 0) die("Cannot write: %s", path);
+  TASSERT(nblocks > SHARD_TEST_MAX_SHARDS);
+
+  // Several shards per block so that most blocks start a shard
+  _check_shards(path, interleaved, NULL, SHARD_TEST_NREADS, NULL, 4*nblocks);
+
+  unlink(path);
+  strbuf_dealloc(&sbuf);
+}
+
+void test_seq_shard()
+{
+  _test_shard_file(false, false);
+  _test_shard_file(true, false);
+  _test_shard_file(true, true);
+  _test_shard_bgzf(false);
+  _test_shard_bgzf(true);
+}
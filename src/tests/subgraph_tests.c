@@ -120,9 +120,50 @@ static void test_subgraph_supernodes()
   db_graph_dealloc(&graph);
 }
 
+// Extend from many seeds so that the search is split between threads, with
+// too little fringe memory so that the fringe has to grow
+static void test_subgraph_threads()
+{
+  dBGraph graph;
+  const size_t kmer_size = 31, ncols = 1, nreads = 10000, readlen = 50;
+  const size_t dist = 5, nthreads = 4;
+  size_t i;
+
+  db_graph_alloc(&graph, kmer_size, ncols, ncols, nreads*readlen,
+                 DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS);
+
+  uint8_t *mask = ctx_calloc(roundup_bits2bytes(graph.ht.capacity), 1);
+  char *seqs = ctx_malloc(nreads * (readlen+1));
+  char **seeds = ctx_malloc(nreads * sizeof(char*));
+  size_t *seedlens = ctx_malloc(nreads * sizeof(size_t));
+
+  // Random reads are very unlikely to share kmers
+  for(i = 0; i < nreads; i++) {
+    seeds[i] = seqs + i*(readlen+1);
+    rand_bases(seeds[i], readlen);
+    seeds[i][readlen] = '\0';
+    seedlens[i] = kmer_size;
+    _tests_add_to_graph(&graph, seeds[i], 0);
+  }
+
+  // Seed with the first kmer of each read
+  subgraph_from_seq(&graph, nthreads, dist, false, false,
+                    2*sizeof(dBNode), mask, seeds, seedlens, nreads);
+
+  TASSERT2(graph.ht.num_kmers == nreads*(dist+1), "%zu kmers",
+           (size_t)graph.ht.num_kmers);
+
+  ctx_free(seedlens);
+  ctx_free(seeds);
+  ctx_free(seqs);
+  ctx_free(mask);
+  db_graph_dealloc(&graph);
+}
+
 void test_subgraph()
 {
   test_status("Testing subgraph...");
   simple_subgraph_test();
   test_subgraph_supernodes();
+  test_subgraph_threads();
 }
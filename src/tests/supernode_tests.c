@@ -3,6 +3,7 @@
 #include "binary_kmer.h"
 #include "db_node.h"
 #include "supernode.h"
+#include "unitig_index.h"
 #include "build_graph.h"
 
 #include "bit_array/bit_macros.h"
@@ -76,6 +77,120 @@ static void pull_out_supernodes(const char **seq, const char **ans, size_t n,
   db_node_buf_dealloc(&nbuf);
 }
 
+// Check every kmer is in a unitig that matches supernode_find()
+static void check_unitig_index(const UnitigIndex *uidx, const dBGraph *graph)
+{
+  dBNodeBuffer nbuf, snode;
+  db_node_buf_alloc(&nbuf, 1024);
+  db_node_buf_alloc(&snode, 1024);
+  size_t i, nutigs = 0, nkmers = 0;
+  const Unitig *utig;
+
+  for(i = 0; i < uidx->utigs.len; i++) {
+    utig = &uidx->utigs.data[i];
+    if(utig->len == 0) continue;
+    nutigs++;
+    nkmers += utig->len;
+
+    db_node_buf_reset(&nbuf);
+    unitig_index_fetch(uidx, i, &nbuf, graph);
+    TASSERT(nbuf.len == utig->len);
+    TASSERT(db_nodes_are_equal(nbuf.data[nbuf.len-1], utig->last));
+
+    db_node_buf_reset(&snode);
+    supernode_find(utig->first.key, &snode, graph);
+    supernode_normalise(snode.data, snode.len, graph);
+    TASSERT(snode.len == nbuf.len);
+    TASSERT(memcmp(snode.data, nbuf.data, nbuf.len * sizeof(dBNode)) == 0);
+  }
+
+  TASSERT2(nutigs == uidx->num_utigs, "%zu vs %zu", nutigs, (size_t)uidx->num_utigs);
+  TASSERT2(nkmers == graph->ht.num_kmers, "%zu vs %zu", nkmers, (size_t)graph->ht.num_kmers);
+
+  for(i = 0; i < graph->ht.capacity; i++) {
+    if(HASH_ENTRY_ASSIGNED(graph->ht.table[i])) {
+      TASSERT(uidx->ids[i] < uidx->utigs.len);
+      TASSERT(uidx->utigs.data[uidx->ids[i]].len > 0);
+    } else {
+      TASSERT(uidx->ids[i] == UNITIG_NONE);
+    }
+  }
+
+  db_node_buf_dealloc(&nbuf);
+  db_node_buf_dealloc(&snode);
+}
+
+static void test_unitig_index_prune()
+{
+  test_status("testing unitig_index_prune()...");
+
+  dBGraph graph;
+  const size_t kmer_size = 19, ncols = 1, nthreads = 2;
+
+  db_graph_alloc(&graph, kmer_size, ncols, ncols, 1024,
+                 DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS);
+
+  // 100bp with a SNP bubble at 39 and a tip at the end
+  const char seq[] =
+"GGCTACCTAACCAGATATCTCTGTATACAGCTGCATTGTGTTTAGTCTACAACGACAGAAATCCCCTTCGACGCCCGC"
+"GACCTCTCTTAACGGACGACGC";
+  const char snp[] =
+"GGCTACCTAACCAGATATCTCTGTATACAGCTGCATTGTCTTTAGTCTACAACGACAGAAATCCCCTTCGACGCCCGC";
+  const char tip[] = "GACCTCTCTTAACGGACGACGGTAGA";
+
+  build_graph_from_str_mt(&graph, 0, seq, strlen(seq));
+  build_graph_from_str_mt(&graph, 0, snp, strlen(snp));
+  build_graph_from_str_mt(&graph, 0, tip, strlen(tip));
+
+  UnitigIndex uidx;
+  unitig_index_alloc(&uidx, graph.ht.capacity);
+  unitig_index_build(&uidx, nthreads, &graph);
+  check_unitig_index(&uidx, &graph);
+
+  // bubble branches, tip, path either side
+  TASSERT2(uidx.num_utigs == 6, "%zu", (size_t)uidx.num_utigs);
+
+  // Unitigs either side of the SNP are adjacent to both branches
+  dBNode node = db_graph_find_str(&graph, seq);
+  ukey_t id = uidx.ids[node.key], next[4];
+  Orientation orients[4];
+  Orientation orient = db_nodes_are_equal(uidx.utigs.data[id].first, node)
+                       ? FORWARD : REVERSE;
+  TASSERT(unitig_index_next(&uidx, id, orient, next, orients, &graph) == 2);
+  TASSERT(unitig_index_next(&uidx, id, !orient, next, orients, &graph) == 0);
+
+  // Remove the SNP branch
+  uint8_t *utig_flags = ctx_calloc(roundup_bits2bytes(uidx.utigs.len), 1);
+  uint8_t *keep = ctx_calloc(roundup_bits2bytes(graph.ht.capacity), 1);
+  size_t i;
+
+  node = db_graph_find_str(&graph, snp+30);
+  for(i = 0; i < uidx.utigs.len; i++)
+    if(i != uidx.ids[node.key]) bitset_set(utig_flags, i);
+
+  unitig_index_flag_kmers(&uidx, nthreads, utig_flags, keep, &graph);
+  unitig_index_prune(&uidx, nthreads, keep, &graph);
+  check_unitig_index(&uidx, &graph);
+  TASSERT2(uidx.num_utigs == 3, "%zu", (size_t)uidx.num_utigs);
+
+  // Remove the tip
+  memset(keep, 0, roundup_bits2bytes(graph.ht.capacity));
+  node = db_graph_find_str(&graph, tip+strlen(tip)-kmer_size);
+  for(i = 0; i < graph.ht.capacity; i++)
+    if(uidx.ids[i] != UNITIG_NONE && uidx.ids[i] != uidx.ids[node.key])
+      bitset_set(keep, i);
+
+  unitig_index_prune(&uidx, nthreads, keep, &graph);
+  check_unitig_index(&uidx, &graph);
+  TASSERT2(uidx.num_utigs == 1, "%zu", (size_t)uidx.num_utigs);
+  TASSERT(graph.ht.num_kmers == strlen(seq)-kmer_size+1);
+
+  ctx_free(utig_flags);
+  ctx_free(keep);
+  unitig_index_dealloc(&uidx);
+  db_graph_dealloc(&graph);
+}
+
 void test_supernode()
 {
   test_status("testing supernode_find()...");
@@ -114,5 +229,14 @@ void test_supernode()
 
   pull_out_supernodes(seq, ans, NSEQ, &graph);
 
+  UnitigIndex uidx;
+  unitig_index_alloc(&uidx, graph.ht.capacity);
+  unitig_index_build(&uidx, 2, &graph);
+  check_unitig_index(&uidx, &graph);
+  TASSERT2(uidx.num_utigs == NSEQ, "%zu", (size_t)uidx.num_utigs);
+  unitig_index_dealloc(&uidx);
+
   db_graph_dealloc(&graph);
+
+  test_unitig_index_prune();
 }
@@ -1,6 +1,7 @@
 #include "global.h"
 #include "all_tests.h"
 #include "util.h"
+#include "thread_stats.h"
 
 #include <math.h> // NAN, INFINITY
 
@@ -72,6 +73,194 @@ static void test_util_calc_N50()
   TASSERT(calc_N50(arr, 10, 55) == 8);
 }
 
+typedef struct {
+  size_t threadid, nchunks;
+  TaskScheduler *sched;
+  uint8_t *counts;
+} TaskSchedTester;
+
+static void _task_sched_thread(void *arg)
+{
+  TaskSchedTester *t = (TaskSchedTester*)arg;
+  size_t i, start, end;
+  while(task_sched_next(t->sched, t->threadid, &start, &end)) {
+    TASSERT(start < end && end <= t->sched->nitems);
+    TASSERT(end - start <= t->sched->chunk_size);
+    for(i = start; i < end; i++) __sync_fetch_and_add(&t->counts[i], 1);
+    t->nchunks++;
+  }
+}
+
+static void test_util_task_sched()
+{
+  test_status("Testing work-stealing task scheduler");
+
+  const size_t nitems = 100003, nthreads_arr[] = {1, 3, 8};
+  uint8_t *counts = ctx_calloc(nitems, sizeof(uint8_t));
+  TaskSchedTester testers[8];
+  TaskScheduler sched;
+  size_t i, j, t, nthreads, nchunks;
+
+  for(i = 0; i < sizeof(nthreads_arr)/sizeof(nthreads_arr[0]); i++)
+  {
+    nthreads = nthreads_arr[i];
+    task_sched_alloc(&sched, nitems, nthreads);
+
+    // Run with nthreads threads, then with one thread to run the jobs one after
+    // another (also checks task_sched_reset())
+    for(j = 0; j < 2; j++) {
+      memset(counts, 0, nitems);
+      for(t = 0; t < nthreads; t++)
+        testers[t] = (TaskSchedTester){.threadid = t, .nchunks = 0,
+                                       .sched = &sched, .counts = counts};
+
+      util_run_threads(testers, nthreads, sizeof(testers[0]),
+                       j == 0 ? nthreads : 1, _task_sched_thread);
+
+      // Every item seen exactly once
+      for(t = 0; t < nitems && counts[t] == 1; t++) {}
+      TASSERT2(t == nitems, "nthreads: %zu item: %zu", nthreads, t);
+
+      nchunks = 0;
+      for(t = 0; t < nthreads; t++) nchunks += testers[t].nchunks;
+      TASSERT(nchunks >= (nitems+sched.chunk_size-1) / sched.chunk_size);
+
+      // When run one after another, the first job steals all the work
+      if(j == 1) {
+        for(t = 1; t < nthreads; t++) TASSERT(testers[t].nchunks == 0);
+      }
+
+      task_sched_reset(&sched);
+    }
+
+    task_sched_dealloc(&sched);
+  }
+
+  ctx_free(counts);
+}
+
+typedef struct {
+  size_t threadid, nitems;
+  ThreadHist *hist;
+  ThreadStats *stats;
+} ThreadStatsTester;
+
+static void _thread_stats_thread(void *arg)
+{
+  ThreadStatsTester *tst = (ThreadStatsTester*)arg;
+  uint64_t *count = thread_stats_get(tst->stats, tst->threadid);
+  size_t i;
+  for(i = 0; i < tst->nitems; i++) {
+    thread_hist_add(tst->hist, tst->threadid, i, 1);
+    (*count)++;
+  }
+}
+
+static void test_util_thread_stats()
+{
+  test_status("Testing per-thread stats and histograms");
+
+  const size_t nthreads = 5, histlen = 10;
+  ThreadStatsTester testers[5];
+  ThreadHist hist;
+  ThreadStats stats;
+  uint64_t merged[10], total = 0;
+  size_t t, i;
+
+  thread_hist_alloc(&hist, nthreads, histlen);
+  thread_stats_alloc(&stats, nthreads, sizeof(uint64_t));
+
+  // Each copy is on its own cache line
+  TASSERT(stats.stride == CACHE_LINE_BYTES);
+  TASSERT(hist.counts.stride == 2*CACHE_LINE_BYTES);
+  const char *ptr;
+  for(t = 0; t < nthreads; t++) {
+    ptr = thread_stats_get(&stats, t);
+    TASSERT((size_t)ptr % CACHE_LINE_BYTES == 0);
+    ptr = thread_stats_get(&hist.counts, t);
+    TASSERT((size_t)ptr % CACHE_LINE_BYTES == 0);
+  }
+
+  // Thread t adds one to bins 0..t*5, the last bin takes values past the end
+  for(t = 0; t < nthreads; t++)
+    testers[t] = (ThreadStatsTester){.threadid = t, .nitems = t*5+1,
+                                     .hist = &hist, .stats = &stats};
+
+  util_run_threads(testers, nthreads, sizeof(testers[0]), nthreads,
+                   _thread_stats_thread);
+
+  for(t = 0; t < nthreads; t++) {
+    total += *(uint64_t*)thread_stats_get(&stats, t);
+  }
+  TASSERT(total == 1+6+11+16+21);
+
+  thread_hist_merge(&hist, merged);
+  TASSERT(merged[0] == 5);
+  for(i = 1; i <= 5; i++) TASSERT2(merged[i] == 4, "i: %zu", i);
+  for(i = 6; i < histlen-1; i++) TASSERT2(merged[i] == 3, "i: %zu", i);
+  TASSERT(merged[histlen-1] == (11-9) + (16-9) + (21-9));
+
+  thread_stats_reset(&stats);
+  TASSERT(*(uint64_t*)thread_stats_get(&stats, nthreads-1) == 0);
+
+  thread_hist_dealloc(&hist);
+  thread_stats_dealloc(&stats);
+}
+
+static void _prof_thread(void *arg)
+{
+  volatile size_t *count = (volatile size_t*)arg;
+  size_t i;
+  for(i = 0; i < 100000; i++) (*count)++;
+}
+
+static void test_util_profile()
+{
+  test_status("Testing phase timers and per-thread times");
+
+  size_t counts[4] = {0}, nphases = 0, nhists = 0, i;
+  const uint64_t hist[3] = {5, 2, 1};
+  const CtxProfPhase *phases;
+  const CtxProfHist *hists;
+
+  ctx_prof_destroy();
+
+  // Phases with the same name are combined
+  ctx_prof_phase("test_a");
+  util_run_threads(counts, 4, sizeof(counts[0]), 3, _prof_thread);
+  ctx_prof_phase("test_b");
+  ctx_prof_phase("test_a");
+  util_run_threads(counts, 2, sizeof(counts[0]), 1, _prof_thread);
+  ctx_prof_phase_end();
+
+  // Not in a phase, not recorded
+  util_run_threads(counts, 4, sizeof(counts[0]), 4, _prof_thread);
+
+  phases = ctx_prof_get_phases(&nphases);
+  TASSERT(nphases == 2);
+  TASSERT(strcmp(phases[0].name, "test_a") == 0);
+  TASSERT(strcmp(phases[1].name, "test_b") == 0);
+  TASSERT(phases[0].nthreads == 3);
+  TASSERT(phases[1].nthreads == 0);
+  TASSERT(phases[0].wall_secs >= 0 && phases[1].wall_secs >= 0);
+  TASSERT(phases[0].peak_rss > 0);
+  for(i = 0; i < phases[0].nthreads; i++) {
+    TASSERT(phases[0].threads[i].busy_secs >= 0);
+    TASSERT(phases[0].threads[i].idle_secs >= 0);
+  }
+
+  ctx_prof_set_hist("test_hist", hist, 2);
+  ctx_prof_set_hist("test_hist", hist, 3);
+  hists = ctx_prof_get_hists(&nhists);
+  TASSERT(nhists == 1);
+  TASSERT(hists[0].len == 3);
+  TASSERT(hists[0].counts[0] == 5 && hists[0].counts[2] == 1);
+
+  ctx_prof_destroy();
+  phases = ctx_prof_get_phases(&nphases);
+  TASSERT(nphases == 0);
+}
+
 void test_util()
 {
   test_util_rev_nibble_lookup();
@@ -79,4 +268,7 @@ void test_util()
   test_util_bytes_to_str();
   test_util_calc_GCD();
   test_util_calc_N50();
+  test_util_task_sched();
+  test_util_thread_stats();
+  test_util_profile();
 }
@@ -24,6 +24,7 @@ typedef struct
   GPathSubset gpsubset;
 
   // Shared data
+  TaskScheduler *sched; // hash table entries to seed from
   volatile size_t *num_contig_ptr;
   size_t contig_limit;
   uint8_t *visited;
@@ -132,7 +133,7 @@ static void _assemble_contig(Assembler *assem, hkey_t hkey, const GPath *gpath,
                                          low_step_confid, low_cumul_confid);
 
     graph_walker_finish(wlk);
-    rpt_walker_fast_clear(rptwlk, nbuf->data, nbuf->len);
+    rpt_walker_clear(rptwlk);
   }
 
   dBNode first = db_node_reverse(nbuf->data[0]), last = nbuf->data[nbuf->len-1];
@@ -235,8 +236,8 @@ static inline void _seed_rnd_kmers(void *arg)
   Assembler *assem = (Assembler*)arg;
   const dBGraph *db_graph = assem->db_graph;
 
-  HASH_ITERATE_PART(&db_graph->ht, assem->threadid, assem->nthreads,
-                    _pulldown_contig, assem);
+  HASH_ITERATE_SCHED(&db_graph->ht, assem->sched, assem->threadid,
+                     _pulldown_contig, assem);
 }
 
 static void _seed_from_file(AsyncIOData *data, void *arg)
@@ -317,8 +318,8 @@ static void assemble_from_paths(void *arg)
 
   gpath_subset_alloc(&assem->gpsubset);
 
-  HASH_ITERATE_PART(&db_graph->ht, assem->threadid, assem->nthreads,
-                    _assemble_from_paths, assem);
+  HASH_ITERATE_SCHED(&db_graph->ht, assem->sched, assem->threadid,
+                     _assemble_from_paths, assem);
 
   gpath_set_dealloc(&assem->gpset);
   gpath_subset_dealloc(&assem->gpsubset);
@@ -378,8 +379,12 @@ void assemble_contigs(size_t nthreads,
   pthread_mutex_t outlock;
   if(pthread_mutex_init(&outlock, NULL) != 0) die("Mutex init failed");
 
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, nthreads);
+
   for(i = 0; i < nthreads; i++) {
     Assembler tmp = {.threadid = i, .nthreads = nthreads,
+                     .sched = &sched,
                      .num_contig_ptr = &num_contigs,
                      .contig_limit = contig_limit,
                      .use_missing_info_check = use_missing_info_check,
@@ -435,6 +440,7 @@ void assemble_contigs(size_t nthreads,
 
       if(i+1 < npathwords || used_paths[npathwords-1] < bitmask64(top_bits)) {
         status("[Assemble] Seeding with unused paths...");
+        task_sched_reset(&sched);
         util_run_threads(workers, nthreads, sizeof(workers[0]),
                          nthreads, assemble_from_paths);
       } else {
@@ -452,6 +458,7 @@ void assemble_contigs(size_t nthreads,
   }
 
   pthread_mutex_destroy(&outlock);
+  task_sched_dealloc(&sched);
   ctx_free(workers);
   ctx_free(used_paths);
 }
@@ -45,6 +45,7 @@ typedef struct
   gzFile gzout;
   pthread_mutex_t *const out_lock;
   size_t *callid;
+  TaskScheduler *const sched; // hash table entries to start from
   const size_t min_ref_nkmers, max_ref_nkmers; // how many kmers of homology req
 } BreakpointCaller;
 
@@ -72,6 +73,9 @@ static BreakpointCaller* brkpt_callers_new(size_t num_callers,
 
   size_t *callid = ctx_calloc(1, sizeof(size_t));
 
+  TaskScheduler *sched = ctx_malloc(sizeof(TaskScheduler));
+  task_sched_alloc(sched, db_graph->ht.capacity, num_callers);
+
   // Each colour in each caller can have a GraphCache path at once
   PathRefRun *path_ref_runs = ctx_calloc(num_callers*MAX_REFRUNS_PER_CALLER(ncols),
                                          sizeof(PathRefRun));
@@ -86,6 +90,7 @@ static BreakpointCaller* brkpt_callers_new(size_t num_callers,
                             .gzout = gzout,
                             .out_lock = out_lock,
                             .callid = callid,
+                            .sched = sched,
                             .allele_refs = path_ref_runs,
                             .flank5p_refs = path_ref_runs+MAX_REFRUNS_PER_ORIENT(ncols),
                             .min_ref_nkmers = min_ref_flank,
@@ -128,6 +133,8 @@ static void brkpt_callers_destroy(BreakpointCaller *callers, size_t num_callers)
   pthread_mutex_destroy(callers[0].out_lock);
   ctx_free(callers[0].out_lock);
   ctx_free(callers[0].callid);
+  task_sched_dealloc(callers[0].sched);
+  ctx_free(callers[0].sched);
   ctx_free(callers[0].allele_refs);
   ctx_free(callers);
 }
@@ -519,8 +526,8 @@ static void breakpoint_caller(void *ptr)
   BreakpointCaller *caller = (BreakpointCaller*)ptr;
   ctx_assert(caller->db_graph->num_edge_cols == 1);
 
-  HASH_ITERATE_PART(&caller->db_graph->ht, caller->threadid, caller->nthreads,
-                    breakpoint_caller_node, caller);
+  HASH_ITERATE_SCHED(&caller->db_graph->ht, caller->sched, caller->threadid,
+                     breakpoint_caller_node, caller);
 }
 
 // Print JSON header to gzout
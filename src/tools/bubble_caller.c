@@ -32,11 +32,15 @@ BubbleCaller* bubble_callers_new(size_t num_callers,
 
   size_t *num_bubbles_ptr = ctx_calloc(1, sizeof(size_t));
 
+  TaskScheduler *sched = ctx_malloc(sizeof(TaskScheduler));
+  task_sched_alloc(sched, db_graph->ht.capacity, num_callers);
+
   for(i = 0; i < num_callers; i++)
   {
     BubbleCaller tmp = {.threadid = i, .nthreads = num_callers,
                         .haploid_seen = ctx_calloc(1+prefs.num_haploid, sizeof(bool)),
                         .num_bubbles_ptr = num_bubbles_ptr,
+                        .sched = sched,
                         .prefs = prefs,
                         .db_graph = db_graph, .gzout = gzout,
                         .out_lock = out_lock};
@@ -82,6 +86,8 @@ void bubble_callers_destroy(BubbleCaller *callers, size_t num_callers)
   pthread_mutex_destroy(callers[0].out_lock);
   ctx_free(callers[0].out_lock);
   ctx_free(callers[0].num_bubbles_ptr);
+  task_sched_dealloc(callers[0].sched);
+  ctx_free(callers[0].sched);
   ctx_free(callers);
 }
 
@@ -270,8 +276,6 @@ void find_bubbles(BubbleCaller *caller, dBNode fork_node)
   Colour colour, colours_loaded = db_graph->num_of_cols;
   bool node_has_col[4];
 
-  uint32_t pathid;
-
   for(colour = 0; colour < colours_loaded; colour++)
   {
     if(!db_node_has_col(db_graph, fork_node.key, colour)) continue;
@@ -292,11 +296,11 @@ void find_bubbles(BubbleCaller *caller, dBNode fork_node)
         graph_walker_start(wlk, fork_node);
         graph_walker_force(wlk, nodes[i], num_edges_in_col > 1);
 
-        pathid = graph_crawler_load_path_limit(cache, nodes[i], wlk, rptwlk,
-                                               caller->prefs.max_allele_len);
+        graph_crawler_load_path_limit(cache, nodes[i], wlk, rptwlk,
+                                      caller->prefs.max_allele_len);
 
         graph_walker_finish(wlk);
-        graph_crawler_reset_rpt_walker(rptwlk, cache, pathid);
+        rpt_walker_clear(rptwlk);
       }
     }
   }
@@ -392,8 +396,8 @@ void bubble_caller(void *args)
 {
   BubbleCaller *caller = (BubbleCaller*)args;
 
-  HASH_ITERATE_PART(&caller->db_graph->ht, caller->threadid, caller->nthreads,
-                    bubble_caller_node, caller);
+  HASH_ITERATE_SCHED(&caller->db_graph->ht, caller->sched, caller->threadid,
+                     bubble_caller_node, caller);
 }
 
 void invoke_bubble_caller(size_t num_of_threads, BubbleCallingPrefs prefs,
@@ -39,6 +39,7 @@ typedef struct
 
   // Shared data
   size_t *num_bubbles_ptr; // statistics - shared pointer
+  TaskScheduler *const sched; // hash table entries to start from
   const BubbleCallingPrefs prefs;
   const dBGraph *db_graph;
   gzFile gzout;
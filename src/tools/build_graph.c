@@ -7,15 +7,96 @@
 #include "loading_stats.h"
 #include "util.h"
 #include "file_util.h"
+#include "covg_edge_buf.h"
+#include "thread_stats.h"
+#include "json_hdr.h"
 
 #include <pthread.h>
 #include "seq_file.h"
 
+typedef struct BuildGraphGrowthStruct BuildGraphGrowth;
+
 typedef struct
 {
-  dBGraph *const db_graph;
-  size_t rcounter; // counter of entries taken from the pool
-} BuildGraphData;
+  dBGraph *db_graph;
+  CovgEdgeBuffer cebuf; // thread-local coverage and edge updates
+  size_t *rcounter; // shared counter of entries taken from the pool
+  BuildGraphGrowth *growth; // NULL if the hash table has a fixed size
+  BuildGraphPartsBuffer *pbuf; // if not NULL, write kmers to partitions
+  LoadingStats *stats; // this thread's stats, one per task
+} BuildGraphWorker;
+
+//
+// Growing the hash table
+//
+// If db_graph->max_capacity is larger than the hash table, workers hold a
+// read lock whilst adding a batch of reads, having reserved room for every
+// kmer in the batch. A worker that cannot reserve room takes the write lock,
+// so all other workers are between batches, flushes the buffered updates of
+// all workers (they hold hkeys) and moves the graph into a larger table.
+//
+
+struct BuildGraphGrowthStruct
+{
+  pthread_rwlock_t lock;
+  volatile size_t reserved; // max kmers that may be added by current batches
+  volatile bool waiting; // a worker is waiting to grow the table
+  BuildGraphWorker *wrkrs;
+  size_t nthreads;
+};
+
+// Upper bound on the number of kmers a batch can add to the graph
+static size_t batch_max_kmers(const AsyncIOBatch *batch)
+{
+  size_t i, n = 0;
+  for(i = 0; i < batch->len; i++)
+    n += batch->data[i].r1.seq.end + batch->data[i].r2.seq.end;
+  return n;
+}
+
+// Take the read lock with room reserved for `nkmers` new kmers.
+// Grows the hash table first if needed.
+static void build_graph_reserve(BuildGraphWorker *wrkr, size_t nkmers)
+{
+  BuildGraphGrowth *gr = wrkr->growth;
+  dBGraph *db_graph = wrkr->db_graph;
+  const HashTable *ht = &db_graph->ht;
+  size_t i, reserved;
+
+  while(1)
+  {
+    pthread_rwlock_rdlock(&gr->lock);
+    reserved = __sync_add_and_fetch(&gr->reserved, nkmers);
+
+    // If we can't grow any more, the table may still have room
+    if(ht->capacity >= db_graph->max_capacity ||
+       (!gr->waiting && !db_graph_needs_grow(db_graph, reserved))) {
+      return;
+    }
+
+    __sync_sub_and_fetch(&gr->reserved, nkmers);
+    gr->waiting = true;
+    pthread_rwlock_unlock(&gr->lock);
+
+    pthread_rwlock_wrlock(&gr->lock);
+    gr->waiting = false;
+
+    // Another worker may have already grown the table
+    if(db_graph_needs_grow(db_graph, nkmers)) {
+      for(i = 0; i < gr->nthreads; i++)
+        covg_edge_buf_flush(&gr->wrkrs[i].cebuf);
+      db_graph_grow_for(db_graph, nkmers, gr->nthreads);
+    }
+
+    pthread_rwlock_unlock(&gr->lock);
+  }
+}
+
+static void build_graph_release(BuildGraphWorker *wrkr, size_t nkmers)
+{
+  __sync_sub_and_fetch(&wrkr->growth->reserved, nkmers);
+  pthread_rwlock_unlock(&wrkr->growth->lock);
+}
 
 //
 // Check for PCR duplicates
@@ -70,7 +151,7 @@ static bool seq_reads_are_novel(read_t *r1, read_t *r2,
   }
 
   size_t num_kmers_novel = !found1 + !found2;
-  __sync_fetch_and_add((volatile size_t*)&stats->num_kmers_novel, num_kmers_novel);
+  stats->num_kmers_novel += num_kmers_novel;
 
   // Each read gives no kmer or a duplicate kmer
   // used find_or_insert so if we have a kmer we have a graph node
@@ -94,41 +175,142 @@ static bool seq_reads_are_novel(read_t *r1, read_t *r2,
 
 // Threadsafe
 // Sequence must be entirely ACGT and len >= kmer_size
+// If cebuf is not NULL, coverage and edges are buffered in it rather than
+// being written directly to the graph
 // Returns number of novel kmers loaded
-size_t build_graph_from_str_mt(dBGraph *db_graph, size_t colour,
-                               const char *seq, size_t len)
+static size_t _build_graph_from_str(dBGraph *db_graph, size_t colour,
+                                    const char *seq, size_t len,
+                                    CovgEdgeBuffer *cebuf)
 {
   ctx_assert(len >= db_graph->kmer_size);
   const size_t kmer_size = db_graph->kmer_size;
-  BinaryKmer bkmer;
-  Nucleotide nuc;
-  dBNode prev, curr;
-  size_t i, num_novel_kmers = 0;
+  const size_t nkmers = len + 1 - kmer_size;
+  BinaryKmerIter kmer_iter;
+  BinaryKmer bkeys[DB_GRAPH_BATCH];
+  Orientation orients[DB_GRAPH_BATCH];
+  dBNode prev = DB_NODE_INIT, nodes[DB_GRAPH_BATCH];
+  bool found[DB_GRAPH_BATCH];
+  size_t i, j, m, num_novel_kmers = 0;
   size_t edge_col = db_graph->num_edge_cols == 1 ? 0 : colour;
+
+  binary_kmer_iter_init(&kmer_iter, kmer_size);
+  binary_kmer_iter_add_str(&kmer_iter, seq, kmer_size-1);
+
+  // Find or add a batch of kmers, then update coverage and edges in order
+  for(i = 0; i < nkmers; i += m)
+  {
+    m = MIN2(nkmers - i, DB_GRAPH_BATCH);
+    binary_kmer_iter_keys(&kmer_iter, seq+kmer_size-1+i, m, bkeys, orients);
+    db_graph_find_or_add_nodes_mt(db_graph, bkeys, orients, m, nodes, found);
+
+    if(cebuf != NULL) {
+      for(j = 0; j < m; j++) {
+        covg_edge_buf_update_node(cebuf, nodes[j], colour);
+        if(i+j > 0) covg_edge_buf_add_edge(cebuf, colour, prev, nodes[j]);
+        num_novel_kmers += !found[j];
+        prev = nodes[j];
+      }
+    }
+    else {
+      for(j = 0; j < m; j++) {
+        db_graph_update_node_mt(db_graph, nodes[j], colour);
+        if(i+j > 0) db_graph_add_edge_mt(db_graph, edge_col, prev, nodes[j]);
+        num_novel_kmers += !found[j];
+        prev = nodes[j];
+      }
+    }
+  }
+
+  return num_novel_kmers;
+}
+
+// Add a sighting of a kmer to coverage. If it is the first coverage in the
+// colour, also count the first sighting that was stored in the Bloom filter.
+static inline void bloom_add_covg_mt(dBGraph *db_graph, hkey_t hkey, Colour col)
+{
+  Covg v;
+  while((v = db_node_covg(db_graph,hkey,col)) < COVG_MAX &&
+        !__sync_bool_compare_and_swap(&db_node_covg(db_graph,hkey,col), v,
+                                      v ? v+1 : 2));
+
+  if(db_graph->node_in_cols != NULL) db_node_set_col_mt(db_graph, hkey, col);
+}
+
+// Threadsafe
+// Same as _build_graph_from_str() but a kmer is only added to the graph on its
+// second sighting in a colour, the first is recorded in db_graph->bloom.
+// Edges are only added between consecutive kmers that are both in the graph.
+// Returns number of novel kmers loaded
+static size_t _build_graph_from_str_bloom(dBGraph *db_graph, size_t colour,
+                                          const char *seq, size_t len)
+{
+  ctx_assert(len >= db_graph->kmer_size);
+  ctx_assert(db_graph->col_covgs != NULL);
+  const size_t kmer_size = db_graph->kmer_size;
+  const size_t nkmers = len + 1 - kmer_size;
+  BinaryKmerIter kmer_iter;
+  BinaryKmer bkeys[DB_GRAPH_BATCH];
+  Orientation orients[DB_GRAPH_BATCH];
+  dBNode prev = DB_NODE_INIT, node, nodes[DB_GRAPH_BATCH];
   bool found;
+  size_t i, j, m, num_novel_kmers = 0;
+  size_t edge_col = db_graph->num_edge_cols == 1 ? 0 : colour;
 
-  bkmer = binary_kmer_from_str(seq, kmer_size);
-  prev = db_graph_find_or_add_node_mt(db_graph, bkmer, &found);
-  db_graph_update_node_mt(db_graph, prev, colour);
-  num_novel_kmers += !found;
+  binary_kmer_iter_init(&kmer_iter, kmer_size);
+  binary_kmer_iter_add_str(&kmer_iter, seq, kmer_size-1);
 
-  for(i = kmer_size; i < len; i++)
+  for(i = 0; i < nkmers; i += m)
   {
-    nuc = dna_char_to_nuc(seq[i]);
-    bkmer = binary_kmer_left_shift_add(bkmer, kmer_size, nuc);
-    curr = db_graph_find_or_add_node_mt(db_graph, bkmer, &found);
-    db_graph_update_node_mt(db_graph, curr, colour);
-    db_graph_add_edge_mt(db_graph, edge_col, prev, curr);
-    num_novel_kmers += !found;
-    prev = curr;
+    m = MIN2(nkmers - i, DB_GRAPH_BATCH);
+    binary_kmer_iter_keys(&kmer_iter, seq+kmer_size-1+i, m, bkeys, orients);
+    db_graph_find_batch(db_graph, bkeys, orients, m, nodes);
+
+    for(j = 0; j < m; j++)
+    {
+      node = nodes[j];
+
+      if(node.key == HASH_NOT_FOUND ||
+         db_node_get_covg(db_graph, node.key, colour) == 0)
+      {
+        // First sighting in this colour
+        if(!kmer_bloom_add_mt(db_graph->bloom, bkeys[j], colour)) {
+          prev.key = HASH_NOT_FOUND;
+          continue;
+        }
+
+        if(node.key == HASH_NOT_FOUND) {
+          node.key = hash_table_find_or_insert_mt(&db_graph->ht, bkeys[j],
+                                                  &found, db_graph->bktlocks);
+          num_novel_kmers += !found;
+        }
+      }
+
+      bloom_add_covg_mt(db_graph, node.key, colour);
+
+      if(prev.key != HASH_NOT_FOUND)
+        db_graph_add_edge_mt(db_graph, edge_col, prev, node);
+
+      prev = node;
+    }
   }
 
   return num_novel_kmers;
 }
 
+size_t build_graph_from_str_mt(dBGraph *db_graph, size_t colour,
+                               const char *seq, size_t len)
+{
+  if(db_graph->bloom != NULL)
+    return _build_graph_from_str_bloom(db_graph, colour, seq, len);
+
+  return _build_graph_from_str(db_graph, colour, seq, len, NULL);
+}
+
 // Already found a start position
+// If pbuf is not NULL, kmers are written to partitions instead of the graph
 static void load_read(const read_t *r, uint8_t qual_cutoff, uint8_t hp_cutoff,
-                      LoadingStats *stats, Colour colour, dBGraph *db_graph)
+                      LoadingStats *stats, Colour colour, dBGraph *db_graph,
+                      CovgEdgeBuffer *cebuf, BuildGraphPartsBuffer *pbuf)
 {
   const size_t kmer_size = db_graph->kmer_size;
   size_t contig_start, contig_end, contig_len;
@@ -141,27 +323,41 @@ static void load_read(const read_t *r, uint8_t qual_cutoff, uint8_t hp_cutoff,
                                 qual_cutoff, hp_cutoff, &search_start);
 
     contig_len = contig_end - contig_start;
-    num_novel_kmers = build_graph_from_str_mt(db_graph, colour,
-                                              r->seq.b+contig_start, contig_len);
+
+    if(pbuf != NULL) {
+      build_graph_parts_add_str(pbuf, colour, r->seq.b+contig_start, contig_len);
+      num_novel_kmers = 0; // not known until partitions are loaded
+    }
+    else if(db_graph->bloom != NULL) {
+      num_novel_kmers = _build_graph_from_str_bloom(db_graph, colour,
+                                                    r->seq.b+contig_start,
+                                                    contig_len);
+    }
+    else {
+      num_novel_kmers = _build_graph_from_str(db_graph, colour,
+                                              r->seq.b+contig_start, contig_len,
+                                              cebuf);
+    }
 
     size_t contig_kmers = contig_len + 1 - kmer_size;
-    __sync_fetch_and_add((volatile size_t*)&stats->total_bases_loaded, contig_len);
-    __sync_fetch_and_add((volatile size_t*)&stats->num_kmers_loaded, contig_kmers);
-    __sync_fetch_and_add((volatile size_t*)&stats->num_kmers_novel, num_novel_kmers);
+    stats->total_bases_loaded += contig_len;
+    stats->num_kmers_loaded += contig_kmers;
+    stats->num_kmers_novel += num_novel_kmers;
     num_contigs++;
   }
 
-  __sync_fetch_and_add((volatile size_t*)&stats->contigs_parsed, num_contigs);
-  __sync_fetch_and_add((volatile size_t*)&stats->num_good_reads, num_contigs > 0);
-  __sync_fetch_and_add((volatile size_t*)&stats->num_bad_reads, num_contigs == 0);
+  stats->contigs_parsed += num_contigs;
+  stats->num_good_reads += (num_contigs > 0);
+  stats->num_bad_reads += (num_contigs == 0);
 }
 
-void build_graph_from_reads_mt(read_t *r1, read_t *r2,
-                               uint8_t fq_offset1, uint8_t fq_offset2,
-                               uint8_t fq_cutoff, uint8_t hp_cutoff,
-                               bool remove_pcr_dups, ReadMateDir matedir,
-                               LoadingStats *stats, size_t colour,
-                               dBGraph *db_graph)
+static void _build_graph_from_reads(read_t *r1, read_t *r2,
+                                    uint8_t fq_offset1, uint8_t fq_offset2,
+                                    uint8_t fq_cutoff, uint8_t hp_cutoff,
+                                    bool remove_pcr_dups, ReadMateDir matedir,
+                                    LoadingStats *stats, size_t colour,
+                                    dBGraph *db_graph, CovgEdgeBuffer *cebuf,
+                                    BuildGraphPartsBuffer *pbuf)
 {
   // status("r1: '%s' '%s'", r1->name.b, r1->seq.b);
   // if(r2) status("r2: '%s' '%s'", r2->name.b, r2->seq.b);
@@ -174,10 +370,10 @@ void build_graph_from_reads_mt(read_t *r1, read_t *r2,
   }
 
   size_t total_bases = r1->seq.end + (r2 ? r2->seq.end : 0);
-  __sync_fetch_and_add((volatile size_t*)&stats->total_bases_read, total_bases);
+  stats->total_bases_read += total_bases;
 
-  if(r2) __sync_fetch_and_add((volatile size_t*)&stats->num_pe_reads, 2);
-  else   __sync_fetch_and_add((volatile size_t*)&stats->num_se_reads, 1);
+  if(r2) stats->num_pe_reads += 2;
+  else   stats->num_se_reads++;
 
   // printf(">%s %zu\n", r1->name.b, colour);
 
@@ -185,36 +381,66 @@ void build_graph_from_reads_mt(read_t *r1, read_t *r2,
                                              fq_cutoff1, fq_cutoff2, hp_cutoff,
                                              matedir, stats, db_graph))
   {
-    if(r2) __sync_fetch_and_add((volatile size_t*)&stats->num_dup_pe_pairs, 1);
-    else   __sync_fetch_and_add((volatile size_t*)&stats->num_dup_se_reads, 1);
+    if(r2) stats->num_dup_pe_pairs++;
+    else   stats->num_dup_se_reads++;
   }
   else {
-    load_read(r1, fq_cutoff1, hp_cutoff, stats, colour, db_graph);
-    if(r2) load_read(r2, fq_cutoff2, hp_cutoff, stats, colour, db_graph);
+    load_read(r1, fq_cutoff1, hp_cutoff, stats, colour, db_graph, cebuf, pbuf);
+    if(r2) load_read(r2, fq_cutoff2, hp_cutoff, stats, colour, db_graph, cebuf, pbuf);
   }
 }
 
-static void add_reads_to_graph(AsyncIOData *data, void *ptr)
+void build_graph_from_reads_mt(read_t *r1, read_t *r2,
+                               uint8_t fq_offset1, uint8_t fq_offset2,
+                               uint8_t fq_cutoff, uint8_t hp_cutoff,
+                               bool remove_pcr_dups, ReadMateDir matedir,
+                               LoadingStats *stats, size_t colour,
+                               dBGraph *db_graph)
 {
-  BuildGraphData *wrkr = (BuildGraphData*)ptr;
-  BuildGraphTask *task = (BuildGraphTask*)data->ptr;
-  read_t *r2 = data->r2.name.end == 0 && data->r2.seq.end == 0 ? NULL : &data->r2;
+  _build_graph_from_reads(r1, r2, fq_offset1, fq_offset2, fq_cutoff, hp_cutoff,
+                          remove_pcr_dups, matedir, stats, colour,
+                          db_graph, NULL, NULL);
+}
+
+static void add_reads_to_graph(AsyncIOBatch *batch, void *ptr)
+{
+  BuildGraphWorker *wrkr = (BuildGraphWorker*)ptr;
+  AsyncIOData *data;
+  BuildGraphTask *task;
+  read_t *r2;
+  size_t i, nkmers = 0;
+
+  if(wrkr->growth != NULL) {
+    nkmers = batch_max_kmers(batch);
+    build_graph_reserve(wrkr, nkmers);
+  }
+
+  for(i = 0; i < batch->len; i++)
+  {
+    data = &batch->data[i];
+    task = (BuildGraphTask*)data->ptr;
+    r2 = data->r2.name.end == 0 && data->r2.seq.end == 0 ? NULL : &data->r2;
 
-  build_graph_from_reads_mt(&data->r1, r2,
+    _build_graph_from_reads(&data->r1, r2,
                             data->fq_offset1, data->fq_offset2,
                             task->fq_cutoff, task->hp_cutoff,
                             task->remove_pcr_dups, task->matedir,
-                            &task->stats,
-                            task->colour, wrkr->db_graph);
+                            &wrkr->stats[task->idx],
+                            task->colour, wrkr->db_graph, &wrkr->cebuf,
+                            wrkr->pbuf);
+  }
+
+  if(wrkr->growth != NULL) build_graph_release(wrkr, nkmers);
 
   // Print progress
-  size_t n = __sync_add_and_fetch((volatile size_t*)&wrkr->rcounter, 1);
-  ctx_update("BuildGraph", n);
+  size_t n = __sync_add_and_fetch((volatile size_t*)wrkr->rcounter, batch->len);
+  ctx_update_batch("BuildGraph", n, batch->len);
 }
 
-// One thread used per input file, num_build_threads used to add reads to graph
-void build_graph(dBGraph *db_graph, BuildGraphTask *files,
-                 size_t num_files, size_t num_build_threads)
+// If parts is not NULL, kmers are written to partitions instead of the graph
+static void _build_graph(dBGraph *db_graph, BuildGraphTask *files,
+                         size_t num_files, size_t num_build_threads,
+                         BuildGraphParts *parts)
 {
   ctx_assert(db_graph->bktlocks != NULL);
 
@@ -228,13 +454,74 @@ void build_graph(dBGraph *db_graph, BuildGraphTask *files,
     memcpy(&async_tasks[f], &files[f].files, sizeof(AsyncIOInput));
   }
 
-  BuildGraphData global_mem = {.db_graph = db_graph, .rcounter = 0};
+  // Each worker combines coverage and edge updates in its own buffer to avoid
+  // contention on the graph for repeated kmers
+  BuildGraphWorker *wrkrs = ctx_calloc(num_build_threads, sizeof(BuildGraphWorker));
+  size_t i, rcounter = 0;
+
+  BuildGraphGrowth growth = {.reserved = 0, .waiting = false,
+                             .wrkrs = wrkrs, .nthreads = num_build_threads};
+  bool growable = (parts == NULL &&
+                   db_graph->max_capacity > db_graph->ht.capacity);
+
+  BuildGraphPartsBuffer *pbufs = NULL;
+  if(parts != NULL) {
+    pbufs = ctx_calloc(num_build_threads, sizeof(BuildGraphPartsBuffer));
+    for(i = 0; i < num_build_threads; i++)
+      build_graph_parts_buf_alloc(&pbufs[i], parts);
+  }
+
+  if(growable && pthread_rwlock_init(&growth.lock, NULL) != 0)
+    die("pthread_rwlock_init failed");
+
+  // Each thread counts reads for every file in its own LoadingStats
+  ThreadStats tstats;
+  thread_stats_alloc(&tstats, num_build_threads, num_files*sizeof(LoadingStats));
+
+  for(i = 0; i < num_build_threads; i++) {
+    wrkrs[i].stats = (LoadingStats*)thread_stats_get(&tstats, i);
+    wrkrs[i].db_graph = db_graph;
+    wrkrs[i].rcounter = &rcounter;
+    wrkrs[i].growth = growable ? &growth : NULL;
+    wrkrs[i].pbuf = pbufs != NULL ? &pbufs[i] : NULL;
+    covg_edge_buf_alloc(&wrkrs[i].cebuf, COVG_EDGE_BUF_SIZE, db_graph);
+  }
+
+  asyncio_run_batch_pool(async_tasks, num_files, add_reads_to_graph,
+                         wrkrs, num_build_threads, sizeof(BuildGraphWorker));
 
-  asyncio_run_pool(async_tasks, num_files, add_reads_to_graph,
-                   &global_mem, num_build_threads, 0);
+  if(growable) pthread_rwlock_destroy(&growth.lock);
 
+  if(parts != NULL) {
+    for(i = 0; i < num_build_threads; i++) {
+      build_graph_parts_buf_flush(&pbufs[i]);
+      build_graph_parts_buf_dealloc(&pbufs[i]);
+    }
+    ctx_free(pbufs);
+  }
+
+  for(i = 0; i < num_build_threads; i++) {
+    covg_edge_buf_flush(&wrkrs[i].cebuf);
+    covg_edge_buf_dealloc(&wrkrs[i].cebuf);
+  }
+
+  ctx_free(wrkrs);
   ctx_free(async_tasks);
 
+  // Merge per-thread stats into each file's stats
+  cJSON *jthreads = cJSON_CreateArray();
+  for(i = 0; i < num_build_threads; i++) {
+    LoadingStats *tstat = (LoadingStats*)thread_stats_get(&tstats, i), tsum;
+    loading_stats_init(&tsum);
+    for(f = 0; f < num_files; f++) {
+      loading_stats_merge(&files[f].stats, &tstat[f]);
+      loading_stats_merge(&tsum, &tstat[f]);
+    }
+    cJSON_AddItemToArray(jthreads, loading_stats_to_json(&tsum));
+  }
+  json_hdr_add_thread_stats("build", jthreads);
+  thread_stats_dealloc(&tstats);
+
   // Copy stats into ginfo
   size_t max_col = 0;
   for(f = 0; f < num_files; f++) {
@@ -245,6 +532,24 @@ void build_graph(dBGraph *db_graph, BuildGraphTask *files,
   db_graph->num_of_cols_used = MAX2(db_graph->num_of_cols_used, max_col+1);
 }
 
+void build_graph(dBGraph *db_graph, BuildGraphTask *files,
+                 size_t num_files, size_t num_build_threads)
+{
+  _build_graph(db_graph, files, num_files, num_build_threads, NULL);
+}
+
+void build_graph_to_parts(dBGraph *db_graph, BuildGraphTask *files,
+                          size_t num_files, size_t num_build_threads,
+                          BuildGraphParts *parts)
+{
+  size_t f;
+  for(f = 0; f < num_files; f++)
+    if(files[f].remove_pcr_dups)
+      die("Cannot remove PCR duplicates when building out-of-core");
+
+  _build_graph(db_graph, files, num_files, num_build_threads, parts);
+}
+
 // One thread used per input file, num_build_threads used to add reads to graph
 // Updates ginfo
 void build_graph_from_seq(dBGraph *db_graph,
@@ -14,6 +14,7 @@
 #include "seq_reader.h"
 #include "async_read_io.h"
 #include "loading_stats.h"
+#include "build_graph_parts.h"
 
 typedef struct
 {
@@ -48,6 +49,7 @@ void build_graph_task_print(const BuildGraphTask *task);
 void build_graph_task_print_stats(const BuildGraphTask *task);
 
 // Threadsafe graph construction
+// `stats` is updated without locking, so each thread must pass its own
 // Beware: this function does not update ginfo
 void build_graph_from_reads_mt(read_t *r1, read_t *r2,
                                uint8_t fq_offset1, uint8_t fq_offset2,
@@ -61,6 +63,13 @@ void build_graph_from_reads_mt(read_t *r1, read_t *r2,
 void build_graph(dBGraph *db_graph, BuildGraphTask *files,
                  size_t num_files, size_t num_build_threads);
 
+// Same as build_graph() but kmers are written to partitions on disk, which are
+// loaded into db_graph by build_graph_parts_save(). Updates ginfo.
+// PCR duplicate removal is not supported.
+void build_graph_to_parts(dBGraph *db_graph, BuildGraphTask *files,
+                          size_t num_files, size_t num_build_threads,
+                          BuildGraphParts *parts);
+
 // One thread used per input file, num_build_threads used to add reads to graph
 // Updates ginfo
 void build_graph_from_seq(dBGraph *db_graph, seq_file_t **files,
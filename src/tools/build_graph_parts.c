@@ -0,0 +1,296 @@
+#include "global.h"
+#include "build_graph_parts.h"
+#include "db_node.h"
+#include "graph_format.h"
+#include "file_util.h"
+#include "util.h"
+
+void build_graph_parts_alloc(BuildGraphParts *parts, size_t nparts,
+                             size_t kmer_size, const char *tmp_dir)
+{
+  ctx_assert(nparts > 0);
+  size_t i;
+
+  BuildGraphParts tmp = {.fhs = ctx_calloc(nparts, sizeof(FILE*)),
+                         .locks = ctx_calloc(nparts, sizeof(pthread_mutex_t)),
+                         .nrecords = ctx_calloc(nparts, sizeof(uint64_t)),
+                         .nparts = nparts, .kmer_size = kmer_size};
+
+  for(i = 0; i < nparts; i++) {
+    tmp.fhs[i] = futil_create_tmp_file(tmp_dir);
+    if(pthread_mutex_init(&tmp.locks[i], NULL) != 0) die("Mutex init failed");
+  }
+
+  memcpy(parts, &tmp, sizeof(BuildGraphParts));
+}
+
+void build_graph_parts_dealloc(BuildGraphParts *parts)
+{
+  size_t i;
+  for(i = 0; i < parts->nparts; i++) {
+    fclose(parts->fhs[i]);
+    pthread_mutex_destroy(&parts->locks[i]);
+  }
+  ctx_free(parts->fhs);
+  ctx_free(parts->locks);
+  ctx_free(parts->nrecords);
+  memset(parts, 0, sizeof(BuildGraphParts));
+}
+
+size_t build_graph_parts_mem(size_t nparts, size_t nthreads)
+{
+  return nthreads * nparts * (BUILD_PARTS_BUFSIZE + sizeof(size_t)) +
+         BUILD_PARTS_CHUNK * BUILD_PARTS_REC_BYTES;
+}
+
+void build_graph_parts_buf_alloc(BuildGraphPartsBuffer *buf,
+                                 BuildGraphParts *parts)
+{
+  BuildGraphPartsBuffer tmp = {.parts = parts,
+                               .data = ctx_malloc(parts->nparts *
+                                                  BUILD_PARTS_BUFSIZE),
+                               .lens = ctx_calloc(parts->nparts, sizeof(size_t)),
+                               .hashes = NULL, .hashes_cap = 0};
+  memcpy(buf, &tmp, sizeof(BuildGraphPartsBuffer));
+}
+
+void build_graph_parts_buf_dealloc(BuildGraphPartsBuffer *buf)
+{
+  ctx_free(buf->data);
+  ctx_free(buf->lens);
+  ctx_free(buf->hashes);
+  memset(buf, 0, sizeof(BuildGraphPartsBuffer));
+}
+
+static void parts_buf_write(BuildGraphPartsBuffer *buf, size_t p)
+{
+  BuildGraphParts *parts = buf->parts;
+  size_t len = buf->lens[p];
+  if(len == 0) return;
+
+  pthread_mutex_lock(&parts->locks[p]);
+  if(fwrite(buf->data + p*BUILD_PARTS_BUFSIZE, 1, len, parts->fhs[p]) != len)
+    die("Cannot write to temporary file [%s]", strerror(errno));
+  parts->nrecords[p] += len / BUILD_PARTS_REC_BYTES;
+  pthread_mutex_unlock(&parts->locks[p]);
+
+  buf->lens[p] = 0;
+}
+
+void build_graph_parts_buf_flush(BuildGraphPartsBuffer *buf)
+{
+  size_t p;
+  for(p = 0; p < buf->parts->nparts; p++) parts_buf_write(buf, p);
+}
+
+static inline void parts_buf_add(BuildGraphPartsBuffer *buf, size_t p,
+                                 BinaryKmer bkey, uint32_t colour, Edges edges)
+{
+  if(buf->lens[p] + BUILD_PARTS_REC_BYTES > BUILD_PARTS_BUFSIZE)
+    parts_buf_write(buf, p);
+
+  uint8_t *ptr = buf->data + p*BUILD_PARTS_BUFSIZE + buf->lens[p];
+  memcpy(ptr, &bkey, sizeof(BinaryKmer));
+  memcpy(ptr+sizeof(BinaryKmer), &colour, sizeof(uint32_t));
+  ptr[sizeof(BinaryKmer)+sizeof(uint32_t)] = edges;
+  buf->lens[p] += BUILD_PARTS_REC_BYTES;
+}
+
+static inline uint64_t parts_hash(uint64_t x)
+{
+  x *= 0x9E3779B97F4A7C15UL;
+  return x ^ (x >> 31);
+}
+
+// Hash the canonical m-mer starting at each position of `seq`
+static void parts_mmer_hashes(const char *seq, size_t len, size_t mmer_size,
+                              uint64_t *hashes)
+{
+  const uint64_t mask = (1UL << (2*mmer_size)) - 1;
+  const size_t shift = 2*(mmer_size-1);
+  uint64_t fw = 0, rv = 0;
+  Nucleotide nuc;
+  size_t i;
+
+  for(i = 0; i < len; i++) {
+    nuc = dna_char_to_nuc(seq[i]);
+    fw = ((fw << 2) | nuc) & mask;
+    rv = (rv >> 2) | ((uint64_t)dna_nuc_complement(nuc) << shift);
+    if(i+1 >= mmer_size) hashes[i+1-mmer_size] = parts_hash(MIN2(fw, rv));
+  }
+}
+
+void build_graph_parts_add_str(BuildGraphPartsBuffer *buf, Colour colour,
+                               const char *seq, size_t len)
+{
+  const size_t kmer_size = buf->parts->kmer_size, nparts = buf->parts->nparts;
+  const size_t mmer_size = MIN2(BUILD_PARTS_MMER, kmer_size);
+  const size_t win = kmer_size - mmer_size + 1; // m-mers per kmer
+  const size_t nkmers = len + 1 - kmer_size, nmmers = len + 1 - mmer_size;
+
+  ctx_assert(len >= kmer_size);
+
+  if(buf->hashes_cap < nmmers) {
+    buf->hashes_cap = roundup2pow(nmmers);
+    buf->hashes = ctx_realloc(buf->hashes, buf->hashes_cap * sizeof(uint64_t));
+  }
+
+  const uint64_t *hashes = buf->hashes;
+  parts_mmer_hashes(seq, len, mmer_size, buf->hashes);
+
+  BinaryKmerIter kmer_iter;
+  BinaryKmer bkeys[DB_GRAPH_BATCH];
+  Orientation orients[DB_GRAPH_BATCH];
+  size_t i, j, k, m, x, minpos = 0;
+  Edges edges;
+
+  binary_kmer_iter_init(&kmer_iter, kmer_size);
+  binary_kmer_iter_add_str(&kmer_iter, seq, kmer_size-1);
+
+  for(i = 0; i < nkmers; i += m)
+  {
+    m = MIN2(nkmers - i, DB_GRAPH_BATCH);
+    binary_kmer_iter_keys(&kmer_iter, seq+kmer_size-1+i, m, bkeys, orients);
+
+    for(j = 0; j < m; j++)
+    {
+      // Minimizer is the smallest hash of the m-mers in kmer k. The canonical
+      // m-mers are the same in both orientations.
+      k = i+j;
+      if(k == 0 || minpos < k) {
+        for(minpos = k, x = k+1; x < k+win; x++)
+          if(hashes[x] < hashes[minpos]) minpos = x;
+      }
+      else if(hashes[k+win-1] < hashes[minpos]) minpos = k+win-1;
+
+      // Same edges as db_graph_add_edge_mt() would add
+      edges = 0;
+      if(k > 0) {
+        edges |= nuc_orient_to_edge(dna_nuc_complement(dna_char_to_nuc(seq[k-1])),
+                                    !orients[j]);
+      }
+      if(k+kmer_size < len) {
+        edges |= nuc_orient_to_edge(dna_char_to_nuc(seq[k+kmer_size]),
+                                    orients[j]);
+      }
+
+      parts_buf_add(buf, parts_hash(hashes[minpos]) % nparts,
+                    bkeys[j], colour, edges);
+    }
+  }
+}
+
+//
+// Loading partitions
+//
+
+typedef struct
+{
+  size_t threadid, nthreads, nrecs;
+  const uint8_t *recs;
+  dBGraph *db_graph;
+} PartsLoader;
+
+static void parts_load_thread(void *arg)
+{
+  const PartsLoader *ld = (const PartsLoader*)arg;
+  dBGraph *db_graph = ld->db_graph;
+  size_t i, start, end;
+  const uint8_t *ptr;
+  BinaryKmer bkey;
+  uint32_t col;
+  Edges edges;
+  hkey_t hkey;
+  bool found;
+
+  start = ld->nrecs * ld->threadid / ld->nthreads;
+  end = ld->nrecs * (ld->threadid+1) / ld->nthreads;
+
+  for(i = start; i < end; i++)
+  {
+    ptr = ld->recs + i*BUILD_PARTS_REC_BYTES;
+    memcpy(&bkey, ptr, sizeof(BinaryKmer));
+    memcpy(&col, ptr+sizeof(BinaryKmer), sizeof(uint32_t));
+    edges = ptr[sizeof(BinaryKmer)+sizeof(uint32_t)];
+
+    hkey = hash_table_find_or_insert_mt(&db_graph->ht, bkey, &found,
+                                        db_graph->bktlocks);
+    db_graph_update_node_mt(db_graph, (dBNode){.key = hkey, .orient = FORWARD},
+                            col);
+
+    if(edges && db_graph->col_edges != NULL) {
+      __sync_or_and_fetch(&db_node_edges(db_graph, hkey,
+                                         db_graph->num_edge_cols == 1 ? 0 : col),
+                          edges);
+    }
+  }
+}
+
+uint64_t build_graph_parts_save(BuildGraphParts *parts, dBGraph *db_graph,
+                                const char *out_path, size_t nthreads)
+{
+  ctx_assert(db_graph->bktlocks != NULL);
+  ctx_assert(db_graph->ht.num_kmers == 0);
+
+  GraphFileHeader hdr = {.version = CTX_GRAPH_FILEFORMAT,
+                         .kmer_size = (uint32_t)db_graph->kmer_size,
+                         .num_of_bitfields = NUM_BKMER_WORDS,
+                         .num_of_cols = (uint32_t)db_graph->num_of_cols,
+                         .capacity = db_graph->num_of_cols,
+                         .ginfo = db_graph->ginfo};
+
+  status("[build] Loading %zu partitions into: %s", parts->nparts,
+         futil_outpath_str(out_path));
+
+  FILE *fout = futil_fopen(out_path, "w");
+  graph_write_header(fout, &hdr);
+
+  uint8_t *recs = ctx_malloc(BUILD_PARTS_CHUNK * BUILD_PARTS_REC_BYTES);
+  PartsLoader *loaders = ctx_calloc(nthreads, sizeof(PartsLoader));
+  uint64_t nkmers = 0, part_nkmers;
+  size_t p, t, n;
+  FILE *fh;
+  char nrecs_str[50], nkmers_str[50];
+
+  for(p = 0; p < parts->nparts; p++)
+  {
+    fh = parts->fhs[p];
+    if(fflush(fh) != 0 || fseek(fh, 0L, SEEK_SET) != 0)
+      die("Cannot read temporary file [%s]", strerror(errno));
+
+    while((n = fread(recs, BUILD_PARTS_REC_BYTES, BUILD_PARTS_CHUNK, fh)) > 0)
+    {
+      db_graph_grow_for(db_graph, n, nthreads);
+
+      for(t = 0; t < nthreads; t++) {
+        loaders[t] = (PartsLoader){.threadid = t, .nthreads = nthreads,
+                                   .nrecs = n, .recs = recs,
+                                   .db_graph = db_graph};
+      }
+
+      util_run_threads(loaders, nthreads, sizeof(PartsLoader),
+                       nthreads, parts_load_thread);
+    }
+
+    if(ferror(fh)) die("Cannot read temporary file [%s]", strerror(errno));
+
+    part_nkmers = graph_write_all_kmers(fout, db_graph);
+    nkmers += part_nkmers;
+
+    ulong_to_str(parts->nrecords[p], nrecs_str);
+    ulong_to_str(part_nkmers, nkmers_str);
+    status("[build]  partition %zu/%zu: %s records, %s kmers",
+           p+1, parts->nparts, nrecs_str, nkmers_str);
+
+    db_graph_reset(db_graph);
+  }
+
+  fclose(fout);
+  ctx_free(loaders);
+  ctx_free(recs);
+
+  graph_writer_print_status(nkmers, db_graph->num_of_cols,
+                            futil_outpath_str(out_path), CTX_GRAPH_FILEFORMAT);
+
+  return nkmers;
+}
@@ -0,0 +1,81 @@
+#ifndef BUILD_GRAPH_PARTS_H_
+#define BUILD_GRAPH_PARTS_H_
+
+//
+// Out-of-core graph construction
+//
+// Instead of adding kmers to the graph, kmers from reads are written to
+// `nparts` temporary files as (kmer, colour, edges) records. Each kmer is sent
+// to the partition given by the minimizer of its canonical m-mers, so both
+// orientations of a kmer always go to the same file and consecutive kmers in a
+// read mostly go to the same file. Partitions are then loaded into the graph
+// one at a time and appended to the output file, so the hash table only has to
+// hold the largest partition.
+//
+
+#include <pthread.h>
+
+#include "cortex_types.h"
+#include "db_graph.h"
+
+// Length of the m-mers used to pick a kmer's partition
+#define BUILD_PARTS_MMER 15
+
+// Bytes buffered per partition by each thread before writing
+#define BUILD_PARTS_BUFSIZE (16*1024)
+
+// Minimizer partitions are not all the same size. Without --grow, the hash
+// table is sized for a partition this many times larger than the average
+#define BUILD_PARTS_SKEW 4
+
+// Records loaded into the graph at a time
+#define BUILD_PARTS_CHUNK (1UL<<20)
+
+// <kmer><4:colour><1:edges>
+#define BUILD_PARTS_REC_BYTES (sizeof(BinaryKmer) + sizeof(uint32_t) + sizeof(Edges))
+
+typedef struct
+{
+  FILE **fhs;
+  pthread_mutex_t *locks;
+  uint64_t *nrecords;
+  size_t nparts, kmer_size;
+} BuildGraphParts;
+
+// Per thread buffers
+typedef struct
+{
+  BuildGraphParts *parts;
+  uint8_t *data; // BUILD_PARTS_BUFSIZE bytes per partition
+  size_t *lens;
+  uint64_t *hashes; // m-mer hashes of the current contig
+  size_t hashes_cap;
+} BuildGraphPartsBuffer;
+
+// Temporary files are created in `tmp_dir` and deleted when closed
+void build_graph_parts_alloc(BuildGraphParts *parts, size_t nparts,
+                             size_t kmer_size, const char *tmp_dir);
+void build_graph_parts_dealloc(BuildGraphParts *parts);
+
+// Memory used by buffers and loading, not including the graph
+size_t build_graph_parts_mem(size_t nparts, size_t nthreads);
+
+void build_graph_parts_buf_alloc(BuildGraphPartsBuffer *buf,
+                                 BuildGraphParts *parts);
+void build_graph_parts_buf_dealloc(BuildGraphPartsBuffer *buf);
+
+// Write all buffered records to the partition files
+void build_graph_parts_buf_flush(BuildGraphPartsBuffer *buf);
+
+// Threadsafe with respect to other buffers on the same partitions
+// Sequence must be entirely ACGT and len >= kmer_size
+void build_graph_parts_add_str(BuildGraphPartsBuffer *buf, Colour colour,
+                               const char *seq, size_t len);
+
+// Load each partition into the empty graph in turn and append its kmers to
+// `out_path`. The header is made from db_graph->ginfo. The graph is left
+// empty. Returns number of kmers written.
+uint64_t build_graph_parts_save(BuildGraphParts *parts, dBGraph *db_graph,
+                                const char *out_path, size_t nthreads);
+
+#endif /* BUILD_GRAPH_PARTS_H_ */
@@ -1,9 +1,11 @@
 #include "global.h"
 #include "util.h"
 #include "file_util.h"
-#include "supernode.h"
+#include "unitig_index.h"
 #include "prune_nodes.h"
 #include "clean_graph.h"
+#include "thread_stats.h"
+#include "json_hdr.h"
 
 #include <math.h> // lgamma, tgamma
 #include <float.h> // DBL_MAX
@@ -11,10 +13,6 @@
 #define DUMP_COVG_ARRSIZE 1000
 #define DUMP_LEN_ARRSIZE 1000
 
-// Define a vector of Covg
-#include "madcrowlib/madcrow_buffer.h"
-madcrow_buffer(covg_buf,CovgBuffer,Covg);
-
 /**
  * Pick a cleaning threshold from kmer coverage histogram. Assumes low coverage
  * kmers are all due to error, to which it fits a gamma distribution. Then
@@ -86,30 +84,25 @@ int cleaning_pick_kmer_threshold(const uint64_t *kmer_covg, size_t arrlen,
   return fdr < fdr_limit ? (int)i : -1;
 }
 
-// #define supernode_covg(covgs,len) supernode_covg_mean(covgs,len)
-#define supernode_covg(covgs,len) supernode_read_starts(covgs,len)
+// #define supernode_covg(utig) ((utig)->covg_mean)
+#define supernode_covg(utig) ((utig)->read_starts)
 
 /**
  * Calculate cleaning threshold for supernodes from a given distribution
  * of supernode coverages
  * @param covgs histogram of supernode coverages
+ * @param seq_depth sequencing depth, or <= 0 to use `seq_depth_est`
+ * @param seq_depth_est mean kmer coverage of the graph
  */
 size_t cleaning_pick_supernode_threshold(const uint64_t *covgs, size_t len,
-                                         double seq_depth,
-                                         const dBGraph *db_graph)
+                                         double seq_depth, double seq_depth_est)
 {
   ctx_assert(len > 5);
-  ctx_assert(db_graph->ht.num_kmers > 0);
 
   size_t i, d1len = len-2, d2len = len-3, f1, f2;
   double *tmp = ctx_malloc((d1len+d2len) * sizeof(double));
   double *delta1 = tmp, *delta2 = tmp + d1len;
 
-  // Get sequencing depth from coverage
-  uint64_t covg_sum = 0, capacity = db_graph->ht.capacity * db_graph->num_of_cols;
-  for(i = 0; i < capacity; i++) covg_sum += db_graph->col_covgs[i];
-  double seq_depth_est = (double)covg_sum / db_graph->ht.num_kmers;
-
   status("[cleaning] Kmer depth before cleaning supernodes: %.2f", seq_depth_est);
   if(seq_depth <= 0) seq_depth = seq_depth_est;
   else status("[cleaning] Using sequence depth argument: %f", seq_depth);
@@ -144,170 +137,190 @@ size_t cleaning_pick_supernode_threshold(const uint64_t *covgs, size_t len,
   { status("[cleaning]   (using fallback1)"); return fallback_thresh+1; }
 }
 
+// Numbers of supernodes removed
+typedef struct
+{
+  uint64_t num_tips,      num_low_covg_snodes,      num_tip_and_low_snodes;
+  uint64_t num_tip_kmers, num_low_covg_snode_kmers, num_tip_and_low_snode_kmers;
+} CleaningCounts;
+
 typedef struct
 {
   const size_t nthreads, covg_threshold, min_keep_tip;
   bool use_supernode_covg; // if true use supernode otherwise kmer coverage
-  CovgBuffer *cbufs;
-  // uint64_t *covg_hist;
-  uint64_t *covg_hist_init, *covg_hist_cleaned;
-  uint64_t *covg_kmers_hist_init, *covg_kmers_hist_cleaned;
-  uint64_t *len_hist_init, *len_hist_cleaned;
+  // Histograms and counts are per thread until merged
+  ThreadHist thread_covg_hist, thread_covg_kmers_hist, thread_len_hist;
+  ThreadStats thread_counts; // CleaningCounts
+  uint64_t *covg_hist, *covg_kmers_hist, *len_hist; // merged
+  CleaningCounts counts; // merged
   const size_t covg_arrlen, len_arrlen;
-  uint8_t *keep_flags;
-  uint64_t num_tips,      num_low_covg_snodes,      num_tip_and_low_snodes;
-  uint64_t num_tip_kmers, num_low_covg_snode_kmers, num_tip_and_low_snode_kmers;
+  const int col; // colour being cleaned, -1 for all colours
+  uint8_t *keep_utigs; // one bit per unitig id
   const dBGraph *db_graph;
 } SupernodeCleaner;
 
-// Get coverages from nodes in nbuf, store in cbuf
-static inline void fetch_coverages(dBNodeBuffer nbuf, CovgBuffer *cbuf,
-                                   const dBGraph *db_graph)
+static inline Edges cleaner_edges(const dBGraph *db_graph, hkey_t hkey,
+                                  int col)
 {
-  size_t i;
-  covg_buf_reset(cbuf);
-  covg_buf_capacity(cbuf, nbuf.len);
-  cbuf->len = nbuf.len;
-  for(i = 0; i < nbuf.len; i++)
-    cbuf->data[i] = db_graph->col_covgs[nbuf.data[i].key];
+  return col < 0 ? db_node_get_edges_union(db_graph, hkey)
+                 : db_node_get_edges(db_graph, hkey, col);
 }
 
-static inline bool nodes_are_tip(dBNodeBuffer nbuf, const dBGraph *db_graph)
+static inline Covg cleaner_covg(const dBGraph *db_graph, hkey_t hkey, int col)
 {
-  Edges first = db_node_get_edges_union(db_graph, nbuf.data[0].key);
-  Edges last = db_node_get_edges_union(db_graph, nbuf.data[nbuf.len-1].key);
-  int in = edges_get_indegree(first, nbuf.data[0].orient);
-  int out = edges_get_outdegree(last, nbuf.data[nbuf.len-1].orient);
+  return col < 0 ? db_node_sum_covg(db_graph, hkey)
+                 : db_node_get_covg(db_graph, hkey, col);
+}
+
+static inline bool unitig_is_tip(const Unitig *utig, int col,
+                                 const dBGraph *db_graph)
+{
+  Edges first = cleaner_edges(db_graph, utig->first.key, col);
+  Edges last = cleaner_edges(db_graph, utig->last.key, col);
+  int in = edges_get_indegree(first, utig->first.orient);
+  int out = edges_get_outdegree(last, utig->last.orient);
   return (in+out <= 1);
 }
 
-static inline bool nodes_are_removable_tip(dBNodeBuffer nbuf,
-                                           size_t min_keep_tip,
+static inline bool unitig_is_removable_tip(const Unitig *utig,
+                                           size_t min_keep_tip, int col,
                                            const dBGraph *db_graph)
 {
-  return (nbuf.len < min_keep_tip && nodes_are_tip(nbuf, db_graph));
+  return (utig->len < min_keep_tip && unitig_is_tip(utig, col, db_graph));
 }
 
 
 static void supernode_cleaner_alloc(SupernodeCleaner *cl, size_t nthreads,
                                     bool use_supernode_covg,
                                     size_t covg_threshold, size_t min_keep_tip,
-                                    uint8_t *keep_flags,
+                                    int col, uint8_t *keep_utigs,
                                     const dBGraph *db_graph)
 {
-  size_t i;
-  CovgBuffer *cbufs = ctx_calloc(nthreads, sizeof(CovgBuffer));
-  for(i = 0; i < nthreads; i++)
-    covg_buf_alloc(&cbufs[i], 1024);
-
-  uint64_t *covg_hist_init, *covg_hist_cleaned;
-  uint64_t *covg_kmers_hist_init, *covg_kmers_hist_cleaned;
-  uint64_t *len_hist_init, *len_hist_cleaned;
-
-  covg_hist_init          = ctx_calloc(DUMP_COVG_ARRSIZE, sizeof(uint64_t));
-  covg_hist_cleaned       = ctx_calloc(DUMP_COVG_ARRSIZE, sizeof(uint64_t));
-  covg_kmers_hist_init    = ctx_calloc(DUMP_COVG_ARRSIZE, sizeof(uint64_t));
-  covg_kmers_hist_cleaned = ctx_calloc(DUMP_COVG_ARRSIZE, sizeof(uint64_t));
-  len_hist_init           = ctx_calloc(DUMP_LEN_ARRSIZE,  sizeof(uint64_t));
-  len_hist_cleaned        = ctx_calloc(DUMP_LEN_ARRSIZE,  sizeof(uint64_t));
-
   SupernodeCleaner tmp = {.nthreads = nthreads,
                           .covg_threshold = covg_threshold,
                           .min_keep_tip = min_keep_tip,
                           .use_supernode_covg = use_supernode_covg,
-                          .cbufs = cbufs,
-                          .covg_hist_init    = covg_hist_init,
-                          .covg_hist_cleaned = covg_hist_cleaned,
-                          .covg_kmers_hist_init = covg_kmers_hist_init,
-                          .covg_kmers_hist_cleaned = covg_kmers_hist_cleaned,
-                          .len_hist_init     = len_hist_init,
-                          .len_hist_cleaned  = len_hist_cleaned,
+                          .covg_hist = ctx_calloc(DUMP_COVG_ARRSIZE, sizeof(uint64_t)),
+                          .covg_kmers_hist = ctx_calloc(DUMP_COVG_ARRSIZE, sizeof(uint64_t)),
+                          .len_hist = ctx_calloc(DUMP_LEN_ARRSIZE, sizeof(uint64_t)),
+                          .counts = {0,0,0,0,0,0},
                           .covg_arrlen = DUMP_COVG_ARRSIZE,
                           .len_arrlen = DUMP_LEN_ARRSIZE,
-                          .keep_flags = keep_flags,
-                          .num_tips = 0,
-                          .num_low_covg_snodes = 0,
-                          .num_tip_and_low_snodes = 0,
-                          .num_tip_kmers = 0,
-                          .num_low_covg_snode_kmers = 0,
-                          .num_tip_and_low_snode_kmers = 0,
+                          .col = col,
+                          .keep_utigs = keep_utigs,
                           .db_graph = db_graph};
 
   memcpy(cl, &tmp, sizeof(SupernodeCleaner));
+
+  thread_hist_alloc(&cl->thread_covg_hist, nthreads, DUMP_COVG_ARRSIZE);
+  thread_hist_alloc(&cl->thread_covg_kmers_hist, nthreads, DUMP_COVG_ARRSIZE);
+  thread_hist_alloc(&cl->thread_len_hist, nthreads, DUMP_LEN_ARRSIZE);
+  thread_stats_alloc(&cl->thread_counts, nthreads, sizeof(CleaningCounts));
 }
 
 static void supernode_cleaner_dealloc(SupernodeCleaner *cl)
 {
-  size_t i;
-  for(i = 0; i < cl->nthreads; i++)
-    covg_buf_dealloc(&cl->cbufs[i]);
-  ctx_free(cl->cbufs);
-  ctx_free(cl->covg_hist_init);
-  ctx_free(cl->covg_hist_cleaned);
-  ctx_free(cl->covg_kmers_hist_init);
-  ctx_free(cl->covg_kmers_hist_cleaned);
-  ctx_free(cl->len_hist_init);
-  ctx_free(cl->len_hist_cleaned);
+  thread_hist_dealloc(&cl->thread_covg_hist);
+  thread_hist_dealloc(&cl->thread_covg_kmers_hist);
+  thread_hist_dealloc(&cl->thread_len_hist);
+  thread_stats_dealloc(&cl->thread_counts);
+  ctx_free(cl->covg_hist);
+  ctx_free(cl->covg_kmers_hist);
+  ctx_free(cl->len_hist);
   memset(cl, 0, sizeof(SupernodeCleaner));
 }
 
-static inline void supernode_get_covg(dBNodeBuffer nbuf, size_t threadid,
-                                      void *arg)
+// Sum histograms and counts of all threads
+static void supernode_cleaner_merge(SupernodeCleaner *cl)
 {
-  const SupernodeCleaner *cl = (const SupernodeCleaner*)arg;
-  size_t i, covg, len;
+  thread_hist_merge(&cl->thread_covg_hist, cl->covg_hist);
+  thread_hist_merge(&cl->thread_covg_kmers_hist, cl->covg_kmers_hist);
+  thread_hist_merge(&cl->thread_len_hist, cl->len_hist);
+
+  size_t i;
+  memset(&cl->counts, 0, sizeof(cl->counts));
+  for(i = 0; i < cl->nthreads; i++) {
+    const CleaningCounts *c = thread_stats_get(&cl->thread_counts, i);
+    cl->counts.num_tips                    += c->num_tips;
+    cl->counts.num_low_covg_snodes         += c->num_low_covg_snodes;
+    cl->counts.num_tip_and_low_snodes      += c->num_tip_and_low_snodes;
+    cl->counts.num_tip_kmers               += c->num_tip_kmers;
+    cl->counts.num_low_covg_snode_kmers    += c->num_low_covg_snode_kmers;
+    cl->counts.num_tip_and_low_snode_kmers += c->num_tip_and_low_snode_kmers;
+  }
+}
+
+// Record how many supernodes each thread removed in the JSON header
+static void supernode_cleaner_add_json(const SupernodeCleaner *cl)
+{
+  size_t i;
+  cJSON *jthreads = cJSON_CreateArray();
+  for(i = 0; i < cl->nthreads; i++) {
+    const CleaningCounts *c = thread_stats_get(&cl->thread_counts, i);
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "num_tips", c->num_tips);
+    cJSON_AddNumberToObject(json, "num_tip_kmers", c->num_tip_kmers);
+    cJSON_AddNumberToObject(json, "num_low_covg_snodes", c->num_low_covg_snodes);
+    cJSON_AddNumberToObject(json, "num_low_covg_snode_kmers",
+                            c->num_low_covg_snode_kmers);
+    cJSON_AddNumberToObject(json, "num_tip_and_low_snodes",
+                            c->num_tip_and_low_snodes);
+    cJSON_AddNumberToObject(json, "num_tip_and_low_snode_kmers",
+                            c->num_tip_and_low_snode_kmers);
+    cJSON_AddItemToArray(jthreads, json);
+  }
+  json_hdr_add_thread_stats("clean", jthreads);
+}
 
-  // Get coverage
-  CovgBuffer *cbuf = &cl->cbufs[threadid];
-  fetch_coverages(nbuf, cbuf, cl->db_graph);
+static void supernode_get_covg(ukey_t id, const Unitig *utig, size_t threadid,
+                               void *arg)
+{
+  (void)id;
+  SupernodeCleaner *cl = (SupernodeCleaner*)arg;
 
   if(cl->use_supernode_covg) {
     // Histogram is of supernode coverage
-    covg = supernode_covg(cbuf->data, cbuf->len);
-    covg = MIN2(covg, cl->covg_arrlen-1);
-    __sync_fetch_and_add((volatile uint64_t *)&cl->covg_hist_init[covg], 1);
-    __sync_fetch_and_add((volatile uint64_t *)&cl->covg_kmers_hist_init[covg], cbuf->len);
-  }
-  else {
-    // Histogram is of each kmer coverage
-    for(i = 0; i < cbuf->len; i++) {
-      covg = MIN2(cbuf->data[i], cl->covg_arrlen-1);
-      __sync_fetch_and_add((volatile uint64_t *)&cl->covg_hist_init[covg], 1);
-    }
+    size_t covg = supernode_covg(utig);
+    thread_hist_add(&cl->thread_covg_hist, threadid, covg, 1);
+    thread_hist_add(&cl->thread_covg_kmers_hist, threadid, covg, utig->len);
   }
 
   // Length histgogram
-  len = MIN2(cbuf->len, cl->len_arrlen-1);
-  __sync_fetch_and_add((volatile uint64_t *)&cl->len_hist_init[len], 1);
+  thread_hist_add(&cl->thread_len_hist, threadid, utig->len, 1);
 }
 
-/*
 typedef struct {
   size_t threadid, nthreads;
+  TaskScheduler *sched;
   SupernodeCleaner *cl;
+  uint64_t covg_sum, nkmers; // kmers with coverage in the colour being cleaned
 } KmerCleanerIterator;
 
-static inline void kmer_get_covg_node(hkey_t hkey, void *arg)
+static inline int kmer_get_covg_node(hkey_t hkey, KmerCleanerIterator *kcl)
 {
-  const SupernodeCleaner *cl = (const SupernodeCleaner*)arg;
-  size_t covg = db_node_sum_covg(cl->db_graph, hkey);
-  covg = MIN2(covg, cl->covg_arrlen-1);
-  __sync_fetch_and_add((volatile uint64_t *)&cl->covg_hist_init[covg], 1);
+  SupernodeCleaner *cl = kcl->cl;
+  size_t covg = cleaner_covg(cl->db_graph, hkey, cl->col);
+  if(covg == 0) return 0; // => keep iterating
+  kcl->covg_sum += covg;
+  kcl->nkmers++;
+  if(!cl->use_supernode_covg) {
+    // Histogram is of each kmer coverage
+    thread_hist_add(&cl->thread_covg_hist, kcl->threadid, covg, 1);
+  }
+  return 0; // => keep iterating
 }
 
 static void kmer_get_covg(void *arg)
 {
-  const KmerCleanerIterator *kcl = (const KmerCleanerIterator*)arg;
-  HASH_ITERATE_PART(&kcl->db_graph->ht, kcl->threadid, kcl->nthreads,
-                    kmer_get_covg_node, kcl->cl);
+  KmerCleanerIterator *kcl = (KmerCleanerIterator*)arg;
+  HASH_ITERATE_SCHED(&kcl->cl->db_graph->ht, kcl->sched, kcl->threadid,
+                     kmer_get_covg_node, kcl);
 }
-*/
 
 /**
  * Get coverage threshold for removing supernodes
  *
- * @param visited should be at least db_graph.ht.capcity bits long and initialised
- *                to zero. On return, it will be 1 at each original kmer index
+ * @param uidx unitig index of the graph
  * @param covgs_csv_path
  * @param lens_csv_path  paths to files to write CSV histogram of supernodes
                          coverages and lengths BEFORE ANY CLEANING.
@@ -318,7 +331,7 @@ int cleaning_get_threshold(size_t num_threads, bool use_supernode_covg,
                            double seq_depth,
                            const char *covgs_csv_path,
                            const char *lens_csv_path,
-                           uint8_t *visited,
+                           const UnitigIndex *uidx,
                            const dBGraph *db_graph)
 {
   // Estimate optimum cleaning threshold
@@ -327,44 +340,68 @@ int cleaning_get_threshold(size_t num_threads, bool use_supernode_covg,
 
   status("[cleaning]   Using %s method", use_supernode_covg ? "supernode" : "kmer gamma");
 
+  if(uidx->colour >= 0)
+    status("[cleaning]   in colour %i", uidx->colour);
+
   // Get supernode coverages and lengths
   SupernodeCleaner cl;
   supernode_cleaner_alloc(&cl, num_threads, use_supernode_covg,
-                          0, 0, NULL, db_graph);
+                          0, 0, uidx->colour, NULL, db_graph);
 
-  supernodes_iterate(num_threads, visited, db_graph, supernode_get_covg, &cl);
+  unitig_index_iterate(uidx, num_threads, supernode_get_covg, &cl);
 
-  // KmerCleanerIterator kcls[nthreads];
-  // for(i = 0; i < nthreads; i++)
-  //   kcls[i] = (KmerCleanerIterator){.threadid = i, .nthreads = nthreads, .cl = &cl};
+  // Get kmer coverage histogram (if not using supernode coverage) and
+  // sequencing depth estimate
+  size_t i;
+  uint64_t covg_sum = 0, nkmers = 0;
+  KmerCleanerIterator *kcls = ctx_calloc(num_threads, sizeof(KmerCleanerIterator));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, num_threads);
+
+  for(i = 0; i < num_threads; i++) {
+    kcls[i] = (KmerCleanerIterator){.threadid = i, .nthreads = num_threads,
+                                    .sched = &sched, .cl = &cl,
+                                    .covg_sum = 0, .nkmers = 0};
+  }
+
+  util_run_threads(kcls, num_threads, sizeof(kcls[0]), num_threads,
+                   kmer_get_covg);
+
+  for(i = 0; i < num_threads; i++) {
+    covg_sum += kcls[i].covg_sum;
+    nkmers += kcls[i].nkmers;
+  }
 
-  // util_run_threads(kcls, nthreads, sizeof(kcls[0]), nthreads, kmer_get_covg);
+  task_sched_dealloc(&sched);
+  ctx_free(kcls);
 
-  // Wipe visited kmer memory
-  memset(visited, 0, roundup_bits2bytes(db_graph->ht.capacity));
+  supernode_cleaner_merge(&cl);
 
   if(covgs_csv_path != NULL) {
-    cleaning_write_covg_histogram(covgs_csv_path, cl.covg_hist_init,
-                                  cl.covg_kmers_hist_init, cl.covg_arrlen);
+    cleaning_write_covg_histogram(covgs_csv_path, cl.covg_hist,
+                                  cl.covg_kmers_hist, cl.covg_arrlen);
   }
 
   if(lens_csv_path != NULL) {
-    cleaning_write_len_histogram(lens_csv_path, cl.len_hist_init, cl.len_arrlen,
+    cleaning_write_len_histogram(lens_csv_path, cl.len_hist, cl.len_arrlen,
                                  db_graph->kmer_size);
   }
 
   // set threshold using histogram and genome size
   int threshold_est = -1;
 
-  if(use_supernode_covg) {
-    threshold_est = cleaning_pick_supernode_threshold(cl.covg_hist_init,
+  if(nkmers == 0) {
+    warn("[cleaning] No kmers to pick a cleaning threshold from");
+  }
+  else if(use_supernode_covg) {
+    threshold_est = cleaning_pick_supernode_threshold(cl.covg_hist,
                                                       cl.covg_arrlen,
                                                       seq_depth,
-                                                      db_graph);
+                                                      (double)covg_sum / nkmers);
   } else {
     double fdr = 0.001;
     while(fdr < 1) {
-      threshold_est = cleaning_pick_kmer_threshold(cl.covg_hist_init,
+      threshold_est = cleaning_pick_kmer_threshold(cl.covg_hist,
                                                    cl.covg_arrlen,
                                                    fdr);
       if(threshold_est >= 0) break;
@@ -384,71 +421,58 @@ int cleaning_get_threshold(size_t num_threads, bool use_supernode_covg,
   return threshold_est;
 }
 
-static inline void supernode_mark(dBNodeBuffer nbuf, size_t threadid,
-                                  void *arg)
+static void supernode_mark(ukey_t id, const Unitig *utig, size_t threadid,
+                           void *arg)
 {
   SupernodeCleaner *cl = (SupernodeCleaner*)arg;
+  CleaningCounts *counts = thread_stats_get(&cl->thread_counts, threadid);
   bool low_covg_snode = false, removable_tip = false;
-  size_t i, covg = 0, len;
-
-  CovgBuffer *cbuf = &cl->cbufs[threadid];
-  fetch_coverages(nbuf, cbuf, cl->db_graph);
-
-  if(cl->use_supernode_covg) {
-    covg = supernode_covg(cbuf->data, cbuf->len);
-  }
-  else {
-    // Covg is max coverage of all kmers
-    for(i = 0; i < cbuf->len; i++)
-      covg = MAX2(covg, cbuf->data[i]);
-  }
+  size_t covg;
 
+  // if not using supernode covg, covg is max coverage of all kmers
+  covg = cl->use_supernode_covg ? supernode_covg(utig) : utig->covg_max;
   low_covg_snode = (covg < cl->covg_threshold);
 
   // Remove tips
-  removable_tip = nodes_are_removable_tip(nbuf, cl->min_keep_tip, cl->db_graph);
+  removable_tip = unitig_is_removable_tip(utig, cl->min_keep_tip, cl->col,
+                                          cl->db_graph);
 
   if(low_covg_snode && removable_tip) {
-    __sync_fetch_and_add((volatile uint64_t *)&cl->num_tip_and_low_snodes, 1);
-    __sync_fetch_and_add((volatile uint64_t *)&cl->num_tip_and_low_snode_kmers, nbuf.len);
+    counts->num_tip_and_low_snodes++;
+    counts->num_tip_and_low_snode_kmers += utig->len;
   } else if(low_covg_snode) {
-    __sync_fetch_and_add((volatile uint64_t *)&cl->num_low_covg_snodes, 1);
-    __sync_fetch_and_add((volatile uint64_t *)&cl->num_low_covg_snode_kmers, nbuf.len);
+    counts->num_low_covg_snodes++;
+    counts->num_low_covg_snode_kmers += utig->len;
   } else if(removable_tip) {
-    __sync_fetch_and_add((volatile uint64_t *)&cl->num_tips, 1);
-    __sync_fetch_and_add((volatile uint64_t *)&cl->num_tip_kmers, nbuf.len);
+    counts->num_tips++;
+    counts->num_tip_kmers += utig->len;
   } else {
-    for(i = 0; i < nbuf.len; i ++)
-      (void)bitset_set_mt(cl->keep_flags, nbuf.data[i].key);
+    (void)bitset_set_mt(cl->keep_utigs, id);
 
     // Add to histograms
-    covg = MIN2(covg, cl->covg_arrlen-1);
-    len = MIN2(nbuf.len, cl->covg_arrlen-1);
-
-    __sync_fetch_and_add((volatile uint64_t *)&cl->covg_hist_cleaned[covg], 1);
-    __sync_fetch_and_add((volatile uint64_t *)&cl->covg_kmers_hist_cleaned[covg], cbuf->len);
-    __sync_fetch_and_add((volatile uint64_t *)&cl->len_hist_cleaned[len], 1);
+    thread_hist_add(&cl->thread_covg_hist, threadid, covg, 1);
+    thread_hist_add(&cl->thread_covg_kmers_hist, threadid, covg, utig->len);
+    thread_hist_add(&cl->thread_len_hist, threadid, utig->len, 1);
   }
 }
 
 // Remove low coverage supernodes and clip tips
 // - Remove supernodes with coverage < `covg_threshold`
 // - Remove tips shorter than `min_keep_tip`
-// `visited`, `keep` should each be at least db_graph.ht.capcity bits long
-//   and initialised to zero. On return,
-//   `visited` will be 1 at each original kmer index
-//   `keep` will be 1 at each retained kmer index
+// `keep` should be at least db_graph.ht.capcity bits long and initialised to
+//   zero. It is used to mark retained kmers and is zero again on return.
+// `uidx` is updated to match the cleaned graph
 void clean_graph(size_t num_threads, bool use_supernode_covg,
                  size_t covg_threshold, size_t min_keep_tip,
                  const char *covgs_csv_path, const char *lens_csv_path,
-                 uint8_t *visited, uint8_t *keep, dBGraph *db_graph)
+                 uint8_t *keep, UnitigIndex *uidx, dBGraph *db_graph)
 {
-  ctx_assert(db_graph->num_of_cols == 1);
   ctx_assert(db_graph->num_edge_cols > 0);
 
-  size_t init_nkmers = db_graph->ht.num_kmers;
+  // Kmers in the colour being cleaned (all kmers if cleaning every colour)
+  size_t init_nkmers = uidx->num_kmers;
 
-  if(db_graph->ht.num_kmers == 0) return;
+  if(init_nkmers == 0) return;
   if(covg_threshold == 0 && min_keep_tip == 0) {
     warn("[cleaning] No cleaning specified");
     return;
@@ -462,45 +486,52 @@ void clean_graph(size_t num_threads, bool use_supernode_covg,
   if(min_keep_tip > 0)
     status("[cleaning] Removing tips shorter than %zu...", min_keep_tip);
 
+  if(uidx->colour >= 0)
+    status("[cleaning]   in colour %i", uidx->colour);
+
   status("[cleaning]   using %zu threads", num_threads);
 
-  // Mark nodes to keep
+  // Mark unitigs to keep
+  uint8_t *keep_utigs = ctx_calloc(roundup_bits2bytes(uidx->utigs.len), 1);
   SupernodeCleaner cl;
   supernode_cleaner_alloc(&cl, num_threads, use_supernode_covg, covg_threshold,
-                          min_keep_tip, keep, db_graph);
-  supernodes_iterate(num_threads, visited, db_graph, supernode_mark, &cl);
+                          min_keep_tip, uidx->colour, keep_utigs, db_graph);
+  unitig_index_iterate(uidx, num_threads, supernode_mark, &cl);
+  supernode_cleaner_merge(&cl);
+  supernode_cleaner_add_json(&cl);
 
   // Print numbers of kmers that are being removed
 
   char num_snodes_str[50], num_tips_str[50], num_tip_snodes_str[50];
   char num_snode_kmers_str[50], num_tip_kmers_str[50], num_tip_snode_kmers_str[50];
-  ulong_to_str(cl.num_low_covg_snodes, num_snodes_str);
-  ulong_to_str(cl.num_tips, num_tips_str);
-  ulong_to_str(cl.num_tip_and_low_snodes, num_tip_snodes_str);
-  ulong_to_str(cl.num_low_covg_snode_kmers, num_snode_kmers_str);
-  ulong_to_str(cl.num_tip_kmers, num_tip_kmers_str);
-  ulong_to_str(cl.num_tip_and_low_snode_kmers, num_tip_snode_kmers_str);
+  ulong_to_str(cl.counts.num_low_covg_snodes, num_snodes_str);
+  ulong_to_str(cl.counts.num_tips, num_tips_str);
+  ulong_to_str(cl.counts.num_tip_and_low_snodes, num_tip_snodes_str);
+  ulong_to_str(cl.counts.num_low_covg_snode_kmers, num_snode_kmers_str);
+  ulong_to_str(cl.counts.num_tip_kmers, num_tip_kmers_str);
+  ulong_to_str(cl.counts.num_tip_and_low_snode_kmers, num_tip_snode_kmers_str);
 
   status("[cleaning] Removing %s low coverage supernode%s [%s kmer%s], "
          "%s supernode tip%s [%s kmer%s] "
          "and %s of both [%s kmer%s]",
-         num_snodes_str, util_plural_str(cl.num_low_covg_snodes),
-         num_snode_kmers_str, util_plural_str(cl.num_low_covg_snode_kmers),
-         num_tips_str, util_plural_str(cl.num_tips),
-         num_tip_kmers_str, util_plural_str(cl.num_tip_kmers),
+         num_snodes_str, util_plural_str(cl.counts.num_low_covg_snodes),
+         num_snode_kmers_str, util_plural_str(cl.counts.num_low_covg_snode_kmers),
+         num_tips_str, util_plural_str(cl.counts.num_tips),
+         num_tip_kmers_str, util_plural_str(cl.counts.num_tip_kmers),
          num_tip_snodes_str,
-         num_tip_snode_kmers_str, util_plural_str(cl.num_tip_and_low_snode_kmers));
+         num_tip_snode_kmers_str, util_plural_str(cl.counts.num_tip_and_low_snode_kmers));
 
   // Remove nodes not marked to keep
-  prune_nodes_lacking_flag(num_threads, keep, db_graph);
+  unitig_index_flag_kmers(uidx, num_threads, keep_utigs, keep, db_graph);
+  unitig_index_prune(uidx, num_threads, keep, db_graph);
 
   // Wipe memory
-  memset(visited, 0, roundup_bits2bytes(db_graph->ht.capacity));
   memset(keep, 0, roundup_bits2bytes(db_graph->ht.capacity));
+  ctx_free(keep_utigs);
 
   // Print status update
   char remain_nkmers_str[100], removed_nkmers_str[100];
-  size_t remain_nkmers = db_graph->ht.num_kmers;
+  size_t remain_nkmers = uidx->num_kmers;
   size_t removed_nkmers = init_nkmers - remain_nkmers;
   ulong_to_str(remain_nkmers, remain_nkmers_str);
   ulong_to_str(removed_nkmers, removed_nkmers_str);
@@ -509,18 +540,72 @@ void clean_graph(size_t num_threads, bool use_supernode_covg,
          (100.0*removed_nkmers)/init_nkmers);
 
   if(covgs_csv_path != NULL) {
-    cleaning_write_covg_histogram(covgs_csv_path, cl.covg_hist_cleaned,
-                                  cl.covg_kmers_hist_cleaned, cl.covg_arrlen);
+    cleaning_write_covg_histogram(covgs_csv_path, cl.covg_hist,
+                                  cl.covg_kmers_hist, cl.covg_arrlen);
   }
 
   if(lens_csv_path != NULL) {
-    cleaning_write_len_histogram(lens_csv_path, cl.len_hist_cleaned,
+    cleaning_write_len_histogram(lens_csv_path, cl.len_hist,
                                  cl.len_arrlen, db_graph->kmer_size);
   }
 
   supernode_cleaner_dealloc(&cl);
 }
 
+typedef struct {
+  size_t threadid, nthreads;
+  TaskScheduler *sched;
+  uint8_t *keep;
+  const dBGraph *db_graph;
+} ColouredKmerMarker;
+
+static inline int kmer_mark_coloured(hkey_t hkey, const ColouredKmerMarker *mk)
+{
+  if(db_node_sum_covg(mk->db_graph, hkey) > 0)
+    (void)bitset_set_mt(mk->keep, hkey);
+  return 0; // => keep iterating
+}
+
+static void kmers_mark_coloured(void *arg)
+{
+  const ColouredKmerMarker *mk = (const ColouredKmerMarker*)arg;
+  HASH_ITERATE_SCHED(&mk->db_graph->ht, mk->sched, mk->threadid,
+                     kmer_mark_coloured, mk);
+}
+
+// Remove kmers that are not in any colour from the hash table
+// `keep` should be at least db_graph.ht.capcity bits long and initialised to
+//   zero. It is zero again on return.
+void cleaning_remove_uncoloured(size_t num_threads, uint8_t *keep,
+                                dBGraph *db_graph)
+{
+  size_t i, init_nkmers = db_graph->ht.num_kmers;
+  ColouredKmerMarker *mks = ctx_calloc(num_threads, sizeof(ColouredKmerMarker));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, num_threads);
+
+  for(i = 0; i < num_threads; i++) {
+    mks[i] = (ColouredKmerMarker){.threadid = i, .nthreads = num_threads,
+                                  .sched = &sched, .keep = keep,
+                                  .db_graph = db_graph};
+  }
+
+  util_run_threads(mks, num_threads, sizeof(mks[0]), num_threads,
+                   kmers_mark_coloured);
+
+  task_sched_dealloc(&sched);
+  ctx_free(mks);
+
+  prune_nodes_lacking_flag(num_threads, keep, db_graph);
+  memset(keep, 0, roundup_bits2bytes(db_graph->ht.capacity));
+
+  char remain_nkmers_str[100], removed_nkmers_str[100];
+  ulong_to_str(db_graph->ht.num_kmers, remain_nkmers_str);
+  ulong_to_str(init_nkmers - db_graph->ht.num_kmers, removed_nkmers_str);
+  status("[cleaning] Removed %s kmers not in any colour, %s remaining",
+         removed_nkmers_str, remain_nkmers_str);
+}
+
 static FILE* _open_histogram_file(const char *path, const char *name)
 {
   FILE *fout;
@@ -2,6 +2,7 @@
 #define CLEAN_GRAPH_H_
 
 #include "db_graph.h"
+#include "unitig_index.h"
 
 /**
  * Pick a cleaning threshold from kmer coverage histogram. Assumes low coverage
@@ -21,16 +22,16 @@ int cleaning_pick_kmer_threshold(const uint64_t *kmer_covg, size_t arrlen,
  * Calculate cleaning threshold for supernodes from a given distribution
  * of supernode coverages
  * @param covgs histogram of supernode coverages
+ * @param seq_depth sequencing depth, or <= 0 to use `seq_depth_est`
+ * @param seq_depth_est mean kmer coverage of the graph
  */
 size_t cleaning_pick_supernode_threshold(const uint64_t *covgs, size_t len,
-                                         double seq_depth,
-                                         const dBGraph *db_graph);
+                                         double seq_depth, double seq_depth_est);
 
 /**
  * Get coverage threshold for removing supernodes
  *
- * @param visited should be at least db_graph.ht.capcity bits long and initialised
- *                to zero. On return, it will be 1 at each original kmer index
+ * @param uidx unitig index of the graph
  * @param covgs_csv_path
  * @param lens_csv_path  paths to files to write CSV histogram of supernodes
                          coverages and lengths BEFORE ANY CLEANING.
@@ -41,15 +42,18 @@ int cleaning_get_threshold(size_t num_threads,
                            bool use_supernode_covg, double seq_depth,
                            const char *covgs_csv_path,
                            const char *lens_csv_path,
-                           uint8_t *visited,
+                           const UnitigIndex *uidx,
                            const dBGraph *db_graph);
 
 /**
  * Remove low coverage supernodes and clip tips
  * - Remove supernodes with coverage < `covg_threshold`
  * - Remove tips shorter than `min_keep_tip`
- * `visited`, `keep` should each be at least db_graph.ht.capcity bits long
- *   and initialised to zero.
+ * `keep` should be at least db_graph.ht.capcity bits long and initialised
+ *   to zero. It is zero again on return.
+ * `uidx` is the unitig index of the graph and is updated to match the
+ *   cleaned graph. If it is the index of a single colour (see
+ *   unitig_index_build_col()) only that colour is cleaned.
  * `covgs_csv_path` and `lens_csv_path` are paths to files to write CSV
  *   histogram of supernodes coverages and lengths AFTER CLEANING.
  *   If NULL these are ignored.
@@ -57,7 +61,16 @@ int cleaning_get_threshold(size_t num_threads,
 void clean_graph(size_t num_threads, bool use_supernode_covg,
                  size_t covg_threshold, size_t min_keep_tip,
                  const char *covgs_csv_path, const char *lens_csv_path,
-                 uint8_t *visited, uint8_t *keep, dBGraph *db_graph);
+                 uint8_t *keep, UnitigIndex *uidx, dBGraph *db_graph);
+
+/**
+ * Remove kmers that are not in any colour from the hash table, for use after
+ * cleaning colours separately.
+ * `keep` should be at least db_graph.ht.capcity bits long and initialised
+ *   to zero. It is zero again on return.
+ */
+void cleaning_remove_uncoloured(size_t num_threads, uint8_t *keep,
+                                dBGraph *db_graph);
 
 void cleaning_write_covg_histogram(const char *path,
                                    const uint64_t *covg_hist,
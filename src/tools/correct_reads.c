@@ -6,6 +6,7 @@
 #include "seq_reader.h"
 #include "file_util.h"
 #include "msg-pool/msgpool.h"
+#include "json_hdr.h"
 
 typedef struct
 {
@@ -359,7 +360,15 @@ void correct_reads(CorrectAlnInput *inputs, size_t num_inputs,
                      wrkrs, num_threads, sizeof(CorrectReadsWorker));
   }
 
-  // Merge stats into workers[0]
+  // Record per-thread stats then merge stats into workers[0]
+  cJSON *threads = cJSON_CreateArray();
+  for(i = 0; i < num_threads; i++) {
+    cJSON_AddItemToArray(threads,
+                         correct_aln_stats_to_json(&wrkrs[i].corrector.aln_stats,
+                                                   &wrkrs[i].corrector.load_stats));
+  }
+  json_hdr_add_thread_stats("correct", threads);
+
   for(i = 1; i < num_threads; i++)
     correct_aln_merge_stats(&wrkrs[0].corrector, &wrkrs[i].corrector);
 
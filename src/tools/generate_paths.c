@@ -14,6 +14,7 @@
 #include "seq_reader.h"
 #include "binary_seq.h"
 #include "gpath_checks.h"
+#include "json_hdr.h"
 
 //
 // Multithreaded code to add paths to the graph from sequence data
@@ -356,9 +357,14 @@ static void worker_contig_to_junctions(GenPathWorker *wrkr,
   const size_t contig_len = contig->len;
   const size_t ctxcol = wrkr->task.crt_params.ctxcol;
 
+  // If colours share one set of edges, only keep edges to kmers in ctxcol
+  const bool edges_per_col = (db_graph->num_edge_cols == db_graph->num_of_cols);
+
   for(i = 0; i < contig_len; i++)
   {
-    edges = db_node_get_edges(db_graph, nodes[i].key, ctxcol);
+    edges = edges_per_col ? db_node_get_edges(db_graph, nodes[i].key, ctxcol)
+                          : db_node_both_edges_in_col(nodes[i].key, ctxcol,
+                                                      db_graph);
     outdegree = edges_get_outdegree(edges, nodes[i].orient);
     indegree = edges_get_indegree(edges, nodes[i].orient);
 
@@ -494,8 +500,22 @@ void generate_paths(CorrectAlnInput *tasks, size_t num_inputs,
                    workers, num_workers, sizeof(GenPathWorker));
 
   ctx_free(asyncio_tasks);
+}
+
+// Record per-thread stats in the JSON header then merge them into workers[0]
+void gen_paths_merge_stats(GenPathWorker *workers, size_t num_workers)
+{
+  size_t i;
+  cJSON *threads = cJSON_CreateArray();
+
+  for(i = 0; i < num_workers; i++) {
+    cJSON_AddItemToArray(threads,
+                         correct_aln_stats_to_json(&workers[i].corrector.aln_stats,
+                                                   &workers[i].corrector.load_stats));
+  }
+
+  json_hdr_add_thread_stats("thread", threads);
 
-  // Merge stats into workers[0]
   for(i = 1; i < num_workers; i++)
     correct_aln_merge_stats(&workers[0].corrector, &workers[i].corrector);
 }
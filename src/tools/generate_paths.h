@@ -26,9 +26,14 @@ void gen_paths_from_str_mt(GenPathWorker *gen_path_wrkr, char *seq,
                            CorrectAlnParam params);
 
 // workers array must be at least as long as tasks
+// Stats are kept per worker until gen_paths_merge_stats() is called
 void generate_paths(CorrectAlnInput *tasks, size_t num_tasks,
                     GenPathWorker *workers, size_t num_workers);
 
+// Record per-thread stats in the JSON header (see json_hdr_add_thread_stats())
+// then merge them into workers[0]
+void gen_paths_merge_stats(GenPathWorker *workers, size_t num_workers);
+
 CorrectAlnStats* gen_paths_get_aln_stats(GenPathWorker *wrkr);
 LoadingStats* gen_paths_get_stats(GenPathWorker *wrkr);;
 
@@ -155,6 +155,7 @@ static inline int infer_edges_node(hkey_t hkey,
 
 typedef struct {
   const size_t threadid, nthreads;
+  TaskScheduler *const sched;
   const bool add_all_edges;
   const dBGraph *db_graph;
   size_t num_nodes_modified;
@@ -166,10 +167,10 @@ static void infer_edges_worker(void *arg)
   size_t num_nodes_modified = 0;
   Covg covgs[wrkr->db_graph->num_of_cols];
 
-  HASH_ITERATE_PART(&wrkr->db_graph->ht, wrkr->threadid, wrkr->nthreads,
-                    infer_edges_node,
-                    wrkr->add_all_edges, covgs, wrkr->db_graph,
-                    &num_nodes_modified);
+  HASH_ITERATE_SCHED(&wrkr->db_graph->ht, wrkr->sched, wrkr->threadid,
+                     infer_edges_node,
+                     wrkr->add_all_edges, covgs, wrkr->db_graph,
+                     &num_nodes_modified);
 
   wrkr->num_nodes_modified = num_nodes_modified;
 }
@@ -183,9 +184,12 @@ size_t infer_edges(size_t nthreads, bool add_all_edges, const dBGraph *db_graph)
   status("[inferedges] Processing stream");
 
   InferEdgesWorker *wrkrs = ctx_calloc(nthreads, sizeof(InferEdgesWorker));
+  TaskScheduler sched;
+  task_sched_alloc(&sched, db_graph->ht.capacity, nthreads);
 
   for(i = 0; i < nthreads; i++) {
     InferEdgesWorker tmp = {.threadid = i, .nthreads = nthreads,
+                            .sched = &sched,
                             .add_all_edges = add_all_edges,
                             .db_graph = db_graph,
                             .num_nodes_modified = 0};
@@ -199,6 +203,7 @@ size_t infer_edges(size_t nthreads, bool add_all_edges, const dBGraph *db_graph)
   for(i = 0; i < nthreads; i++)
     num_nodes_modified += wrkrs[i].num_nodes_modified;
 
+  task_sched_dealloc(&sched);
   ctx_free(wrkrs);
 
   return num_nodes_modified;
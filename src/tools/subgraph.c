@@ -8,24 +8,44 @@
 #include "loading_stats.h"
 #include "util.h"
 
+// Each thread collects this many fringe nodes before adding them to the
+// shared fringe for the next step
+#define SUBGRAPH_LOCAL_FRINGE 4096
+
 typedef struct
 {
   const dBGraph *const db_graph; // graph we are operating on
   uint8_t *const kmer_mask; // bitset of visited kmers
   const bool grab_supernodes; // grab entire supernodes or just kmers
+  const size_t dist; // how many steps to extend from seed kmers
+  const size_t num_fringe_nodes; // fringe size that fits in memory limit
   dBNodeBuffer nbufs[2], snode_buf;
   LoadingStats stats;
 } SubgraphBuilder;
 
+typedef struct
+{
+  size_t threadid;
+  const dBNodeBuffer *fringe; // nodes to extend from in this step
+  TaskScheduler *sched; // splits fringe between threads
+  dBNodeBuffer *next_fringe; // shared, protected by lock
+  pthread_mutex_t *lock;
+  dBNodeBuffer local; // this thread's part of next_fringe
+  uint8_t *kmer_mask;
+  const dBGraph *db_graph;
+} SubgraphExtender;
+
 static void subgraph_builder_alloc(SubgraphBuilder *builder,
-                                   size_t num_fringe_nodes,
+                                   size_t dist, size_t num_fringe_nodes,
                                    bool grab_supernodes,
                                    uint8_t *kmer_mask,
                                    const dBGraph *graph)
 {
   SubgraphBuilder tmp = {.db_graph = graph,
                          .kmer_mask = kmer_mask,
-                         .grab_supernodes = grab_supernodes};
+                         .grab_supernodes = grab_supernodes,
+                         .dist = dist,
+                         .num_fringe_nodes = num_fringe_nodes};
 
   memcpy(builder, &tmp, sizeof(SubgraphBuilder));
   db_node_buf_alloc(&builder->nbufs[0], num_fringe_nodes);
@@ -42,6 +62,7 @@ static void subgraph_builder_dealloc(SubgraphBuilder *builder)
 }
 
 // Mark all kmers touched by a read, if they already exist in the graph
+// Nodes are added to nbuf unless it is NULL
 static void mark_bkmer(BinaryKmer bkmer, dBNodeBuffer *nbuf,
                        uint8_t *kmer_mask, const dBGraph *db_graph)
 {
@@ -53,12 +74,9 @@ static void mark_bkmer(BinaryKmer bkmer, dBNodeBuffer *nbuf,
     status("got bkmer %s\n", tmp);
   #endif
 
-  // attempt_add return index of item or -1 on failure
   if(node.key != HASH_NOT_FOUND) {
-    if(!bitset_get(kmer_mask, node.key) && nbuf->capacity > 0 &&
-       db_node_buf_attempt_add(nbuf, node) < 0) {
-      die("Please increase <mem> size");
-    }
+    if(!bitset_get(kmer_mask, node.key) && nbuf != NULL)
+      db_node_buf_add(nbuf, node);
     bitset_set(kmer_mask, node.key);
   }
 }
@@ -76,14 +94,11 @@ static inline void mark_snode(BinaryKmer bkmer,
     db_node_buf_reset(snode_buf);
     supernode_find(node.key, snode_buf, db_graph);
 
-    for(i = 0; i < snode_buf->len; i++) {
+    for(i = 0; i < snode_buf->len; i++)
       bitset_set(kmer_mask, snode_buf->data[i].key);
-      // attempt_add return index of item or -1 on failure
-      if(nbuf->capacity > 0 &&
-         db_node_buf_attempt_add(nbuf, snode_buf->data[i]) < 0) {
-        die("Please increase <mem> size");
-      }
-    }
+
+    if(nbuf != NULL)
+      db_node_buf_append(nbuf, snode_buf->data, snode_buf->len);
   }
 }
 
@@ -94,37 +109,49 @@ static void store_read_nodes(read_t *r1, read_t *r2,
   SubgraphBuilder *builder = (SubgraphBuilder*)ptr;
   const dBGraph *db_graph = builder->db_graph;
 
+  // Only need to remember seed nodes if we are extending from them
+  dBNodeBuffer *nbuf = builder->dist > 0 ? &builder->nbufs[0] : NULL;
+
   if(builder->grab_supernodes)
   {
     READ_TO_BKMERS(r1, db_graph->kmer_size, 0, 0, &builder->stats, mark_snode,
-                   &builder->nbufs[0], &builder->snode_buf,
-                   builder->kmer_mask, db_graph);
+                   nbuf, &builder->snode_buf, builder->kmer_mask, db_graph);
     if(r2 != NULL) {
       READ_TO_BKMERS(r2, db_graph->kmer_size, 0, 0, &builder->stats, mark_snode,
-                     &builder->nbufs[0], &builder->snode_buf,
-                     builder->kmer_mask, db_graph);
+                     nbuf, &builder->snode_buf, builder->kmer_mask, db_graph);
     }
   }
   else
   {
     READ_TO_BKMERS(r1, db_graph->kmer_size, 0, 0, &builder->stats, mark_bkmer,
-                   &builder->nbufs[0], builder->kmer_mask, db_graph);
+                   nbuf, builder->kmer_mask, db_graph);
     if(r2 != NULL) {
       READ_TO_BKMERS(r2, db_graph->kmer_size, 0, 0, &builder->stats, mark_bkmer,
-                     &builder->nbufs[0], builder->kmer_mask, db_graph);
+                     nbuf, builder->kmer_mask, db_graph);
     }
   }
 }
 
-static void store_node_neighbours(const hkey_t hkey, dBNodeBuffer *nbuf,
-                                  uint8_t *kmer_mask, const dBGraph *db_graph)
+static void flush_local_fringe(SubgraphExtender *wrkr)
 {
+  pthread_mutex_lock(wrkr->lock);
+  db_node_buf_append(wrkr->next_fringe, wrkr->local.data, wrkr->local.len);
+  pthread_mutex_unlock(wrkr->lock);
+  db_node_buf_reset(&wrkr->local);
+}
+
+// Claim unvisited neighbours of a node, adding them to the next fringe
+static void store_node_neighbours(const hkey_t hkey, SubgraphExtender *wrkr)
+{
+  const dBGraph *db_graph = wrkr->db_graph;
+
   // Get neighbours
   BinaryKmer bkmer = db_node_get_bkmer(db_graph, hkey);
   Edges edges = db_node_get_edges_union(db_graph, hkey);
   size_t num_next, i;
   dBNode next_nodes[8];
   Nucleotide next_bases[8];
+  bool got_lock;
 
   // Get neighbours in forward dir
   num_next  = db_graph_next_nodes(db_graph, bkmer, FORWARD, edges,
@@ -134,39 +161,94 @@ static void store_node_neighbours(const hkey_t hkey, dBNodeBuffer *nbuf,
   num_next += db_graph_next_nodes(db_graph, bkmer, REVERSE, edges,
                                   next_nodes+num_next, next_bases+num_next);
 
-  // if not flagged add to list
-  // attempt_add return index of item or -1 on failure
+  // if not flagged, flag and add to list
+  // only one thread can set the flag, so each node is added once
   for(i = 0; i < num_next; i++) {
-    if(!bitset_get(kmer_mask, next_nodes[i].key) &&
-       db_node_buf_attempt_add(nbuf, next_nodes[i]) < 0) {
-      die("Please increase <mem> size");
-    }
-    bitset_set(kmer_mask, next_nodes[i].key);
+    bitlock_try_acquire(wrkr->kmer_mask, next_nodes[i].key, &got_lock);
+    if(got_lock) db_node_buf_add(&wrkr->local, next_nodes[i]);
   }
+
+  if(wrkr->local.len >= SUBGRAPH_LOCAL_FRINGE)
+    flush_local_fringe(wrkr);
 }
 
+static void subgraph_extend_thread(void *arg)
+{
+  SubgraphExtender *wrkr = (SubgraphExtender*)arg;
+  const dBNode *fringe = wrkr->fringe->data;
+  size_t start, end, i;
+
+  while(task_sched_next(wrkr->sched, wrkr->threadid, &start, &end))
+    for(i = start; i < end; i++)
+      store_node_neighbours(fringe[i].key, wrkr);
 
-static void extend(SubgraphBuilder *builder, size_t dist)
+  flush_local_fringe(wrkr);
+}
+
+// Level-synchronous breadth first search. Each step the fringe is split
+// between threads, which claim neighbours by atomically setting their bit in
+// kmer_mask. The fringe grows beyond the memory limit rather than failing.
+static void extend(SubgraphBuilder *builder, size_t nthreads)
 {
-  const dBGraph *db_graph = builder->db_graph;
-  uint8_t *kmer_mask = builder->kmer_mask;
+  const size_t dist = builder->dist;
   dBNodeBuffer *nbuf0 = &builder->nbufs[0], *nbuf1 = &builder->nbufs[1];
-  size_t d, i;
+  size_t d, i, nthreads_step;
+  bool warned = false;
+
+  if(dist == 0) return;
+
+  char dist_str[100];
+  ulong_to_str(dist, dist_str);
+  status("Extending subgraph by %s kmers with %zu thread%s\n",
+         dist_str, nthreads, util_plural_str(nthreads));
+
+  pthread_mutex_t lock;
+  if(pthread_mutex_init(&lock, NULL) != 0) die("Mutex init failed");
+
+  TaskScheduler sched;
+  SubgraphExtender *wrkrs = ctx_calloc(nthreads, sizeof(SubgraphExtender));
+
+  for(i = 0; i < nthreads; i++) {
+    wrkrs[i] = (SubgraphExtender){.threadid = i, .sched = &sched,
+                                  .lock = &lock,
+                                  .kmer_mask = builder->kmer_mask,
+                                  .db_graph = builder->db_graph};
+    db_node_buf_alloc(&wrkrs[i].local, SUBGRAPH_LOCAL_FRINGE+8);
+  }
 
-  if(dist > 0)
+  for(d = 0; d < dist && nbuf0->len > 0; d++)
   {
-    char dist_str[100];
-    ulong_to_str(dist, dist_str);
-    status("Extending subgraph by %s kmers\n", dist_str);
-
-    for(d = 0; d < dist; d++) {
-      db_node_buf_reset(nbuf1);
-      for(i = 0; i < nbuf0->len; i++) {
-        store_node_neighbours(nbuf0->data[i].key, nbuf1, kmer_mask, db_graph);
-      }
-      SWAP(nbuf0, nbuf1);
+    db_node_buf_reset(nbuf1);
+
+    // Don't start threads to extend a handful of nodes
+    nthreads_step = (nbuf0->len + SUBGRAPH_LOCAL_FRINGE - 1) / SUBGRAPH_LOCAL_FRINGE;
+    nthreads_step = MIN2(nthreads_step, nthreads);
+    task_sched_alloc(&sched, nbuf0->len, nthreads_step);
+
+    for(i = 0; i < nthreads_step; i++) {
+      wrkrs[i].fringe = nbuf0;
+      wrkrs[i].next_fringe = nbuf1;
+    }
+
+    util_run_threads(wrkrs, nthreads_step, sizeof(wrkrs[0]),
+                     nthreads_step, subgraph_extend_thread);
+
+    task_sched_dealloc(&sched);
+
+    if(!warned && nbuf1->len > builder->num_fringe_nodes) {
+      char nfringe_str[100];
+      ulong_to_str(nbuf1->len, nfringe_str);
+      warn("Fringe of search (%s kmers) is larger than memory limit allows"
+           " (set -m <mem> higher)", nfringe_str);
+      warned = true;
     }
+
+    SWAP(nbuf0, nbuf1);
   }
+
+  for(i = 0; i < nthreads; i++) db_node_buf_dealloc(&wrkrs[i].local);
+  ctx_free(wrkrs);
+  pthread_mutex_destroy(&lock);
 }
 
 static void print_stats(const SubgraphBuilder *builder)
@@ -188,8 +270,9 @@ static size_t get_num_fringe_nodes(size_t fringe_mem, size_t dist)
 // `nthreads` number of threads to use
 // `dist` is how many steps away from seed kmers to take
 // `invert`, if true, means only save kmers not touched
-// `fringe_mem` is how many bytes can be used to remember the fringe of
-// the breadth first search (we use 8 bytes per kmer)
+// `fringe_mem` is how many bytes should be used to remember the fringe of
+// the breadth first search (we use 8 bytes per kmer). If the fringe gets
+// larger we warn and use more memory.
 // `kmer_mask` should be a bit array (one bit per kmer) of zero'd memory
 void subgraph_from_reads(dBGraph *db_graph, size_t nthreads, size_t dist,
                          bool invert, bool grab_supernodes,
@@ -200,8 +283,8 @@ void subgraph_from_reads(dBGraph *db_graph, size_t nthreads, size_t dist,
   size_t i, num_of_fringe_nodes = get_num_fringe_nodes(fringe_mem, dist);
 
   SubgraphBuilder builder;
-  subgraph_builder_alloc(&builder, num_of_fringe_nodes, grab_supernodes,
-                         kmer_mask, db_graph);
+  subgraph_builder_alloc(&builder, dist, num_of_fringe_nodes,
+                         grab_supernodes, kmer_mask, db_graph);
 
   // Load sequence and mark in first pass
   read_t r1;
@@ -215,7 +298,7 @@ void subgraph_from_reads(dBGraph *db_graph, size_t nthreads, size_t dist,
 
   seq_read_dealloc(&r1);
 
-  extend(&builder, dist);
+  extend(&builder, nthreads);
   subgraph_builder_dealloc(&builder);
 
   if(invert) {
@@ -233,8 +316,9 @@ void subgraph_from_reads(dBGraph *db_graph, size_t nthreads, size_t dist,
 // `nthreads` number of threads to use
 // `dist` is how many steps away from seed kmers to take
 // `invert`, if true, means only save kmers not touched
-// `fringe_mem` is how many bytes can be used to remember the fringe of
-// the breadth first search (we use 8 bytes per kmer)
+// `fringe_mem` is how many bytes should be used to remember the fringe of
+// the breadth first search (we use 8 bytes per kmer). If the fringe gets
+// larger we warn and use more memory.
 // `kmer_mask` should be a bit array (one bit per kmer) of zero'd memory
 void subgraph_from_seq(dBGraph *db_graph, size_t nthreads, size_t dist,
                        bool invert, bool grab_supernodes,
@@ -245,8 +329,8 @@ void subgraph_from_seq(dBGraph *db_graph, size_t nthreads, size_t dist,
   size_t i, num_of_fringe_nodes = get_num_fringe_nodes(fringe_mem, dist);
 
   SubgraphBuilder builder;
-  subgraph_builder_alloc(&builder, num_of_fringe_nodes, grab_supernodes,
-                         kmer_mask, db_graph);
+  subgraph_builder_alloc(&builder, dist, num_of_fringe_nodes,
+                         grab_supernodes, kmer_mask, db_graph);
 
   // Load sequence and mark in first pass
   char empty[10] = "";
@@ -262,7 +346,7 @@ void subgraph_from_seq(dBGraph *db_graph, size_t nthreads, size_t dist,
 
   print_stats(&builder);
 
-  extend(&builder, dist);
+  extend(&builder, nthreads);
   subgraph_builder_dealloc(&builder);
 
   if(invert) {
@@ -11,8 +11,9 @@
 
 // `dist` is how many steps away from seed kmers to take
 // `invert`, if true, means only save kmers not touched
-// `fringe_mem` is how many bytes can be used to remember the fringe of
-// the breadth first search (we use 8 bytes per kmer)
+// `fringe_mem` is how many bytes should be used to remember the fringe of
+// the breadth first search (we use 8 bytes per kmer). If the fringe gets
+// larger we warn and use more memory.
 // `kmer_mask` should be a bit array (one bit per kmer) of zero'd memory
 void subgraph_from_reads(dBGraph *db_graph, size_t nthreads, size_t dist,
                          bool invert, bool grab_supernodes,
@@ -22,8 +23,9 @@ void subgraph_from_reads(dBGraph *db_graph, size_t nthreads, size_t dist,
 // `nthreads` number of threads to use
 // `dist` is how many steps away from seed kmers to take
 // `invert`, if true, means only save kmers not touched
-// `fringe_mem` is how many bytes can be used to remember the fringe of
-// the breadth first search (we use 8 bytes per kmer)
+// `fringe_mem` is how many bytes should be used to remember the fringe of
+// the breadth first search (we use 8 bytes per kmer). If the fringe gets
+// larger we warn and use more memory.
 // `kmer_mask` should be a bit array (one bit per kmer) of zero'd memory
 void subgraph_from_seq(dBGraph *db_graph, size_t nthreads, size_t dist,
                        bool invert, bool grab_supernodes,
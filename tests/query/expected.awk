@@ -0,0 +1,23 @@
+#
+# Print the expected output of `ctx query` for one colour graphs
+# usage: awk -f expected.awk <(ctx view -k in.ctx) queries.txt
+#
+
+function revcmp(kmer,    i, rc) {
+  rc = "";
+  for(i = length(kmer); i > 0; i--) rc = rc comp[substr(kmer, i, 1)];
+  return rc;
+}
+
+BEGIN { comp["A"]="T"; comp["C"]="G"; comp["G"]="C"; comp["T"]="A"; }
+
+# Kmers in the graph
+NR == FNR { graph[$1] = $0; next; }
+
+# Queries
+{
+  rc = revcmp($1);
+  key = ($1 < rc ? $1 : rc);
+  if(key in graph) print graph[key];
+  else print key, 0, "........";
+}